@@ -1081,6 +1081,12 @@ int opt_cpucount(void *optctx, const char *opt, const char *arg)
     return ret;
 }
 
+int opt_thread_pool(void *optctx, const char *opt, const char *arg)
+{
+    av_cpu_set_thread_pool(parse_number_or_die(opt, arg, OPT_INT, -1, INT_MAX));
+    return 0;
+}
+
 static void expand_filename_template(AVBPrint *bp, const char *template,
                                      struct tm *tm)
 {
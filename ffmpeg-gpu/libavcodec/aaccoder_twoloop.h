@@ -105,7 +105,7 @@ static void search_for_quantizers_twoloop(AVCodecContext *avctx,
 
     int fflag, minscaler, maxscaler, nminscaler;
     int its  = 0;
-    int maxits = 30;
+    int maxits = s->options.preset == AAC_PRESET_QUALITY ? 30 : 12;
     int allz = 0;
     int tbits;
     int cutoff = 1024;
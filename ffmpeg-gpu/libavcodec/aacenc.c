@@ -554,6 +554,109 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+/**
+ * Search the coding tools and quantizers of a channel element, with the
+ * context of the slice thread running it.
+ */
+static int search_element(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    AACEncContext *s0 = avctx->priv_data;
+    AACEncContext *s  = s0->thread_ctx[threadnr];
+    const FFPsyWindowInfo *windows = arg, *wi;
+    const int tag   = s0->chan_map[jobnr+1];
+    const int chans = tag == TYPE_CPE ? 2 : 1;
+    ChannelElement *cpe = &s0->cpe[jobnr];
+    SingleChannelElement *sce;
+    int i, ch, w, start_ch = 0, filtered = 0;
+
+    for (i = 0; i < jobnr; i++)
+        start_ch += s0->chan_map[i+1] == TYPE_CPE ? 2 : 1;
+    wi = windows + start_ch;
+
+    s->psy.bitres.alloc = s0->bitres_alloc[jobnr];
+    /* Noise of each element from its own sequence, whatever the thread */
+    s->random_state = s0->random_state + jobnr * 0x9E3779B9U;
+    s->cur_type = tag;
+    for (ch = 0; ch < chans; ch++) {
+        s->cur_channel = start_ch + ch;
+        if (s->options.pns && s->coder->mark_pns)
+            s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
+        s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
+    }
+    if (chans > 1
+        && wi[0].window_type[0] == wi[1].window_type[0]
+        && wi[0].window_shape   == wi[1].window_shape) {
+
+        cpe->common_window = 1;
+        for (w = 0; w < wi[0].num_windows; w++) {
+            if (wi[0].grouping[w] != wi[1].grouping[w]) {
+                cpe->common_window = 0;
+                break;
+            }
+        }
+    }
+    for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
+        sce = &cpe->ch[ch];
+        s->cur_channel = start_ch + ch;
+        if (s->options.tns && s->coder->search_for_tns)
+            s->coder->search_for_tns(s, sce);
+        if (s->options.tns && s->coder->apply_tns_filt)
+            s->coder->apply_tns_filt(s, sce);
+        if (sce->tns.present)
+            filtered = 1;
+        if (s->options.pns && s->coder->search_for_pns)
+            s->coder->search_for_pns(s, avctx, sce);
+    }
+    s->cur_channel = start_ch;
+    if (s->options.intensity_stereo) { /* Intensity Stereo */
+        if (s->coder->search_for_is)
+            s->coder->search_for_is(s, avctx, cpe);
+        apply_intensity_stereo(cpe);
+    }
+    if (s->options.pred) { /* Prediction */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = start_ch + ch;
+            if (s->options.pred && s->coder->search_for_pred)
+                s->coder->search_for_pred(s, sce);
+            if (sce->ics.predictor_present)
+                filtered = 1;
+        }
+        if (s->coder->adjust_common_pred)
+            s->coder->adjust_common_pred(s, cpe);
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = start_ch + ch;
+            if (s->options.pred && s->coder->apply_main_pred)
+                s->coder->apply_main_pred(s, sce);
+        }
+        s->cur_channel = start_ch;
+    }
+    if (s->options.mid_side) { /* Mid/Side stereo */
+        if (s->options.mid_side == -1 && s->coder->search_for_ms)
+            s->coder->search_for_ms(s, cpe);
+        else if (cpe->common_window)
+            memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
+        apply_mid_side_stereo(cpe);
+    }
+    adjust_frame_information(cpe, chans);
+    if (s->options.ltp) { /* LTP */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = start_ch + ch;
+            if (s->coder->search_for_ltp)
+                s->coder->search_for_ltp(s, sce, cpe->common_window);
+            if (sce->ics.ltp.present)
+                filtered = 1;
+        }
+        s->cur_channel = start_ch;
+        if (s->coder->adjust_common_ltp)
+            s->coder->adjust_common_ltp(s, cpe);
+    }
+    s0->coeffs_filtered[jobnr] = filtered;
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
@@ -564,7 +667,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
     IndividualChannelStream *ics;
     int i, its, ch, w, chans, tag, start_ch, ret, frame_bits;
     int target_bits, rate_bits, too_many_bits, too_few_bits;
-    int ms_mode = 0, is_mode = 0, tns_mode = 0, pred_mode = 0;
+    int ms_mode = 0, is_mode = 0, filter_mode = 0;
     int chan_el_counter[4];
     FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
 
@@ -689,7 +792,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             put_bitstream_info(s, LIBAVCODEC_IDENT);
         start_ch = 0;
         target_bits = 0;
-        memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < s->chan_map[0]; i++) {
             FFPsyWindowInfo* wi = windows + start_ch;
             const float *coeffs[2];
@@ -699,8 +801,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             cpe->common_window = 0;
             memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
             memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
-            put_bits(&s->pb, 3, tag);
-            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             for (ch = 0; ch < chans; ch++) {
                 sce = &cpe->ch[ch];
                 coeffs[ch] = sce->coeffs;
@@ -722,82 +822,33 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
                 s->psy.bitres.alloc /= chans;
             }
-            s->cur_type = tag;
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                if (s->options.pns && s->coder->mark_pns)
-                    s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
-            }
-            if (chans > 1
-                && wi[0].window_type[0] == wi[1].window_type[0]
-                && wi[0].window_shape   == wi[1].window_shape) {
-
-                cpe->common_window = 1;
-                for (w = 0; w < wi[0].num_windows; w++) {
-                    if (wi[0].grouping[w] != wi[1].grouping[w]) {
-                        cpe->common_window = 0;
-                        break;
-                    }
-                }
-            }
-            for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
-                sce = &cpe->ch[ch];
-                s->cur_channel = start_ch + ch;
-                if (s->options.tns && s->coder->search_for_tns)
-                    s->coder->search_for_tns(s, sce);
-                if (s->options.tns && s->coder->apply_tns_filt)
-                    s->coder->apply_tns_filt(s, sce);
-                if (sce->tns.present)
-                    tns_mode = 1;
-                if (s->options.pns && s->coder->search_for_pns)
-                    s->coder->search_for_pns(s, avctx, sce);
-            }
-            s->cur_channel = start_ch;
-            if (s->options.intensity_stereo) { /* Intensity Stereo */
-                if (s->coder->search_for_is)
-                    s->coder->search_for_is(s, avctx, cpe);
-                if (cpe->is_mode) is_mode = 1;
-                apply_intensity_stereo(cpe);
-            }
-            if (s->options.pred) { /* Prediction */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->search_for_pred)
-                        s->coder->search_for_pred(s, sce);
-                    if (cpe->ch[ch].ics.predictor_present) pred_mode = 1;
-                }
-                if (s->coder->adjust_common_pred)
-                    s->coder->adjust_common_pred(s, cpe);
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->apply_main_pred)
-                        s->coder->apply_main_pred(s, sce);
-                }
-                s->cur_channel = start_ch;
-            }
-            if (s->options.mid_side) { /* Mid/Side stereo */
-                if (s->options.mid_side == -1 && s->coder->search_for_ms)
-                    s->coder->search_for_ms(s, cpe);
-                else if (cpe->common_window)
-                    memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
-                apply_mid_side_stereo(cpe);
-            }
-            adjust_frame_information(cpe, chans);
-            if (s->options.ltp) { /* LTP */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->coder->search_for_ltp)
-                        s->coder->search_for_ltp(s, sce, cpe->common_window);
-                    if (sce->ics.ltp.present) pred_mode = 1;
-                }
-                s->cur_channel = start_ch;
-                if (s->coder->adjust_common_ltp)
-                    s->coder->adjust_common_ltp(s, cpe);
-            }
+            s->bitres_alloc[i] = s->psy.bitres.alloc;
+            start_ch += chans;
+        }
+
+        /* The channel elements are coded independently, on the slice threads */
+        for (i = 0; i < s->nb_thread_ctx; i++) {
+            AACEncContext *t = s->thread_ctx[i];
+            t->psy    = s->psy;
+            t->lambda = s->lambda;
+        }
+        avctx->execute2(avctx, search_element, windows, NULL, s->chan_map[0]);
+        for (i = 0; i < s->nb_thread_ctx; i++)
+            if (s->thread_ctx[i]->psy.cutoff != s->psy.cutoff)
+                s->psy.cutoff = s->thread_ctx[i]->psy.cutoff;
+
+        start_ch = 0;
+        memset(chan_el_counter, 0, sizeof(chan_el_counter));
+        for (i = 0; i < s->chan_map[0]; i++) {
+            tag      = s->chan_map[i+1];
+            chans    = tag == TYPE_CPE ? 2 : 1;
+            cpe      = &s->cpe[i];
+            put_bits(&s->pb, 3, tag);
+            put_bits(&s->pb, 4, chan_el_counter[tag]++);
+            if (cpe->is_mode)
+                is_mode = 1;
+            if (s->coeffs_filtered[i])
+                filter_mode = 1;
             if (chans == 2) {
                 put_bits(&s->pb, 1, cpe->common_window);
                 if (cpe->common_window) {
@@ -838,7 +889,8 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
         too_many_bits = too_many_bits + too_many_bits/2;
 
         if (   its == 0 /* for steady-state Q-scale tracking */
-            || (its < 5 && (frame_bits < too_few_bits || frame_bits > too_many_bits))
+            || (its < (s->options.preset == AAC_PRESET_QUALITY ? 5 : 2)
+                && (frame_bits < too_few_bits || frame_bits > too_many_bits))
             || frame_bits >= 6144 * s->channels - 3  )
         {
             float ratio = ((float)rate_bits) / frame_bits;
@@ -862,7 +914,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             if (ratio > 0.9f && ratio < 1.1f) {
                 break;
             } else {
-                if (is_mode || ms_mode || tns_mode || pred_mode) {
+                if (is_mode || ms_mode || filter_mode) {
                     for (i = 0; i < s->chan_map[0]; i++) {
                         // Must restore coeffs
                         chans = tag == TYPE_CPE ? 2 : 1;
@@ -880,6 +932,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     if (s->options.ltp && s->coder->ltp_insert_new_frame)
         s->coder->ltp_insert_new_frame(s);
+    s->random_state += s->chan_map[0] * 0x9E3779B9U;
 
     put_bits(&s->pb, 3, TYPE_END);
     flush_put_bits(&s->pb);
@@ -900,6 +953,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 static av_cold int aac_encode_end(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
+    int i;
 
     av_log(avctx, AV_LOG_INFO, "Qavg: %.3f\n", s->lambda_count ? s->lambda_sum / s->lambda_count : NAN);
 
@@ -907,6 +961,11 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     ff_mdct_end(&s->mdct128);
     ff_psy_end(&s->psy);
     ff_lpc_end(&s->lpc);
+    for (i = 0; i < s->nb_thread_ctx; i++) {
+        ff_lpc_end(&s->thread_ctx[i]->lpc);
+        av_freep(&s->thread_ctx[i]);
+    }
+    av_freep(&s->thread_ctx);
     if (s->psypp)
         ff_psy_preprocess_end(s->psypp);
     av_freep(&s->buffer.samples);
@@ -948,6 +1007,35 @@ static av_cold int alloc_buffers(AVCodecContext *avctx, AACEncContext *s)
     return 0;
 }
 
+/**
+ * Copy the initialized context for each slice thread, with its own
+ * scratch buffers and TNS LPC context. A frame has one job per channel
+ * element, so no more threads than elements run them.
+ */
+static av_cold int alloc_thread_contexts(AVCodecContext *avctx, AACEncContext *s)
+{
+    int nb_threads = avctx->active_thread_type & FF_THREAD_SLICE ? avctx->thread_count : 1;
+    int i, ret;
+
+    nb_threads = FFMIN(nb_threads, s->chan_map[0]);
+
+    if (!FF_ALLOCZ_TYPED_ARRAY(s->thread_ctx, nb_threads))
+        return AVERROR(ENOMEM);
+    for (i = 0; i < nb_threads; i++) {
+        AACEncContext *t = av_malloc(sizeof(*t));
+        if (!t)
+            return AVERROR(ENOMEM);
+        *t = *s;
+        t->thread_ctx    = NULL;
+        t->nb_thread_ctx = 0;
+        s->thread_ctx[s->nb_thread_ctx++] = t;
+        if ((ret = ff_lpc_init(&t->lpc, 2*avctx->frame_size, TNS_MAX_ORDER,
+                               FF_LPC_TYPE_LEVINSON)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
 static av_cold int aac_encode_init(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
@@ -1057,6 +1145,8 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
     s->profile = avctx->profile;
 
     /* Coder limitations */
+    if (s->options.coder < 0)
+        s->options.coder = s->options.preset == AAC_PRESET_FAST ? AAC_CODER_FAST : AAC_CODER_TWOLOOP;
     s->coder = &ff_aac_coders[s->options.coder];
     if (s->options.coder == AAC_CODER_ANMR) {
         ERROR_IF(avctx->strict_std_compliance > FF_COMPLIANCE_EXPERIMENTAL,
@@ -1107,12 +1197,17 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
     ff_af_queue_init(avctx, &s->afq);
     ff_aac_tableinit();
 
-    return 0;
+    return alloc_thread_contexts(avctx, s);
 }
 
 #define AACENC_FLAGS AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_AUDIO_PARAM
 static const AVOption aacenc_options[] = {
-    {"aac_coder", "Coding algorithm", offsetof(AACEncContext, options.coder), AV_OPT_TYPE_INT, {.i64 = AAC_CODER_TWOLOOP}, 0, AAC_CODER_NB-1, AACENC_FLAGS, "coder"},
+    {"aac_preset", "Speed/quality trade-off", offsetof(AACEncContext, options.preset), AV_OPT_TYPE_INT, {.i64 = AAC_PRESET_QUALITY}, 0, AAC_PRESET_NB-1, AACENC_FLAGS, "preset"},
+        {"quality",  "Full searches",                              0, AV_OPT_TYPE_CONST, {.i64 = AAC_PRESET_QUALITY},  INT_MIN, INT_MAX, AACENC_FLAGS, "preset"},
+        {"balanced", "Shorter quantizer search and rate control",  0, AV_OPT_TYPE_CONST, {.i64 = AAC_PRESET_BALANCED}, INT_MIN, INT_MAX, AACENC_FLAGS, "preset"},
+        {"fast",     "Fast coder, shorter rate control",           0, AV_OPT_TYPE_CONST, {.i64 = AAC_PRESET_FAST},     INT_MIN, INT_MAX, AACENC_FLAGS, "preset"},
+    {"aac_coder", "Coding algorithm", offsetof(AACEncContext, options.coder), AV_OPT_TYPE_INT, {.i64 = -1}, -1, AAC_CODER_NB-1, AACENC_FLAGS, "coder"},
+        {"auto",     "Chosen by aac_preset",      0, AV_OPT_TYPE_CONST, {.i64 = -1},                INT_MIN, INT_MAX, AACENC_FLAGS, "coder"},
         {"anmr",     "ANMR method",               0, AV_OPT_TYPE_CONST, {.i64 = AAC_CODER_ANMR},    INT_MIN, INT_MAX, AACENC_FLAGS, "coder"},
         {"twoloop",  "Two loop searching method", 0, AV_OPT_TYPE_CONST, {.i64 = AAC_CODER_TWOLOOP}, INT_MIN, INT_MAX, AACENC_FLAGS, "coder"},
         {"fast",     "Default fast search",       0, AV_OPT_TYPE_CONST, {.i64 = AAC_CODER_FAST},    INT_MIN, INT_MAX, AACENC_FLAGS, "coder"},
@@ -1151,7 +1246,8 @@ const FFCodec ff_aac_encoder = {
     .defaults       = aac_encode_defaults,
     .p.supported_samplerates = ff_mpeg4audio_sample_rates,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_INIT_CLEANUP,
-    .p.capabilities = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY,
+    .p.capabilities = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .p.sample_fmts  = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_FLTP,
                                                      AV_SAMPLE_FMT_NONE },
     .p.priv_class   = &aacenc_class,
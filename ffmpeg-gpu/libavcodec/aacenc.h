@@ -43,7 +43,16 @@ typedef enum AACCoder {
     AAC_CODER_NB,
 }AACCoder;
 
+typedef enum AACEncPreset {
+    AAC_PRESET_QUALITY = 0,
+    AAC_PRESET_BALANCED,
+    AAC_PRESET_FAST,
+
+    AAC_PRESET_NB,
+} AACEncPreset;
+
 typedef struct AACEncOptions {
+    int preset;
     int coder;
     int pns;
     int tns;
@@ -407,10 +416,15 @@ typedef struct AACEncContext {
     float lambda_sum;                            ///< sum(lambda), for Qvg reporting
     int lambda_count;                            ///< count(lambda), for Qvg reporting
     enum RawDataBlockType cur_type;              ///< channel group type cur_channel belongs to
+    int bitres_alloc[MAX_ELEM_ID];               ///< psy bit allocation per channel of each element
+    int coeffs_filtered[MAX_ELEM_ID];            ///< whether TNS or prediction changed the coefficients of each element
+    struct AACEncContext **thread_ctx;           ///< contexts coding the channel elements, one per slice thread
+    int nb_thread_ctx;
 
     AudioFrameQueue afq;
     DECLARE_ALIGNED(16, int,   qcoefs)[96];      ///< quantized coefficients
     DECLARE_ALIGNED(32, float, scoefs)[1024];    ///< scaled coefficients
+    DECLARE_ALIGNED(16, float, rcoefs)[96];      ///< reconstructed quantized coefficients
 
     uint16_t quantize_band_cost_cache_generation;
     AACQuantizeBandCostCacheEntry quantize_band_cost_cache[256][128]; ///< memoization area for quantize_band_cost
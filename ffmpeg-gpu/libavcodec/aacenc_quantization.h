@@ -83,12 +83,13 @@ static av_always_inline float quantize_and_encode_band_cost_template(
     } else {
         off = aac_cb_maxval[cb];
     }
+    if (!out)
+        out = s->rcoefs;
     for (i = 0; i < size; i += dim) {
         const float *vec;
         int *quants = s->qcoefs + i;
         int curidx = 0;
         int curbits;
-        float quantized, rd = 0.0f;
         for (j = 0; j < dim; j++) {
             curidx *= aac_cb_range[cb];
             curidx += quants[j] + off;
@@ -97,9 +98,9 @@ static av_always_inline float quantize_and_encode_band_cost_template(
         vec     = &ff_aac_codebook_vectors[cb-1][curidx*dim];
         if (BT_UNSIGNED) {
             for (j = 0; j < dim; j++) {
-                float t = fabsf(in[i+j]);
-                float di;
+                float quantized;
                 if (BT_ESC && vec[j] == 64.0f) { //FIXME: slow
+                    float t = fabsf(in[i+j]);
                     if (t >= CLIPPED_ESCAPE) {
                         quantized = CLIPPED_ESCAPE;
                         curbits += 21;
@@ -111,26 +112,17 @@ static av_always_inline float quantize_and_encode_band_cost_template(
                 } else {
                     quantized = vec[j]*IQ;
                 }
-                di = t - quantized;
-                if (out)
-                    out[i+j] = in[i+j] >= 0 ? quantized : -quantized;
+                out[i+j] = in[i+j] >= 0 ? quantized : -quantized;
                 if (vec[j] != 0.0f)
                     curbits++;
-                qenergy += quantized*quantized;
-                rd += di*di;
             }
         } else {
-            for (j = 0; j < dim; j++) {
-                quantized = vec[j]*IQ;
-                qenergy += quantized*quantized;
-                if (out)
-                    out[i+j] = quantized;
-                rd += (in[i+j] - quantized)*(in[i+j] - quantized);
-            }
+            for (j = 0; j < dim; j++)
+                out[i+j] = vec[j]*IQ;
         }
-        cost    += rd * lambda + curbits;
         resbits += curbits;
-        if (cost >= uplim)
+        /* The distortion only adds to the cost */
+        if (resbits >= uplim)
             return uplim;
         if (pb) {
             put_bits(pb, ff_aac_spectral_bits[cb-1][curidx], ff_aac_spectral_codes[cb-1][curidx]);
@@ -152,6 +144,12 @@ static av_always_inline float quantize_and_encode_band_cost_template(
         }
     }
 
+    /* The sign of a reconstructed value is that of its input, so the
+     * distortion of the magnitudes is the distortion of the values. */
+    cost = quant_band_err(in, out, size, &qenergy) * lambda + resbits;
+    if (cost >= uplim)
+        return uplim;
+
     if (bits)
         *bits = resbits;
     if (energy)
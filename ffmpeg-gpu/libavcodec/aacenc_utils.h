@@ -68,13 +68,26 @@ static inline void quantize_bands(int *out, const float *in, const float *scaled
 {
     int i;
     for (i = 0; i < size; i++) {
-        float qc = scaled[i] * Q34;
-        int tmp = (int)FFMIN(qc + rounding, (float)maxval);
-        if (is_signed && in[i] < 0.0f) {
-            tmp = -tmp;
+        float qc = FFMIN(scaled[i] * Q34 + rounding, (float)maxval);
+        /* Without a branch on the sign, which is mispredicted half the time */
+        out[i] = is_signed ? (int)copysignf(qc, in[i]) : (int)qc;
+    }
+}
+
+static inline float quant_band_err(const float *in, const float *rec, int size,
+                                   float *energy)
+{
+    float err[4] = { 0.0f }, qenergy[4] = { 0.0f };
+    int i, j;
+    for (i = 0; i < size; i += 4) {
+        for (j = 0; j < 4; j++) {
+            float di = in[i+j] - rec[i+j];
+            err[j]     += di * di;
+            qenergy[j] += rec[i+j] * rec[i+j];
         }
-        out[i] = tmp;
     }
+    *energy = (qenergy[0] + qenergy[2]) + (qenergy[1] + qenergy[3]);
+    return (err[0] + err[2]) + (err[1] + err[3]);
 }
 
 static inline float find_max_val(int group_len, int swb_size, const float *scaled)
@@ -119,6 +119,11 @@ int ff_cbs_bsf_generic_init(AVBSFContext *bsf, const CBSBSFType *type)
     if (err < 0)
         return err;
 
+    if (ctx->decompose == BSF_DECOMPOSE_NEEDED) {
+        ctx->input->decompose_unit_types    = ctx->decompose_unit_types;
+        ctx->input->nb_decompose_unit_types = ctx->nb_decompose_unit_types;
+    }
+
     err = ff_cbs_init(&ctx->output, type->codec_id, bsf);
     if (err < 0)
         return err;
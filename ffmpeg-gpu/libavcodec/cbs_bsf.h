@@ -57,6 +57,15 @@ typedef struct CBSBSFContext {
     CodedBitstreamContext *input;
     CodedBitstreamContext *output;
     CodedBitstreamFragment fragment;
+
+    // Which units to decompose (BSF_DECOMPOSE_*), as set by the
+    // "decompose" option of the BSF.
+    int decompose;
+    // Unit types to decompose with BSF_DECOMPOSE_NEEDED, set by the BSF
+    // before ff_cbs_bsf_generic_init().  If NULL, all units are
+    // decomposed anyway.
+    const CodedBitstreamUnitType *decompose_unit_types;
+    int nb_decompose_unit_types;
 } CBSBSFContext;
 
 /**
@@ -134,4 +143,25 @@ enum {
         { .i64 = BSF_ELEMENT_EXTRACT }, .flags = opt_flags, .unit = name } \
 
 
+// Options for unit decomposition.
+enum {
+    // Decompose every unit, so that the whole fragment is rewritten.
+    BSF_DECOMPOSE_ALL,
+    // Only decompose the unit types which the BSF may inspect or modify;
+    // the data of the other units is passed through by reference and
+    // copied unchanged into the output fragment.
+    BSF_DECOMPOSE_NEEDED,
+};
+
+#define BSF_DECOMPOSE_OPTIONS(opt_flags) \
+    { "decompose", "Units to decompose", \
+        OFFSET(common.decompose), AV_OPT_TYPE_INT, \
+        { .i64 = BSF_DECOMPOSE_ALL }, \
+        BSF_DECOMPOSE_ALL, BSF_DECOMPOSE_NEEDED, opt_flags, "decompose" }, \
+    { "all",    "All units", 0, AV_OPT_TYPE_CONST, \
+        { .i64 = BSF_DECOMPOSE_ALL    }, .flags = opt_flags, .unit = "decompose" }, \
+    { "needed", "Only the units the filter needs", 0, AV_OPT_TYPE_CONST, \
+        { .i64 = BSF_DECOMPOSE_NEEDED }, .flags = opt_flags, .unit = "decompose" }
+
+
 #endif /* AVCODEC_CBS_BSF_H */
@@ -1235,12 +1235,50 @@ static int cbs_h2645_unit_requires_zero_byte(enum AVCodecID codec_id,
     return 0;
 }
 
+/**
+ * Copy the RBSP of a unit to dst with emulation prevention, returning the
+ * size written.  The bytes between two emulation_prevention_three_bytes are
+ * copied as a whole, and runs without zero bytes are skipped with memchr(),
+ * so that the common case of a slice without start code emulation is little
+ * more than a memcpy().
+ */
+static size_t cbs_h2645_escape_rbsp(uint8_t *dst, const uint8_t *src,
+                                    size_t size)
+{
+    size_t dp = 0, sp = 0, start = 0;
+    int zero_run = 0;
+
+    while (sp < size) {
+        if (zero_run < 2) {
+            if (!zero_run) {
+                const uint8_t *zero = memchr(src + sp, 0, size - sp);
+                if (!zero)
+                    break;
+                sp = zero - src;
+            }
+            zero_run = src[sp++] == 0 ? zero_run + 1 : 0;
+        } else {
+            if ((src[sp] & ~3) == 0) {
+                memcpy(dst + dp, src + start, sp - start);
+                dp   += sp - start;
+                start = sp;
+                // emulation_prevention_three_byte
+                dst[dp++] = 3;
+            }
+            zero_run = src[sp++] == 0;
+        }
+    }
+    memcpy(dst + dp, src + start, size - start);
+
+    return dp + size - start;
+}
+
 static int cbs_h2645_assemble_fragment(CodedBitstreamContext *ctx,
                                        CodedBitstreamFragment *frag)
 {
     uint8_t *data;
-    size_t max_size, dp, sp;
-    int err, i, zero_run;
+    size_t max_size, dp;
+    int err, i;
 
     for (i = 0; i < frag->nb_units; i++) {
         // Data should already all have been written when we get here.
@@ -1278,22 +1316,7 @@ static int cbs_h2645_assemble_fragment(CodedBitstreamContext *ctx,
         data[dp++] = 0;
         data[dp++] = 1;
 
-        zero_run = 0;
-        for (sp = 0; sp < unit->data_size; sp++) {
-            if (zero_run < 2) {
-                if (unit->data[sp] == 0)
-                    ++zero_run;
-                else
-                    zero_run = 0;
-            } else {
-                if ((unit->data[sp] & ~3) == 0) {
-                    // emulation_prevention_three_byte
-                    data[dp++] = 3;
-                }
-                zero_run = unit->data[sp] == 0;
-            }
-            data[dp++] = unit->data[sp];
-        }
+        dp += cbs_h2645_escape_rbsp(data + dp, unit->data, unit->data_size);
     }
 
     av_assert0(dp <= max_size);
@@ -31,109 +31,166 @@
 #include "h264.h"
 #include "h2645_parse.h"
 
-int ff_h2645_extract_rbsp(const uint8_t *src, int length,
-                          H2645RBSP *rbsp, H2645NAL *nal, int small_padding)
+/* OR each byte of a word with the next one, a zero byte in the result is
+ * a pair of zero bytes, or a zero last byte whose pair spans two words */
+#define PAIRS(x) ((x) | (HAVE_BIGENDIAN ? (x) << 8 : (x) >> 8))
+
+/**
+ * Find the first start code or emulation prevention candidate, i.e. two
+ * zero bytes followed by a byte lower than or equal to 3.
+ *
+ * @param buf  buffer to scan, readable up to buf + size +
+ *             AV_INPUT_BUFFER_PADDING_SIZE
+ * @param size number of bytes in buf
+ * @return offset of the first of the two zero bytes, or size if there
+ *         is no candidate ending before buf + size
+ */
+static int find_escape(const uint8_t *buf, int size)
 {
-    int i, si, di;
-    uint8_t *dst;
+    int i = 0;
 
-    nal->skipped_bytes = 0;
-#define STARTCODE_TEST                                                  \
-        if (i + 2 < length && src[i + 1] == 0 && src[i + 2] <= 3) {     \
-            if (src[i + 2] != 3 && src[i + 2] != 0) {                   \
-                /* startcode, so we must be past the end */             \
-                length = i;                                             \
-            }                                                           \
-            break;                                                      \
-        }
 #if HAVE_FAST_UNALIGNED
-#define FIND_FIRST_ZERO                                                 \
-        if (i > 0 && !src[i])                                           \
-            i--;                                                        \
-        while (src[i])                                                  \
-            i++
 #if HAVE_FAST_64BIT
-    for (i = 0; i + 1 < length; i += 9) {
-        if (!((~AV_RN64(src + i) &
-               (AV_RN64(src + i) - 0x0100010001000101ULL)) &
-              0x8000800080008080ULL))
+    for (; i + 2 < size; i += 8) {
+        uint64_t x = PAIRS(AV_RN64(buf + i));
+        if (!((x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL))
             continue;
-        FIND_FIRST_ZERO;
-        STARTCODE_TEST;
-        i -= 7;
+        for (int j = i; j < i + 8 && j + 2 < size; j++) {
+            if (buf[j + 1])
+                j++;
+            else if (!buf[j] && buf[j + 2] <= 3)
+                return j;
+        }
     }
 #else
-    for (i = 0; i + 1 < length; i += 5) {
-        if (!((~AV_RN32(src + i) &
-               (AV_RN32(src + i) - 0x01000101U)) &
-              0x80008080U))
+    for (; i + 2 < size; i += 4) {
+        uint32_t x = PAIRS(AV_RN32(buf + i));
+        if (!((x - 0x01010101U) & ~x & 0x80808080U))
             continue;
-        FIND_FIRST_ZERO;
-        STARTCODE_TEST;
-        i -= 3;
+        for (int j = i; j < i + 4 && j + 2 < size; j++) {
+            if (buf[j + 1])
+                j++;
+            else if (!buf[j] && buf[j + 2] <= 3)
+                return j;
+        }
     }
 #endif /* HAVE_FAST_64BIT */
 #else
-    for (i = 0; i + 1 < length; i += 2) {
-        if (src[i])
-            continue;
-        if (i > 0 && src[i - 1] == 0)
-            i--;
-        STARTCODE_TEST;
-    }
+    for (; i + 2 < size; i++)
+        if (!buf[i] && !buf[i + 1] && buf[i + 2] <= 3)
+            return i;
 #endif /* HAVE_FAST_UNALIGNED */
+    return size;
+}
+
+/**
+ * Find the next emulation prevention byte or start code from i on; runs of
+ * three or more zero bytes are neither.
+ */
+static int next_escape(const uint8_t *src, int i, int length)
+{
+    for (;; i++) {
+        i += find_escape(src + i, length - i);
+        if (i >= length || src[i + 2])
+            return i;
+    }
+}
+
+static int add_skipped_byte(H2645NAL *nal, int pos)
+{
+    if (!nal->skipped_bytes_pos)
+        return 0;
+
+    nal->skipped_bytes++;
+    if (nal->skipped_bytes_pos_size < nal->skipped_bytes) {
+        nal->skipped_bytes_pos_size *= 2;
+        av_assert0(nal->skipped_bytes_pos_size >= nal->skipped_bytes);
+        av_reallocp_array(&nal->skipped_bytes_pos,
+                nal->skipped_bytes_pos_size,
+                sizeof(*nal->skipped_bytes_pos));
+        if (!nal->skipped_bytes_pos) {
+            nal->skipped_bytes_pos_size = 0;
+            return AVERROR(ENOMEM);
+        }
+    }
+    nal->skipped_bytes_pos[nal->skipped_bytes-1] = pos;
+    return 0;
+}
 
-    if (i >= length - 1 && small_padding) { // no escaped 0
+/* Below this many bytes per escape, the runs are too short for the search
+ * and memcpy() to pay off and the bytes are copied one at a time. */
+#define MIN_ESCAPE_DISTANCE 256
+
+int ff_h2645_extract_rbsp(const uint8_t *src, int length,
+                          H2645RBSP *rbsp, H2645NAL *nal, int small_padding)
+{
+    int i, si, di, ret, escapes = 0;
+    uint8_t *dst;
+
+    nal->skipped_bytes = 0;
+
+    i = find_escape(src, length);
+    if (i < length && src[i + 2] && src[i + 2] != 3) {
+        /* startcode, so we must be past the end */
+        length = i;
+    }
+
+    if (i >= length && small_padding) { // no escaped 0
         nal->data     =
         nal->raw_data = src;
         nal->size     =
         nal->raw_size = length;
         return length;
-    } else if (i > length)
-        i = length;
+    }
 
     dst = &rbsp->rbsp_buffer[rbsp->rbsp_buffer_size];
 
-    memcpy(dst, src, i);
-    si = di = i;
-    while (si + 2 < length) {
-        // remove escapes (very rare 1:2^22)
-        if (src[si + 2] > 3) {
-            dst[di++] = src[si++];
-            dst[di++] = src[si++];
-        } else if (src[si] == 0 && src[si + 1] == 0 && src[si + 2] != 0) {
-            if (src[si + 2] == 3) { // escape
+    /* copy the runs between the escapes (very rare 1:2^22) */
+    si = di = 0;
+    while ((i = next_escape(src, i, length)) < length) {
+        if (src[i + 2] != 3) { // next start code
+            length = i;
+            break;
+        }
+
+        memcpy(dst + di, src + si, i + 2 - si);
+        di += i + 2 - si;
+        si  = i + 3;
+        i   = si;
+
+        if ((ret = add_skipped_byte(nal, di - 1)) < 0)
+            return ret;
+        if (++escapes >= 16 && si < escapes * MIN_ESCAPE_DISTANCE)
+            break;
+    }
+
+    /* dense escapes, the rest of the NAL unit is copied bytewise */
+    if (i < length) {
+        while (si + 2 < length) {
+            if (src[si + 2] > 3) {
+                dst[di++] = src[si++];
+                dst[di++] = src[si++];
+            } else if (src[si] == 0 && src[si + 1] == 0 && src[si + 2] != 0) {
+                if (src[si + 2] != 3) { // next start code
+                    length = si;
+                    break;
+                }
                 dst[di++] = 0;
                 dst[di++] = 0;
                 si       += 3;
 
-                if (nal->skipped_bytes_pos) {
-                    nal->skipped_bytes++;
-                    if (nal->skipped_bytes_pos_size < nal->skipped_bytes) {
-                        nal->skipped_bytes_pos_size *= 2;
-                        av_assert0(nal->skipped_bytes_pos_size >= nal->skipped_bytes);
-                        av_reallocp_array(&nal->skipped_bytes_pos,
-                                nal->skipped_bytes_pos_size,
-                                sizeof(*nal->skipped_bytes_pos));
-                        if (!nal->skipped_bytes_pos) {
-                            nal->skipped_bytes_pos_size = 0;
-                            return AVERROR(ENOMEM);
-                        }
-                    }
-                    if (nal->skipped_bytes_pos)
-                        nal->skipped_bytes_pos[nal->skipped_bytes-1] = di - 1;
-                }
+                if ((ret = add_skipped_byte(nal, di - 1)) < 0)
+                    return ret;
                 continue;
-            } else // next start code
-                goto nsc;
-        }
+            }
 
-        dst[di++] = src[si++];
+            dst[di++] = src[si++];
+        }
     }
-    while (si < length)
-        dst[di++] = src[si++];
+    memcpy(dst + di, src + si, length - si);
+    di += length - si;
+    si  = length;
 
-nsc:
     memset(dst + di, 0, AV_INPUT_BUFFER_PADDING_SIZE);
 
     nal->data = dst;
@@ -333,17 +390,17 @@ static int h264_parse_nal_header(H2645NAL *nal, void *logctx)
 
 static int find_next_start_code(const uint8_t *buf, const uint8_t *next_avc)
 {
+    int size = next_avc - buf - 1;
     int i = 0;
 
     if (buf + 3 >= next_avc)
         return next_avc - buf;
 
-    while (buf + i + 3 < next_avc) {
-        if (buf[i] == 0 && buf[i + 1] == 0 && buf[i + 2] == 1)
-            break;
-        i++;
+    for (;; i++) {
+        i += find_escape(buf + i, size - i);
+        if (i >= size || buf[i + 2] == 1)
+            return FFMIN(i, size - 2) + 3;
     }
-    return i + 3;
 }
 
 static void alloc_rbsp_buffer(H2645RBSP *rbsp, unsigned int size, int use_ref)
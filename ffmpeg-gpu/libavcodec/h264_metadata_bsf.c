@@ -80,6 +80,8 @@ typedef struct H264MetadataContext {
     H264RawSEIDisplayOrientation display_orientation_payload;
 
     int level;
+
+    CodedBitstreamUnitType decompose_unit_types[5];
 } H264MetadataContext;
 
 
@@ -590,6 +592,20 @@ static int h264_metadata_init(AVBSFContext *bsf)
         }
     }
 
+    // Parameter sets are always edited; slices are only inspected to
+    // build an AUD, and SEI only for the options dealing with messages.
+    // Filler NAL units are deleted without being decomposed.
+    ctx->common.decompose_unit_types = ctx->decompose_unit_types;
+    ctx->decompose_unit_types[ctx->common.nb_decompose_unit_types++] = H264_NAL_SPS;
+    ctx->decompose_unit_types[ctx->common.nb_decompose_unit_types++] = H264_NAL_PPS;
+    if (ctx->aud == BSF_ELEMENT_INSERT) {
+        ctx->decompose_unit_types[ctx->common.nb_decompose_unit_types++] = H264_NAL_SLICE;
+        ctx->decompose_unit_types[ctx->common.nb_decompose_unit_types++] = H264_NAL_IDR_SLICE;
+    }
+    if (ctx->sei_user_data || ctx->delete_filler ||
+        ctx->display_orientation != BSF_ELEMENT_PASS)
+        ctx->decompose_unit_types[ctx->common.nb_decompose_unit_types++] = H264_NAL_SEI;
+
     return ff_cbs_bsf_generic_init(bsf, &h264_metadata_type);
 }
 
@@ -673,6 +689,8 @@ static const AVOption h264_metadata_options[] = {
         0, AV_OPT_TYPE_CONST,
         { .i64 = FLIP_VERTICAL },   .flags = FLAGS, .unit = "flip" },
 
+    BSF_DECOMPOSE_OPTIONS(FLAGS),
+
     { "level", "Set level (table A-1)",
         OFFSET(level), AV_OPT_TYPE_INT,
         { .i64 = LEVEL_UNSET }, LEVEL_UNSET, 0xff, FLAGS, "level" },
@@ -61,6 +61,8 @@ typedef struct H265MetadataContext {
     int level;
     int level_guess;
     int level_warned;
+
+    CodedBitstreamUnitType decompose_unit_types[3];
 } H265MetadataContext;
 
 
@@ -406,6 +408,18 @@ static const CBSBSFType h265_metadata_type = {
 
 static int h265_metadata_init(AVBSFContext *bsf)
 {
+    H265MetadataContext *ctx = bsf->priv_data;
+
+    // The parameter sets are edited or used to guess the level.  Building
+    // an AUD needs the headers of all NAL units, so then everything is
+    // decomposed.
+    if (ctx->aud != BSF_ELEMENT_INSERT) {
+        ctx->common.decompose_unit_types = ctx->decompose_unit_types;
+        ctx->decompose_unit_types[ctx->common.nb_decompose_unit_types++] = HEVC_NAL_VPS;
+        ctx->decompose_unit_types[ctx->common.nb_decompose_unit_types++] = HEVC_NAL_SPS;
+        ctx->decompose_unit_types[ctx->common.nb_decompose_unit_types++] = HEVC_NAL_PPS;
+    }
+
     return ff_cbs_bsf_generic_init(bsf, &h265_metadata_type);
 }
 
@@ -485,6 +499,8 @@ static const AVOption h265_metadata_options[] = {
     { LEVEL("8.5", 255) },
 #undef LEVEL
 
+    BSF_DECOMPOSE_OPTIONS(FLAGS),
+
     { NULL }
 };
 
@@ -936,8 +936,10 @@ static int hls_slice_header(HEVCContext *s)
                 sh->entry_point_offset[i] = val + 1; // +1; // +1 to get the size
             }
             if (s->threads_number > 1 && (s->ps.pps->num_tile_rows > 1 || s->ps.pps->num_tile_columns > 1)) {
-                s->enable_parallel_tiles = 0; // TODO: you can enable tiles in parallel here
-                s->threads_number = 1;
+                // tiles combined with WPP are decoded on a single thread
+                s->enable_parallel_tiles = !s->ps.pps->entropy_coding_sync_enabled_flag;
+                if (!s->enable_parallel_tiles)
+                    s->threads_number = 1;
             } else
                 s->enable_parallel_tiles = 0;
         } else
@@ -2622,6 +2624,110 @@ error:
     return ret;
 }
 
+static int hls_decode_entry_tile(AVCodecContext *avctxt, void *input_tile, int job, int self_id)
+{
+    HEVCContext *s1  = avctxt->priv_data, *s;
+    HEVCLocalContext *lc;
+    const HEVCSPS *sps = s1->ps.sps;
+    const HEVCPPS *pps = s1->ps.pps;
+    int tile        = ((int *)input_tile)[job];
+    int ctb_addr_rs = pps->tile_pos_rs[tile];
+    int ctb_addr_ts = pps->ctb_addr_rs_to_ts[ctb_addr_rs];
+    int more_data   = 1;
+    int ret;
+
+    s = s1->sList[self_id];
+    lc = s->HEVClc;
+
+    if (job) {
+        ret = init_get_bits8(&lc->gb, s->data + s->sh.offset[job - 1], s->sh.size[job - 1]);
+        if (ret < 0)
+            goto error;
+    }
+
+    while (more_data && ctb_addr_ts < sps->ctb_size && pps->tile_id[ctb_addr_ts] == tile) {
+        int x_ctb, y_ctb;
+
+        ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+        x_ctb = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size;
+
+        if (atomic_load(&s1->wpp_err)) {
+            ret = 0;
+            goto unset;
+        }
+
+        hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
+
+        ret = ff_hevc_cabac_init(s, ctb_addr_ts, 0);
+        if (ret < 0)
+            goto error;
+
+        hls_sao_param(s, x_ctb >> sps->log2_ctb_size, y_ctb >> sps->log2_ctb_size);
+
+        s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
+        more_data = hls_coding_quadtree(s, x_ctb, y_ctb, sps->log2_ctb_size, 0);
+        if (more_data < 0) {
+            ret = more_data;
+            goto error;
+        }
+        ctb_addr_ts++;
+    }
+
+    // every tile but the last one of the slice segment must be complete
+    if (job < s->sh.num_entry_point_offsets ? !more_data || ctb_addr_ts >= sps->ctb_size :
+                                              more_data && ctb_addr_ts < sps->ctb_size) {
+        av_log(s->avctx, AV_LOG_ERROR, "Tile %d ends at a wrong position.\n", tile);
+        ret = AVERROR_INVALIDDATA;
+        goto error;
+    }
+
+    return job < s->sh.num_entry_point_offsets ? 0 : ctb_addr_ts;
+error:
+    atomic_store(&s1->wpp_err, 1);
+unset:
+    // the CTBs of the tile that were not decoded are not part of the slice
+    for (; ctb_addr_ts < sps->ctb_size && pps->tile_id[ctb_addr_ts] == tile; ctb_addr_ts++)
+        s->tab_slice_address[pps->ctb_addr_ts_to_rs[ctb_addr_ts]] = -1;
+    return ret;
+}
+
+/*
+ * Run the in-loop filters of the slice segment once all its tiles are
+ * decoded, in the order they are run when decoding the tiles one after
+ * another.
+ */
+static void hls_filter_tiles(HEVCContext *s, int ctb_addr_ts, int ctb_addr_ts_end)
+{
+    const HEVCSPS *sps = s->ps.sps;
+    const HEVCPPS *pps = s->ps.pps;
+    int ctb_size = 1 << sps->log2_ctb_size;
+    int x_ctb = -ctb_size, y_ctb = -ctb_size;
+
+    if (!s->sh.disable_deblocking_filter_flag) {
+        for (int ts = ctb_addr_ts; ts < ctb_addr_ts_end; ts++) {
+            int ctb_addr_rs = pps->ctb_addr_ts_to_rs[ts];
+            ff_hevc_tile_boundary_strengths(s, (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size,
+                                               (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size);
+        }
+    }
+
+    for (; ctb_addr_ts < ctb_addr_ts_end; ctb_addr_ts++) {
+        int ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+
+        x_ctb = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size;
+        ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
+    }
+
+    if (x_ctb + ctb_size >= sps->width &&
+        y_ctb + ctb_size >= sps->height)
+        ff_hevc_hls_filter(s, x_ctb, y_ctb, ctb_size);
+}
+
 static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 {
     const uint8_t *data = nal->data;
@@ -2639,7 +2745,19 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         return AVERROR(ENOMEM);
     }
 
-    if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
+    if (s->enable_parallel_tiles) {
+        const HEVCPPS *pps = s->ps.pps;
+        int first_tile = pps->tile_id[pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs]];
+
+        // the substreams are expected to be whole tiles, decode anything else serially
+        if (pps->tile_pos_rs[first_tile] != s->sh.slice_ctb_addr_rs ||
+            first_tile + s->sh.num_entry_point_offsets >= pps->num_tile_columns * pps->num_tile_rows) {
+            av_free(ret);
+            av_free(arg);
+            s->enable_parallel_tiles = 0;
+            return hls_slice_data(s);
+        }
+    } else if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
         av_log(s->avctx, AV_LOG_ERROR, "WPP ctb addresses are wrong (%d %d %d %d)\n",
             s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets,
             s->ps.sps->ctb_width, s->ps.sps->ctb_height
@@ -2715,11 +2833,49 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         ret[i] = 0;
     }
 
-    if (s->ps.pps->entropy_coding_sync_enabled_flag)
+    if (s->ps.pps->entropy_coding_sync_enabled_flag) {
         s->avctx->execute2(s->avctx, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
 
-    for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
-        res += ret[i];
+        for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
+            res += ret[i];
+    } else {
+        const HEVCPPS *pps  = s->ps.pps;
+        int ctb_addr_ts     = pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+        int first_tile      = pps->tile_id[ctb_addr_ts];
+        int last_tile       = first_tile + s->sh.num_entry_point_offsets;
+        int ctb_addr_ts_end = last_tile + 1 < pps->num_tile_columns * pps->num_tile_rows ?
+                              pps->ctb_addr_rs_to_ts[pps->tile_pos_rs[last_tile + 1]] :
+                              s->ps.sps->ctb_size;
+
+        if (s->sh.dependent_slice_segment_flag) {
+            if (!ctb_addr_ts) {
+                av_log(s->avctx, AV_LOG_ERROR, "Impossible initial tile.\n");
+                res = AVERROR_INVALIDDATA;
+                goto error;
+            }
+            if (s->tab_slice_address[pps->ctb_addr_ts_to_rs[ctb_addr_ts - 1]] != s->sh.slice_addr) {
+                av_log(s->avctx, AV_LOG_ERROR, "Previous slice segment missing\n");
+                res = AVERROR_INVALIDDATA;
+                goto error;
+            }
+        }
+
+        // the neighbours of a CTB in the other tiles of the slice segment
+        // may not be decoded yet, but are known to be in the same slice
+        for (i = ctb_addr_ts; i < ctb_addr_ts_end; i++)
+            s->tab_slice_address[pps->ctb_addr_ts_to_rs[i]] = s->sh.slice_addr;
+        for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
+            arg[i] = first_tile + i;
+
+        s->avctx->execute2(s->avctx, hls_decode_entry_tile, arg, ret, s->sh.num_entry_point_offsets + 1);
+
+        res = ret[s->sh.num_entry_point_offsets];
+        for (i = 0; i < s->sh.num_entry_point_offsets; i++)
+            if (ret[i] < 0)
+                res = ret[i];
+        if (res > 0)
+            hls_filter_tiles(s, ctb_addr_ts, res);
+    }
 error:
     av_free(ret);
     av_free(arg);
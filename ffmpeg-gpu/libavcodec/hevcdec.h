@@ -677,6 +677,12 @@ void ff_hevc_set_qPy(HEVCContext *s, int xBase, int yBase,
                      int log2_cb_size);
 void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
                                            int log2_trafo_size);
+/**
+ * Derive the boundary strengths of the upper and left edges of a CTB which
+ * are tile edges, skipped by ff_hevc_deblocking_boundary_strengths() while
+ * the tiles are decoded in parallel.
+ */
+void ff_hevc_tile_boundary_strengths(HEVCContext *s, int x_ctb, int y_ctb);
 int ff_hevc_cu_qp_delta_sign_flag(HEVCContext *s);
 int ff_hevc_cu_qp_delta_abs(HEVCContext *s);
 int ff_hevc_cu_chroma_qp_offset_flag(HEVCContext *s);
@@ -99,16 +99,63 @@ void ff_mjpeg_amv_encode_picture_header(MpegEncContext *s)
         mjpeg_encode_picture_header(s);
 }
 
-#if CONFIG_MJPEG_ENCODER
 /**
- * Encodes and outputs the entire frame in the JPEG format.
+ * Escapes the 0xff bytes written since the last marker and, between the
+ * restart intervals of a frame coded in slices, puts the next RST marker.
  *
  * @param s The MpegEncContext.
+ * @param mb_y The last macroblock row of the restart interval.
+ * @return int Error code, 0 if successful.
  */
-static void mjpeg_encode_picture_frame(MpegEncContext *s)
+static int mjpeg_end_restart_interval(MpegEncContext *s, int mb_y)
 {
-    int nbits, code, table_id;
-    MJpegContext *m = s->mjpeg_ctx;
+    PutBitContext *pbc = &s->pb;
+    int ret;
+
+    ret = ff_mpv_reallocate_putbitbuffer(s, put_bits_count(&s->pb) / 8 + 100,
+                                            put_bits_count(&s->pb) / 4 + 1000);
+    if (ret < 0) {
+        av_log(s->avctx, AV_LOG_ERROR, "Buffer reallocation failed\n");
+        return ret;
+    }
+
+    ff_mjpeg_escape_FF(pbc, s->esc_pos);
+
+    if (s->slice_context_count > 1 && mb_y < s->mb_height - 1)
+        put_marker(pbc, RST0 + (mb_y&7));
+    s->esc_pos = put_bytes_count(pbc, 0);
+
+    return 0;
+}
+
+#if CONFIG_MJPEG_ENCODER
+static int count_slice_codes(AVCodecContext *avctx, void *arg)
+{
+    MpegEncContext *const s  = *(void**)arg;
+    MpegEncContext *const s0 = avctx->priv_data;
+    MJpegContext *const m = s->mjpeg_ctx;
+    MJpegEncHuffmanContext *stats = m->huff_stats[(MpegEncContext**)arg - s0->thread_context];
+
+    for (int i = 0; i < 4; i++)
+        ff_mjpeg_encode_huffman_init(&stats[i]);
+
+    for (int mb_y = s->start_mb_y; mb_y < s->end_mb_y; mb_y++) {
+        const MJpegHuffmanCode *c = m->huff_buffer + mb_y * m->huff_row_size;
+
+        for (size_t i = 0; i < m->huff_ncode[mb_y]; i++)
+            ff_mjpeg_encode_huffman_increment(&stats[c[i].table_id], c[i].code);
+    }
+    return 0;
+}
+
+/**
+ * Encodes and outputs the rows of a slice context, each row being a restart
+ * interval when the frame is coded in slices.
+ */
+static int encode_slice_codes(AVCodecContext *avctx, void *arg)
+{
+    MpegEncContext *const s = *(void**)arg;
+    MJpegContext *const m = s->mjpeg_ctx;
     uint8_t  *huff_size[4] = { m->huff_size_dc_luminance,
                                m->huff_size_dc_chrominance,
                                m->huff_size_ac_luminance,
@@ -117,75 +164,71 @@ static void mjpeg_encode_picture_frame(MpegEncContext *s)
                                m->huff_code_dc_chrominance,
                                m->huff_code_ac_luminance,
                                m->huff_code_ac_chrominance };
+    int bits = put_bits_count(&s->pb), ret;
     size_t total_bits = 0;
     size_t bytes_needed;
 
-    s->header_bits = get_bits_diff(s);
     // Estimate the total size first
-    for (int i = 0; i < m->huff_ncode; i++) {
-        table_id = m->huff_buffer[i].table_id;
-        code = m->huff_buffer[i].code;
-        nbits = code & 0xf;
+    for (int mb_y = s->start_mb_y; mb_y < s->end_mb_y; mb_y++) {
+        const MJpegHuffmanCode *c = m->huff_buffer + mb_y * m->huff_row_size;
 
-        total_bits += huff_size[table_id][code] + nbits;
+        for (size_t i = 0; i < m->huff_ncode[mb_y]; i++)
+            total_bits += huff_size[c[i].table_id][c[i].code] + (c[i].code & 0xf);
     }
 
     bytes_needed = (total_bits + 7) / 8;
-    ff_mpv_reallocate_putbitbuffer(s, bytes_needed, bytes_needed);
+    ret = ff_mpv_reallocate_putbitbuffer(s, bytes_needed, bytes_needed);
+    if (ret < 0) {
+        av_log(avctx, AV_LOG_ERROR, "Buffer reallocation failed\n");
+        return ret;
+    }
 
-    for (int i = 0; i < m->huff_ncode; i++) {
-        table_id = m->huff_buffer[i].table_id;
-        code = m->huff_buffer[i].code;
-        nbits = code & 0xf;
+    for (int mb_y = s->start_mb_y; mb_y < s->end_mb_y; mb_y++) {
+        const MJpegHuffmanCode *c = m->huff_buffer + mb_y * m->huff_row_size;
+
+        for (size_t i = 0; i < m->huff_ncode[mb_y]; i++) {
+            int table_id = c[i].table_id;
+            int code     = c[i].code;
+            int nbits    = code & 0xf;
+
+            put_bits(&s->pb, huff_size[table_id][code], huff_code[table_id][code]);
+            if (nbits != 0) {
+                put_sbits(&s->pb, nbits, c[i].mant);
+            }
+        }
 
-        put_bits(&s->pb, huff_size[table_id][code], huff_code[table_id][code]);
-        if (nbits != 0) {
-            put_sbits(&s->pb, nbits, m->huff_buffer[i].mant);
+        if (s->slice_context_count > 1 || mb_y == s->end_mb_y - 1) {
+            ret = mjpeg_end_restart_interval(s, mb_y);
+            if (ret < 0)
+                return ret;
         }
     }
+    flush_put_bits(&s->pb);
 
-    m->huff_ncode = 0;
-    s->i_tex_bits = get_bits_diff(s);
+    s->i_tex_bits += put_bits_count(&s->pb) - bits;
+    return 0;
 }
 
 /**
  * Builds all 4 optimal Huffman tables.
  *
- * Uses the data stored in the JPEG buffer to compute the tables.
  * Stores the Huffman tables in the bits_* and val_* arrays in the MJpegContext.
  *
- * @param m MJpegContext containing the JPEG buffer.
+ * @param m MJpegContext to store the tables in.
+ * @param ctx The code counts of the frame, per table.
  */
-static void mjpeg_build_optimal_huffman(MJpegContext *m)
+static void mjpeg_build_optimal_huffman(MJpegContext *m, MJpegEncHuffmanContext ctx[4])
 {
-    MJpegEncHuffmanContext dc_luminance_ctx;
-    MJpegEncHuffmanContext dc_chrominance_ctx;
-    MJpegEncHuffmanContext ac_luminance_ctx;
-    MJpegEncHuffmanContext ac_chrominance_ctx;
-    MJpegEncHuffmanContext *ctx[4] = { &dc_luminance_ctx,
-                                       &dc_chrominance_ctx,
-                                       &ac_luminance_ctx,
-                                       &ac_chrominance_ctx };
-    for (int i = 0; i < 4; i++)
-        ff_mjpeg_encode_huffman_init(ctx[i]);
-
-    for (int i = 0; i < m->huff_ncode; i++) {
-        int table_id = m->huff_buffer[i].table_id;
-        int code     = m->huff_buffer[i].code;
-
-        ff_mjpeg_encode_huffman_increment(ctx[table_id], code);
-    }
-
-    ff_mjpeg_encode_huffman_close(&dc_luminance_ctx,
+    ff_mjpeg_encode_huffman_close(&ctx[0],
                                   m->bits_dc_luminance,
                                   m->val_dc_luminance, 12);
-    ff_mjpeg_encode_huffman_close(&dc_chrominance_ctx,
+    ff_mjpeg_encode_huffman_close(&ctx[1],
                                   m->bits_dc_chrominance,
                                   m->val_dc_chrominance, 12);
-    ff_mjpeg_encode_huffman_close(&ac_luminance_ctx,
+    ff_mjpeg_encode_huffman_close(&ctx[2],
                                   m->bits_ac_luminance,
                                   m->val_ac_luminance, 256);
-    ff_mjpeg_encode_huffman_close(&ac_chrominance_ctx,
+    ff_mjpeg_encode_huffman_close(&ctx[3],
                                   m->bits_ac_chrominance,
                                   m->val_ac_chrominance, 256);
 
@@ -206,13 +249,59 @@ static void mjpeg_build_optimal_huffman(MJpegContext *m)
                                  m->bits_ac_chrominance,
                                  m->val_ac_chrominance);
 }
+
+int ff_mjpeg_encode_picture_frame(MpegEncContext *s)
+{
+    MJpegContext *const m = s->mjpeg_ctx;
+    AVCodecContext *const avctx = s->avctx;
+    const int nb_slices = s->slice_context_count;
+    int rets[MAX_THREADS];
+    int bits;
+
+    if (!m->huff_stats) {
+        m->huff_stats = av_calloc(nb_slices, sizeof(*m->huff_stats));
+        if (!m->huff_stats)
+            return AVERROR(ENOMEM);
+    }
+
+    // The statistics of the slices are gathered in parallel, then summed.
+    avctx->execute(avctx, count_slice_codes, s->thread_context, NULL,
+                   nb_slices, sizeof(void*));
+    for (int i = 1; i < nb_slices; i++)
+        for (int t = 0; t < 4; t++)
+            for (int v = 0; v < 256; v++)
+                m->huff_stats[0][t].val_count[v] += m->huff_stats[i][t].val_count[v];
+
+    mjpeg_build_optimal_huffman(m, m->huff_stats[0]);
+
+    // Replace the VLCs with the optimal ones.
+    // The default ones may be used for trellis during quantization.
+    init_uni_ac_vlc(m->huff_size_ac_luminance,   m->uni_ac_vlc_len);
+    init_uni_ac_vlc(m->huff_size_ac_chrominance, m->uni_chroma_ac_vlc_len);
+    s->intra_ac_vlc_length      =
+    s->intra_ac_vlc_last_length = m->uni_ac_vlc_len;
+    s->intra_chroma_ac_vlc_length      =
+    s->intra_chroma_ac_vlc_last_length = m->uni_chroma_ac_vlc_len;
+
+    bits = put_bits_count(&s->pb);
+    mjpeg_encode_picture_header(s);
+    s->header_bits = put_bits_count(&s->pb) - bits;
+
+    // Each slice context codes its rows into its own part of the packet.
+    avctx->execute(avctx, encode_slice_codes, s->thread_context, rets,
+                   nb_slices, sizeof(void*));
+    for (int i = 0; i < nb_slices; i++)
+        if (rets[i] < 0)
+            return rets[i];
+
+    return 0;
+}
 #endif
 
 /**
- * Writes the complete JPEG frame when optimal huffman tables are enabled,
- * otherwise writes the stuffing.
- *
- * Header + values + stuffing.
+ * Writes the stuffing at the end of a restart interval. With optimal
+ * huffman tables, only resets the DC prediction: the codes of the frame
+ * are written by ff_mjpeg_encode_picture_frame() once all are known.
  *
  * @param s The MpegEncContext.
  * @return int Error code, 0 if successful.
@@ -220,43 +309,12 @@ static void mjpeg_build_optimal_huffman(MJpegContext *m)
 int ff_mjpeg_encode_stuffing(MpegEncContext *s)
 {
     MJpegContext *const m = s->mjpeg_ctx;
-    PutBitContext *pbc = &s->pb;
     int mb_y = s->mb_y - !s->mb_x;
-    int ret;
-
-#if CONFIG_MJPEG_ENCODER
-    if (m->huffman == HUFFMAN_TABLE_OPTIMAL) {
+    int ret = 0;
 
-        mjpeg_build_optimal_huffman(m);
+    if (m->huffman != HUFFMAN_TABLE_OPTIMAL)
+        ret = mjpeg_end_restart_interval(s, mb_y);
 
-        // Replace the VLCs with the optimal ones.
-        // The default ones may be used for trellis during quantization.
-        init_uni_ac_vlc(m->huff_size_ac_luminance,   m->uni_ac_vlc_len);
-        init_uni_ac_vlc(m->huff_size_ac_chrominance, m->uni_chroma_ac_vlc_len);
-        s->intra_ac_vlc_length      =
-        s->intra_ac_vlc_last_length = m->uni_ac_vlc_len;
-        s->intra_chroma_ac_vlc_length      =
-        s->intra_chroma_ac_vlc_last_length = m->uni_chroma_ac_vlc_len;
-
-        mjpeg_encode_picture_header(s);
-        mjpeg_encode_picture_frame(s);
-    }
-#endif
-
-    ret = ff_mpv_reallocate_putbitbuffer(s, put_bits_count(&s->pb) / 8 + 100,
-                                            put_bits_count(&s->pb) / 4 + 1000);
-    if (ret < 0) {
-        av_log(s->avctx, AV_LOG_ERROR, "Buffer reallocation failed\n");
-        goto fail;
-    }
-
-    ff_mjpeg_escape_FF(pbc, s->esc_pos);
-
-    if (s->slice_context_count > 1 && mb_y < s->mb_height - 1)
-        put_marker(pbc, RST0 + (mb_y&7));
-    s->esc_pos = put_bytes_count(pbc, 0);
-
-fail:
     for (int i = 0; i < 3; i++)
         s->last_dc[i] = 128 << s->intra_dc_precision;
 
@@ -285,8 +343,12 @@ static int alloc_huffman(MpegEncContext *s)
     num_blocks = num_mbs * blocks_per_mb;
     num_codes = num_blocks * 64;
 
+    // Each MB row gets its own part of the buffer, so that the rows
+    // of the slice contexts can be recorded concurrently.
+    m->huff_row_size = (size_t)s->mb_width * blocks_per_mb * 64;
     m->huff_buffer = av_malloc_array(num_codes, sizeof(MJpegHuffmanCode));
-    if (!m->huff_buffer)
+    m->huff_ncode  = av_calloc(s->mb_height, sizeof(*m->huff_ncode));
+    if (!m->huff_buffer || !m->huff_ncode)
         return AVERROR(ENOMEM);
     return 0;
 }
@@ -294,14 +356,11 @@ static int alloc_huffman(MpegEncContext *s)
 av_cold int ff_mjpeg_encode_init(MpegEncContext *s)
 {
     MJpegContext *const m = &((MJPEGEncContext*)s)->mjpeg;
-    int ret, use_slices;
+    int ret;
 
     s->mjpeg_ctx = m;
-    use_slices = s->avctx->slices > 0 ? s->avctx->slices > 1 :
-                 (s->avctx->active_thread_type & FF_THREAD_SLICE) &&
-                 s->avctx->thread_count > 1;
 
-    if (s->codec_id == AV_CODEC_ID_AMV || use_slices)
+    if (s->codec_id == AV_CODEC_ID_AMV)
         m->huffman = HUFFMAN_TABLE_DEFAULT;
 
     if (s->mpv_flags & FF_MPV_FLAG_QP_RD) {
@@ -352,9 +411,6 @@ av_cold int ff_mjpeg_encode_init(MpegEncContext *s)
     s->intra_chroma_ac_vlc_length      =
     s->intra_chroma_ac_vlc_last_length = m->uni_chroma_ac_vlc_len;
 
-    // Buffers start out empty.
-    m->huff_ncode = 0;
-
     if (m->huffman == HUFFMAN_TABLE_OPTIMAL)
         return alloc_huffman(s);
 
@@ -365,6 +421,8 @@ static av_cold int mjpeg_encode_close(AVCodecContext *avctx)
 {
     MJPEGEncContext *const mjpeg = avctx->priv_data;
     av_freep(&mjpeg->mjpeg.huff_buffer);
+    av_freep(&mjpeg->mjpeg.huff_ncode);
+    av_freep(&mjpeg->mjpeg.huff_stats);
     ff_mpv_encode_end(avctx);
     return 0;
 }
@@ -372,32 +430,32 @@ static av_cold int mjpeg_encode_close(AVCodecContext *avctx)
 /**
  * Add code and table_id to the JPEG buffer.
  *
- * @param s The MJpegContext which contains the JPEG buffer.
+ * @param c The position in the JPEG buffer, advanced past the code.
  * @param table_id Which Huffman table the code belongs to.
  * @param code The encoded exponent of the coefficients and the run-bits.
  */
-static inline void ff_mjpeg_encode_code(MJpegContext *s, uint8_t table_id, int code)
+static inline void ff_mjpeg_encode_code(MJpegHuffmanCode **c, uint8_t table_id, int code)
 {
-    MJpegHuffmanCode *c = &s->huff_buffer[s->huff_ncode++];
-    c->table_id = table_id;
-    c->code = code;
+    (*c)->table_id = table_id;
+    (*c)->code = code;
+    (*c)++;
 }
 
 /**
  * Add the coefficient's data to the JPEG buffer.
  *
- * @param s The MJpegContext which contains the JPEG buffer.
+ * @param c The position in the JPEG buffer, advanced past the code.
  * @param table_id Which Huffman table the code belongs to.
  * @param val The coefficient.
  * @param run The run-bits.
  */
-static void ff_mjpeg_encode_coef(MJpegContext *s, uint8_t table_id, int val, int run)
+static void ff_mjpeg_encode_coef(MJpegHuffmanCode **c, uint8_t table_id, int val, int run)
 {
     int mant, code;
 
     if (val == 0) {
         av_assert0(run == 0);
-        ff_mjpeg_encode_code(s, table_id, 0);
+        ff_mjpeg_encode_code(c, table_id, 0);
     } else {
         mant = val;
         if (val < 0) {
@@ -407,23 +465,24 @@ static void ff_mjpeg_encode_coef(MJpegContext *s, uint8_t table_id, int val, int
 
         code = (run << 4) | (av_log2_16bit(val) + 1);
 
-        s->huff_buffer[s->huff_ncode].mant = mant;
-        ff_mjpeg_encode_code(s, table_id, code);
+        (*c)->mant = mant;
+        ff_mjpeg_encode_code(c, table_id, code);
     }
 }
 
 /**
  * Add the block's data into the JPEG buffer.
  *
- * @param s The MpegEncContext that contains the JPEG buffer.
+ * @param s The MpegEncContext.
+ * @param c The position in the JPEG buffer, advanced past the block.
  * @param block The block.
  * @param n The block's index or number.
  */
-static void record_block(MpegEncContext *s, int16_t *block, int n)
+static void record_block(MpegEncContext *s, MJpegHuffmanCode **c,
+                         int16_t *block, int n)
 {
     int i, j, table_id;
     int component, dc, last_index, val, run;
-    MJpegContext *m = s->mjpeg_ctx;
 
     /* DC coef */
     component = (n <= 3 ? 0 : (n&1) + 1);
@@ -431,7 +490,7 @@ static void record_block(MpegEncContext *s, int16_t *block, int n)
     dc = block[0]; /* overflow is impossible */
     val = dc - s->last_dc[component];
 
-    ff_mjpeg_encode_coef(m, table_id, val, 0);
+    ff_mjpeg_encode_coef(c, table_id, val, 0);
 
     s->last_dc[component] = dc;
 
@@ -449,17 +508,17 @@ static void record_block(MpegEncContext *s, int16_t *block, int n)
             run++;
         } else {
             while (run >= 16) {
-                ff_mjpeg_encode_code(m, table_id, 0xf0);
+                ff_mjpeg_encode_code(c, table_id, 0xf0);
                 run -= 16;
             }
-            ff_mjpeg_encode_coef(m, table_id, val, run);
+            ff_mjpeg_encode_coef(c, table_id, val, run);
             run = 0;
         }
     }
 
     /* output EOB only if not already 64 values */
     if (last_index < 63 || run != 0)
-        ff_mjpeg_encode_code(m, table_id, 0);
+        ff_mjpeg_encode_code(c, table_id, 0);
 }
 
 static void encode_block(MpegEncContext *s, int16_t *block, int n)
@@ -524,34 +583,44 @@ void ff_mjpeg_encode_mb(MpegEncContext *s, int16_t block[12][64])
 {
     int i;
     if (s->mjpeg_ctx->huffman == HUFFMAN_TABLE_OPTIMAL) {
+        MJpegContext *const m = s->mjpeg_ctx;
+        MJpegHuffmanCode *const row = m->huff_buffer + s->mb_y * m->huff_row_size;
+        MJpegHuffmanCode *c;
+
+        if (!s->mb_x)
+            m->huff_ncode[s->mb_y] = 0;
+        c = row + m->huff_ncode[s->mb_y];
+
         if (s->chroma_format == CHROMA_444) {
-            record_block(s, block[0], 0);
-            record_block(s, block[2], 2);
-            record_block(s, block[4], 4);
-            record_block(s, block[8], 8);
-            record_block(s, block[5], 5);
-            record_block(s, block[9], 9);
+            record_block(s, &c, block[0], 0);
+            record_block(s, &c, block[2], 2);
+            record_block(s, &c, block[4], 4);
+            record_block(s, &c, block[8], 8);
+            record_block(s, &c, block[5], 5);
+            record_block(s, &c, block[9], 9);
 
             if (16*s->mb_x+8 < s->width) {
-                record_block(s, block[1], 1);
-                record_block(s, block[3], 3);
-                record_block(s, block[6], 6);
-                record_block(s, block[10], 10);
-                record_block(s, block[7], 7);
-                record_block(s, block[11], 11);
+                record_block(s, &c, block[1], 1);
+                record_block(s, &c, block[3], 3);
+                record_block(s, &c, block[6], 6);
+                record_block(s, &c, block[10], 10);
+                record_block(s, &c, block[7], 7);
+                record_block(s, &c, block[11], 11);
             }
         } else {
             for(i=0;i<5;i++) {
-                record_block(s, block[i], i);
+                record_block(s, &c, block[i], i);
             }
             if (s->chroma_format == CHROMA_420) {
-                record_block(s, block[5], 5);
+                record_block(s, &c, block[5], 5);
             } else {
-                record_block(s, block[6], 6);
-                record_block(s, block[5], 5);
-                record_block(s, block[7], 7);
+                record_block(s, &c, block[6], 6);
+                record_block(s, &c, block[5], 5);
+                record_block(s, &c, block[7], 7);
             }
         }
+
+        m->huff_ncode[s->mb_y] = c - row;
     } else {
         if (s->chroma_format == CHROMA_444) {
             encode_block(s, block[0], 0);
@@ -36,6 +36,7 @@
 #include <stdint.h>
 
 #include "mjpeg.h"
+#include "mjpegenc_huffman.h"
 #include "mpegvideo.h"
 #include "put_bits.h"
 
@@ -44,7 +45,9 @@
  *
  * Optimal Huffman table generation requires the frame data to be loaded into
  * a buffer so that the tables can be computed.
- * There are at most mb_width*mb_height*12*64 of these per frame.
+ * There are at most mb_width*mb_height*12*64 of these per frame; each row
+ * of macroblocks has its own part of the buffer, so that the slice contexts
+ * can fill and code their rows in parallel.
  */
 typedef struct MJpegHuffmanCode {
     // 0=DC lum, 1=DC chrom, 2=AC lum, 3=AC chrom
@@ -88,8 +91,10 @@ typedef struct MJpegContext {
     uint8_t bits_ac_chrominance[17]; ///< AC chrominance Huffman bits.
     uint8_t val_ac_chrominance[256]; ///< AC chrominance Huffman values.
 
-    size_t huff_ncode;               ///< Number of current entries in the buffer.
+    size_t *huff_ncode;              ///< Number of entries of each row in the buffer.
+    size_t huff_row_size;            ///< Entries reserved for each row in the buffer.
     MJpegHuffmanCode *huff_buffer;   ///< Buffer for Huffman code values.
+    MJpegEncHuffmanContext (*huff_stats)[4]; ///< Code counts of each slice context.
 } MJpegContext;
 
 /**
@@ -111,5 +116,10 @@ int  ff_mjpeg_encode_init(MpegEncContext *s);
 void ff_mjpeg_amv_encode_picture_header(MpegEncContext *s);
 void ff_mjpeg_encode_mb(MpegEncContext *s, int16_t block[12][64]);
 int  ff_mjpeg_encode_stuffing(MpegEncContext *s);
+/**
+ * Build the optimal Huffman tables from the codes recorded by all slice
+ * contexts, write the picture header and code the slices.
+ */
+int  ff_mjpeg_encode_picture_frame(MpegEncContext *s);
 
 #endif /* AVCODEC_MJPEGENC_H */
@@ -30,6 +30,7 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/crc.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/libm.h"
 #include "libavutil/opt.h"
 #include "libavutil/color_utils.h"
@@ -39,6 +40,10 @@
 
 #define IOBUF_SIZE 4096
 
+/* uncompressed bytes per block when deflating with slice threads */
+#define PNG_BLOCK_SIZE  (1 << 17)
+#define PNG_WINDOW_SIZE (1 << 15)
+
 typedef struct APNGFctlChunk {
     uint32_t sequence_number;
     uint32_t width, height;
@@ -47,6 +52,19 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+typedef struct PNGEncThread {
+    FFZStream zstream;           ///< raw deflate stream
+    uint8_t *crow_base;
+} PNGEncThread;
+
+typedef struct PNGEncBlock {
+    uint8_t *buf;                ///< the IDAT/fdAT chunk holding the block
+    unsigned int buf_size;
+    int size;                    ///< size of the chunk or an error code
+    int in_size;                 ///< size of the filtered rows
+    uLong adler;                 ///< Adler-32 of the filtered rows
+} PNGEncBlock;
+
 typedef struct PNGEncContext {
     AVClass *class;
     LLVidEncDSPContext llvidencdsp;
@@ -59,6 +77,7 @@ typedef struct PNGEncContext {
 
     FFZStream zstream;
     uint8_t buf[IOBUF_SIZE];
+    int compression_level;
     int dpi;                     ///< Physical pixel density, in dots per inch, if set
     int dpm;                     ///< Physical pixel density, in dots per meter, if set
 
@@ -79,6 +98,15 @@ typedef struct PNGEncContext {
     APNGFctlChunk last_frame_fctl;
     uint8_t *last_frame_packet;
     size_t last_frame_packet_size;
+
+    // slice threading
+    PNGEncThread *threads;
+    int nb_threads;
+    PNGEncBlock *blocks;
+    int nb_blocks_allocated;
+    int block_rows;
+    uint8_t *filtered;           ///< the filtered rows of the image
+    unsigned int filtered_size;
 } PNGEncContext;
 
 static void png_get_interlaced_row(uint8_t *dst, int row_size,
@@ -479,6 +507,201 @@ static int encode_headers(AVCodecContext *avctx, const AVFrame *pict)
     return 0;
 }
 
+static int deflate_block_data(PNGEncBlock *b, z_stream *zstream,
+                              const uint8_t *data, int size, int flush)
+{
+    int ret;
+
+    zstream->next_in  = data;
+    zstream->avail_in = size;
+    do {
+        if (!zstream->avail_out) {
+            ptrdiff_t pos = zstream->next_out - b->buf;
+            uint8_t *buf = av_fast_realloc(b->buf, &b->buf_size, b->buf_size * 3 / 2);
+            if (!buf)
+                return AVERROR(ENOMEM);
+            b->buf = buf;
+            /* room for the Adler-32 and the CRC */
+            zstream->next_out  = buf + pos;
+            zstream->avail_out = b->buf_size - pos - 8;
+        }
+        ret = deflate(zstream, flush);
+        if (ret == Z_STREAM_ERROR)
+            return AVERROR_EXTERNAL;
+    } while (flush == Z_FINISH ? ret != Z_STREAM_END
+                               : zstream->avail_in || !zstream->avail_out);
+    return 0;
+}
+
+static void finish_block_chunk(PNGEncBlock *b)
+{
+    const AVCRC *crc_table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+
+    AV_WB32(b->buf, b->size - 8);
+    AV_WB32(b->buf + b->size, ~av_crc(crc_table, ~0U, b->buf + 4, b->size - 4));
+    b->size += 4;
+}
+
+static int filter_block(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s       = avctx->priv_data;
+    const AVFrame *const p = arg;
+    const int row_size = (p->width * s->bits_per_pixel + 7) >> 3;
+    const int bpp      = s->bits_per_pixel >> 3;
+    const int y0       = jobnr * s->block_rows;
+    const int y1       = FFMIN(y0 + s->block_rows, p->height);
+    uint8_t *crow_buf  = s->threads[threadnr].crow_base + 15;
+    uint8_t *dst       = s->filtered + y0 * (row_size + 1);
+    uint8_t *top       = y0 ? p->data[0] + (y0 - 1) * p->linesize[0] : NULL;
+
+    for (int y = y0; y < y1; y++) {
+        uint8_t *ptr = p->data[0] + y * p->linesize[0];
+        memcpy(dst, png_choose_filter(s, crow_buf, ptr, top, row_size, bpp), row_size + 1);
+        dst += row_size + 1;
+        top  = ptr;
+    }
+    return 0;
+}
+
+/**
+ * Deflate the filtered rows of one block into a chunk of its own, as a raw
+ * deflate stream ending on a byte boundary. The window is primed with the
+ * end of the previous block, so the blocks concatenate into one zlib stream
+ * (the approach of pigz) compressing almost as well as a sequential one.
+ */
+static int deflate_block(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s        = avctx->priv_data;
+    const AVFrame *const p  = arg;
+    PNGEncBlock *b          = &s->blocks[jobnr];
+    z_stream *const zstream = &s->threads[threadnr].zstream.zstream;
+    const int row_size = (p->width * s->bits_per_pixel + 7) >> 3;
+    const int y0       = jobnr * s->block_rows;
+    const int y1       = FFMIN(y0 + s->block_rows, p->height);
+    const int last     = y1 == p->height;
+    const int fdat     = avctx->codec_id == AV_CODEC_ID_APNG && avctx->frame_number;
+    const int hdr_size = 8 + 4 * fdat + 2 * !jobnr;
+    const uint8_t *in  = s->filtered + y0 * (row_size + 1);
+    int ret;
+
+    b->in_size = (y1 - y0) * (row_size + 1);
+    b->adler   = adler32(adler32(0, NULL, 0), in, b->in_size);
+
+    deflateReset(zstream);
+    if (y0) {
+        int len = FFMIN(in - s->filtered, PNG_WINDOW_SIZE);
+        if (deflateSetDictionary(zstream, in - len, len) != Z_OK) {
+            ret = AVERROR_EXTERNAL;
+            goto fail;
+        }
+    }
+
+    av_fast_malloc(&b->buf, &b->buf_size,
+                   hdr_size + deflateBound(zstream, b->in_size) + 32);
+    if (!b->buf) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    zstream->next_out  = b->buf + hdr_size;
+    zstream->avail_out = b->buf_size - hdr_size - 8;
+    ret = deflate_block_data(b, zstream, in, b->in_size, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret < 0)
+        goto fail;
+
+    AV_WB32(b->buf + 4, fdat ? MKBETAG('f', 'd', 'A', 'T') : MKBETAG('I', 'D', 'A', 'T'));
+    if (fdat)
+        AV_WB32(b->buf + 8, s->sequence_number + jobnr);
+    if (!jobnr) {
+        /* the zlib header deflate() would have written */
+        int level = s->compression_level == Z_DEFAULT_COMPRESSION ? 6 : s->compression_level;
+        int header = (0x78 << 8) | ((level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6);
+        AV_WB16(b->buf + hdr_size - 2, header + 31 - header % 31);
+    }
+    b->size = zstream->next_out - b->buf;
+    /* the last chunk is completed once the Adler-32 of the image is known */
+    if (!last)
+        finish_block_chunk(b);
+    return 0;
+
+fail:
+    b->size = ret;
+    return ret;
+}
+
+static int encode_frame_blocks(AVCodecContext *avctx, const AVFrame *pict)
+{
+    PNGEncContext *s = avctx->priv_data;
+    const int row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
+    const int nb_blocks = (pict->height + s->block_rows - 1) / s->block_rows;
+    PNGEncBlock *last;
+    uLong adler = 0;
+
+    if (nb_blocks > s->nb_blocks_allocated) {
+        PNGEncBlock *blocks = av_realloc_array(s->blocks, nb_blocks, sizeof(*blocks));
+        if (!blocks)
+            return AVERROR(ENOMEM);
+        memset(blocks + s->nb_blocks_allocated, 0,
+               (nb_blocks - s->nb_blocks_allocated) * sizeof(*blocks));
+        s->blocks = blocks;
+        s->nb_blocks_allocated = nb_blocks;
+    }
+    av_fast_malloc(&s->filtered, &s->filtered_size, (size_t)pict->height * (row_size + 1));
+    if (!s->filtered)
+        return AVERROR(ENOMEM);
+
+    /* the dictionary of a block is the end of the previous one, so all rows
+     * are filtered before any block is deflated */
+    avctx->execute2(avctx, filter_block,  (void *)pict, NULL, nb_blocks);
+    avctx->execute2(avctx, deflate_block, (void *)pict, NULL, nb_blocks);
+
+    for (int i = 0; i < nb_blocks; i++) {
+        PNGEncBlock *b = &s->blocks[i];
+        if (b->size < 0)
+            return b->size;
+        adler = i ? adler32_combine(adler, b->adler, b->in_size) : b->adler;
+    }
+    last = &s->blocks[nb_blocks - 1];
+    AV_WB32(last->buf + last->size, adler);
+    last->size += 4;
+    finish_block_chunk(last);
+
+    for (int i = 0; i < nb_blocks; i++) {
+        PNGEncBlock *b = &s->blocks[i];
+        if (s->bytestream_end - s->bytestream < b->size)
+            return AVERROR_BUG;
+        memcpy(s->bytestream, b->buf, b->size);
+        s->bytestream += b->size;
+    }
+    if (avctx->codec_id == AV_CODEC_ID_APNG && avctx->frame_number)
+        s->sequence_number += nb_blocks;
+
+    return 0;
+}
+
+static int init_block_threads(AVCodecContext *avctx)
+{
+    PNGEncContext *s = avctx->priv_data;
+    const int row_size = (avctx->width * s->bits_per_pixel + 7) >> 3;
+    int ret;
+
+    s->threads = av_calloc(avctx->thread_count, sizeof(*s->threads));
+    if (!s->threads)
+        return AVERROR(ENOMEM);
+    s->nb_threads = avctx->thread_count;
+
+    for (int i = 0; i < s->nb_threads; i++) {
+        PNGEncThread *t = &s->threads[i];
+
+        t->crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+        if (!t->crow_base)
+            return AVERROR(ENOMEM);
+        if ((ret = ff_deflate_init2(&t->zstream, s->compression_level,
+                                    -MAX_WBITS, avctx)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 {
     PNGEncContext *s       = avctx->priv_data;
@@ -493,6 +716,9 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
+    if (s->threads && !s->is_progressive && pict->height > s->block_rows)
+        return encode_frame_blocks(avctx, pict);
+
     crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
     if (!crow_base) {
         ret = AVERROR(ENOMEM);
@@ -1072,7 +1298,7 @@ static int encode_apng(AVCodecContext *avctx, AVPacket *pkt,
 static av_cold int png_enc_init(AVCodecContext *avctx)
 {
     PNGEncContext *s = avctx->priv_data;
-    int compression_level;
+    int ret;
 
     switch (avctx->pix_fmt) {
     case AV_PIX_FMT_RGBA:
@@ -1150,10 +1376,17 @@ static av_cold int png_enc_init(AVCodecContext *avctx)
     }
     s->bits_per_pixel = ff_png_get_nb_channels(s->color_type) * s->bit_depth;
 
-    compression_level = avctx->compression_level == FF_COMPRESSION_DEFAULT
-                      ? Z_DEFAULT_COMPRESSION
-                      : av_clip(avctx->compression_level, 0, 9);
-    return ff_deflate_init(&s->zstream, compression_level, avctx);
+    s->compression_level = avctx->compression_level == FF_COMPRESSION_DEFAULT
+                         ? Z_DEFAULT_COMPRESSION
+                         : av_clip(avctx->compression_level, 0, 9);
+    ret = ff_deflate_init(&s->zstream, s->compression_level, avctx);
+    if (ret < 0)
+        return ret;
+
+    s->block_rows = FFMAX(PNG_BLOCK_SIZE / (((avctx->width * s->bits_per_pixel + 7) >> 3) + 1), 1);
+    if (avctx->active_thread_type & FF_THREAD_SLICE)
+        return init_block_threads(avctx);
+    return 0;
 }
 
 static av_cold int png_enc_close(AVCodecContext *avctx)
@@ -1161,6 +1394,17 @@ static av_cold int png_enc_close(AVCodecContext *avctx)
     PNGEncContext *s = avctx->priv_data;
 
     ff_deflate_end(&s->zstream);
+    for (int i = 0; i < s->nb_threads; i++) {
+        ff_deflate_end(&s->threads[i].zstream);
+        av_freep(&s->threads[i].crow_base);
+    }
+    av_freep(&s->threads);
+    s->nb_threads = 0;
+    for (int i = 0; i < s->nb_blocks_allocated; i++)
+        av_freep(&s->blocks[i].buf);
+    av_freep(&s->blocks);
+    s->nb_blocks_allocated = 0;
+    av_freep(&s->filtered);
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1200,7 +1444,7 @@ const FFCodec ff_png_encoder = {
     .init           = png_enc_init,
     .close          = png_enc_close,
     FF_CODEC_ENCODE_CB(encode_png),
-    .p.capabilities = AV_CODEC_CAP_FRAME_THREADS,
+    .p.capabilities = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS,
     .p.pix_fmts     = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA,
         AV_PIX_FMT_RGB48BE, AV_PIX_FMT_RGBA64BE,
@@ -1218,7 +1462,8 @@ const FFCodec ff_apng_encoder = {
     .p.long_name    = NULL_IF_CONFIG_SMALL("APNG (Animated Portable Network Graphics) image"),
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_APNG,
-    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY,
+    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(PNGEncContext),
     .init           = png_enc_init,
     .close          = png_enc_close,
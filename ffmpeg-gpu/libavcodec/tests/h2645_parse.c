@@ -0,0 +1,268 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/defs.h"
+#include "libavcodec/h2645_parse.h"
+
+#define MAX_NALS 64
+
+/* bytes with a zero density of about 1 / zero_rate */
+static void fill_payload(AVLFG *lfg, uint8_t *buf, int size, int zero_rate)
+{
+    for (int i = 0; i < size; i++) {
+        uint32_t r = av_lfg_get(lfg);
+        buf[i] = r % zero_rate ? (r >> 8) & 0xff : 0;
+        if (!(r >> 28) && i + 1 < size)
+            buf[++i] = av_lfg_get(lfg) & 3;
+    }
+}
+
+/* the removal of the emulation prevention bytes, one byte at a time */
+static int extract_rbsp_ref(const uint8_t *src, int length, uint8_t *dst,
+                            int *size, int *skipped, int *nb_skipped)
+{
+    int si = 0, di = 0;
+
+    *nb_skipped = 0;
+    while (si < length) {
+        if (si + 2 < length && !src[si] && !src[si + 1] && src[si + 2] && src[si + 2] <= 3) {
+            if (src[si + 2] != 3)
+                break;
+            dst[di++] = 0;
+            dst[di++] = 0;
+            si += 3;
+            skipped[(*nb_skipped)++] = di - 1;
+            continue;
+        }
+        dst[di++] = src[si++];
+    }
+    *size = di;
+    return si;
+}
+
+static int test_extract_rbsp(AVLFG *lfg, int zero_rate, int small_padding)
+{
+    int size = 1 + av_lfg_get(lfg) % 4096, ref_size, ref_nb_skipped, consumed, ref_consumed;
+    uint8_t *src = av_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    uint8_t *ref = av_malloc(size);
+    int *ref_skipped = av_malloc_array(size, sizeof(*ref_skipped));
+    H2645RBSP rbsp = { .rbsp_buffer = av_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE) };
+    H2645NAL nal = { .skipped_bytes_pos_size = 1,
+                     .skipped_bytes_pos = av_malloc(sizeof(*nal.skipped_bytes_pos)) };
+    int ret = AVERROR(ENOMEM);
+
+    if (!src || !ref || !ref_skipped || !rbsp.rbsp_buffer || !nal.skipped_bytes_pos)
+        goto end;
+    fill_payload(lfg, src, size, zero_rate);
+    /* zeros in the padding must not be taken for a start code */
+    memset(src + size, av_lfg_get(lfg) & 1 ? 0 : 0xff, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    consumed     = ff_h2645_extract_rbsp(src, size, &rbsp, &nal, small_padding);
+    ref_consumed = extract_rbsp_ref(src, size, ref, &ref_size, ref_skipped, &ref_nb_skipped);
+    ret = consumed == ref_consumed && nal.size == ref_size && nal.raw_size == consumed &&
+          nal.raw_data == src && !memcmp(nal.data, ref, ref_size) &&
+          nal.skipped_bytes == ref_nb_skipped &&
+          !memcmp(nal.skipped_bytes_pos, ref_skipped, ref_nb_skipped * sizeof(*ref_skipped)) ?
+          0 : AVERROR_BUG;
+    if (ret < 0)
+        printf("extract_rbsp: size %d, zero rate %d, small padding %d: "
+               "consumed %d/%d, rbsp size %d/%d, %d/%d escapes\n",
+               size, zero_rate, small_padding, consumed, ref_consumed,
+               nal.size, ref_size, nal.skipped_bytes, ref_nb_skipped);
+
+end:
+    av_free(src);
+    av_free(ref);
+    av_free(ref_skipped);
+    av_free(rbsp.rbsp_buffer);
+    av_free(nal.skipped_bytes_pos);
+    return ret;
+}
+
+/* payload, escaped: 00 00 0x with x <= 3 becomes 00 00 03 0x */
+static int escape_nal(uint8_t *dst, const uint8_t *src, int size)
+{
+    int zeros = 0, di = 0;
+
+    for (int i = 0; i < size; i++) {
+        if (zeros == 2 && src[i] <= 3) {
+            dst[di++] = 3;
+            zeros = 0;
+        }
+        zeros = src[i] ? 0 : zeros + 1;
+        dst[di++] = src[i];
+    }
+    return di;
+}
+
+/* an Annex B access unit of H.264 slices, nb NAL units of up to max_size bytes */
+static int gen_access_unit(AVLFG *lfg, uint8_t *buf, uint8_t **nals, int *sizes,
+                           int nb, int max_size, int zero_rate)
+{
+    int pos = 0;
+
+    for (int i = 0; i < nb; i++) {
+        uint8_t *nal = nals[i];
+        int size = 2 + av_lfg_get(lfg) % (max_size - 1);
+
+        fill_payload(lfg, nal, size, zero_rate);
+        nal[0] = 0x65;
+        /* rbsp_stop_one_bit */
+        nal[size - 1] |= 1;
+        sizes[i] = size;
+
+        if (!i || av_lfg_get(lfg) & 1)
+            buf[pos++] = 0;
+        buf[pos++] = 0;
+        buf[pos++] = 0;
+        buf[pos++] = 1;
+        pos += escape_nal(buf + pos, nal, size);
+        /* trailing_zero_8bits */
+        if (!(av_lfg_get(lfg) & 3))
+            for (int j = av_lfg_get(lfg) % 4; j >= 0; j--)
+                buf[pos++] = 0;
+    }
+    memset(buf + pos, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    return pos;
+}
+
+static int test_packet_split(AVLFG *lfg, H2645Packet *pkt, int zero_rate)
+{
+    const int max_size = 2048, nb = 1 + av_lfg_get(lfg) % MAX_NALS;
+    uint8_t *buf = av_malloc(MAX_NALS * (max_size * 3 / 2 + 8) + AV_INPUT_BUFFER_PADDING_SIZE);
+    uint8_t *nals[MAX_NALS] = { NULL };
+    int sizes[MAX_NALS], size, ret = AVERROR(ENOMEM);
+
+    if (!buf)
+        goto end;
+    for (int i = 0; i < nb; i++)
+        if (!(nals[i] = av_malloc(max_size)))
+            goto end;
+    size = gen_access_unit(lfg, buf, nals, sizes, nb, max_size, zero_rate);
+
+    ret = ff_h2645_packet_split(pkt, buf, size, NULL, 0, 0, AV_CODEC_ID_H264, 0, 0);
+    if (ret < 0)
+        goto end;
+    ret = pkt->nb_nals == nb ? 0 : AVERROR_BUG;
+    for (int i = 0; i < FFMIN(nb, pkt->nb_nals) && !ret; i++) {
+        const H2645NAL *nal = &pkt->nals[i];
+        /* the trailing zeros stay in the NAL unit */
+        if (nal->size < sizes[i] || memcmp(nal->data, nals[i], sizes[i]))
+            ret = AVERROR_BUG;
+        for (int j = sizes[i]; j < nal->size && !ret; j++)
+            if (nal->data[j])
+                ret = AVERROR_BUG;
+    }
+    if (ret < 0)
+        printf("packet_split: %d NAL units, zero rate %d: %d NAL units found\n",
+               nb, zero_rate, pkt->nb_nals);
+
+end:
+    av_free(buf);
+    for (int i = 0; i < nb; i++)
+        av_free(nals[i]);
+    return ret;
+}
+
+/* high bitrate intra: a few large slices per access unit */
+static int benchmark(void)
+{
+    static const int zero_rates[] = { 256, 16, 4 };
+    const int nb = 8, max_size = 1 << 20, runs = 20;
+    uint8_t *buf = av_malloc(nb * (max_size * 3 / 2 + 8) + AV_INPUT_BUFFER_PADDING_SIZE);
+    uint8_t *dst = av_malloc(max_size * 3 / 2 + 8);
+    int *skipped = av_malloc_array(max_size, sizeof(*skipped));
+    uint8_t *nals[8] = { NULL };
+    H2645Packet pkt = { 0 };
+    int sizes[8], ret = AVERROR(ENOMEM);
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 0);
+    if (!buf || !dst || !skipped)
+        goto end;
+    for (int i = 0; i < nb; i++)
+        if (!(nals[i] = av_malloc(max_size)))
+            goto end;
+
+    for (int z = 0; z < FF_ARRAY_ELEMS(zero_rates); z++) {
+        int size = gen_access_unit(&lfg, buf, nals, sizes, nb, max_size, zero_rates[z]);
+        int64_t t[2];
+
+        t[0] = av_gettime_relative();
+        for (int r = 0; r < runs; r++)
+            if ((ret = ff_h2645_packet_split(&pkt, buf, size, NULL, 0, 0,
+                                             AV_CODEC_ID_H264, 0, 0)) < 0)
+                goto end;
+        t[0] = av_gettime_relative() - t[0];
+
+        t[1] = av_gettime_relative();
+        for (int r = 0; r < runs; r++) {
+            for (int i = 0; i < pkt.nb_nals; i++) {
+                int rbsp_size, nb_skipped, pos = pkt.nals[i].raw_data - buf;
+                extract_rbsp_ref(buf + pos, size - pos, dst, &rbsp_size, skipped, &nb_skipped);
+            }
+        }
+        t[1] = av_gettime_relative() - t[1];
+
+        printf("zero rate 1/%-3d: %d bytes, packet split %7.1f MB/s, bytewise %7.1f MB/s\n",
+               zero_rates[z], size, size * (double)runs / FFMAX(t[0], 1),
+               size * (double)runs / FFMAX(t[1], 1));
+    }
+    ret = 0;
+
+end:
+    ff_h2645_packet_uninit(&pkt);
+    av_free(buf);
+    av_free(dst);
+    av_free(skipped);
+    for (int i = 0; i < nb; i++)
+        av_free(nals[i]);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const int zero_rates[] = { 1, 2, 3, 8, 64, 1024 };
+    H2645Packet pkt = { 0 };
+    AVLFG lfg;
+    int ret = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "-b"))
+        return benchmark() < 0;
+
+    av_lfg_init(&lfg, 0x2645);
+    for (int z = 0; z < FF_ARRAY_ELEMS(zero_rates); z++) {
+        int err = 0;
+        for (int i = 0; i < 200; i++)
+            err |= test_extract_rbsp(&lfg, zero_rates[z], i & 1);
+        for (int i = 0; i < 20; i++)
+            err |= test_packet_split(&lfg, &pkt, zero_rates[z]);
+        printf("zero rate 1/%d: %s\n", zero_rates[z], err ? "differ" : "match");
+        ret |= err;
+    }
+    ff_h2645_packet_uninit(&pkt);
+
+    return ret < 0;
+}
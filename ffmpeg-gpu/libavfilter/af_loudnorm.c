@@ -20,6 +20,7 @@
 
 /* http://k.ylo.ph/2016/04/04/loudnorm.html */
 
+#include "libavutil/internal.h"
 #include "libavutil/opt.h"
 #include "avfilter.h"
 #include "internal.h"
@@ -62,6 +63,8 @@ typedef struct LoudNormContext {
     int linear;
     int dual_mono;
     enum PrintFormat print_format;
+    char *stats_file;
+    char *measured_file;
 
     double *buf;
     int buf_size;
@@ -119,6 +122,8 @@ static const AVOption loudnorm_options[] = {
     {     "none",         0,                                   0,                        AV_OPT_TYPE_CONST,   {.i64 =  NONE},     0,         0,  FLAGS, "print_format" },
     {     "json",         0,                                   0,                        AV_OPT_TYPE_CONST,   {.i64 =  JSON},     0,         0,  FLAGS, "print_format" },
     {     "summary",      0,                                   0,                        AV_OPT_TYPE_CONST,   {.i64 =  SUMMARY},  0,         0,  FLAGS, "print_format" },
+    { "stats_file",       "write input measurements to file",  OFFSET(stats_file),       AV_OPT_TYPE_STRING,  {.str =  NULL},      0,         0,  FLAGS },
+    { "measured_file",    "read input measurements from file", OFFSET(measured_file),    AV_OPT_TYPE_STRING,  {.str =  NULL},      0,         0,  FLAGS },
     { NULL }
 };
 
@@ -769,11 +774,74 @@ static int config_input(AVFilterLink *inlink)
     return 0;
 }
 
+/**
+ * Read the measured_* options from a record written by stats_file, so that
+ * a measurement done earlier can be reused without a separate analysis pass.
+ * Only the measured_* options can be set from the file.
+ */
+static av_cold int read_measured_file(AVFilterContext *ctx)
+{
+    static const char *const fields[] = {
+        "measured_I", "measured_i", "measured_TP", "measured_tp",
+        "measured_LRA", "measured_lra", "measured_thresh",
+    };
+    LoudNormContext *s = ctx->priv;
+    char buf[256];
+    const char *p = buf;
+    size_t len;
+    FILE *f;
+    int ret;
+
+    f = avpriv_fopen_utf8(s->measured_file, "r");
+    if (!f) {
+        ret = AVERROR(errno);
+        av_log(ctx, AV_LOG_ERROR, "Could not open %s: %s\n",
+               s->measured_file, av_err2str(ret));
+        return ret;
+    }
+    len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r' || buf[len - 1] == ' '))
+        len--;
+    buf[len] = 0;
+
+    while (*p) {
+        char *key, *val;
+        int i;
+
+        ret = av_opt_get_key_value(&p, "=", ":", 0, &key, &val);
+        if (ret < 0)
+            goto fail;
+        for (i = 0; i < FF_ARRAY_ELEMS(fields); i++)
+            if (!strcmp(key, fields[i]))
+                break;
+        ret = i < FF_ARRAY_ELEMS(fields) ? av_opt_set(s, key, val, 0)
+                                         : AVERROR(EINVAL);
+        av_free(key);
+        av_free(val);
+        if (ret < 0)
+            goto fail;
+        if (*p)
+            p++;
+    }
+    return 0;
+
+fail:
+    av_log(ctx, AV_LOG_ERROR, "Invalid measurements in %s\n", s->measured_file);
+    return ret;
+}
+
 static av_cold int init(AVFilterContext *ctx)
 {
     LoudNormContext *s = ctx->priv;
     s->frame_type = FIRST_FRAME;
 
+    if (s->measured_file) {
+        int ret = read_measured_file(ctx);
+        if (ret < 0)
+            return ret;
+    }
+
     if (s->linear) {
         double offset, offset_tp;
         offset    = s->target_i - s->measured_i;
@@ -819,6 +887,20 @@ static av_cold void uninit(AVFilterContext *ctx)
             tp_out = tmp;
     }
 
+    if (s->stats_file) {
+        FILE *f = avpriv_fopen_utf8(s->stats_file, "w");
+        if (f) {
+            /* clipped to the ranges of the measured_* options */
+            fprintf(f, "measured_I=%.2f:measured_TP=%.2f:measured_LRA=%.2f:measured_thresh=%.2f\n",
+                    av_clipd(i_in, -99., 0.), av_clipd(20. * log10(tp_in), -99., 99.),
+                    av_clipd(lra_in, 0., 99.), av_clipd(thresh_in, -99., 0.));
+            fclose(f);
+        } else {
+            av_log(ctx, AV_LOG_ERROR, "Could not open %s: %s\n",
+                   s->stats_file, av_err2str(AVERROR(errno)));
+        }
+    }
+
     switch(s->print_format) {
     case NONE:
         break;
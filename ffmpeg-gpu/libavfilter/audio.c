@@ -38,6 +38,7 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
 {
     AVFrame *frame = NULL;
     int channels = link->ch_layout.nb_channels;
+    FFFrameAllocator *allocator = link->graph ? link->graph->internal->frame_allocator : NULL;
 #if FF_API_OLD_CHANNEL_LAYOUT
 FF_DISABLE_DEPRECATION_WARNINGS
     int channel_layout_nb_channels = av_get_channel_layout_nb_channels(link->channel_layout);
@@ -48,7 +49,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
 #endif
 
     if (!link->frame_pool) {
-        link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
+        link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, allocator, channels,
                                                     nb_samples, link->format, align);
         if (!link->frame_pool)
             return NULL;
@@ -68,7 +69,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
             pool_format != link->format || pool_align != align) {
 
             ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
-            link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
+            link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, allocator, channels,
                                                         nb_samples, link->format, align);
             if (!link->frame_pool)
                 return NULL;
@@ -37,6 +37,7 @@
 #include "avfilter.h"
 #include "buffersink.h"
 #include "formats.h"
+#include "framepool.h"
 #include "internal.h"
 #include "thread.h"
 
@@ -91,6 +92,13 @@ AVFilterGraph *avfilter_graph_alloc(void)
         return NULL;
     }
 
+    ret->internal->frame_allocator = ff_frame_allocator_alloc();
+    if (!ret->internal->frame_allocator) {
+        av_freep(&ret->internal);
+        av_freep(&ret);
+        return NULL;
+    }
+
     ret->av_class = &filtergraph_class;
     av_opt_set_defaults(ret);
     ff_framequeue_global_init(&ret->internal->frame_queues);
@@ -126,6 +134,18 @@ void avfilter_graph_free(AVFilterGraph **graph)
 
     ff_graph_thread_free(*graph);
 
+    if ((*graph)->internal->frame_allocator) {
+        FFFrameAllocatorStats stats;
+        ff_frame_allocator_get_stats((*graph)->internal->frame_allocator, &stats);
+        if (stats.requests)
+            av_log(*graph, AV_LOG_VERBOSE, "Frame buffers: %"PRIu64" requests, "
+                   "%"PRIu64" allocations (%.1f%% reused), %"PRIu64" trims, "
+                   "%.1f MiB peak\n", stats.requests, stats.allocations,
+                   100.0 * (stats.requests - stats.allocations) / stats.requests,
+                   stats.trims, stats.max_size / 1048576.0);
+        ff_frame_allocator_free(&(*graph)->internal->frame_allocator);
+    }
+
     av_freep(&(*graph)->sink_links);
 
     av_opt_free(*graph);
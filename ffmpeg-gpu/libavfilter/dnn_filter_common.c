@@ -16,11 +16,19 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <math.h>
+
 #include "dnn_filter_common.h"
 #include "libavutil/avstring.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
 
 #define MAX_SUPPORTED_OUTPUTS_NB 4
 
+/* kept boxes covering more grid cells than this are not put in the grid,
+ * every candidate is tested against them */
+#define NMS_MAX_CELLS 36
+
 static char **separate_output_names(const char *expr, const char *val_sep, int *separated_nb)
 {
     char *val, **parsed_vals = NULL;
@@ -161,3 +169,132 @@ void ff_dnn_uninit(DnnContext *ctx)
         av_freep(&ctx->dnn_module);
     }
 }
+
+typedef struct NMSNode {
+    int box;                    ///< index of a kept box
+    int next;                   ///< next node of the cell, -1 at the end
+} NMSNode;
+
+static int cmp_boxes(const void *a, const void *b)
+{
+    const DNNDetectBox *ba = a, *bb = b;
+
+    if (ba->confidence != bb->confidence)
+        return ba->confidence < bb->confidence ? 1 : -1;
+    if (ba->label != bb->label)
+        return FFDIFFSIGN(ba->label, bb->label);
+    if (ba->x0 != bb->x0)
+        return ba->x0 < bb->x0 ? -1 : 1;
+    if (ba->y0 != bb->y0)
+        return ba->y0 < bb->y0 ? -1 : 1;
+    if (ba->x1 != bb->x1)
+        return ba->x1 < bb->x1 ? -1 : 1;
+    if (ba->y1 != bb->y1)
+        return ba->y1 < bb->y1 ? -1 : 1;
+    return 0;
+}
+
+static int boxes_overlap(const DNNDetectBox *a, const DNNDetectBox *b, float iou_threshold)
+{
+    float w = FFMIN(a->x1, b->x1) - FFMAX(a->x0, b->x0);
+    float h = FFMIN(a->y1, b->y1) - FFMAX(a->y0, b->y0);
+    float inter, uni;
+
+    if (!(w > 0 && h > 0))
+        return 0;
+    inter = w * h;
+    uni   = (a->x1 - a->x0) * (a->y1 - a->y0) + (b->x1 - b->x0) * (b->y1 - b->y0) - inter;
+    return inter > iou_threshold * uni;
+}
+
+static inline int nms_cell(float x, int grid)
+{
+    x *= grid;
+    return !(x > 0) ? 0 : x >= grid - 1 ? grid - 1 : (int)x;
+}
+
+/*
+ * Boxes which overlap share at least one cell of a grid over the frame, so
+ * a candidate is only tested against the kept boxes of the cells it covers
+ * instead of all of them.
+ */
+int ff_dnn_nms(DNNDetectBox *boxes, int nb_boxes, float iou_threshold,
+               int class_agnostic, void **buf, unsigned *buf_size)
+{
+    int grid, nb_kept = 0, nb_nodes = 0, large = -1;
+    float extent = 0;
+    NMSNode *nodes;
+    int *head, *stamp;
+    size_t size;
+
+    if (nb_boxes <= 0)
+        return 0;
+
+    qsort(boxes, nb_boxes, sizeof(*boxes), cmp_boxes);
+
+    /* cells about half the size of an average box, so that most boxes are in
+     * at most 9 cells, but not much more cells than boxes */
+    for (int i = 0; i < nb_boxes; i++) {
+        float w = boxes[i].x1 - boxes[i].x0, h = boxes[i].y1 - boxes[i].y0;
+        float e = FFMAX(w, h);
+        if (e > 0)
+            extent += FFMIN(e, 1);
+    }
+    extent /= nb_boxes;
+    grid = av_clip(2 / FFMAX(extent, 1.0f / 64), 1, FFMIN(sqrt(nb_boxes), 64));
+    size = ((size_t)nb_boxes * NMS_MAX_CELLS) * sizeof(*nodes) +
+           ((size_t)grid * grid + nb_boxes) * sizeof(*head);
+    if (size > UINT_MAX)
+        return AVERROR(EINVAL);
+    av_fast_malloc(buf, buf_size, size);
+    if (!*buf)
+        return AVERROR(ENOMEM);
+    nodes = *buf;
+    head  = (int *)(nodes + (size_t)nb_boxes * NMS_MAX_CELLS);
+    stamp = head + grid * grid;
+    memset(head,  -1, grid * grid * sizeof(*head));
+    memset(stamp, -1, nb_boxes * sizeof(*stamp));
+
+    for (int i = 0; i < nb_boxes; i++) {
+        const DNNDetectBox b = boxes[i];
+        const int cx0 = nms_cell(b.x0, grid), cx1 = nms_cell(b.x1, grid);
+        const int cy0 = nms_cell(b.y0, grid), cy1 = nms_cell(b.y1, grid);
+        int suppressed = 0, n;
+
+        for (n = large; n >= 0 && !suppressed; n = nodes[n].next) {
+            const DNNDetectBox *k = &boxes[nodes[n].box];
+            suppressed = (class_agnostic || k->label == b.label) &&
+                         boxes_overlap(k, &b, iou_threshold);
+        }
+        for (int cy = cy0; cy <= cy1 && !suppressed; cy++) {
+            for (int cx = cx0; cx <= cx1 && !suppressed; cx++) {
+                for (n = head[cy * grid + cx]; n >= 0 && !suppressed; n = nodes[n].next) {
+                    const DNNDetectBox *k = &boxes[nodes[n].box];
+                    if (stamp[nodes[n].box] == i)
+                        continue;
+                    stamp[nodes[n].box] = i;
+                    suppressed = (class_agnostic || k->label == b.label) &&
+                                 boxes_overlap(k, &b, iou_threshold);
+                }
+            }
+        }
+        if (suppressed)
+            continue;
+
+        boxes[nb_kept] = b;
+        if ((cx1 - cx0 + 1) * (cy1 - cy0 + 1) > NMS_MAX_CELLS) {
+            nodes[nb_nodes] = (NMSNode){ nb_kept, large };
+            large = nb_nodes++;
+        } else {
+            for (int cy = cy0; cy <= cy1; cy++) {
+                for (int cx = cx0; cx <= cx1; cx++) {
+                    nodes[nb_nodes] = (NMSNode){ nb_kept, head[cy * grid + cx] };
+                    head[cy * grid + cx] = nb_nodes++;
+                }
+            }
+        }
+        nb_kept++;
+    }
+
+    return nb_kept;
+}
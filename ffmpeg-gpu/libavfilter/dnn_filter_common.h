@@ -40,6 +40,15 @@ typedef struct DnnContext {
     DNNModel *model;
 } DnnContext;
 
+/**
+ * A detected object, decoded from the output of a model.
+ */
+typedef struct DNNDetectBox {
+    float x0, y0, x1, y1;       ///< corners, normalized to the frame size
+    float confidence;
+    int label;
+} DNNDetectBox;
+
 #define DNN_COMMON_OPTIONS \
     { "model",              "path to model file",         OFFSET(model_filename),   AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },\
     { "input",              "input name of the model",    OFFSET(model_inputname),  AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },\
@@ -61,4 +70,20 @@ DNNAsyncStatusType ff_dnn_get_result(DnnContext *ctx, AVFrame **in_frame, AVFram
 int ff_dnn_flush(DnnContext *ctx);
 void ff_dnn_uninit(DnnContext *ctx);
 
+/**
+ * Non-maximum suppression.
+ *
+ * Sort the boxes by decreasing confidence and drop every box whose
+ * intersection over union with a kept box of the same label is above
+ * iou_threshold. The kept boxes are moved to the start of the array,
+ * most confident first.
+ *
+ * @param class_agnostic if set, boxes of different labels suppress each other
+ * @param buf            scratch buffer, reallocated with av_fast_malloc()
+ *                       and to be freed by the caller
+ * @return the number of kept boxes, or a negative AVERROR
+ */
+int ff_dnn_nms(DNNDetectBox *boxes, int nb_boxes, float iou_threshold,
+               int class_agnostic, void **buf, unsigned *buf_size);
+
 #endif
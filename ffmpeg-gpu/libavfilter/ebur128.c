@@ -97,6 +97,12 @@ struct FFEBUR128StateInternal {
     unsigned long window;
     /** Data pointer array for interleaved data */
     void **data_ptrs;
+    /** Energy of each channel in each 100ms sub-block of audio_data. */
+    double *subblock_energy;
+    /** Number of 100ms sub-blocks in audio_data. */
+    size_t subblocks;
+    /** Next sub-block whose energy has to be computed. */
+    size_t subblock_index;
 };
 
 static AVOnce histogram_init = AV_ONCE_INIT;
@@ -257,12 +263,18 @@ FFEBUR128State *ff_ebur128_init(unsigned int channels,
         (double *) av_calloc(st->d->audio_data_frames,
                              st->channels * sizeof(*st->d->audio_data));
     CHECK_ERROR(!st->d->audio_data, 0, free_sample_peak)
+    st->d->subblocks = st->d->audio_data_frames / st->d->samples_in_100ms;
+    st->d->subblock_energy =
+        (double *) av_calloc(st->d->subblocks,
+                             st->channels * sizeof(*st->d->subblock_energy));
+    CHECK_ERROR(!st->d->subblock_energy, 0, free_audio_data)
+    st->d->subblock_index = 0;
 
     ebur128_init_filter(st);
 
     st->d->block_energy_histogram =
         av_mallocz(1000 * sizeof(*st->d->block_energy_histogram));
-    CHECK_ERROR(!st->d->block_energy_histogram, 0, free_audio_data)
+    CHECK_ERROR(!st->d->block_energy_histogram, 0, free_subblock_energy)
     st->d->short_term_block_energy_histogram =
         av_mallocz(1000 * sizeof(*st->d->short_term_block_energy_histogram));
     CHECK_ERROR(!st->d->short_term_block_energy_histogram, 0,
@@ -287,6 +299,8 @@ free_short_term_block_energy_histogram:
     av_free(st->d->short_term_block_energy_histogram);
 free_block_energy_histogram:
     av_free(st->d->block_energy_histogram);
+free_subblock_energy:
+    av_free(st->d->subblock_energy);
 free_audio_data:
     av_free(st->d->audio_data);
 free_sample_peak:
@@ -306,6 +320,7 @@ void ff_ebur128_destroy(FFEBUR128State ** st)
     av_free((*st)->d->block_energy_histogram);
     av_free((*st)->d->short_term_block_energy_histogram);
     av_free((*st)->d->audio_data);
+    av_free((*st)->d->subblock_energy);
     av_free((*st)->d->channel_map);
     av_free((*st)->d->sample_peak);
     av_free((*st)->d->data_ptrs);
@@ -319,6 +334,10 @@ static void ebur128_filter_##type(FFEBUR128State* st, const type** srcs,
                                   size_t src_index, size_t frames,                 \
                                   int stride) {                                    \
     double* audio_data = st->d->audio_data + st->d->audio_data_index;              \
+    const double a1 = st->d->a[1], a2 = st->d->a[2];                               \
+    const double a3 = st->d->a[3], a4 = st->d->a[4];                               \
+    const double b0 = st->d->b[0], b1 = st->d->b[1], b2 = st->d->b[2];             \
+    const double b3 = st->d->b[3], b4 = st->d->b[4];                               \
     size_t i, c;                                                                   \
                                                                                    \
     if ((st->mode & FF_EBUR128_MODE_SAMPLE_PEAK) == FF_EBUR128_MODE_SAMPLE_PEAK) { \
@@ -337,30 +356,29 @@ static void ebur128_filter_##type(FFEBUR128State* st, const type** srcs,
         }                                                                          \
     }                                                                              \
     for (c = 0; c < st->channels; ++c) {                                           \
+        const type *src = srcs[c] + src_index;                                     \
+        double *dst = audio_data + c;                                              \
+        double *v, v1, v2, v3, v4;                                                 \
         int ci = st->d->channel_map[c] - 1;                                        \
         if (ci < 0) continue;                                                      \
         else if (ci == FF_EBUR128_DUAL_MONO - 1) ci = 0; /*dual mono */            \
+        /* same operations as on st->d->v, with the state kept in registers */     \
+        v = st->d->v[ci];                                                          \
+        v1 = v[1]; v2 = v[2]; v3 = v[3]; v4 = v[4];                                \
         for (i = 0; i < frames; ++i) {                                             \
-            st->d->v[ci][0] = (double) (srcs[c][src_index + i * stride] / scaling_factor) \
-                         - st->d->a[1] * st->d->v[ci][1]                           \
-                         - st->d->a[2] * st->d->v[ci][2]                           \
-                         - st->d->a[3] * st->d->v[ci][3]                           \
-                         - st->d->a[4] * st->d->v[ci][4];                          \
-            audio_data[i * st->channels + c] =                                     \
-                           st->d->b[0] * st->d->v[ci][0]                           \
-                         + st->d->b[1] * st->d->v[ci][1]                           \
-                         + st->d->b[2] * st->d->v[ci][2]                           \
-                         + st->d->b[3] * st->d->v[ci][3]                           \
-                         + st->d->b[4] * st->d->v[ci][4];                          \
-            st->d->v[ci][4] = st->d->v[ci][3];                                     \
-            st->d->v[ci][3] = st->d->v[ci][2];                                     \
-            st->d->v[ci][2] = st->d->v[ci][1];                                     \
-            st->d->v[ci][1] = st->d->v[ci][0];                                     \
+            double v0 = (double) (src[i * stride] / scaling_factor)                \
+                      - a1 * v1 - a2 * v2 - a3 * v3 - a4 * v4;                     \
+            dst[i * st->channels] = b0 * v0 + b1 * v1 + b2 * v2                    \
+                                  + b3 * v3 + b4 * v4;                             \
+            v4 = v3;                                                               \
+            v3 = v2;                                                               \
+            v2 = v1;                                                               \
+            v1 = v0;                                                               \
         }                                                                          \
-        st->d->v[ci][4] = fabs(st->d->v[ci][4]) < DBL_MIN ? 0.0 : st->d->v[ci][4]; \
-        st->d->v[ci][3] = fabs(st->d->v[ci][3]) < DBL_MIN ? 0.0 : st->d->v[ci][3]; \
-        st->d->v[ci][2] = fabs(st->d->v[ci][2]) < DBL_MIN ? 0.0 : st->d->v[ci][2]; \
-        st->d->v[ci][1] = fabs(st->d->v[ci][1]) < DBL_MIN ? 0.0 : st->d->v[ci][1]; \
+        v[4] = fabs(v4) < DBL_MIN ? 0.0 : v4;                                      \
+        v[3] = fabs(v3) < DBL_MIN ? 0.0 : v3;                                      \
+        v[2] = fabs(v2) < DBL_MIN ? 0.0 : v2;                                      \
+        v[1] = fabs(v1) < DBL_MIN ? 0.0 : v1;                                      \
     }                                                                              \
 }
 EBUR128_FILTER(double, 1.0)
@@ -388,51 +406,107 @@ static size_t find_histogram_index(double energy)
     return index_min;
 }
 
+static double ebur128_channel_weight(int channel)
+{
+    if (channel == FF_EBUR128_Mp110 ||
+        channel == FF_EBUR128_Mm110 ||
+        channel == FF_EBUR128_Mp060 ||
+        channel == FF_EBUR128_Mm060 ||
+        channel == FF_EBUR128_Mp090 ||
+        channel == FF_EBUR128_Mm090) {
+        return 1.41;
+    } else if (channel == FF_EBUR128_DUAL_MONO) {
+        return 2.0;
+    }
+    return 1.0;
+}
+
+/* Sum the energy of each channel over the 100ms sub-blocks completed since
+ * audio_data_index was prev_index, so that gating and short-term blocks,
+ * which all start and end on a 100ms boundary, do not have to go over the
+ * samples again. The frames of a sub-block may have been added in several
+ * calls, so the sub-blocks are found from the ring position. */
+static void ebur128_calc_subblocks(FFEBUR128State * st, size_t prev_index)
+{
+    const size_t frames = st->d->samples_in_100ms;
+    const size_t end = st->d->audio_data_index / st->channels / frames;
+    size_t b, i, c;
+
+    for (b = prev_index / st->channels / frames; b < end; b++) {
+        const double *data = st->d->audio_data + b * frames * st->channels;
+        double *energy = st->d->subblock_energy + b * st->channels;
+
+        for (c = 0; c < st->channels; ++c) {
+            double sum0 = 0.0, sum1 = 0.0;
+            if (st->d->channel_map[c] != FF_EBUR128_UNUSED) {
+                const double *src = data + c;
+                for (i = 0; i + 1 < frames; i += 2) {
+                    sum0 += src[ i      * st->channels] * src[ i      * st->channels];
+                    sum1 += src[(i + 1) * st->channels] * src[(i + 1) * st->channels];
+                }
+                if (i < frames)
+                    sum0 += src[i * st->channels] * src[i * st->channels];
+            }
+            energy[c] = sum0 + sum1;
+        }
+    }
+    st->d->subblock_index = end % st->d->subblocks;
+}
+
 static void ebur128_calc_gating_block(FFEBUR128State * st,
                                       size_t frames_per_block,
                                       double *optional_output)
 {
     size_t i, c;
+    size_t index = st->d->audio_data_index / st->channels;
     double sum = 0.0;
     double channel_sum;
-    for (c = 0; c < st->channels; ++c) {
-        if (st->d->channel_map[c] == FF_EBUR128_UNUSED)
-            continue;
-        channel_sum = 0.0;
-        if (st->d->audio_data_index < frames_per_block * st->channels) {
-            for (i = 0; i < st->d->audio_data_index / st->channels; ++i) {
-                channel_sum += st->d->audio_data[i * st->channels + c] *
-                    st->d->audio_data[i * st->channels + c];
-            }
-            for (i = st->d->audio_data_frames -
-                 (frames_per_block -
-                  st->d->audio_data_index / st->channels);
-                 i < st->d->audio_data_frames; ++i) {
-                channel_sum += st->d->audio_data[i * st->channels + c] *
-                    st->d->audio_data[i * st->channels + c];
-            }
-        } else {
-            for (i =
-                 st->d->audio_data_index / st->channels - frames_per_block;
-                 i < st->d->audio_data_index / st->channels; ++i) {
-                channel_sum +=
-                    st->d->audio_data[i * st->channels +
-                                      c] * st->d->audio_data[i *
-                                                             st->channels +
-                                                             c];
-            }
+
+    if (!(frames_per_block % st->d->samples_in_100ms) &&
+        !(index % st->d->samples_in_100ms) &&
+        index / st->d->samples_in_100ms % st->d->subblocks == st->d->subblock_index) {
+        /* the block is made of complete sub-blocks */
+        size_t nb_subblocks = frames_per_block / st->d->samples_in_100ms;
+        size_t first = st->d->subblock_index + st->d->subblocks - nb_subblocks;
+        for (c = 0; c < st->channels; ++c) {
+            if (st->d->channel_map[c] == FF_EBUR128_UNUSED)
+                continue;
+            channel_sum = 0.0;
+            for (i = first; i < first + nb_subblocks; ++i)
+                channel_sum += st->d->subblock_energy[(i % st->d->subblocks) *
+                                                      st->channels + c];
+            sum += channel_sum * ebur128_channel_weight(st->d->channel_map[c]);
         }
-        if (st->d->channel_map[c] == FF_EBUR128_Mp110 ||
-            st->d->channel_map[c] == FF_EBUR128_Mm110 ||
-            st->d->channel_map[c] == FF_EBUR128_Mp060 ||
-            st->d->channel_map[c] == FF_EBUR128_Mm060 ||
-            st->d->channel_map[c] == FF_EBUR128_Mp090 ||
-            st->d->channel_map[c] == FF_EBUR128_Mm090) {
-            channel_sum *= 1.41;
-        } else if (st->d->channel_map[c] == FF_EBUR128_DUAL_MONO) {
-            channel_sum *= 2.0;
+    } else {
+        for (c = 0; c < st->channels; ++c) {
+            if (st->d->channel_map[c] == FF_EBUR128_UNUSED)
+                continue;
+            channel_sum = 0.0;
+            if (st->d->audio_data_index < frames_per_block * st->channels) {
+                for (i = 0; i < st->d->audio_data_index / st->channels; ++i) {
+                    channel_sum += st->d->audio_data[i * st->channels + c] *
+                        st->d->audio_data[i * st->channels + c];
+                }
+                for (i = st->d->audio_data_frames -
+                     (frames_per_block -
+                      st->d->audio_data_index / st->channels);
+                     i < st->d->audio_data_frames; ++i) {
+                    channel_sum += st->d->audio_data[i * st->channels + c] *
+                        st->d->audio_data[i * st->channels + c];
+                }
+            } else {
+                for (i =
+                     st->d->audio_data_index / st->channels - frames_per_block;
+                     i < st->d->audio_data_index / st->channels; ++i) {
+                    channel_sum +=
+                        st->d->audio_data[i * st->channels +
+                                          c] * st->d->audio_data[i *
+                                                                 st->channels +
+                                                                 c];
+                }
+            }
+            sum += channel_sum * ebur128_channel_weight(st->d->channel_map[c]);
         }
-        sum += channel_sum;
     }
     sum /= (double) frames_per_block;
     if (optional_output) {
@@ -467,6 +541,8 @@ static void ebur128_add_frames_planar_##type(FFEBUR128State* st, const type** sr
             src_index += st->d->needed_frames * stride;                                \
             frames -= st->d->needed_frames;                                            \
             st->d->audio_data_index += st->d->needed_frames * st->channels;            \
+            ebur128_calc_subblocks(st, st->d->audio_data_index -                       \
+                                       st->d->needed_frames * st->channels);           \
             /* calculate the new gating block */                                       \
             if ((st->mode & FF_EBUR128_MODE_I) == FF_EBUR128_MODE_I) {                 \
                 ebur128_calc_gating_block(st, st->d->samples_in_100ms * 4, NULL);      \
@@ -492,6 +568,8 @@ static void ebur128_add_frames_planar_##type(FFEBUR128State* st, const type** sr
         } else {                                                                       \
             ebur128_filter_##type(st, srcs, src_index, frames, stride);                \
             st->d->audio_data_index += frames * st->channels;                          \
+            ebur128_calc_subblocks(st, st->d->audio_data_index -                       \
+                                       frames * st->channels);                         \
             if ((st->mode & FF_EBUR128_MODE_LRA) == FF_EBUR128_MODE_LRA) {             \
                 st->d->short_term_frame_counter += frames;                             \
             }                                                                          \
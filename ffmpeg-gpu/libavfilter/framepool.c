@@ -26,6 +26,32 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/mem.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/thread.h"
+
+/* size classes: 1 << CLASS_SUB_BITS of them per power of two from
+ * 1 << CLASS_MIN_BITS bytes up to INT_MAX */
+#define CLASS_MIN_BITS  8
+#define CLASS_SUB_BITS  3
+#define NB_CLASSES      (((31 - CLASS_MIN_BITS) << CLASS_SUB_BITS) + 1)
+
+/* every TRIM_INTERVAL requests, classes not used during the last TRIM_AGE
+ * requests release their idle buffers */
+#define TRIM_INTERVAL   1024
+#define TRIM_AGE        4096
+
+typedef struct FrameClass {
+    FFFrameAllocator *fa;
+    AVBufferPool *pool;
+    size_t size;
+    unsigned nb_buffers;
+    uint64_t last_use;
+} FrameClass;
+
+struct FFFrameAllocator {
+    AVMutex lock;
+    FrameClass classes[NB_CLASSES];
+    FFFrameAllocatorStats stats;
+};
 
 struct FFFramePool {
 
@@ -46,9 +72,147 @@ struct FFFramePool {
     int linesize[4];
     AVBufferPool *pools[4];
 
+    /* buffers from the graph allocator instead of the pools */
+    FFFrameAllocator *allocator;
+    size_t sizes[4];
 };
 
+static int size_class(size_t size, size_t *class_size)
+{
+    int bits, shift, sub;
+
+    if (size <= 1 << CLASS_MIN_BITS) {
+        *class_size = 1 << CLASS_MIN_BITS;
+        return 0;
+    }
+    bits  = av_log2(size);
+    shift = bits - CLASS_SUB_BITS;
+    sub   = (size - (1 << bits) + (1 << shift) - 1) >> shift;
+    *class_size = ((size_t)1 << bits) + ((size_t)sub << shift);
+    return ((bits - CLASS_MIN_BITS) << CLASS_SUB_BITS) + sub;
+}
+
+/* called with fa->lock held */
+static void trim_class(FFFrameAllocator *fa, FrameClass *c)
+{
+    if (!c->pool)
+        return;
+    av_buffer_pool_uninit(&c->pool);
+    fa->stats.size -= c->nb_buffers * c->size;
+    fa->stats.trims++;
+    c->nb_buffers = 0;
+}
+
+/* called with fa->lock held, from av_buffer_pool_get() */
+static AVBufferRef *class_alloc(void *opaque, size_t size)
+{
+    FrameClass *c = opaque;
+    FFFrameAllocator *fa = c->fa;
+    AVBufferRef *buf = av_buffer_allocz(size);
+
+    if (!buf) {
+        for (int i = 0; i < NB_CLASSES; i++)
+            if (&fa->classes[i] != c)
+                trim_class(fa, &fa->classes[i]);
+        buf = av_buffer_allocz(size);
+        if (!buf)
+            return NULL;
+    }
+
+    c->nb_buffers++;
+    fa->stats.allocations++;
+    fa->stats.size += size;
+    fa->stats.max_size = FFMAX(fa->stats.max_size, fa->stats.size);
+    return buf;
+}
+
+FFFrameAllocator *ff_frame_allocator_alloc(void)
+{
+    FFFrameAllocator *fa = av_mallocz(sizeof(*fa));
+
+    if (!fa)
+        return NULL;
+    if (ff_mutex_init(&fa->lock, NULL)) {
+        av_free(fa);
+        return NULL;
+    }
+    for (int i = 0; i < NB_CLASSES; i++)
+        fa->classes[i].fa = fa;
+    return fa;
+}
+
+void ff_frame_allocator_free(FFFrameAllocator **pfa)
+{
+    FFFrameAllocator *fa = *pfa;
+
+    if (!fa)
+        return;
+    for (int i = 0; i < NB_CLASSES; i++)
+        av_buffer_pool_uninit(&fa->classes[i].pool);
+    ff_mutex_destroy(&fa->lock);
+    av_freep(pfa);
+}
+
+AVBufferRef *ff_frame_allocator_get(FFFrameAllocator *fa, size_t size)
+{
+    AVBufferRef *buf = NULL;
+    FrameClass *c;
+    size_t class_size;
+    int idx;
+
+    if (size > INT_MAX)
+        return NULL;
+    idx = size_class(size, &class_size);
+    c = &fa->classes[idx];
+
+    ff_mutex_lock(&fa->lock);
+    if (!c->pool) {
+        c->size = class_size;
+        c->pool = av_buffer_pool_init2(class_size, c, class_alloc, NULL);
+        if (!c->pool)
+            goto end;
+    }
+    c->last_use = ++fa->stats.requests;
+    buf = av_buffer_pool_get(c->pool);
+
+    if (!(fa->stats.requests % TRIM_INTERVAL)) {
+        for (int i = 0; i < NB_CLASSES; i++)
+            if (fa->classes[i].pool &&
+                fa->stats.requests - fa->classes[i].last_use > TRIM_AGE)
+                trim_class(fa, &fa->classes[i]);
+    }
+end:
+    ff_mutex_unlock(&fa->lock);
+    return buf;
+}
+
+void ff_frame_allocator_trim(FFFrameAllocator *fa)
+{
+    ff_mutex_lock(&fa->lock);
+    for (int i = 0; i < NB_CLASSES; i++)
+        trim_class(fa, &fa->classes[i]);
+    ff_mutex_unlock(&fa->lock);
+}
+
+void ff_frame_allocator_get_stats(FFFrameAllocator *fa, FFFrameAllocatorStats *stats)
+{
+    ff_mutex_lock(&fa->lock);
+    *stats = fa->stats;
+    stats->nb_classes = 0;
+    for (int i = 0; i < NB_CLASSES; i++)
+        stats->nb_classes += !!fa->classes[i].pool;
+    ff_mutex_unlock(&fa->lock);
+}
+
+static AVBufferRef *pool_get_buffer(FFFramePool *pool, int plane)
+{
+    if (pool->allocator)
+        return ff_frame_allocator_get(pool->allocator, pool->sizes[plane]);
+    return av_buffer_pool_get(pool->pools[plane]);
+}
+
 FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
+                                      FFFrameAllocator *allocator,
                                       int width,
                                       int height,
                                       enum AVPixelFormat format,
@@ -96,9 +260,13 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
         goto fail;
     }
 
+    pool->allocator = allocator;
     for (i = 0; i < 4 && sizes[i]; i++) {
         if (sizes[i] > SIZE_MAX - align)
             goto fail;
+        pool->sizes[i] = sizes[i] + align;
+        if (allocator)
+            continue;
         pool->pools[i] = av_buffer_pool_init(sizes[i] + align, alloc);
         if (!pool->pools[i])
             goto fail;
@@ -112,6 +280,7 @@ fail:
 }
 
 FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
+                                      FFFrameAllocator *allocator,
                                       int channels,
                                       int nb_samples,
                                       enum AVSampleFormat format,
@@ -138,9 +307,13 @@ FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
     if (ret < 0)
         goto fail;
 
-    pool->pools[0] = av_buffer_pool_init(pool->linesize[0], NULL);
-    if (!pool->pools[0])
-        goto fail;
+    pool->allocator = allocator;
+    pool->sizes[0] = pool->linesize[0];
+    if (!allocator) {
+        pool->pools[0] = av_buffer_pool_init(pool->linesize[0], NULL);
+        if (!pool->pools[0])
+            goto fail;
+    }
 
     return pool;
 
@@ -211,10 +384,10 @@ AVFrame *ff_frame_pool_get(FFFramePool *pool)
 
         for (i = 0; i < 4; i++) {
             frame->linesize[i] = pool->linesize[i];
-            if (!pool->pools[i])
+            if (!pool->sizes[i])
                 break;
 
-            frame->buf[i] = av_buffer_pool_get(pool->pools[i]);
+            frame->buf[i] = pool_get_buffer(pool, i);
             if (!frame->buf[i])
                 goto fail;
 
@@ -257,13 +430,13 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
 
         for (i = 0; i < FFMIN(pool->planes, AV_NUM_DATA_POINTERS); i++) {
-            frame->buf[i] = av_buffer_pool_get(pool->pools[0]);
+            frame->buf[i] = pool_get_buffer(pool, 0);
             if (!frame->buf[i])
                 goto fail;
             frame->extended_data[i] = frame->data[i] = frame->buf[i]->data;
         }
         for (i = 0; i < frame->nb_extended_buf; i++) {
-            frame->extended_buf[i] = av_buffer_pool_get(pool->pools[0]);
+            frame->extended_buf[i] = pool_get_buffer(pool, 0);
             if (!frame->extended_buf[i])
                 goto fail;
             frame->extended_data[i + AV_NUM_DATA_POINTERS] = frame->extended_buf[i]->data;
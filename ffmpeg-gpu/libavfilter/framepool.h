@@ -32,12 +32,70 @@
  */
 typedef struct FFFramePool FFFramePool;
 
+/**
+ * Buffer allocator shared by the frame pools of a filter graph. This structure
+ * is opaque and not meant to be accessed directly.
+ *
+ * Buffers are grouped in size classes, 8 per power of two, so frame pools
+ * with different but close sizes draw from the same buffers and a pool that
+ * is reinitialized, e.g. after a size change, reuses the buffers of the
+ * previous one. Every buffer is allocated with av_buffer_allocz() and has the
+ * alignment of av_malloc().
+ */
+typedef struct FFFrameAllocator FFFrameAllocator;
+
+typedef struct FFFrameAllocatorStats {
+    uint64_t requests;      ///< buffers handed out
+    uint64_t allocations;   ///< buffers that were newly allocated
+    uint64_t trims;         ///< size classes whose idle buffers were released
+    size_t size;            ///< bytes held by the allocator, idle or in use
+    size_t max_size;        ///< largest value of size
+    int nb_classes;         ///< size classes holding buffers
+} FFFrameAllocatorStats;
+
+/**
+ * Allocate a frame allocator.
+ *
+ * @return newly created allocator on success, NULL on error.
+ */
+FFFrameAllocator *ff_frame_allocator_alloc(void);
+
+/**
+ * Free the frame allocator. Buffers still in use stay valid and are freed
+ * when they are released.
+ *
+ * @param fa pointer to the allocator to be freed. It will be set to NULL.
+ */
+void ff_frame_allocator_free(FFFrameAllocator **fa);
+
+/**
+ * Get a buffer of at least size bytes, reusing an idle buffer of the same size
+ * class when available. This function may be called simultaneously from
+ * multiple threads.
+ *
+ * Size classes that have not been used for a while are trimmed, and when an
+ * allocation fails all the idle buffers are released before retrying.
+ *
+ * @return a new buffer reference on success, NULL on error.
+ */
+AVBufferRef *ff_frame_allocator_get(FFFrameAllocator *fa, size_t size);
+
+/**
+ * Release all the idle buffers. Buffers in use are freed instead of being
+ * recycled when they are released.
+ */
+void ff_frame_allocator_trim(FFFrameAllocator *fa);
+
+void ff_frame_allocator_get_stats(FFFrameAllocator *fa, FFFrameAllocatorStats *stats);
+
 /**
  * Allocate and initialize a video frame pool.
  *
  * @param alloc a function that will be used to allocate new frame buffers when
  * the pool is empty. May be NULL, then the default allocator will be used
  * (av_buffer_alloc()).
+ * @param allocator allocator to get the frame buffers from, instead of pool
+ * private buffers allocated with alloc. May be NULL.
  * @param width width of each frame in this pool
  * @param height height of each frame in this pool
  * @param format format of each frame in this pool
@@ -45,6 +103,7 @@ typedef struct FFFramePool FFFramePool;
  * @return newly created video frame pool on success, NULL on error.
  */
 FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
+                                      FFFrameAllocator *allocator,
                                       int width,
                                       int height,
                                       enum AVPixelFormat format,
@@ -56,6 +115,8 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
  * @param alloc a function that will be used to allocate new frame buffers when
  * the pool is empty. May be NULL, then the default allocator will be used
  * (av_buffer_alloc()).
+ * @param allocator allocator to get the frame buffers from, instead of pool
+ * private buffers allocated with alloc. May be NULL.
  * @param channels channels of each frame in this pool
  * @param nb_samples number of samples of each frame in this pool
  * @param format format of each frame in this pool
@@ -63,6 +124,7 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
  * @return newly created audio frame pool on success, NULL on error.
  */
 FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
+                                      FFFrameAllocator *allocator,
                                       int channels,
                                       int samples,
                                       enum AVSampleFormat format,
@@ -133,6 +133,7 @@ struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+    struct FFFrameAllocator *frame_allocator;
 };
 
 struct AVFilterInternal {
@@ -108,6 +108,10 @@ typedef struct StreamContext {
     /* overflow protection */
     int divide;
 
+    /* first column and line of each block of the integral image */
+    int xbound[33];
+    int ybound[33];
+
     FineSignature* finesiglist;
     FineSignature* curfinesig;
 
@@ -138,7 +142,7 @@ typedef struct SignatureContext {
     int thit;
     /* end input parameters */
 
-    uint8_t l1distlut[243*242/2]; /* 243 + 242 + 241 ... */
+    uint8_t l1distlut[243][243]; /* ternary distance of two 5 element words */
     StreamContext* streamcontexts;
 } SignatureContext;
 
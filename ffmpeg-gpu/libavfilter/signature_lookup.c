@@ -37,13 +37,13 @@
 #define STATUS_END_REACHED 1
 #define STATUS_BEGIN_REACHED 2
 
-static void fill_l1distlut(uint8_t lut[])
+static void fill_l1distlut(uint8_t lut[243][243])
 {
-    int i, j, tmp_i, tmp_j,count;
+    int i, j, tmp_i, tmp_j;
     uint8_t dist;
 
-    for (i = 0, count = 0; i < 242; i++) {
-        for (j = i + 1; j < 243; j++, count++) {
+    for (i = 0; i < 243; i++) {
+        for (j = i; j < 243; j++) {
             /* ternary distance between i and j */
             dist = 0;
             tmp_i = i; tmp_j = j;
@@ -52,7 +52,7 @@ static void fill_l1distlut(uint8_t lut[])
                 tmp_j /= 3;
                 tmp_i /= 3;
             } while (tmp_i > 0 || tmp_j > 0);
-            lut[count] = dist;
+            lut[i][j] = lut[j][i] = dist;
         }
     }
 }
@@ -91,20 +91,9 @@ static unsigned int get_l1dist(AVFilterContext *ctx, SignatureContext *sc, const
 {
     unsigned int i;
     unsigned int dist = 0;
-    uint8_t f, s;
-
-    for (i = 0; i < SIGELEM_SIZE/5; i++) {
-        if (first[i] != second[i]) {
-            f = first[i];
-            s = second[i];
-            if (f > s) {
-                /* little variation of gauss sum formula */
-                dist += sc->l1distlut[243*242/2 - (243-s)*(242-s)/2 + f - s - 1];
-            } else {
-                dist += sc->l1distlut[243*242/2 - (243-f)*(242-f)/2 + s - f - 1];
-            }
-        }
-    }
+
+    for (i = 0; i < SIGELEM_SIZE/5; i++)
+        dist += sc->l1distlut[first[i]][second[i]];
     return dist;
 }
 
@@ -545,8 +534,6 @@ static MatchingInfo lookup_signatures(AVFilterContext *ctx, SignatureContext *sc
     bestmatch.meandist = 99999;
     bestmatch.whole = 0;
 
-    fill_l1distlut(sc->l1distlut);
-
     /* stage 1: coarsesignature matching */
     if (find_next_coarsecandidate(sc, second->coarsesiglist, &cs, &cs2, 1) == 0)
         return bestmatch; /* no candidate found */
@@ -0,0 +1,354 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/bprint.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
+
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+
+#define MAX_LAYERS 16
+#define MAX_FRAMES 64
+
+typedef struct Layer {
+    int w, h, x, y, z;
+    int rate;                   ///< frame rate, 0 for a single frame repeated
+    int alpha;                  ///< background alpha of testsrc2, -1 for a ramp
+    double opacity;
+} Layer;
+
+typedef struct TestCase {
+    const char *format;         ///< composite and overlay format
+    const char *main_fmt, *layer_fmt;
+    int w, h;
+    int nb_layers;
+    Layer layers[MAX_LAYERS];
+} TestCase;
+
+static const TestCase tests[] = {
+    { "yuv420", "yuv420p", "yuva420p", 352, 288, 5, {
+        { 160,  90,   20,   30, 0, 25,   0, 1.00 },
+        { 101,  57,  -31,  201, 3,  5,  -1, 0.50 },
+        { 200, 120,  250,  -40, 1, 25,   0, 1.00 },
+        { 352, 288,    0,    0, 2,  0,  96, 0.25 },
+        {  64,  64, 1000, 1000, 1, 25, 255, 1.00 },
+    } },
+    { "yuv444", "yuv444p", "yuva444p", 320, 240, 3, {
+        { 133,  77,   -7,   -9, 2, 25,   0, 1.00 },
+        {  99,  55,  201,  171, 1,  5,  -1, 0.75 },
+        { 320,  16,    0,  100, 0,  0, 255, 1.00 },
+    } },
+    { "gbrp", "gbrp", "gbrap", 320, 240, 3, {
+        { 160,  90,  170,  160, 0, 25,   0, 1.00 },
+        {  97,  67,   11,   13, 0,  0,  -1, 0.40 },
+        { 320, 240,  -50,   30, 1,  5,   0, 1.00 },
+    } },
+};
+
+static void layer_source(AVBPrint *bp, const TestCase *t, const Layer *l, int frames)
+{
+    av_bprintf(bp, "testsrc2=s=%dx%d:alpha=%d", l->w, l->h, FFMAX(l->alpha, 0));
+    if (l->rate)
+        av_bprintf(bp, ":r=%d,trim=end_frame=%d", l->rate, frames * l->rate / 25 + 1);
+    else
+        av_bprintf(bp, ":r=25,trim=end_frame=1");
+    av_bprintf(bp, ",format=%s", t->layer_fmt);
+    if (l->alpha < 0)
+        av_bprintf(bp, ",geq=%s:a='mod(X*7+Y*13+N*5,256)'", strcmp(t->format, "gbrp") ?
+                   "lum='lum(X,Y)':cb='cb(X,Y)':cr='cr(X,Y)'" : "r='r(X,Y)':g='g(X,Y)':b='b(X,Y)'");
+}
+
+static void composite_graph(AVBPrint *bp, const TestCase *t, int frames)
+{
+    const char *sep = "";
+    int i;
+
+    av_bprintf(bp, "testsrc2=s=%dx%d:r=25,trim=end_frame=%d,format=%s[main];",
+               t->w, t->h, frames, t->main_fmt);
+    for (i = 0; i < t->nb_layers; i++) {
+        layer_source(bp, t, &t->layers[i], frames);
+        av_bprintf(bp, "[l%d];", i);
+    }
+    av_bprintf(bp, "[main]");
+    for (i = 0; i < t->nb_layers; i++)
+        av_bprintf(bp, "[l%d]", i);
+    av_bprintf(bp, "composite=inputs=%d:format=%s:layout=", t->nb_layers + 1, t->format);
+    for (i = 0; i < t->nb_layers; i++, sep = "|")
+        av_bprintf(bp, "%s%d_%d", sep, t->layers[i].x, t->layers[i].y);
+    av_bprintf(bp, ":order=");
+    for (i = 0, sep = ""; i < t->nb_layers; i++, sep = "|")
+        av_bprintf(bp, "%s%d", sep, t->layers[i].z);
+    av_bprintf(bp, ":opacity=");
+    for (i = 0, sep = ""; i < t->nb_layers; i++, sep = "|")
+        av_bprintf(bp, "%s%g", sep, t->layers[i].opacity);
+    av_bprintf(bp, "[out]");
+}
+
+/* the same picture with one overlay per layer, in painting order */
+static void overlay_graph(AVBPrint *bp, const TestCase *t, int frames)
+{
+    int i, z, n = 0;
+
+    av_bprintf(bp, "testsrc2=s=%dx%d:r=25,trim=end_frame=%d,format=%s[t0];",
+               t->w, t->h, frames, t->main_fmt);
+    for (z = 0; z < MAX_LAYERS; z++) {
+        for (i = 0; i < t->nb_layers; i++) {
+            const Layer *l = &t->layers[i];
+            if (l->z != z)
+                continue;
+            layer_source(bp, t, l, frames);
+            if (l->opacity < 1)
+                av_bprintf(bp, ",lut=a='floor((val*%ld+128)*257/65536)'",
+                           lrint(l->opacity * 255));
+            av_bprintf(bp, "[l%d];[t%d][l%d]overlay=x=%d:y=%d:format=%s[%s%d];",
+                       i, n, i, l->x, l->y, t->format,
+                       n + 1 < t->nb_layers ? "t" : "out", n + 1);
+            n++;
+        }
+    }
+    bp->str[--bp->len] = 0;
+}
+
+static int run_graph(const char *desc, AVFrame **frames, int *nb_frames, int64_t *time)
+{
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFilterInOut *in = NULL, *out = NULL;
+    AVFilterContext *sink;
+    AVFrame *frame = NULL;
+    int ret;
+
+    *nb_frames = 0;
+    if (!graph)
+        return AVERROR(ENOMEM);
+    if ((ret = avfilter_graph_parse_ptr(graph, desc, &in, &out, NULL)) < 0)
+        goto end;
+    if (!out || out->next) {
+        ret = AVERROR_BUG;
+        goto end;
+    }
+    if ((ret = avfilter_graph_create_filter(&sink, avfilter_get_by_name("buffersink"),
+                                            "out", NULL, NULL, graph)) < 0 ||
+        (ret = avfilter_link(out->filter_ctx, out->pad_idx, sink, 0)) < 0 ||
+        (ret = avfilter_graph_config(graph, NULL)) < 0)
+        goto end;
+
+    *time = av_gettime_relative();
+    while (1) {
+        if (!frame && !(frame = av_frame_alloc())) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        ret = av_buffersink_get_frame(sink, frame);
+        if (ret < 0)
+            break;
+        if (frames && *nb_frames < MAX_FRAMES) {
+            frames[(*nb_frames)++] = frame;
+            frame = NULL;
+        } else {
+            (*nb_frames)++;
+            av_frame_unref(frame);
+        }
+    }
+    *time = av_gettime_relative() - *time;
+    if (ret == AVERROR_EOF)
+        ret = 0;
+
+end:
+    av_frame_free(&frame);
+    avfilter_inout_free(&in);
+    avfilter_inout_free(&out);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+static int compare_frames(const AVFrame *a, const AVFrame *b)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(a->format);
+
+    if (a->format != b->format || a->width != b->width ||
+        a->height != b->height || a->pts != b->pts)
+        return 1;
+    for (int p = 0; p < 3; p++) {
+        int w = p ? AV_CEIL_RSHIFT(a->width,  desc->log2_chroma_w) : a->width;
+        int h = p ? AV_CEIL_RSHIFT(a->height, desc->log2_chroma_h) : a->height;
+        for (int y = 0; y < h; y++)
+            if (memcmp(a->data[p] + y * a->linesize[p],
+                       b->data[p] + y * b->linesize[p], w))
+                return 1;
+    }
+    return 0;
+}
+
+static int test_equivalence(const TestCase *t)
+{
+    AVFrame *frames[2][MAX_FRAMES] = { { NULL } };
+    int nb_frames[2], i, ret, diff = 0;
+    int64_t time;
+    AVBPrint bp[2];
+
+    for (i = 0; i < 2; i++) {
+        av_bprint_init(&bp[i], 0, AV_BPRINT_SIZE_UNLIMITED);
+        (i ? overlay_graph : composite_graph)(&bp[i], t, 50);
+        if ((ret = run_graph(bp[i].str, frames[i], &nb_frames[i], &time)) < 0) {
+            printf("%s: %s\n", bp[i].str, av_err2str(ret));
+            goto end;
+        }
+    }
+
+    for (i = 0; i < FFMIN(nb_frames[0], nb_frames[1]); i++)
+        diff += compare_frames(frames[0][i], frames[1][i]);
+    printf("%s, %d layers: %d frames, %d frames with overlay, %d different\n",
+           t->format, t->nb_layers, nb_frames[0], nb_frames[1], diff);
+    ret = diff || nb_frames[0] != nb_frames[1] ? AVERROR_BUG : 0;
+
+end:
+    for (i = 0; i < 2; i++) {
+        av_bprint_finalize(&bp[i], NULL);
+        for (int j = 0; j < MAX_FRAMES; j++)
+            av_frame_free(&frames[i][j]);
+    }
+    return ret;
+}
+
+/* a layer whose frames share one opaque alpha buffer but change colour, as
+ * a decoder or a pool may produce; the colour of each frame must be used */
+static int test_shared_alpha(void)
+{
+    const char *desc = "color=c=black:s=64x64:r=25,trim=end_frame=8,format=yuv444p[m];"
+                       "buffer@layer=video_size=32x32:pix_fmt=yuva444p:time_base=1/25[l];"
+                       "[m][l]composite=inputs=2:format=yuv444:layout=16_16";
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFilterInOut *in = NULL, *out = NULL;
+    AVFilterContext *src, *sink;
+    AVBufferRef *alpha = av_buffer_alloc(32 * 32);
+    AVFrame *frame = av_frame_alloc();
+    int nb_frames = 0, wrong = 0, ret;
+
+    if (!graph || !alpha || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    memset(alpha->data, 255, 32 * 32);
+    if ((ret = avfilter_graph_parse_ptr(graph, desc, &in, &out, NULL)) < 0 ||
+        (ret = avfilter_graph_create_filter(&sink, avfilter_get_by_name("buffersink"),
+                                            "out", NULL, NULL, graph)) < 0 ||
+        (ret = avfilter_link(out->filter_ctx, out->pad_idx, sink, 0)) < 0 ||
+        (ret = avfilter_graph_config(graph, NULL)) < 0)
+        goto end;
+    if (!(src = avfilter_graph_get_filter(graph, "buffer@layer"))) {
+        ret = AVERROR_BUG;
+        goto end;
+    }
+
+    for (int n = 0; n < 8; n++) {
+        frame->format = AV_PIX_FMT_YUVA444P;
+        frame->width  = frame->height = 32;
+        frame->pts    = n;
+        for (int p = 0; p < 3; p++) {
+            if (!(frame->buf[p] = av_buffer_alloc(32 * 32))) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+            memset(frame->buf[p]->data, p ? 128 : 40 + 20 * n, 32 * 32);
+            frame->data[p]     = frame->buf[p]->data;
+            frame->linesize[p] = 32;
+        }
+        if (!(frame->buf[3] = av_buffer_ref(alpha))) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        frame->data[3]     = alpha->data;
+        frame->linesize[3] = 32;
+        if ((ret = av_buffersrc_add_frame(src, frame)) < 0)
+            goto end;
+    }
+    if ((ret = av_buffersrc_add_frame(src, NULL)) < 0)
+        goto end;
+
+    while ((ret = av_buffersink_get_frame(sink, frame)) >= 0) {
+        wrong += frame->data[0][32 * frame->linesize[0] + 32] != 40 + 20 * frame->pts;
+        nb_frames++;
+        av_frame_unref(frame);
+    }
+    if (ret == AVERROR_EOF)
+        ret = 0;
+    printf("shared alpha, changing colours: %d frames, %d wrong\n", nb_frames, wrong);
+    if (!ret && (wrong || nb_frames != 8))
+        ret = AVERROR_BUG;
+
+end:
+    av_frame_free(&frame);
+    av_buffer_unref(&alpha);
+    avfilter_inout_free(&in);
+    avfilter_inout_free(&out);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+/* burn-in of N 480x270 logos on a 1080p video, with the composite filter
+ * and with a chain of N overlays */
+static int benchmark(int frames)
+{
+    static const int counts[] = { 1, 2, 4, 8, 16 };
+
+    for (int c = 0; c < FF_ARRAY_ELEMS(counts); c++) {
+        TestCase t = { "yuv420", "yuv420p", "yuva420p", 1920, 1080, counts[c] };
+        double fps[2];
+
+        for (int i = 0; i < t.nb_layers; i++)
+            t.layers[i] = (Layer){ 480, 270, 96 + 432 * (i & 3), 54 + 256 * (i >> 2) % 1024,
+                                   i, 0, 0, 1.0 };
+        for (int i = 0; i < 2; i++) {
+            AVBPrint bp;
+            int64_t time;
+            int n, ret;
+
+            av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+            (i ? overlay_graph : composite_graph)(&bp, &t, frames);
+            ret = run_graph(bp.str, NULL, &n, &time);
+            av_bprint_finalize(&bp, NULL);
+            if (ret < 0) {
+                printf("benchmark failed: %s\n", av_err2str(ret));
+                return ret;
+            }
+            fps[i] = n * 1000000.0 / FFMAX(time, 1);
+        }
+        printf("%2d layers: composite %6.1f fps, overlay chain %6.1f fps\n",
+               t.nb_layers, fps[0], fps[1]);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ret = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "-b"))
+        return benchmark(argc > 2 ? atoi(argv[2]) : 100) < 0;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(tests); i++)
+        ret |= test_equivalence(&tests[i]);
+    ret |= test_shared_alpha();
+
+    return ret < 0;
+}
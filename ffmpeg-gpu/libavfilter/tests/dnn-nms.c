@@ -0,0 +1,197 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+#include "libavfilter/dnn_filter_common.h"
+
+#define NB_LABELS 4
+
+static float randf(AVLFG *lfg)
+{
+    return av_lfg_get(lfg) / 4294967296.0f;
+}
+
+/* proposals of a detection model: several boxes jittered around every
+ * object, some boxes far from everything, a few covering most of the frame
+ * or going past its edges */
+static void gen_boxes(AVLFG *lfg, DNNDetectBox *boxes, int nb)
+{
+    int i = 0;
+
+    while (i < nb) {
+        float cx = randf(lfg), cy = randf(lfg);
+        float w = 0.01f + 0.2f * randf(lfg), h = 0.01f + 0.2f * randf(lfg);
+        int label = av_lfg_get(lfg) % NB_LABELS;
+        int proposals = 1 + av_lfg_get(lfg) % 12;
+
+        if (!(av_lfg_get(lfg) % 50))
+            w = h = 0.5f + randf(lfg);
+        for (int j = 0; j < proposals && i < nb; j++, i++) {
+            float jx = (randf(lfg) - 0.5f) * w * 0.4f;
+            float jy = (randf(lfg) - 0.5f) * h * 0.4f;
+            boxes[i] = (DNNDetectBox) {
+                .x0 = cx + jx - w / 2, .x1 = cx + jx + w / 2,
+                .y0 = cy + jy - h / 2, .y1 = cy + jy + h / 2,
+                .confidence = randf(lfg),
+                .label = av_lfg_get(lfg) % 8 ? label : av_lfg_get(lfg) % NB_LABELS,
+            };
+        }
+    }
+}
+
+static int cmp_ref(const void *a, const void *b)
+{
+    const DNNDetectBox *ba = a, *bb = b;
+
+    if (ba->confidence != bb->confidence)
+        return ba->confidence < bb->confidence ? 1 : -1;
+    if (ba->label != bb->label)
+        return ba->label < bb->label ? -1 : 1;
+    if (ba->x0 != bb->x0)
+        return ba->x0 < bb->x0 ? -1 : 1;
+    if (ba->y0 != bb->y0)
+        return ba->y0 < bb->y0 ? -1 : 1;
+    if (ba->x1 != bb->x1)
+        return ba->x1 < bb->x1 ? -1 : 1;
+    if (ba->y1 != bb->y1)
+        return ba->y1 < bb->y1 ? -1 : 1;
+    return 0;
+}
+
+/* every candidate against every kept box */
+static int nms_ref(DNNDetectBox *boxes, int nb, float iou_threshold, int class_agnostic)
+{
+    int nb_kept = 0;
+
+    qsort(boxes, nb, sizeof(*boxes), cmp_ref);
+    for (int i = 0; i < nb; i++) {
+        DNNDetectBox b = boxes[i];
+        int suppressed = 0;
+
+        for (int k = 0; k < nb_kept && !suppressed; k++) {
+            const DNNDetectBox *a = &boxes[k];
+            float w = FFMIN(a->x1, b.x1) - FFMAX(a->x0, b.x0);
+            float h = FFMIN(a->y1, b.y1) - FFMAX(a->y0, b.y0);
+            float inter = w * h;
+            float uni = (a->x1 - a->x0) * (a->y1 - a->y0) + (b.x1 - b.x0) * (b.y1 - b.y0) - inter;
+
+            if (!class_agnostic && a->label != b.label)
+                continue;
+            suppressed = w > 0 && h > 0 && inter > iou_threshold * uni;
+        }
+        if (!suppressed)
+            boxes[nb_kept++] = b;
+    }
+    return nb_kept;
+}
+
+static int test_nms(AVLFG *lfg, int nb, float iou_threshold, int class_agnostic,
+                    void **buf, unsigned *buf_size)
+{
+    DNNDetectBox *boxes = av_malloc_array(FFMAX(nb, 1), sizeof(*boxes));
+    DNNDetectBox *ref   = av_malloc_array(FFMAX(nb, 1), sizeof(*ref));
+    int nb_kept, nb_ref, ret = AVERROR(ENOMEM);
+
+    if (!boxes || !ref)
+        goto end;
+    gen_boxes(lfg, boxes, nb);
+    memcpy(ref, boxes, nb * sizeof(*boxes));
+
+    nb_kept = ff_dnn_nms(boxes, nb, iou_threshold, class_agnostic, buf, buf_size);
+    nb_ref  = nms_ref(ref, nb, iou_threshold, class_agnostic);
+    ret = nb_kept == nb_ref && !memcmp(boxes, ref, nb_ref * sizeof(*ref)) ? 0 : AVERROR_BUG;
+    printf("%5d boxes, iou %.2f%s: %4d kept, %s\n", nb, iou_threshold,
+           class_agnostic ? ", class agnostic" : "", nb_kept, ret ? "differ" : "match");
+
+end:
+    av_free(boxes);
+    av_free(ref);
+    return ret;
+}
+
+static void benchmark(void)
+{
+    static const int counts[] = { 100, 1000, 5000, 20000, 100000 };
+    void *buf = NULL;
+    unsigned buf_size = 0;
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 0);
+    for (int i = 0; i < FF_ARRAY_ELEMS(counts); i++) {
+        int nb = counts[i], runs = FFMAX(1, 200000 / nb), nb_kept = 0;
+        DNNDetectBox *src   = av_malloc_array(nb, sizeof(*src));
+        DNNDetectBox *boxes = av_malloc_array(nb, sizeof(*boxes));
+        int64_t t[2] = { 0 };
+
+        if (!src || !boxes) {
+            av_free(src);
+            av_free(boxes);
+            break;
+        }
+        gen_boxes(&lfg, src, nb);
+        for (int r = 0; r < runs; r++) {
+            int64_t t0 = av_gettime_relative();
+            memcpy(boxes, src, nb * sizeof(*src));
+            nb_kept = ff_dnn_nms(boxes, nb, 0.5, 0, &buf, &buf_size);
+            t[0] += av_gettime_relative() - t0;
+            if (nb > 20000)
+                continue;
+            t0 = av_gettime_relative();
+            memcpy(boxes, src, nb * sizeof(*src));
+            nms_ref(boxes, nb, 0.5, 0);
+            t[1] += av_gettime_relative() - t0;
+        }
+        printf("%6d boxes, %5d kept: grid %9.1f us", nb, nb_kept, t[0] / (double)runs);
+        if (t[1])
+            printf(", all pairs %10.1f us", t[1] / (double)runs);
+        printf("\n");
+        av_free(src);
+        av_free(boxes);
+    }
+    av_free(buf);
+}
+
+int main(int argc, char **argv)
+{
+    static const int counts[] = { 0, 1, 20, 300, 3000 };
+    static const float thresholds[] = { 0.0f, 0.3f, 0.5f, 0.9f, 1.0f };
+    void *buf = NULL;
+    unsigned buf_size = 0;
+    AVLFG lfg;
+    int ret = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "-b")) {
+        benchmark();
+        return 0;
+    }
+
+    av_lfg_init(&lfg, 0x4E35);
+    for (int i = 0; i < FF_ARRAY_ELEMS(counts); i++)
+        for (int j = 0; j < FF_ARRAY_ELEMS(thresholds); j++)
+            for (int agnostic = 0; agnostic < 2; agnostic++)
+                ret |= test_nms(&lfg, counts[i], thresholds[j], agnostic, &buf, &buf_size);
+    av_free(buf);
+
+    return ret < 0;
+}
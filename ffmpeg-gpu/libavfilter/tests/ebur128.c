@@ -0,0 +1,237 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/lfg.h"
+#include "libavutil/time.h"
+
+#include "libavfilter/ebur128.c"
+
+#define SAMPLE_RATE 48000
+#define MAX_CHANNELS 8
+
+/* 1kHz sine in every channel, or a noisy tone whose level changes every
+ * second, to get a non-zero loudness range */
+static void gen_audio(AVLFG *lfg, double *dst, int channels, int64_t start,
+                      int frames, int tone)
+{
+    int i, c;
+
+    for (i = 0; i < frames; i++) {
+        int64_t n = start + i;
+        double level = tone ? pow(10.0, -23.0 / 20.0)
+                            : pow(10.0, -(20.0 + 3 * (n / SAMPLE_RATE % 5)) / 20.0);
+        for (c = 0; c < channels; c++) {
+            double v = sin(2 * M_PI * 1000 * n / SAMPLE_RATE);
+            if (!tone)
+                v = 0.7 * sin(2 * M_PI * (220 << c % 4) * n / SAMPLE_RATE) +
+                    0.3 * ((int)av_lfg_get(lfg) / 2147483648.0);
+            dst[i * channels + c] = level * v;
+        }
+    }
+}
+
+/* energy of the last frames_per_block frames, summed directly from the
+ * filtered samples as it was done before the 100ms sub-blocks */
+static double direct_energy(FFEBUR128State *st, size_t frames_per_block)
+{
+    size_t subblock_index = st->d->subblock_index;
+    double energy;
+
+    /* make the sub-blocks look out of date */
+    st->d->subblock_index = (subblock_index + 1) % st->d->subblocks;
+    ebur128_calc_gating_block(st, frames_per_block, &energy);
+    st->d->subblock_index = subblock_index;
+    return energy;
+}
+
+static int test_layout(int channels, int dual_mono, int tone, int seconds)
+{
+    FFEBUR128State *st;
+    AVLFG lfg;
+    double buf[SAMPLE_RATE / 2 * MAX_CHANNELS];
+    double max_err = 0.0, global, lra, thresh, peak = 0.0;
+    int64_t pos = 0, end = (int64_t)seconds * SAMPLE_RATE;
+    int c;
+
+    st = ff_ebur128_init(channels, SAMPLE_RATE, 0,
+                         FF_EBUR128_MODE_I | FF_EBUR128_MODE_S |
+                         FF_EBUR128_MODE_LRA | FF_EBUR128_MODE_SAMPLE_PEAK);
+    if (!st)
+        return AVERROR(ENOMEM);
+    if (dual_mono)
+        ff_ebur128_set_channel(st, 0, FF_EBUR128_DUAL_MONO);
+    av_lfg_init(&lfg, 0x1770 + channels);
+
+    while (pos < end) {
+        /* mix chunks on and off the 100ms grid */
+        int frames = FFMIN(end - pos, 1 + av_lfg_get(&lfg) % (SAMPLE_RATE / 2));
+        if (av_lfg_get(&lfg) & 1)
+            frames = FFMIN(end - pos, SAMPLE_RATE / 10);
+        gen_audio(&lfg, buf, channels, pos, frames, tone);
+        ff_ebur128_add_frames_double(st, buf, frames);
+        pos += frames;
+
+        if (pos >= 3 * SAMPLE_RATE) {
+            double fast, ref;
+            ebur128_energy_shortterm(st, &fast);
+            ref = direct_energy(st, st->d->samples_in_100ms * 30);
+            max_err = FFMAX(max_err, fabs(fast - ref) / FFMAX(ref, DBL_MIN));
+            ebur128_calc_gating_block(st, st->d->samples_in_100ms * 4, &fast);
+            ref = direct_energy(st, st->d->samples_in_100ms * 4);
+            max_err = FFMAX(max_err, fabs(fast - ref) / FFMAX(ref, DBL_MIN));
+        }
+    }
+
+    ff_ebur128_loudness_global(st, &global);
+    ff_ebur128_loudness_range(st, &lra);
+    ff_ebur128_relative_threshold(st, &thresh);
+    for (c = 0; c < channels; c++) {
+        double tmp;
+        ff_ebur128_sample_peak(st, c, &tmp);
+        peak = FFMAX(peak, tmp);
+    }
+    printf("%d channels%s, %s: I %.1f LUFS, LRA %.1f LU, threshold %.1f LUFS, "
+           "peak %.1f dBFS, block energies %s\n",
+           channels, dual_mono ? " (dual mono)" : "", tone ? "1kHz" : "noise",
+           global, lra, thresh, 20 * log10(peak),
+           max_err < 1e-9 ? "match" : "differ");
+
+    ff_ebur128_destroy(&st);
+    return max_err < 1e-9 ? 0 : AVERROR_BUG;
+}
+
+/* chunks of odd sizes, so that 100ms blocks are completed over several
+ * calls; each chunk is cut at the block ends, where the momentary and
+ * short-term loudness are checked against the direct sums */
+static int test_odd_chunks(int channels, int seconds)
+{
+    FFEBUR128State *st;
+    AVLFG lfg;
+    double buf[SAMPLE_RATE / 4 * MAX_CHANNELS];
+    double max_err = 0.0;
+    int64_t pos = 0, end = (int64_t)seconds * SAMPLE_RATE;
+    int blocks = 0, misaligned = 0;
+
+    st = ff_ebur128_init(channels, SAMPLE_RATE, 0,
+                         FF_EBUR128_MODE_M | FF_EBUR128_MODE_S);
+    if (!st)
+        return AVERROR(ENOMEM);
+    av_lfg_init(&lfg, 0x3d9 + channels);
+
+    while (pos < end) {
+        int frames = FFMIN(end - pos, (av_lfg_get(&lfg) % (SAMPLE_RATE / 4)) | 1);
+
+        gen_audio(&lfg, buf, channels, pos, frames, 0);
+        for (int done = 0; done < frames;) {
+            const size_t block = st->d->samples_in_100ms;
+            int n = FFMIN(frames - done, block - (pos + done) % block);
+            size_t index;
+            double fast, ref;
+
+            ff_ebur128_add_frames_double(st, buf + done * channels, n);
+            done += n;
+            if ((pos + done) % block)
+                continue;
+
+            /* the sub-blocks have to be up to date at every block end */
+            index = st->d->audio_data_index / channels;
+            if (index / block % st->d->subblocks != st->d->subblock_index)
+                misaligned++;
+            blocks++;
+            if (pos + done < 3 * SAMPLE_RATE)
+                continue;
+
+            /* momentary loudness, as ebur128 and loudnorm compute it */
+            ebur128_energy_in_interval(st, block * 4, &fast);
+            fast = ebur128_energy_to_loudness(fast);
+            ref  = ebur128_energy_to_loudness(direct_energy(st, block * 4));
+            max_err = FFMAX(max_err, fabs(fast - ref));
+            ff_ebur128_loudness_shortterm(st, &fast);
+            ref = ebur128_energy_to_loudness(direct_energy(st, block * 30));
+            max_err = FFMAX(max_err, fabs(fast - ref));
+        }
+        pos += frames;
+    }
+
+    printf("%d channels, odd chunks: %d blocks, %d with stale sub-blocks, "
+           "loudness %s\n", channels, blocks, misaligned,
+           max_err < 1e-6 ? "match" : "differs");
+
+    ff_ebur128_destroy(&st);
+    return !misaligned && max_err < 1e-6 ? 0 : AVERROR_BUG;
+}
+
+/* throughput of the loudnorm usage: 100ms frames, a short-term loudness
+ * query after each one */
+static void benchmark(int seconds)
+{
+    static const int layouts[] = { 1, 2, 6, 8 };
+    double *buf = av_malloc_array(SAMPLE_RATE / 10 * MAX_CHANNELS, sizeof(*buf));
+    AVLFG lfg;
+    int i, j;
+
+    if (!buf)
+        return;
+    av_lfg_init(&lfg, 0);
+    for (i = 0; i < FF_ARRAY_ELEMS(layouts); i++) {
+        FFEBUR128State *st = ff_ebur128_init(layouts[i], SAMPLE_RATE, 0,
+                                             FF_EBUR128_MODE_I | FF_EBUR128_MODE_S |
+                                             FF_EBUR128_MODE_LRA | FF_EBUR128_MODE_SAMPLE_PEAK);
+        int64_t t;
+        double out;
+
+        if (!st)
+            break;
+        gen_audio(&lfg, buf, layouts[i], 0, SAMPLE_RATE / 10, 0);
+        t = av_gettime_relative();
+        for (j = 0; j < seconds * 10; j++) {
+            ff_ebur128_add_frames_double(st, buf, SAMPLE_RATE / 10);
+            ff_ebur128_loudness_shortterm(st, &out);
+        }
+        t = av_gettime_relative() - t;
+        printf("%d channels: %8.1f Msamples/s per channel\n", layouts[i],
+               seconds * (double)SAMPLE_RATE / FFMAX(t, 1));
+        ff_ebur128_destroy(&st);
+    }
+    av_free(buf);
+}
+
+int main(int argc, char **argv)
+{
+    int ret = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "-b")) {
+        benchmark(argc > 2 ? atoi(argv[2]) : 600);
+        return 0;
+    }
+
+    ret |= test_layout(2, 0, 1, 20);
+    ret |= test_layout(1, 1, 1, 20);
+    ret |= test_layout(1, 0, 0, 20);
+    ret |= test_layout(2, 0, 0, 20);
+    ret |= test_layout(6, 0, 0, 20);
+    ret |= test_layout(8, 0, 0, 20);
+    /* the 3s ring buffer wraps 6 times */
+    ret |= test_odd_chunks(2, 20);
+    ret |= test_odd_chunks(6, 20);
+
+    return ret < 0;
+}
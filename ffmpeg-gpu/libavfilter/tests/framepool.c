@@ -0,0 +1,271 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#if HAVE_GETRUSAGE
+#include <sys/resource.h>
+#endif
+
+#include "libavutil/bprint.h"
+#include "libavutil/time.h"
+
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/framepool.c"
+#include "libavfilter/internal.h"
+
+#define NB_FRAMES 4
+
+static void print_stats(const char *what, FFFrameAllocator *fa)
+{
+    FFFrameAllocatorStats st;
+
+    ff_frame_allocator_get_stats(fa, &st);
+    printf("%-20s requests %5"PRIu64" allocations %3"PRIu64" trims %2"PRIu64
+           " classes %d size %8zu\n", what, st.requests, st.allocations,
+           st.trims, st.nb_classes, st.size);
+}
+
+static int test_classes(void)
+{
+    static const size_t sizes[] = { 1, 256, 257, 1000, 4096, 4097, 65535,
+                                    1920 * 1080, 1920 * 1080 + 64, 1 << 30 };
+    int i, ret = 0;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(sizes); i++) {
+        size_t class_size;
+        int idx = size_class(sizes[i], &class_size);
+        int ok = class_size >= sizes[i] && class_size <= FFMAX(sizes[i] * 9 / 8, 256) &&
+                 idx >= 0 && idx < NB_CLASSES;
+        printf("size %10zu: class %3d, %10zu bytes%s\n", sizes[i], idx, class_size,
+               ok ? "" : " (wrong)");
+        ret |= !ok;
+    }
+    return ret ? AVERROR_BUG : 0;
+}
+
+static int get_frames(FFFramePool *pool, AVFrame **frames, int nb)
+{
+    for (int i = 0; i < nb; i++) {
+        frames[i] = ff_frame_pool_get(pool);
+        if (!frames[i])
+            return AVERROR(ENOMEM);
+        for (int p = 0; p < 4 && frames[i]->data[p]; p++)
+            if ((uintptr_t)frames[i]->data[p] & 15) {
+                printf("plane %d not aligned\n", p);
+                return AVERROR_BUG;
+            }
+    }
+    return 0;
+}
+
+static void free_frames(AVFrame **frames, int nb)
+{
+    for (int i = 0; i < nb; i++)
+        av_frame_free(&frames[i]);
+}
+
+static int test_allocator(void)
+{
+    FFFrameAllocator *fa = ff_frame_allocator_alloc();
+    FFFramePool *pool = NULL;
+    AVFrame *frames[NB_FRAMES] = { NULL };
+    int ret = AVERROR(ENOMEM);
+
+    if (!fa)
+        return ret;
+
+    /* frames are recycled through the allocator */
+    pool = ff_frame_pool_video_init(NULL, fa, 1920, 1080, AV_PIX_FMT_YUV420P, 32);
+    if (!pool || (ret = get_frames(pool, frames, NB_FRAMES)) < 0)
+        goto end;
+    free_frames(frames, NB_FRAMES);
+    if ((ret = get_frames(pool, frames, NB_FRAMES)) < 0)
+        goto end;
+    free_frames(frames, NB_FRAMES);
+    print_stats("1920x1080 twice", fa);
+
+    /* a new pool of a close size reuses the same buffers */
+    ff_frame_pool_uninit(&pool);
+    pool = ff_frame_pool_video_init(NULL, fa, 1920, 1072, AV_PIX_FMT_YUV420P, 32);
+    if (!pool || (ret = get_frames(pool, frames, NB_FRAMES)) < 0)
+        goto end;
+    free_frames(frames, NB_FRAMES);
+    print_stats("1920x1072", fa);
+
+    /* audio shares the allocator */
+    ff_frame_pool_uninit(&pool);
+    pool = ff_frame_pool_audio_init(NULL, fa, 2, 1024, AV_SAMPLE_FMT_FLTP, 32);
+    if (!pool || (ret = get_frames(pool, frames, 1)) < 0)
+        goto end;
+    free_frames(frames, 1);
+    print_stats("audio", fa);
+
+    /* the video classes are trimmed once they have not been used for a while */
+    for (int i = 0; i < TRIM_AGE + TRIM_INTERVAL; i += 2) {
+        if ((ret = get_frames(pool, frames, 1)) < 0)
+            goto end;
+        free_frames(frames, 1);
+    }
+    print_stats("stale classes", fa);
+
+    ff_frame_allocator_trim(fa);
+    print_stats("trim", fa);
+    ret = 0;
+
+end:
+    free_frames(frames, NB_FRAMES);
+    ff_frame_pool_uninit(&pool);
+    ff_frame_allocator_free(&fa);
+    return ret;
+}
+
+static int64_t page_faults(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage rusage;
+    getrusage(RUSAGE_SELF, &rusage);
+    return rusage.ru_minflt;
+#else
+    return 0;
+#endif
+}
+
+/* 10 rendition ladder: every rendition makes its own copy of the source at
+ * its size. With resize, the source size changes every 5 frames, which
+ * reinitializes the frame pools of all the links. */
+static int run_ladder(int frames, int shared, int resize, int64_t *time,
+                      int64_t *faults, FFFrameAllocatorStats *st)
+{
+    static const int heights[] = { 1080, 1080, 900, 720, 720, 540, 480, 360, 288, 240 };
+    AVFilterContext *sinks[FF_ARRAY_ELEMS(heights)];
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFilterInOut *in = NULL, *out = NULL, *cur;
+    AVFrame *frame = av_frame_alloc();
+    AVBPrint bp;
+    int i, ret, nb_sinks = 0, eof = 0;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    if (!graph || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if (!shared)
+        ff_frame_allocator_free(&graph->internal->frame_allocator);
+
+    av_bprintf(&bp, "testsrc2=s=1920x1080:r=25,trim=end_frame=%d", frames);
+    if (resize)
+        av_bprintf(&bp, ",scale=w=1920-32*mod(floor(n/5)\\,4):h=1080:eval=frame:flags=neighbor");
+    av_bprintf(&bp, ",split=10");
+    for (i = 0; i < FF_ARRAY_ELEMS(heights); i++)
+        av_bprintf(&bp, "[s%d]", i);
+    for (i = 0; i < FF_ARRAY_ELEMS(heights); i++)
+        if (resize)
+            av_bprintf(&bp, ";[s%d]hflip[o%d]", i, i);
+        else
+            av_bprintf(&bp, ";[s%d]crop=%d:%d,hflip[o%d]", i,
+                       heights[i] * 16 / 9 & ~1, heights[i], i);
+
+    if ((ret = avfilter_graph_parse_ptr(graph, bp.str, &in, &out, NULL)) < 0)
+        goto end;
+    for (cur = out; cur; cur = cur->next) {
+        AVFilterContext *sink;
+        char name[16];
+
+        snprintf(name, sizeof(name), "out%d", nb_sinks);
+        if ((ret = avfilter_graph_create_filter(&sink, avfilter_get_by_name("buffersink"),
+                                                name, NULL, NULL, graph)) < 0 ||
+            (ret = avfilter_link(cur->filter_ctx, cur->pad_idx, sink, 0)) < 0)
+            goto end;
+        sinks[nb_sinks++] = sink;
+    }
+    if ((ret = avfilter_graph_config(graph, NULL)) < 0)
+        goto end;
+
+    *faults = page_faults();
+    *time = av_gettime_relative();
+    while (eof < nb_sinks) {
+        for (i = 0; i < nb_sinks; i++) {
+            if (!sinks[i])
+                continue;
+            ret = av_buffersink_get_frame(sinks[i], frame);
+            if (ret == AVERROR_EOF) {
+                sinks[i] = NULL;
+                eof++;
+            } else if (ret < 0 && ret != AVERROR(EAGAIN)) {
+                goto end;
+            }
+            av_frame_unref(frame);
+        }
+    }
+    *time = av_gettime_relative() - *time;
+    *faults = page_faults() - *faults;
+    ret = 0;
+
+    memset(st, 0, sizeof(*st));
+    if (shared)
+        ff_frame_allocator_get_stats(graph->internal->frame_allocator, st);
+
+end:
+    av_bprint_finalize(&bp, NULL);
+    av_frame_free(&frame);
+    avfilter_inout_free(&in);
+    avfilter_inout_free(&out);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+static int benchmark(int frames)
+{
+    for (int resize = 0; resize < 2; resize++) {
+        for (int shared = 1; shared >= 0; shared--) {
+            FFFrameAllocatorStats st;
+            int64_t t, faults;
+            int ret = run_ladder(frames, shared, resize, &t, &faults, &st);
+
+            if (ret < 0) {
+                printf("ladder failed: %s\n", av_err2str(ret));
+                return ret;
+            }
+            printf("%-8s %-8s allocator: %6.1f fps, %7"PRId64" page faults",
+                   resize ? "resizing" : "static", shared ? "graph" : "per link",
+                   frames * 1000000.0 / FFMAX(t, 1), faults);
+            if (shared)
+                printf(", %"PRIu64" requests, %"PRIu64" allocations, %.1f MiB peak",
+                       st.requests, st.allocations, st.max_size / 1048576.0);
+            printf("\n");
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ret = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "-b"))
+        return benchmark(argc > 2 ? atoi(argv[2]) : 250) < 0;
+
+    ret |= test_classes();
+    ret |= test_allocator();
+
+    return ret < 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/lfg.h"
+#include "libavutil/time.h"
+
+#include "libavfilter/vf_tonemap.c"
+
+#define WIDTH 4096
+#define MAX_ERR 1e-4
+
+static const char *const names[TONEMAP_MAX] = {
+    "none", "linear", "gamma", "clip", "reinhard", "hable", "mobius",
+};
+
+/* tone mapping of one pixel with the curve evaluated directly */
+static void tonemap_ref(const TonemapContext *s, float rgb[3], double peak)
+{
+    float sig, sig_orig;
+
+    if (s->desat > 0) {
+        float luma = av_q2d(s->coeffs->cr) * rgb[0] + av_q2d(s->coeffs->cg) * rgb[1] +
+                     av_q2d(s->coeffs->cb) * rgb[2];
+        float overbright = FFMAX(luma - s->desat, 1e-6) / FFMAX(luma, 1e-6);
+        for (int i = 0; i < 3; i++)
+            rgb[i] = MIX(rgb[i], luma, overbright);
+    }
+    sig = sig_orig = FFMAX(FFMAX3(rgb[0], rgb[1], rgb[2]), 1e-6);
+    sig = tonemap_curve(s, sig, peak);
+    for (int i = 0; i < 3; i++)
+        rgb[i] *= sig / sig_orig;
+}
+
+static int setup(AVFilterContext *ctx, TonemapContext *s, int tonemap, double desat)
+{
+    memset(s, 0, sizeof(*s));
+    s->tonemap = tonemap;
+    s->param   = NAN;
+    s->desat   = desat;
+    s->format  = AV_PIX_FMT_NONE;
+    s->trc     = AVCOL_TRC_BT709;
+    s->coeffs  = av_csp_luma_coeffs_from_avcsp(AVCOL_SPC_BT2020_NCL);
+    s->rgb2rgb_passthrough = 1;
+    ctx->priv  = s;
+    return init(ctx);
+}
+
+/* linear light from 1e-6 to ~40 times the reference white */
+static void gen_row(AVLFG *lfg, float *rgb[3])
+{
+    for (int p = 0; p < 3; p++)
+        for (int x = 0; x < WIDTH; x++)
+            rgb[p][x] = expf(av_lfg_get(lfg) / (double)UINT_MAX * 17.5 - 13.8);
+}
+
+static int test_curve(AVLFG *lfg, float *buf, int tonemap, double desat, double peak)
+{
+    AVFilterContext ctx = { 0 };
+    TonemapContext s;
+    float *rgb[3] = { buf, buf + WIDTH, buf + 2 * WIDTH };
+    float *dst[3] = { buf + 3 * WIDTH, buf + 4 * WIDTH, buf + 5 * WIDTH };
+    double max_err = 0.0;
+    int ret;
+
+    if ((ret = setup(&ctx, &s, tonemap, desat)) < 0 ||
+        (ret = build_gain_lut(&s, peak)) < 0)
+        goto end;
+
+    for (int n = 0; n < 64; n++) {
+        gen_row(lfg, rgb);
+        tonemap_row(&s, dst, (const float **)rgb, WIDTH, peak);
+        for (int x = 0; x < WIDTH; x++) {
+            float ref[3] = { rgb[0][x], rgb[1][x], rgb[2][x] };
+            tonemap_ref(&s, ref, peak);
+            for (int p = 0; p < 3; p++)
+                max_err = FFMAX(max_err, fabs(dst[p][x] - ref[p]) / FFMAX(fabs(ref[p]), 1.0));
+        }
+    }
+    printf("%-8s desat %g peak %5.1f: %s\n", names[tonemap], desat, peak,
+           max_err < MAX_ERR ? "match" : "differ");
+    ret = max_err < MAX_ERR ? 0 : AVERROR_BUG;
+end:
+    uninit(&ctx);
+    return ret;
+}
+
+static int test_trc(void)
+{
+    AVFilterContext ctx = { 0 };
+    TonemapContext s;
+    double pq_err = 0.0, gamma_err = 0.0;
+    int ret;
+
+    if ((ret = setup(&ctx, &s, TONEMAP_NONE, 0)) < 0)
+        goto end;
+
+    /* every 10 bit code value and the points in between */
+    for (int i = 0; i <= 2046; i++) {
+        float x = i / 2046.0f, ref;
+
+        ref = pq_eotf(x);
+        pq_err = FFMAX(pq_err, fabs(linearize(&s, x) - ref) / FFMAX(ref, 1e-3));
+        ref = bt1886_inverse_eotf(x);
+        gamma_err = FFMAX(gamma_err, fabs(delinearize(&s, x) - ref));
+    }
+    printf("st2084 eotf: %s, bt1886 inverse eotf: %s\n",
+           pq_err    < 1e-3   ? "match" : "differ",
+           gamma_err < MAX_ERR ? "match" : "differ");
+    ret = pq_err < 1e-3 && gamma_err < MAX_ERR ? 0 : AVERROR_BUG;
+end:
+    uninit(&ctx);
+    return ret;
+}
+
+static void benchmark(float *buf, int rows)
+{
+    float *rgb[3] = { buf, buf + WIDTH, buf + 2 * WIDTH };
+    float *dst[3] = { buf + 3 * WIDTH, buf + 4 * WIDTH, buf + 5 * WIDTH };
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 0);
+    gen_row(&lfg, rgb);
+    for (int tonemap = 0; tonemap < TONEMAP_MAX; tonemap++) {
+        AVFilterContext ctx = { 0 };
+        TonemapContext s;
+        int64_t t0, t1;
+
+        if (setup(&ctx, &s, tonemap, 2) < 0 || build_gain_lut(&s, 100) < 0)
+            break;
+        t0 = av_gettime_relative();
+        for (int n = 0; n < rows; n++)
+            for (int x = 0; x < WIDTH; x++) {
+                float px[3] = { rgb[0][x], rgb[1][x], rgb[2][x] };
+                tonemap_ref(&s, px, 100);
+                dst[0][x] = px[0];
+                dst[1][x] = px[1];
+                dst[2][x] = px[2];
+            }
+        t0 = av_gettime_relative() - t0;
+        t1 = av_gettime_relative();
+        for (int n = 0; n < rows; n++)
+            tonemap_row(&s, dst, (const float **)rgb, WIDTH, 100);
+        t1 = av_gettime_relative() - t1;
+        printf("%-8s: direct %7.1f Mpixels/s, table %7.1f Mpixels/s\n", names[tonemap],
+               rows * (double)WIDTH / FFMAX(t0, 1), rows * (double)WIDTH / FFMAX(t1, 1));
+        uninit(&ctx);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static const double peaks[] = { 1.5, 10, 100 };
+    float *buf = av_malloc_array(6 * WIDTH, sizeof(*buf));
+    AVLFG lfg;
+    int ret = 0;
+
+    if (!buf)
+        return 1;
+
+    if (argc > 1 && !strcmp(argv[1], "-b")) {
+        benchmark(buf, argc > 2 ? atoi(argv[2]) : 2000);
+        av_free(buf);
+        return 0;
+    }
+
+    av_lfg_init(&lfg, 0x70E);
+    for (int tonemap = 0; tonemap < TONEMAP_MAX; tonemap++)
+        for (int i = 0; i < FF_ARRAY_ELEMS(peaks); i++)
+            ret |= test_curve(&lfg, buf, tonemap, i ? 2 : 0, peaks[i]);
+    ret |= test_trc();
+
+    av_free(buf);
+    return ret < 0;
+}
@@ -0,0 +1,536 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * composite several layers on top of a video in a single pass
+ *
+ * The result is the same as a chain of overlay filters with straight alpha,
+ * but every output row is visited once for all the layers, and only where
+ * a layer has a non-zero alpha. The alpha planes of a layer, subsampled
+ * for chroma and scaled by its opacity, and the extent of its visible
+ * pixels are computed when a new frame arrives on that layer and reused
+ * for as long as the frame is repeated.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "framesync.h"
+#include "internal.h"
+#include "video.h"
+
+/* rows blended for all the layers before moving on, so that the output
+ * rows stay in cache while the layers are painted over each other */
+#define BAND_ROWS 16
+
+/* divide by 255 and round to nearest, as in vf_overlay */
+#define FAST_DIV255(x) ((((x) + 128) * 257) >> 16)
+
+enum CompositeFormat {
+    COMPOSITE_FORMAT_YUV420,
+    COMPOSITE_FORMAT_YUV444,
+    COMPOSITE_FORMAT_GBRP,
+    COMPOSITE_FORMAT_NB
+};
+
+typedef struct LayerSpan {
+    int start, end;             ///< columns with a non-zero alpha, end excluded
+    int opaque;                 ///< every column of the span has full alpha
+} LayerSpan;
+
+typedef struct CompositeLayer {
+    int input;                  ///< input pad of the layer
+    int x, y;                   ///< position in the main picture
+    int z;                      ///< painting order
+    int opacity;                ///< 0-255, scales the alpha of the layer
+
+    AVFrame *frame;             ///< frame the alpha planes were built from
+    const uint8_t *alpha[2];    ///< alpha of the luma and chroma planes
+    int alpha_linesize[2];
+    LayerSpan *spans[2];        ///< visible columns of every luma and chroma row
+    int w[2], h[2];             ///< size of the luma and chroma planes
+    uint8_t *alpha_buf;
+    unsigned alpha_buf_size;
+    LayerSpan *span_buf;
+    unsigned span_buf_size;
+    int visible;
+} CompositeLayer;
+
+typedef struct CompositeContext {
+    const AVClass *class;
+    int nb_inputs;
+    char *layout_str;
+    char *order_str;
+    char *opacity_str;
+    int format;                 ///< CompositeFormat
+
+    int hsub, vsub;
+    CompositeLayer *layers;     ///< sorted in painting order
+    int nb_layers;
+    CompositeLayer **visible;   ///< layers to paint on the current frame
+    int nb_visible;
+
+    FFFrameSync fs;
+} CompositeContext;
+
+static int cmp_layers(const void *a, const void *b)
+{
+    const CompositeLayer *la = a, *lb = b;
+
+    if (la->z != lb->z)
+        return FFDIFFSIGN(la->z, lb->z);
+    return FFDIFFSIGN(la->input, lb->input);
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    CompositeContext *s = ctx->priv;
+    char *layout = NULL, *order = NULL, *opacity = NULL;
+    char *layout_save = NULL, *order_save = NULL, *opacity_save = NULL;
+    AVFilterPad pad = { 0 };
+    int i, ret;
+
+    s->nb_layers = s->nb_inputs - 1;
+    s->layers  = av_calloc(s->nb_layers, sizeof(*s->layers));
+    s->visible = av_calloc(s->nb_layers, sizeof(*s->visible));
+    if (!s->layers || !s->visible)
+        return AVERROR(ENOMEM);
+
+    pad.type = AVMEDIA_TYPE_VIDEO;
+    pad.name = "main";
+    if ((ret = ff_append_inpad(ctx, &pad)) < 0)
+        return ret;
+
+    if ((s->layout_str  && !(layout  = av_strdup(s->layout_str)))  ||
+        (s->order_str   && !(order   = av_strdup(s->order_str)))   ||
+        (s->opacity_str && !(opacity = av_strdup(s->opacity_str)))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (i = 0; i < s->nb_layers; i++) {
+        CompositeLayer *l = &s->layers[i];
+        const char *arg;
+        char *tail;
+        double d;
+
+        l->input   = i + 1;
+        l->z       = i;
+        l->opacity = 255;
+
+        if ((arg = av_strtok(i ? NULL : layout, "|", &layout_save)) &&
+            sscanf(arg, "%d_%d", &l->x, &l->y) != 2) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid position '%s' for layer %d.\n", arg, i + 1);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        if ((arg = av_strtok(i ? NULL : order, "|", &order_save)) &&
+            sscanf(arg, "%d", &l->z) != 1) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid order '%s' for layer %d.\n", arg, i + 1);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        if ((arg = av_strtok(i ? NULL : opacity, "|", &opacity_save))) {
+            d = strtod(arg, &tail);
+            if (*tail || !(d >= 0.0 && d <= 1.0)) {
+                av_log(ctx, AV_LOG_ERROR, "Invalid opacity '%s' for layer %d.\n", arg, i + 1);
+                ret = AVERROR(EINVAL);
+                goto end;
+            }
+            l->opacity = lrint(d * 255);
+        }
+
+        if (!(l->frame = av_frame_alloc())) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+
+        pad.name = av_asprintf("layer%d", i + 1);
+        if (!pad.name) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if ((ret = ff_append_inpad_free_name(ctx, &pad)) < 0)
+            goto end;
+    }
+    qsort(s->layers, s->nb_layers, sizeof(*s->layers), cmp_layers);
+    ret = 0;
+
+end:
+    av_free(layout);
+    av_free(order);
+    av_free(opacity);
+    return ret;
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    static const enum AVPixelFormat main_pix_fmts[COMPOSITE_FORMAT_NB][3] = {
+        [COMPOSITE_FORMAT_YUV420] = { AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_NONE },
+        [COMPOSITE_FORMAT_YUV444] = { AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUVJ444P, AV_PIX_FMT_NONE },
+        [COMPOSITE_FORMAT_GBRP]   = { AV_PIX_FMT_GBRP,    AV_PIX_FMT_NONE },
+    };
+    static const enum AVPixelFormat layer_pix_fmts[COMPOSITE_FORMAT_NB][2] = {
+        [COMPOSITE_FORMAT_YUV420] = { AV_PIX_FMT_YUVA420P, AV_PIX_FMT_NONE },
+        [COMPOSITE_FORMAT_YUV444] = { AV_PIX_FMT_YUVA444P, AV_PIX_FMT_NONE },
+        [COMPOSITE_FORMAT_GBRP]   = { AV_PIX_FMT_GBRAP,    AV_PIX_FMT_NONE },
+    };
+    CompositeContext *s = ctx->priv;
+    AVFilterFormats *formats;
+    int i, ret;
+
+    formats = ff_make_format_list(main_pix_fmts[s->format]);
+    if ((ret = ff_formats_ref(formats, &ctx->inputs[0]->outcfg.formats)) < 0 ||
+        (ret = ff_formats_ref(formats, &ctx->outputs[0]->incfg.formats)) < 0)
+        return ret;
+
+    formats = ff_make_format_list(layer_pix_fmts[s->format]);
+    for (i = 1; i < ctx->nb_inputs; i++)
+        if ((ret = ff_formats_ref(formats, &ctx->inputs[i]->outcfg.formats)) < 0)
+            return ret;
+    return 0;
+}
+
+/* whether frame is made of the same buffers as the current layer frame, so
+ * that its alpha is known to be unchanged */
+static int same_buffers(const AVFrame *cur, const AVFrame *frame)
+{
+    if (!cur->buf[0] || cur->width != frame->width || cur->height != frame->height ||
+        cur->data[3] != frame->data[3] || cur->linesize[3] != frame->linesize[3])
+        return 0;
+    for (int i = 0; i < FF_ARRAY_ELEMS(cur->buf); i++)
+        if (cur->buf[i] ? !frame->buf[i] || cur->buf[i]->buffer != frame->buf[i]->buffer
+                        : !!frame->buf[i])
+            return 0;
+    return 1;
+}
+
+/**
+ * Build the alpha planes and the visible spans of a layer for a new frame.
+ * The chroma alpha is the average of the luma alpha it covers, computed as
+ * vf_overlay does at the edges of the layer.
+ */
+static int prepare_layer(CompositeContext *s, CompositeLayer *l, AVFrame *frame)
+{
+    const int hsub = s->hsub, vsub = s->vsub, sub = hsub || vsub;
+    const int unchanged = same_buffers(l->frame, frame);
+    const uint8_t *a;
+    uint8_t *dst;
+    ptrdiff_t as;
+    unsigned size;
+    int i, j, k, ret;
+
+    av_frame_unref(l->frame);
+    if ((ret = av_frame_ref(l->frame, frame)) < 0)
+        return ret;
+    /* the buffers are kept referenced, so they cannot have been reused */
+    if (unchanged)
+        return 0;
+
+    l->w[0] = frame->width;
+    l->h[0] = frame->height;
+    l->w[1] = AV_CEIL_RSHIFT(frame->width,  hsub);
+    l->h[1] = AV_CEIL_RSHIFT(frame->height, vsub);
+
+    size = (l->opacity < 255 ? l->w[0] * l->h[0] : 0) + (sub ? l->w[1] * l->h[1] : 0);
+    if (size) {
+        av_fast_malloc(&l->alpha_buf, &l->alpha_buf_size, size);
+        if (!l->alpha_buf)
+            return AVERROR(ENOMEM);
+    }
+    av_fast_malloc(&l->span_buf, &l->span_buf_size,
+                   (l->h[0] + (sub ? l->h[1] : 0)) * sizeof(*l->span_buf));
+    if (!l->span_buf)
+        return AVERROR(ENOMEM);
+
+    dst = l->alpha_buf;
+    if (l->opacity < 255) {
+        for (j = 0; j < l->h[0]; j++) {
+            a = frame->data[3] + j * frame->linesize[3];
+            for (i = 0; i < l->w[0]; i++)
+                dst[j * l->w[0] + i] = FAST_DIV255(a[i] * l->opacity);
+        }
+        l->alpha[0] = dst;
+        l->alpha_linesize[0] = l->w[0];
+        dst += l->w[0] * l->h[0];
+    } else {
+        l->alpha[0] = frame->data[3];
+        l->alpha_linesize[0] = frame->linesize[3];
+    }
+    l->spans[0] = l->span_buf;
+
+    if (sub) {
+        a  = l->alpha[0];
+        as = l->alpha_linesize[0];
+        for (j = 0; j < l->h[1]; j++, a += as << vsub) {
+            for (k = 0; k < l->w[1]; k++) {
+                const uint8_t *p = a + (k << hsub);
+                int alpha, alpha_h, alpha_v;
+
+                if (hsub && vsub && j + 1 < l->h[1] && k + 1 < l->w[1]) {
+                    alpha = (p[0] + p[as] + p[1] + p[as + 1]) >> 2;
+                } else {
+                    alpha_h = hsub && k + 1 < l->w[1] ? (p[0] + p[1])  >> 1 : p[0];
+                    alpha_v = vsub && j + 1 < l->h[1] ? (p[0] + p[as]) >> 1 : p[0];
+                    alpha = (alpha_v + alpha_h) >> 1;
+                }
+                dst[j * l->w[1] + k] = alpha;
+            }
+        }
+        l->alpha[1] = dst;
+        l->alpha_linesize[1] = l->w[1];
+        l->spans[1] = l->span_buf + l->h[0];
+    } else {
+        l->alpha[1] = l->alpha[0];
+        l->alpha_linesize[1] = l->alpha_linesize[0];
+        l->spans[1] = l->spans[0];
+    }
+
+    l->visible = 0;
+    for (i = 0; i < 1 + sub; i++) {
+        for (j = 0; j < l->h[i]; j++) {
+            LayerSpan *span = &l->spans[i][j];
+            int start, end;
+
+            a = l->alpha[i] + j * l->alpha_linesize[i];
+            for (start = 0; start < l->w[i] && !a[start]; start++)
+                ;
+            for (end = l->w[i]; end > start && !a[end - 1]; end--)
+                ;
+            span->start  = start;
+            span->end    = end;
+            span->opaque = 1;
+            for (k = start; k < end && span->opaque; k++)
+                span->opaque = a[k] == 255;
+            l->visible |= end > start;
+        }
+    }
+    return 0;
+}
+
+static void blend_row(uint8_t *d, const uint8_t *s, const uint8_t *a, int w)
+{
+    for (int i = 0; i < w; i++)
+        d[i] = FAST_DIV255(d[i] * (255 - a[i]) + s[i] * a[i]);
+}
+
+static int composite_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    CompositeContext *s = ctx->priv;
+    AVFrame *out = arg;
+    const int nb_bands   = (out->height + BAND_ROWS - 1) / BAND_ROWS;
+    const int band_start = (nb_bands *  jobnr)      / nb_jobs;
+    const int band_end   = (nb_bands * (jobnr + 1)) / nb_jobs;
+
+    for (int band = band_start; band < band_end; band++) {
+        const int y0 = band * BAND_ROWS;
+        const int y1 = FFMIN(y0 + BAND_ROWS, out->height);
+
+        for (int p = 0; p < 3; p++) {
+            const int c  = p > 0;
+            const int hs = c ? s->hsub : 0;
+            const int vs = c ? s->vsub : 0;
+            const int dw = AV_CEIL_RSHIFT(out->width,  hs);
+            const int dh = AV_CEIL_RSHIFT(out->height, vs);
+            const int r0 = AV_CEIL_RSHIFT(y0, vs);
+            const int r1 = AV_CEIL_RSHIFT(y1, vs);
+
+            for (int n = 0; n < s->nb_visible; n++) {
+                const CompositeLayer *l = s->visible[n];
+                const AVFrame *src = l->frame;
+                const int xp = l->x >> hs;
+                const int yp = l->y >> vs;
+                const int end = FFMIN3(r1, yp + l->h[c], dh);
+
+                for (int r = FFMAX(r0, yp); r < end; r++) {
+                    const int j = r - yp;
+                    const LayerSpan *span = &l->spans[c][j];
+                    const int k0 = FFMAX(span->start, -xp);
+                    const int k1 = FFMIN(span->end, dw - xp);
+                    uint8_t *d = out->data[p] + r * out->linesize[p] + xp + k0;
+                    const uint8_t *sp = src->data[p] + j * src->linesize[p] + k0;
+
+                    if (k0 >= k1)
+                        continue;
+                    if (span->opaque)
+                        memcpy(d, sp, k1 - k0);
+                    else
+                        blend_row(d, sp, l->alpha[c] + j * l->alpha_linesize[c] + k0, k1 - k0);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int composite_frame(FFFrameSync *fs)
+{
+    AVFilterContext *ctx = fs->parent;
+    CompositeContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    AVFrame *out;
+    int i, ret;
+
+    if ((ret = ff_framesync_get_frame(fs, 0, &out, 1)) < 0)
+        return ret;
+    out->pts = av_rescale_q(fs->pts, fs->time_base, outlink->time_base);
+    if (ctx->is_disabled)
+        return ff_filter_frame(outlink, out);
+
+    s->nb_visible = 0;
+    for (i = 0; i < s->nb_layers; i++) {
+        CompositeLayer *l = &s->layers[i];
+        AVFrame *frame;
+
+        if ((ret = ff_framesync_get_frame(fs, l->input, &frame, 0)) < 0)
+            goto fail;
+        if (!frame)
+            continue;
+        if ((ret = prepare_layer(s, l, frame)) < 0)
+            goto fail;
+        if (l->visible &&
+            l->x < out->width  && l->x + l->w[0] > 0 &&
+            l->y < out->height && l->y + l->h[0] > 0)
+            s->visible[s->nb_visible++] = l;
+    }
+
+    if (s->nb_visible) {
+        if ((ret = ff_inlink_make_frame_writable(ctx->inputs[0], &out)) < 0)
+            goto fail;
+        ff_filter_execute(ctx, composite_slice, out, NULL,
+                          FFMIN((out->height + BAND_ROWS - 1) / BAND_ROWS,
+                                ff_filter_get_nb_threads(ctx)));
+    }
+    return ff_filter_frame(outlink, out);
+
+fail:
+    av_frame_free(&out);
+    return ret;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    CompositeContext *s = ctx->priv;
+    AVFilterLink *mainlink = ctx->inputs[0];
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(mainlink->format);
+    FFFrameSyncIn *in;
+    int i, ret;
+
+    s->hsub = desc->log2_chroma_w;
+    s->vsub = desc->log2_chroma_h;
+    /* same rounding of the position as vf_overlay */
+    for (i = 0; i < s->nb_layers; i++) {
+        CompositeLayer *l = &s->layers[i];
+        l->x &= ~((1 << s->hsub) - 1);
+        l->y &= ~((1 << s->vsub) - 1);
+    }
+
+    if ((ret = ff_framesync_init(&s->fs, ctx, ctx->nb_inputs)) < 0)
+        return ret;
+    in = s->fs.in;
+    s->fs.opaque   = s;
+    s->fs.on_event = composite_frame;
+    for (i = 0; i < ctx->nb_inputs; i++) {
+        in[i].time_base = ctx->inputs[i]->time_base;
+        in[i].sync      = i ? 1 : 2;
+        in[i].before    = i ? EXT_NULL : EXT_STOP;
+        in[i].after     = EXT_INFINITY;
+    }
+
+    outlink->w = mainlink->w;
+    outlink->h = mainlink->h;
+    outlink->time_base = mainlink->time_base;
+
+    return ff_framesync_configure(&s->fs);
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    CompositeContext *s = ctx->priv;
+
+    ff_framesync_uninit(&s->fs);
+    for (int i = 0; i < s->nb_layers; i++) {
+        CompositeLayer *l = &s->layers[i];
+        av_frame_free(&l->frame);
+        av_freep(&l->alpha_buf);
+        av_freep(&l->span_buf);
+    }
+    av_freep(&s->layers);
+    av_freep(&s->visible);
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    CompositeContext *s = ctx->priv;
+    return ff_framesync_activate(&s->fs);
+}
+
+#define OFFSET(x) offsetof(CompositeContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption composite_options[] = {
+    { "inputs", "set number of inputs, the main one and the layers", OFFSET(nb_inputs), AV_OPT_TYPE_INT, {.i64=2}, 2, INT_MAX, FLAGS },
+    { "layout", "set the position of every layer", OFFSET(layout_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    { "order", "set the painting order of every layer", OFFSET(order_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    { "opacity", "set the opacity of every layer", OFFSET(opacity_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    { "format", "set the format of the main input and the output", OFFSET(format), AV_OPT_TYPE_INT, {.i64=COMPOSITE_FORMAT_YUV420}, 0, COMPOSITE_FORMAT_NB-1, FLAGS, "format" },
+        { "yuv420", "", 0, AV_OPT_TYPE_CONST, {.i64=COMPOSITE_FORMAT_YUV420}, .flags = FLAGS, .unit = "format" },
+        { "yuv444", "", 0, AV_OPT_TYPE_CONST, {.i64=COMPOSITE_FORMAT_YUV444}, .flags = FLAGS, .unit = "format" },
+        { "gbrp",   "", 0, AV_OPT_TYPE_CONST, {.i64=COMPOSITE_FORMAT_GBRP},   .flags = FLAGS, .unit = "format" },
+    { "eof_action", "Action to take when encountering EOF from a layer",
+        OFFSET(fs.opt_eof_action), AV_OPT_TYPE_INT, { .i64 = EOF_ACTION_REPEAT },
+        EOF_ACTION_REPEAT, EOF_ACTION_PASS, .flags = FLAGS, "eof_action" },
+        { "repeat", "Repeat the previous frame.",   0, AV_OPT_TYPE_CONST, { .i64 = EOF_ACTION_REPEAT }, .flags = FLAGS, "eof_action" },
+        { "endall", "End all streams.",             0, AV_OPT_TYPE_CONST, { .i64 = EOF_ACTION_ENDALL }, .flags = FLAGS, "eof_action" },
+        { "pass",   "Pass through the main input.", 0, AV_OPT_TYPE_CONST, { .i64 = EOF_ACTION_PASS },   .flags = FLAGS, "eof_action" },
+    { "shortest", "force termination when the shortest input terminates", OFFSET(fs.opt_shortest), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+    { "repeatlast", "repeat the last frame of every layer", OFFSET(fs.opt_repeatlast), AV_OPT_TYPE_BOOL, {.i64=1}, 0, 1, FLAGS },
+    { NULL }
+};
+
+FRAMESYNC_DEFINE_CLASS(composite, CompositeContext, fs);
+
+static const AVFilterPad composite_outputs[] = {
+    {
+        .name          = "default",
+        .type          = AVMEDIA_TYPE_VIDEO,
+        .config_props  = config_output,
+    },
+};
+
+const AVFilter ff_vf_composite = {
+    .name          = "composite",
+    .description   = NULL_IF_CONFIG_SMALL("Composite several layers on top of a video."),
+    .preinit       = composite_framesync_preinit,
+    .init          = init,
+    .uninit        = uninit,
+    .priv_size     = sizeof(CompositeContext),
+    .priv_class    = &composite_class,
+    .activate      = activate,
+    FILTER_OUTPUTS(composite_outputs),
+    FILTER_QUERY_FUNC(query_formats),
+    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS |
+                     AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
+                     AVFILTER_FLAG_SLICE_THREADS,
+};
@@ -25,6 +25,7 @@
 
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 
 #include "avfilter.h"
@@ -42,8 +43,24 @@ typedef struct CropDetectContext {
     int frame_nb;
     int max_pixsteps[4];
     int max_outliers;
+    int interval;
+
+    int nb_threads;
+    int *scores;        ///< line scores of the current batch
+    int *col_totals;    ///< per job column sums
+
+    /* last detected area, exported for the frames that are not analyzed */
+    int x, y, w, h;
 } CropDetectContext;
 
+typedef struct ThreadData {
+    AVFrame *frame;
+    int from;           ///< first line of the batch
+    int dir;            ///< +1 or -1
+    int nb_lines;
+    int vertical;       ///< lines are columns
+} ThreadData;
+
 static const enum AVPixelFormat pix_fmts[] = {
     AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUVJ420P,
     AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUVJ422P,
@@ -61,59 +78,177 @@ static const enum AVPixelFormat pix_fmts[] = {
     AV_PIX_FMT_NONE
 };
 
-static int checkline(void *ctx, const unsigned char *src, int stride, int len, int bpp)
+#define MASK_BYTES    UINT64_C(0x00FF00FF00FF00FF)
+#define MASK_WORDS    UINT64_C(0x0000FFFF0000FFFF)
+#define MASK_NO_ALPHA UINT64_C(0x00FFFFFF00FFFFFF)
+
+/**
+ * Sum len contiguous bytes, skipping the bytes cleared in mask, 8 bytes at a
+ * time in 16 bit lanes.
+ */
+static int sum_line8(const uint8_t *src, int len, uint64_t mask)
 {
-    int total = 0;
-    int div = len;
-    const uint16_t *src16 = (const uint16_t *)src;
-
-    switch (bpp) {
-    case 1:
-        while (len >= 8) {
-            total += src[       0] + src[  stride] + src[2*stride] + src[3*stride]
-                  +  src[4*stride] + src[5*stride] + src[6*stride] + src[7*stride];
-            src += 8*stride;
-            len -= 8;
-        }
-        while (--len >= 0) {
-            total += src[0];
-            src += stride;
-        }
-        break;
-    case 2:
-        stride >>= 1;
-        while (len >= 8) {
-            total += src16[       0] + src16[  stride] + src16[2*stride] + src16[3*stride]
-                  +  src16[4*stride] + src16[5*stride] + src16[6*stride] + src16[7*stride];
-            src16 += 8*stride;
-            len -= 8;
+    const int len8 = len & ~7;
+    int total = 0, i = 0;
+
+    while (i < len8) {
+        /* at most 128 words, so that the 16 bit lanes do not overflow */
+        const int end = FFMIN(len8, i + 8 * 128);
+        uint64_t acc = 0;
+
+        for (; i < end; i += 8) {
+            uint64_t v = AV_RL64(src + i) & mask;
+            acc += (v & MASK_BYTES) + ((v >> 8) & MASK_BYTES);
         }
-        while (--len >= 0) {
-            total += src16[0];
-            src16 += stride;
+        acc = (acc & MASK_WORDS) + ((acc >> 16) & MASK_WORDS);
+        total += (uint32_t)acc + (acc >> 32);
+    }
+    for (; i < len; i++)
+        if (mask >> (8 * (i & 7)) & 0xFF)
+            total += src[i];
+    return total;
+}
+
+/* Same for 16 bit samples, 4 samples at a time in 32 bit lanes. */
+static int sum_line16(const uint16_t *src, int len)
+{
+    const int len4 = len & ~3;
+    uint64_t acc = 0;
+    int total = 0, i;
+
+    for (i = 0; i < len4; i += 4) {
+        uint64_t v = AV_RN64(src + i);
+        acc += (v & MASK_WORDS) + ((v >> 16) & MASK_WORDS);
+    }
+    total = (uint32_t)acc + (acc >> 32);
+    for (; i < len; i++)
+        total += src[i];
+    return total;
+}
+
+/* Add the samples of the columns [x0, x0 + len) of one row to totals. */
+static void add_columns8(int *totals, const uint8_t *src, int len)
+{
+    for (int i = 0; i < len; i++)
+        totals[i] += src[i];
+}
+
+static void add_columns16(int *totals, const uint16_t *src, int len)
+{
+    for (int i = 0; i < len; i++)
+        totals[i] += src[i];
+}
+
+static void add_columns_packed(int *totals, const uint8_t *src, int len, int bpp)
+{
+    for (int i = 0; i < len; i++)
+        totals[i] += src[i * bpp] + src[i * bpp + 1] + src[i * bpp + 2];
+}
+
+static int line_div(int len, int bpp)
+{
+    return bpp >= 3 ? 3 * len : len;
+}
+
+/**
+ * Compute the scores of a part of a batch of lines. Rows are summed one by
+ * one, columns are summed all at once walking the frame row by row, rather
+ * than one column at a time down the frame.
+ */
+static int score_lines(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    CropDetectContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const AVFrame *frame = td->frame;
+    const int bpp = s->max_pixsteps[0];
+    const int start = (td->nb_lines *  jobnr   ) / nb_jobs;
+    const int end   = (td->nb_lines * (jobnr+1)) / nb_jobs;
+    const int len = end - start;
+    const uint8_t *src = frame->data[0];
+    int first;
+
+    if (len <= 0)
+        return 0;
+
+    // lowest line index of this part, the lines are processed in memory order
+    first = td->dir > 0 ? td->from + start : td->from - (end - 1);
+
+    if (!td->vertical) {
+        const int div = line_div(frame->width, bpp);
+        for (int i = start; i < end; i++) {
+            const uint8_t *line = src + (td->from + td->dir * i) * frame->linesize[0];
+            int total;
+
+            switch (bpp) {
+            case 1:  total = sum_line8(line, frame->width, UINT64_MAX);        break;
+            case 2:  total = sum_line16((const uint16_t *)line, frame->width); break;
+            case 3:  total = sum_line8(line, frame->width * 3, UINT64_MAX);    break;
+            default: total = sum_line8(line, frame->width * 4, MASK_NO_ALPHA); break;
+            }
+            s->scores[i] = total / div;
         }
-        break;
-    case 3:
-    case 4:
-        while (len >= 4) {
-            total += src[0]        + src[1         ] + src[2         ]
-                  +  src[  stride] + src[1+  stride] + src[2+  stride]
-                  +  src[2*stride] + src[1+2*stride] + src[2+2*stride]
-                  +  src[3*stride] + src[1+3*stride] + src[2+3*stride];
-            src += 4*stride;
-            len -= 4;
+    } else {
+        const int div = line_div(frame->height, bpp);
+        int *totals = s->col_totals + jobnr * frame->width;
+
+        memset(totals, 0, len * sizeof(*totals));
+        src += first * bpp;
+        for (int y = 0; y < frame->height; y++) {
+            switch (bpp) {
+            case 1:  add_columns8(totals, src, len);                    break;
+            case 2:  add_columns16(totals, (const uint16_t *)src, len); break;
+            default: add_columns_packed(totals, src, len, bpp);         break;
+            }
+            src += frame->linesize[0];
         }
-        while (--len >= 0) {
-            total += src[0] + src[1] + src[2];
-            src += stride;
+        for (int i = start; i < end; i++)
+            s->scores[i] = totals[td->from + td->dir * i - first] / div;
+    }
+
+    return 0;
+}
+
+/**
+ * Scan the lines from 'from' in direction dir while the scan continues,
+ * and return the border found, or *dst unchanged. The line scores are
+ * computed in batches of growing size, so that the scan stays cheap when
+ * it stops early, which it usually does on the first line with content.
+ */
+static int find_border(AVFilterContext *ctx, AVFrame *frame, int vertical,
+                       int from, int dir, int stop, int dst, int limit)
+{
+    CropDetectContext *s = ctx->priv;
+    const int nb_lines = dir > 0 ? stop - from : from - stop;
+    int batch = 8, done = 0, outliers = 0;
+    int last = from;
+
+    while (done < nb_lines) {
+        ThreadData td = {
+            .frame    = frame,
+            .from     = from + dir * done,
+            .dir      = dir,
+            .nb_lines = FFMIN(batch, nb_lines - done),
+            .vertical = vertical,
+        };
+        const int nb_jobs = FFMIN(s->nb_threads, FFMAX(1, td.nb_lines / 8));
+
+        ff_filter_execute(ctx, score_lines, &td, NULL, nb_jobs);
+
+        for (int i = 0; i < td.nb_lines; i++) {
+            const int line = td.from + dir * i;
+
+            av_log(ctx, AV_LOG_DEBUG, "total:%d\n", s->scores[i]);
+            if (s->scores[i] > limit) {
+                if (++outliers > s->max_outliers)
+                    return last;
+            } else
+                last = line + dir;
         }
-        div *= 3;
-        break;
+        done  += td.nb_lines;
+        batch *= 2;
     }
-    total /= div;
 
-    av_log(ctx, AV_LOG_DEBUG, "total:%d\n", total);
-    return total;
+    return dst;
 }
 
 static av_cold int init(AVFilterContext *ctx)
@@ -144,9 +279,25 @@ static int config_input(AVFilterLink *inlink)
     s->x2 = 0;
     s->y2 = 0;
 
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    av_freep(&s->scores);
+    av_freep(&s->col_totals);
+    s->scores     = av_calloc(FFMAX(inlink->w, inlink->h), sizeof(*s->scores));
+    s->col_totals = av_calloc(s->nb_threads, inlink->w * sizeof(*s->col_totals));
+    if (!s->scores || !s->col_totals)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    CropDetectContext *s = ctx->priv;
+
+    av_freep(&s->scores);
+    av_freep(&s->col_totals);
+}
+
 #define SET_META(key, value) \
     av_dict_set_int(metadata, key, value, 0)
 
@@ -154,15 +305,22 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
     CropDetectContext *s = ctx->priv;
-    int bpp = s->max_pixsteps[0];
     int w, h, x, y, shrink_by;
-    AVDictionary **metadata;
-    int outliers, last_y;
+    AVDictionary **metadata = &frame->metadata;
     int limit = lrint(s->limit);
 
     // ignore first s->skip frames
-    if (++s->frame_nb > 0) {
-        metadata = &frame->metadata;
+    if (++s->frame_nb > 0 && (s->frame_nb - 1) % s->interval) {
+        // only analyze one frame out of s->interval, export the last result
+        SET_META("lavfi.cropdetect.x1", s->x1);
+        SET_META("lavfi.cropdetect.x2", s->x2);
+        SET_META("lavfi.cropdetect.y1", s->y1);
+        SET_META("lavfi.cropdetect.y2", s->y2);
+        SET_META("lavfi.cropdetect.w",  s->w);
+        SET_META("lavfi.cropdetect.h",  s->h);
+        SET_META("lavfi.cropdetect.x",  s->x);
+        SET_META("lavfi.cropdetect.y",  s->y);
+    } else if (s->frame_nb > 0) {
 
         // Reset the crop area every reset_count frames, if reset_count is > 0
         if (s->reset_count > 0 && s->frame_nb > s->reset_count) {
@@ -173,23 +331,10 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
             s->frame_nb = 1;
         }
 
-#define FIND(DST, FROM, NOEND, INC, STEP0, STEP1, LEN) \
-        outliers = 0;\
-        for (last_y = y = FROM; NOEND; y = y INC) {\
-            if (checkline(ctx, frame->data[0] + STEP0 * y, STEP1, LEN, bpp) > limit) {\
-                if (++outliers > s->max_outliers) { \
-                    DST = last_y;\
-                    break;\
-                }\
-            } else\
-                last_y = y INC;\
-        }
-
-        FIND(s->y1,                 0,               y < s->y1, +1, frame->linesize[0], bpp, frame->width);
-        FIND(s->y2, frame->height - 1, y > FFMAX(s->y2, s->y1), -1, frame->linesize[0], bpp, frame->width);
-        FIND(s->x1,                 0,               y < s->x1, +1, bpp, frame->linesize[0], frame->height);
-        FIND(s->x2,  frame->width - 1, y > FFMAX(s->x2, s->x1), -1, bpp, frame->linesize[0], frame->height);
-
+        s->y1 = find_border(ctx, frame, 0,                 0, +1, s->y1, s->y1, limit);
+        s->y2 = find_border(ctx, frame, 0, frame->height - 1, -1, FFMAX(s->y2, s->y1), s->y2, limit);
+        s->x1 = find_border(ctx, frame, 1,                 0, +1, s->x1, s->x1, limit);
+        s->x2 = find_border(ctx, frame, 1,  frame->width - 1, -1, FFMAX(s->x2, s->x1), s->x2, limit);
 
         // round x and y (up), important for yuv colorspaces
         // make sure they stay rounded!
@@ -214,6 +359,11 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
         h -= shrink_by;
         y += (shrink_by/2 + 1) & ~1;
 
+        s->x = x;
+        s->y = y;
+        s->w = w;
+        s->h = h;
+
         SET_META("lavfi.cropdetect.x1", s->x1);
         SET_META("lavfi.cropdetect.x2", s->x2);
         SET_META("lavfi.cropdetect.y1", s->y1);
@@ -243,6 +393,7 @@ static const AVOption cropdetect_options[] = {
     { "skip",  "Number of initial frames to skip",                    OFFSET(skip),        AV_OPT_TYPE_INT, { .i64 = 2 },  0, INT_MAX, FLAGS },
     { "reset_count", "Recalculate the crop area after this many frames",OFFSET(reset_count),AV_OPT_TYPE_INT,{ .i64 = 0 },  0, INT_MAX, FLAGS },
     { "max_outliers", "Threshold count of outliers",                  OFFSET(max_outliers),AV_OPT_TYPE_INT, { .i64 = 0 },  0, INT_MAX, FLAGS },
+    { "interval", "Analyze one frame out of this many",               OFFSET(interval),    AV_OPT_TYPE_INT, { .i64 = 1 },  1, INT_MAX, FLAGS },
     { NULL }
 };
 
@@ -270,8 +421,10 @@ const AVFilter ff_vf_cropdetect = {
     .priv_size     = sizeof(CropDetectContext),
     .priv_class    = &cropdetect_class,
     .init          = init,
+    .uninit        = uninit,
     FILTER_INPUTS(avfilter_vf_cropdetect_inputs),
     FILTER_OUTPUTS(avfilter_vf_cropdetect_outputs),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_METADATA_ONLY,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_METADATA_ONLY |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
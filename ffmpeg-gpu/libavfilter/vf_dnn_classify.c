@@ -42,6 +42,7 @@ typedef struct DnnClassifyContext {
     char *target;
     char **labels;
     int label_count;
+    int softmax;
 } DnnClassifyContext;
 
 #define OFFSET(x) offsetof(DnnClassifyContext, dnnctx.x)
@@ -56,6 +57,7 @@ static const AVOption dnn_classify_options[] = {
     { "confidence",  "threshold of confidence",    OFFSET2(confidence),      AV_OPT_TYPE_FLOAT,     { .dbl = 0.5 },  0, 1, FLAGS},
     { "labels",      "path to labels file",        OFFSET2(labels_filename), AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
     { "target",      "which one to be classified", OFFSET2(target),          AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "softmax",     "apply softmax to the model output", OFFSET2(softmax),  AV_OPT_TYPE_BOOL,      { .i64 = 0 },    0, 1, FLAGS },
     { NULL }
 };
 
@@ -98,6 +100,14 @@ static int dnn_classify_post_proc(AVFrame *frame, DNNData *output, uint32_t bbox
         }
     }
 
+    /* the model outputs logits, only the probability of the best class is needed */
+    if (ctx->softmax) {
+        float sum = 0.0f;
+        for (int i = 0; i < output->channels; i++)
+            sum += expf(classifications[i] - confidence);
+        confidence = 1.0f / sum;
+    }
+
     if (confidence < conf_threshold) {
         return 0;
     }
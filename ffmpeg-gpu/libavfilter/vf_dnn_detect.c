@@ -41,6 +41,13 @@ typedef struct DnnDetectContext {
     char *labels_filename;
     char **labels;
     int label_count;
+    float nms_iou;
+    int nms_agnostic;
+
+    DNNDetectBox *boxes;
+    unsigned boxes_size;
+    void *nms_buf;
+    unsigned nms_buf_size;
 } DnnDetectContext;
 
 #define OFFSET(x) offsetof(DnnDetectContext, dnnctx.x)
@@ -57,35 +64,35 @@ static const AVOption dnn_detect_options[] = {
     DNN_COMMON_OPTIONS
     { "confidence",  "threshold of confidence",    OFFSET2(confidence),      AV_OPT_TYPE_FLOAT,     { .dbl = 0.5 },  0, 1, FLAGS},
     { "labels",      "path to labels file",        OFFSET2(labels_filename), AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "nms_iou",     "IoU threshold of non-maximum suppression, 1 disables it", OFFSET2(nms_iou), AV_OPT_TYPE_FLOAT, { .dbl = 1 }, 0, 1, FLAGS },
+    { "nms_agnostic", "suppress overlapping boxes of different labels", OFFSET2(nms_agnostic), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
     { NULL }
 };
 
 AVFILTER_DEFINE_CLASS(dnn_detect);
 
-static int dnn_detect_post_proc_ov(AVFrame *frame, DNNData *output, AVFilterContext *filter_ctx)
+static DNNDetectBox *get_boxes(DnnDetectContext *ctx, int nb)
+{
+    if (nb <= 0 || nb > INT_MAX / sizeof(*ctx->boxes))
+        return NULL;
+    av_fast_malloc(&ctx->boxes, &ctx->boxes_size, nb * sizeof(*ctx->boxes));
+    return ctx->boxes;
+}
+
+/**
+ * Apply the non-maximum suppression to the decoded boxes and export the
+ * remaining ones as side data of the frame.
+ */
+static int dnn_detect_export_boxes(AVFrame *frame, int nb_bboxes, AVFilterContext *filter_ctx)
 {
     DnnDetectContext *ctx = filter_ctx->priv;
-    float conf_threshold = ctx->confidence;
-    int proposal_count = output->height;
-    int detect_size = output->width;
-    float *detections = output->data;
-    int nb_bboxes = 0;
-    AVFrameSideData *sd;
-    AVDetectionBBox *bbox;
     AVDetectionBBoxHeader *header;
 
-    sd = av_frame_get_side_data(frame, AV_FRAME_DATA_DETECTION_BBOXES);
-    if (sd) {
-        av_log(filter_ctx, AV_LOG_ERROR, "already have bounding boxes in side data.\n");
-        return -1;
-    }
-
-    for (int i = 0; i < proposal_count; ++i) {
-        float conf = detections[i * detect_size + 2];
-        if (conf < conf_threshold) {
-            continue;
-        }
-        nb_bboxes++;
+    if (nb_bboxes && ctx->nms_iou < 1) {
+        nb_bboxes = ff_dnn_nms(ctx->boxes, nb_bboxes, ctx->nms_iou, ctx->nms_agnostic,
+                               &ctx->nms_buf, &ctx->nms_buf_size);
+        if (nb_bboxes < 0)
+            return nb_bboxes;
     }
 
     if (nb_bboxes == 0) {
@@ -101,54 +108,76 @@ static int dnn_detect_post_proc_ov(AVFrame *frame, DNNData *output, AVFilterCont
 
     av_strlcpy(header->source, ctx->dnnctx.model_filename, sizeof(header->source));
 
-    for (int i = 0; i < proposal_count; ++i) {
-        int av_unused image_id = (int)detections[i * detect_size + 0];
-        int label_id = (int)detections[i * detect_size + 1];
-        float conf   =      detections[i * detect_size + 2];
-        float x0     =      detections[i * detect_size + 3];
-        float y0     =      detections[i * detect_size + 4];
-        float x1     =      detections[i * detect_size + 5];
-        float y1     =      detections[i * detect_size + 6];
-
-        bbox = av_get_detection_bbox(header, i);
-
-        if (conf < conf_threshold) {
-            continue;
-        }
+    for (int i = 0; i < nb_bboxes; i++) {
+        const DNNDetectBox *box = &ctx->boxes[i];
+        AVDetectionBBox *bbox = av_get_detection_bbox(header, i);
 
-        bbox->x = (int)(x0 * frame->width);
-        bbox->w = (int)(x1 * frame->width) - bbox->x;
-        bbox->y = (int)(y0 * frame->height);
-        bbox->h = (int)(y1 * frame->height) - bbox->y;
+        bbox->x = (int)(box->x0 * frame->width);
+        bbox->w = (int)(box->x1 * frame->width) - bbox->x;
+        bbox->y = (int)(box->y0 * frame->height);
+        bbox->h = (int)(box->y1 * frame->height) - bbox->y;
 
-        bbox->detect_confidence = av_make_q((int)(conf * 10000), 10000);
+        bbox->detect_confidence = av_make_q((int)(box->confidence * 10000), 10000);
         bbox->classify_count = 0;
 
-        if (ctx->labels && label_id < ctx->label_count) {
-            av_strlcpy(bbox->detect_label, ctx->labels[label_id], sizeof(bbox->detect_label));
+        if (ctx->labels && box->label >= 0 && box->label < ctx->label_count) {
+            av_strlcpy(bbox->detect_label, ctx->labels[box->label], sizeof(bbox->detect_label));
         } else {
-            snprintf(bbox->detect_label, sizeof(bbox->detect_label), "%d", label_id);
-        }
-
-        nb_bboxes--;
-        if (nb_bboxes == 0) {
-            break;
+            snprintf(bbox->detect_label, sizeof(bbox->detect_label), "%d", box->label);
         }
     }
 
     return 0;
 }
 
+static int dnn_detect_post_proc_ov(AVFrame *frame, DNNData *output, AVFilterContext *filter_ctx)
+{
+    DnnDetectContext *ctx = filter_ctx->priv;
+    float conf_threshold = ctx->confidence;
+    int proposal_count = output->height;
+    int detect_size = output->width;
+    const float *detections = output->data;
+    DNNDetectBox *boxes;
+    int nb_bboxes = 0;
+    AVFrameSideData *sd;
+
+    sd = av_frame_get_side_data(frame, AV_FRAME_DATA_DETECTION_BBOXES);
+    if (sd) {
+        av_log(filter_ctx, AV_LOG_ERROR, "already have bounding boxes in side data.\n");
+        return -1;
+    }
+
+    if (proposal_count <= 0)
+        return dnn_detect_export_boxes(frame, 0, filter_ctx);
+    if (!(boxes = get_boxes(ctx, proposal_count)))
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < proposal_count; ++i, detections += detect_size) {
+        float conf = detections[2];
+        if (!(conf >= conf_threshold))
+            continue;
+        boxes[nb_bboxes++] = (DNNDetectBox) {
+            .label      = (int)detections[1],
+            .confidence = conf,
+            .x0         = detections[3],
+            .y0         = detections[4],
+            .x1         = detections[5],
+            .y1         = detections[6],
+        };
+    }
+
+    return dnn_detect_export_boxes(frame, nb_bboxes, filter_ctx);
+}
+
 static int dnn_detect_post_proc_tf(AVFrame *frame, DNNData *output, AVFilterContext *filter_ctx)
 {
     DnnDetectContext *ctx = filter_ctx->priv;
     int proposal_count;
     float conf_threshold = ctx->confidence;
-    float *conf, *position, *label_id, x0, y0, x1, y1;
+    const float *conf, *position, *label_id;
+    DNNDetectBox *boxes;
     int nb_bboxes = 0;
     AVFrameSideData *sd;
-    AVDetectionBBox *bbox;
-    AVDetectionBBoxHeader *header;
 
     proposal_count = *(float *)(output[0].data);
     conf           = output[1].data;
@@ -161,57 +190,25 @@ static int dnn_detect_post_proc_tf(AVFrame *frame, DNNData *output, AVFilterCont
         return -1;
     }
 
-    for (int i = 0; i < proposal_count; ++i) {
-        if (conf[i] < conf_threshold)
-            continue;
-        nb_bboxes++;
-    }
-
-    if (nb_bboxes == 0) {
-        av_log(filter_ctx, AV_LOG_VERBOSE, "nothing detected in this frame.\n");
-        return 0;
-    }
-
-    header = av_detection_bbox_create_side_data(frame, nb_bboxes);
-    if (!header) {
-        av_log(filter_ctx, AV_LOG_ERROR, "failed to create side data with %d bounding boxes\n", nb_bboxes);
-        return -1;
-    }
-
-    av_strlcpy(header->source, ctx->dnnctx.model_filename, sizeof(header->source));
+    if (proposal_count <= 0)
+        return dnn_detect_export_boxes(frame, 0, filter_ctx);
+    if (!(boxes = get_boxes(ctx, proposal_count)))
+        return AVERROR(ENOMEM);
 
     for (int i = 0; i < proposal_count; ++i) {
-        y0 = position[i * 4];
-        x0 = position[i * 4 + 1];
-        y1 = position[i * 4 + 2];
-        x1 = position[i * 4 + 3];
-
-        bbox = av_get_detection_bbox(header, i);
-
-        if (conf[i] < conf_threshold) {
+        if (!(conf[i] >= conf_threshold))
             continue;
-        }
-
-        bbox->x = (int)(x0 * frame->width);
-        bbox->w = (int)(x1 * frame->width) - bbox->x;
-        bbox->y = (int)(y0 * frame->height);
-        bbox->h = (int)(y1 * frame->height) - bbox->y;
-
-        bbox->detect_confidence = av_make_q((int)(conf[i] * 10000), 10000);
-        bbox->classify_count = 0;
-
-        if (ctx->labels && label_id[i] < ctx->label_count) {
-            av_strlcpy(bbox->detect_label, ctx->labels[(int)label_id[i]], sizeof(bbox->detect_label));
-        } else {
-            snprintf(bbox->detect_label, sizeof(bbox->detect_label), "%d", (int)label_id[i]);
-        }
-
-        nb_bboxes--;
-        if (nb_bboxes == 0) {
-            break;
-        }
+        boxes[nb_bboxes++] = (DNNDetectBox) {
+            .label      = (int)label_id[i],
+            .confidence = conf[i],
+            .y0         = position[i * 4],
+            .x0         = position[i * 4 + 1],
+            .y1         = position[i * 4 + 2],
+            .x1         = position[i * 4 + 3],
+        };
     }
-    return 0;
+
+    return dnn_detect_export_boxes(frame, nb_bboxes, filter_ctx);
 }
 
 static int dnn_detect_post_proc(AVFrame *frame, DNNData *output, uint32_t nb, AVFilterContext *filter_ctx)
@@ -438,6 +435,8 @@ static av_cold void dnn_detect_uninit(AVFilterContext *context)
     DnnDetectContext *ctx = context->priv;
     ff_dnn_uninit(&ctx->dnnctx);
     free_detect_labels(ctx);
+    av_freep(&ctx->boxes);
+    av_freep(&ctx->nms_buf);
 }
 
 static const AVFilterPad dnn_detect_inputs[] = {
@@ -28,6 +28,7 @@
 
 #include "avfilter.h"
 #include "filters.h"
+#include "internal.h"
 #include "scene_sad.h"
 
 typedef struct FreezeDetectContext {
@@ -37,6 +38,9 @@ typedef struct FreezeDetectContext {
     ptrdiff_t height[4];
     ff_scene_sad_fn sad;
     int bitdepth;
+    uint64_t count;              ///< number of compared samples
+    uint64_t *job_sad;           ///< SAD of each slice job
+    int nb_jobs;
     AVFrame *reference_frame;
     int64_t n;
     int64_t reference_n;
@@ -44,6 +48,7 @@ typedef struct FreezeDetectContext {
 
     double noise;
     int64_t duration;            ///< minimum duration of frozen frame until notification
+    int step;                    ///< compare one line out of step
 } FreezeDetectContext;
 
 #define OFFSET(x) offsetof(FreezeDetectContext, x)
@@ -55,6 +60,7 @@ static const AVOption freezedetect_options[] = {
     { "noise",               "set noise tolerance",                       OFFSET(noise),  AV_OPT_TYPE_DOUBLE,   {.dbl=0.001},     0,       1.0, V|F },
     { "d",                   "set minimum duration in seconds",        OFFSET(duration),  AV_OPT_TYPE_DURATION, {.i64=2000000},   0, INT64_MAX, V|F },
     { "duration",            "set minimum duration in seconds",        OFFSET(duration),  AV_OPT_TYPE_DURATION, {.i64=2000000},   0, INT64_MAX, V|F },
+    { "step",                "set the line step of the comparison",        OFFSET(step),  AV_OPT_TYPE_INT,      {.i64=1},           1,        64, V|F },
 
     {NULL}
 };
@@ -96,16 +102,25 @@ static int config_input(AVFilterLink *inlink)
 
     s->bitdepth = pix_desc->comp[0].depth;
 
+    s->count = 0;
     for (int plane = 0; plane < 4; plane++) {
         ptrdiff_t line_size = av_image_get_linesize(inlink->format, inlink->w, plane);
         s->width[plane] = line_size >> (s->bitdepth > 8);
         s->height[plane] = inlink->h >> ((plane == 1 || plane == 2) ? pix_desc->log2_chroma_h : 0);
+        s->count += s->width[plane] * ((s->height[plane] + s->step - 1) / s->step);
     }
 
     s->sad = ff_scene_sad_get_fn(s->bitdepth == 8 ? 8 : 16);
     if (!s->sad)
         return AVERROR(EINVAL);
 
+    s->nb_jobs = FFMAX(1, FFMIN(ff_filter_get_nb_threads(ctx),
+                                (inlink->h / s->step) / 16));
+    av_freep(&s->job_sad);
+    s->job_sad = av_calloc(s->nb_jobs, sizeof(*s->job_sad));
+    if (!s->job_sad)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -113,26 +128,66 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     FreezeDetectContext *s = ctx->priv;
     av_frame_free(&s->reference_frame);
+    av_freep(&s->job_sad);
 }
 
-static int is_frozen(FreezeDetectContext *s, AVFrame *reference, AVFrame *frame)
+/* same test as on the whole frame, so that it can be done on a partial sum */
+static int above_noise(FreezeDetectContext *s, uint64_t sad)
 {
+    double mafd = (double)sad / s->count / (1ULL << s->bitdepth);
+    return mafd > s->noise;
+}
+
+typedef struct ThreadData {
+    AVFrame *reference, *frame;
+} ThreadData;
+
+/**
+ * Sum the SAD of a band of every plane, one line out of step. The sums are
+ * nonnegative, so the job stops as soon as its own sum is enough to tell
+ * that the frame is not frozen.
+ */
+static int sad_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    FreezeDetectContext *s = ctx->priv;
+    ThreadData *td = arg;
     uint64_t sad = 0;
-    uint64_t count = 0;
-    double mafd;
+
     for (int plane = 0; plane < 4; plane++) {
-        if (s->width[plane]) {
-            uint64_t plane_sad;
-            s->sad(frame->data[plane], frame->linesize[plane],
-                   reference->data[plane], reference->linesize[plane],
-                   s->width[plane], s->height[plane], &plane_sad);
-            sad += plane_sad;
-            count += s->width[plane] * s->height[plane];
+        const int lines = (s->height[plane] + s->step - 1) / s->step;
+        const int start = (lines *  jobnr     ) / nb_jobs;
+        const int end   = (lines * (jobnr + 1)) / nb_jobs;
+        const ptrdiff_t ref_linesize   = td->reference->linesize[plane] * s->step;
+        const ptrdiff_t frame_linesize = td->frame->linesize[plane] * s->step;
+
+        if (!s->width[plane])
+            continue;
+        for (int y = start; y < end; y += 16) {
+            uint64_t band_sad;
+            s->sad(td->frame->data[plane] + y * frame_linesize, frame_linesize,
+                   td->reference->data[plane] + y * ref_linesize, ref_linesize,
+                   s->width[plane], FFMIN(16, end - y), &band_sad);
+            sad += band_sad;
+            if (above_noise(s, sad))
+                goto end;
         }
     }
+end:
     emms_c();
-    mafd = (double)sad / count / (1ULL << s->bitdepth);
-    return (mafd <= s->noise);
+    s->job_sad[jobnr] = sad;
+    return 0;
+}
+
+static int is_frozen(AVFilterContext *ctx, AVFrame *reference, AVFrame *frame)
+{
+    FreezeDetectContext *s = ctx->priv;
+    ThreadData td = { .reference = reference, .frame = frame };
+    uint64_t sad = 0;
+
+    ff_filter_execute(ctx, sad_slice, &td, NULL, s->nb_jobs);
+    for (int i = 0; i < s->nb_jobs; i++)
+        sad += s->job_sad[i];
+    return !above_noise(s, sad);
 }
 
 static int set_meta(FreezeDetectContext *s, AVFrame *frame, const char *key, const char *value)
@@ -166,7 +221,7 @@ static int activate(AVFilterContext *ctx)
             else
                 duration = av_rescale_q(frame->pts - s->reference_frame->pts, inlink->time_base, AV_TIME_BASE_Q);
 
-            frozen = is_frozen(s, s->reference_frame, frame);
+            frozen = is_frozen(ctx, s->reference_frame, frame);
             if (duration >= s->duration) {
                 if (!s->frozen)
                     set_meta(s, frame, "lavfi.freezedetect.freeze_start", av_ts2timestr(s->reference_frame->pts, &inlink->time_base));
@@ -217,7 +272,7 @@ const AVFilter ff_vf_freezedetect = {
     .priv_size     = sizeof(FreezeDetectContext),
     .priv_class    = &freezedetect_class,
     .uninit        = uninit,
-    .flags         = AVFILTER_FLAG_METADATA_ONLY,
+    .flags         = AVFILTER_FLAG_METADATA_ONLY | AVFILTER_FLAG_SLICE_THREADS,
     FILTER_INPUTS(freezedetect_inputs),
     FILTER_OUTPUTS(freezedetect_outputs),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
@@ -121,28 +121,14 @@ static void denoise_spatial(HQDN3DContext *s,
 }
 
 av_always_inline
-static int denoise_depth(HQDN3DContext *s,
-                         uint8_t *src, uint8_t *dst,
-                         uint16_t *line_ant, uint16_t **frame_ant_ptr,
-                         int w, int h, int sstride, int dstride,
-                         int16_t *spatial, int16_t *temporal, int depth)
+static void denoise_depth(HQDN3DContext *s,
+                          uint8_t *src, uint8_t *dst,
+                          uint16_t *line_ant, uint16_t *frame_ant,
+                          int w, int h, int sstride, int dstride,
+                          int16_t *spatial, int16_t *temporal, int depth)
 {
     // FIXME: For 16-bit depth, frame_ant could be a pointer to the previous
     // filtered frame rather than a separate buffer.
-    long x, y;
-    uint16_t *frame_ant = *frame_ant_ptr;
-    if (!frame_ant) {
-        uint8_t *frame_src = src;
-        *frame_ant_ptr = frame_ant = av_malloc_array(w, h*sizeof(uint16_t));
-        if (!frame_ant)
-            return AVERROR(ENOMEM);
-        for (y = 0; y < h; y++, src += sstride, frame_ant += w)
-            for (x = 0; x < w; x++)
-                frame_ant[x] = LOAD(x);
-        src = frame_src;
-        frame_ant = *frame_ant_ptr;
-    }
-
     if (spatial[0])
         denoise_spatial(s, src, dst, line_ant, frame_ant,
                         w, h, sstride, dstride, spatial, temporal, depth);
@@ -150,25 +136,90 @@ static int denoise_depth(HQDN3DContext *s,
         denoise_temporal(src, dst, frame_ant,
                          w, h, sstride, dstride, temporal, depth);
     emms_c();
-    return 0;
 }
 
-#define denoise(...)                                                          \
+/*
+ * With several threads, the spatial filter is split in two passes which are
+ * bit-exact with denoise_spatial(). The horizontal recursion only runs along
+ * a line, so it is done in slices of lines into hbuf. The vertical recursion
+ * and the temporal filter only run along a column, so they are done in
+ * slices of columns from hbuf.
+ */
+av_always_inline
+static void denoise_horizontal(uint8_t *src, uint16_t *hbuf,
+                               int w, int y0, int y1, int sstride,
+                               int16_t *spatial, int depth)
+{
+    long x, y;
+    uint32_t pixel_ant;
+
+    spatial += 256 << LUT_BITS;
+
+    src  += y0 * sstride;
+    hbuf += y0 * w;
+    for (y = y0; y < y1; y++) {
+        /* the first pixel is only filtered against itself on the first line */
+        pixel_ant = LOAD(0);
+        if (!y)
+            pixel_ant = lowpass(pixel_ant, pixel_ant, spatial, depth);
+        hbuf[0] = pixel_ant;
+        for (x = 1; x < w; x++)
+            hbuf[x] = pixel_ant = lowpass(pixel_ant, LOAD(x), spatial, depth);
+        src  += sstride;
+        hbuf += w;
+    }
+}
+
+av_always_inline
+static void denoise_vertical(uint8_t *dst, uint16_t *hbuf,
+                             uint16_t *line_ant, uint16_t *frame_ant,
+                             int w, int h, int x0, int x1, int dstride,
+                             int16_t *spatial, int16_t *temporal, int depth)
+{
+    long x, y;
+    uint32_t tmp;
+
+    spatial  += 256 << LUT_BITS;
+    temporal += 256 << LUT_BITS;
+
+    for (x = x0; x < x1; x++) {
+        line_ant[x]  = tmp = hbuf[x];
+        frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+        STORE(x, tmp);
+    }
+
+    for (y = 1; y < h; y++) {
+        dst       += dstride;
+        hbuf      += w;
+        frame_ant += w;
+        for (x = x0; x < x1; x++) {
+            line_ant[x]  = tmp = lowpass(line_ant[x], hbuf[x], spatial, depth);
+            frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+            STORE(x, tmp);
+        }
+    }
+}
+
+av_always_inline
+static void load_frame(uint8_t *src, uint16_t *frame_ant,
+                       int w, int h, int sstride, int depth)
+{
+    long x, y;
+
+    for (y = 0; y < h; y++, src += sstride, frame_ant += w)
+        for (x = 0; x < w; x++)
+            frame_ant[x] = LOAD(x);
+}
+
+#define CALL_DEPTH(func, ...)                                                 \
     do {                                                                      \
-        int ret = AVERROR_BUG;                                                \
         switch (s->depth) {                                                   \
-            case  8: ret = denoise_depth(__VA_ARGS__,  8); break;             \
-            case  9: ret = denoise_depth(__VA_ARGS__,  9); break;             \
-            case 10: ret = denoise_depth(__VA_ARGS__, 10); break;             \
-            case 12: ret = denoise_depth(__VA_ARGS__, 12); break;             \
-            case 14: ret = denoise_depth(__VA_ARGS__, 14); break;             \
-            case 16: ret = denoise_depth(__VA_ARGS__, 16); break;             \
-        }                                                                     \
-        if (ret < 0) {                                                        \
-            av_frame_free(&out);                                              \
-            if (!direct)                                                      \
-                av_frame_free(&in);                                           \
-            return ret;                                                       \
+            case  8: func(__VA_ARGS__,  8); break;                            \
+            case  9: func(__VA_ARGS__,  9); break;                            \
+            case 10: func(__VA_ARGS__, 10); break;                            \
+            case 12: func(__VA_ARGS__, 12); break;                            \
+            case 14: func(__VA_ARGS__, 14); break;                            \
+            case 16: func(__VA_ARGS__, 16); break;                            \
         }                                                                     \
     } while (0)
 
@@ -227,6 +278,9 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->frame_prev[0]);
     av_freep(&s->frame_prev[1]);
     av_freep(&s->frame_prev[2]);
+    av_freep(&s->hbuf[0]);
+    av_freep(&s->hbuf[1]);
+    av_freep(&s->hbuf[2]);
 }
 
 static const enum AVPixelFormat pix_fmts[] = {
@@ -263,11 +317,19 @@ static int config_input(AVFilterLink *inlink)
     s->hsub  = desc->log2_chroma_w;
     s->vsub  = desc->log2_chroma_h;
     s->depth = depth = desc->comp[0].depth;
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
 
     for (i = 0; i < 3; i++) {
         s->line[i] = av_malloc_array(inlink->w, sizeof(*s->line[i]));
         if (!s->line[i])
             return AVERROR(ENOMEM);
+        if (s->nb_threads > 1) {
+            s->hbuf[i] = av_malloc_array(AV_CEIL_RSHIFT(inlink->w, !!i * s->hsub),
+                                         AV_CEIL_RSHIFT(inlink->h, !!i * s->vsub) *
+                                         sizeof(*s->hbuf[i]));
+            if (!s->hbuf[i])
+                return AVERROR(ENOMEM);
+        }
     }
 
     for (i = 0; i < 4; i++) {
@@ -287,24 +349,77 @@ static int config_input(AVFilterLink *inlink)
 
 typedef struct ThreadData {
     AVFrame *in, *out;
-    int direct;
 } ThreadData;
 
 static int do_denoise(AVFilterContext *ctx, void *data, int job_nr, int n_jobs)
+{
+    HQDN3DContext *s = ctx->priv;
+    const ThreadData *td = data;
+
+    CALL_DEPTH(denoise_depth, s, td->in->data[job_nr], td->out->data[job_nr],
+               s->line[job_nr], s->frame_prev[job_nr],
+               AV_CEIL_RSHIFT(td->in->width,  (!!job_nr * s->hsub)),
+               AV_CEIL_RSHIFT(td->in->height, (!!job_nr * s->vsub)),
+               td->in->linesize[job_nr], td->out->linesize[job_nr],
+               s->coefs[job_nr ? CHROMA_SPATIAL : LUMA_SPATIAL],
+               s->coefs[job_nr ? CHROMA_TMP     : LUMA_TMP]);
+
+    return 0;
+}
+
+/* first pass: slices of lines, the whole temporal filter without spatial */
+static int denoise_lines(AVFilterContext *ctx, void *data, int job_nr, int n_jobs)
 {
     HQDN3DContext *s = ctx->priv;
     const ThreadData *td = data;
     AVFrame *out = td->out;
     AVFrame *in = td->in;
-    int direct = td->direct;
 
-    denoise(s, in->data[job_nr], out->data[job_nr],
-                s->line[job_nr], &s->frame_prev[job_nr],
-                AV_CEIL_RSHIFT(in->width,  (!!job_nr * s->hsub)),
-                AV_CEIL_RSHIFT(in->height, (!!job_nr * s->vsub)),
-                in->linesize[job_nr], out->linesize[job_nr],
-                s->coefs[job_nr ? CHROMA_SPATIAL : LUMA_SPATIAL],
-                s->coefs[job_nr ? CHROMA_TMP     : LUMA_TMP]);
+    for (int p = 0; p < 3; p++) {
+        const int w  = AV_CEIL_RSHIFT(in->width,  !!p * s->hsub);
+        const int h  = AV_CEIL_RSHIFT(in->height, !!p * s->vsub);
+        const int y0 = (h *  job_nr     ) / n_jobs;
+        const int y1 = (h * (job_nr + 1)) / n_jobs;
+        int16_t *spatial  = s->coefs[p ? CHROMA_SPATIAL : LUMA_SPATIAL];
+        int16_t *temporal = s->coefs[p ? CHROMA_TMP     : LUMA_TMP];
+
+        if (spatial[0])
+            CALL_DEPTH(denoise_horizontal, in->data[p], s->hbuf[p],
+                       w, y0, y1, in->linesize[p], spatial);
+        else
+            CALL_DEPTH(denoise_temporal, in->data[p] + y0 * in->linesize[p],
+                       out->data[p] + y0 * out->linesize[p],
+                       s->frame_prev[p] + y0 * w, w, y1 - y0,
+                       in->linesize[p], out->linesize[p], temporal);
+    }
+    emms_c();
+
+    return 0;
+}
+
+/* second pass: slices of columns, vertical spatial and temporal filter */
+static int denoise_columns(AVFilterContext *ctx, void *data, int job_nr, int n_jobs)
+{
+    HQDN3DContext *s = ctx->priv;
+    const ThreadData *td = data;
+    AVFrame *out = td->out;
+
+    for (int p = 0; p < 3; p++) {
+        const int w  = AV_CEIL_RSHIFT(td->in->width,  !!p * s->hsub);
+        const int h  = AV_CEIL_RSHIFT(td->in->height, !!p * s->vsub);
+        /* multiples of 16 columns to keep the slices on separate cache lines */
+        const int units = (w + 15) >> 4;
+        const int x0 = FFMIN(w, (units *  job_nr      / n_jobs) << 4);
+        const int x1 = FFMIN(w, (units * (job_nr + 1) / n_jobs) << 4);
+        int16_t *spatial  = s->coefs[p ? CHROMA_SPATIAL : LUMA_SPATIAL];
+        int16_t *temporal = s->coefs[p ? CHROMA_TMP     : LUMA_TMP];
+
+        if (spatial[0] && x0 < x1)
+            CALL_DEPTH(denoise_vertical, out->data[p], s->hbuf[p],
+                       s->line[p], s->frame_prev[p], w, h, x0, x1,
+                       out->linesize[p], spatial, temporal);
+    }
+    emms_c();
 
     return 0;
 }
@@ -313,6 +428,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx  = inlink->dst;
     AVFilterLink *outlink = ctx->outputs[0];
+    HQDN3DContext *s = ctx->priv;
 
     AVFrame *out;
     int direct = av_frame_is_writable(in) && !ctx->is_disabled;
@@ -330,11 +446,35 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         av_frame_copy_props(out, in);
     }
 
+    for (int p = 0; p < 3; p++) {
+        const int w = AV_CEIL_RSHIFT(in->width,  !!p * s->hsub);
+        const int h = AV_CEIL_RSHIFT(in->height, !!p * s->vsub);
+
+        if (s->frame_prev[p])
+            continue;
+        s->frame_prev[p] = av_malloc_array(w, h * sizeof(*s->frame_prev[p]));
+        if (!s->frame_prev[p]) {
+            if (!direct)
+                av_frame_free(&out);
+            av_frame_free(&in);
+            return AVERROR(ENOMEM);
+        }
+        CALL_DEPTH(load_frame, in->data[p], s->frame_prev[p], w, h, in->linesize[p]);
+    }
+
     td.in = in;
     td.out = out;
-    td.direct = direct;
-    /* one thread per plane */
-    ff_filter_execute(ctx, do_denoise, &td, NULL, 3);
+    if (s->nb_threads > 1) {
+        /* the second pass only runs on planes with a spatial filter */
+        const int nb_jobs = FFMIN(s->nb_threads, FFMAX(1, in->height / 16));
+
+        ff_filter_execute(ctx, denoise_lines,   &td, NULL, nb_jobs);
+        ff_filter_execute(ctx, denoise_columns, &td, NULL,
+                          FFMIN(s->nb_threads, FFMAX(1, in->width / 64)));
+    } else {
+        /* one job per plane */
+        ff_filter_execute(ctx, do_denoise, &td, NULL, 3);
+    }
 
     if (ctx->is_disabled) {
         av_frame_free(&out);
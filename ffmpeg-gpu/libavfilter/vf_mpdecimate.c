@@ -46,9 +46,15 @@ typedef struct DecimateContext {
     int drop_count;                ///< if positive: number of frames sequentially dropped
                                    ///< if negative: number of sequential frames which were not dropped
 
+    int step;                      ///< compare one block out of step in both directions
+
     int hsub, vsub;                ///< chroma subsampling values
     AVFrame *ref;                  ///< reference picture
     av_pixelutils_sad_fn sad;      ///< sum of absolute difference function
+
+    int nb_threads;
+    int *job_count;                ///< number of blocks above lo in each slice job,
+                                   ///< or -1 if the job found the planes different
 } DecimateContext;
 
 #define OFFSET(x) offsetof(DecimateContext, x)
@@ -60,45 +66,92 @@ static const AVOption mpdecimate_options[] = {
     { "hi",   "set high dropping threshold", OFFSET(hi), AV_OPT_TYPE_INT, {.i64=64*12}, INT_MIN, INT_MAX, FLAGS },
     { "lo",   "set low dropping threshold", OFFSET(lo), AV_OPT_TYPE_INT, {.i64=64*5}, INT_MIN, INT_MAX, FLAGS },
     { "frac", "set fraction dropping threshold",  OFFSET(frac), AV_OPT_TYPE_FLOAT, {.dbl=0.33}, 0, 1, FLAGS },
+    { "step", "set the block step of the comparison", OFFSET(step), AV_OPT_TYPE_INT, {.i64=1}, 1, 64, FLAGS },
     { NULL }
 };
 
 AVFILTER_DEFINE_CLASS(mpdecimate);
 
+typedef struct ThreadData {
+    uint8_t *cur, *ref;
+    int cur_linesize, ref_linesize;
+    int w, h;
+    int t;                         ///< threshold on the number of blocks above lo
+} ThreadData;
+
 /**
- * Return 1 if the two planes are different, 0 otherwise.
+ * Compare the 8x8 blocks of a band of block rows. The counts of the jobs
+ * only add up, so a job stops as soon as it alone tells that the planes
+ * are different.
  */
-static int diff_planes(AVFilterContext *ctx,
-                       uint8_t *cur, int cur_linesize,
-                       uint8_t *ref, int ref_linesize,
-                       int w, int h)
+static int diff_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     DecimateContext *decimate = ctx->priv;
-
+    ThreadData *td = arg;
+    const int step = 4 * decimate->step;
+    const int rows = td->h > 7 ? (td->h - 8) / step + 1 : 0;
+    const int start = (rows *  jobnr     ) / nb_jobs;
+    const int end   = (rows * (jobnr + 1)) / nb_jobs;
     int x, y;
     int d, c = 0;
-    int t = (w/16)*(h/16)*decimate->frac;
 
     /* compute difference for blocks of 8x8 bytes */
-    for (y = 0; y < h-7; y += 4) {
-        for (x = 8; x < w-7; x += 4) {
-            d = decimate->sad(cur + y*cur_linesize + x, cur_linesize,
-                              ref + y*ref_linesize + x, ref_linesize);
+    for (y = start * step; y < end * step; y += step) {
+        for (x = 8; x < td->w-7; x += step) {
+            d = decimate->sad(td->cur + y*td->cur_linesize + x, td->cur_linesize,
+                              td->ref + y*td->ref_linesize + x, td->ref_linesize);
             if (d > decimate->hi) {
                 av_log(ctx, AV_LOG_DEBUG, "%d>=hi ", d);
-                return 1;
+                c = -1;
+                goto end;
             }
             if (d > decimate->lo) {
                 c++;
-                if (c > t) {
-                    av_log(ctx, AV_LOG_DEBUG, "lo:%d>=%d ", c, t);
-                    return 1;
+                if (c > td->t) {
+                    av_log(ctx, AV_LOG_DEBUG, "lo:%d>=%d ", c, td->t);
+                    c = -1;
+                    goto end;
                 }
             }
         }
     }
+end:
+    emms_c();
+    decimate->job_count[jobnr] = c;
+    return 0;
+}
 
-    av_log(ctx, AV_LOG_DEBUG, "lo:%d<%d ", c, t);
+/**
+ * Return 1 if the two planes are different, 0 otherwise.
+ */
+static int diff_planes(AVFilterContext *ctx,
+                       uint8_t *cur, int cur_linesize,
+                       uint8_t *ref, int ref_linesize,
+                       int w, int h)
+{
+    DecimateContext *decimate = ctx->priv;
+    ThreadData td = {
+        .cur = cur, .cur_linesize = cur_linesize,
+        .ref = ref, .ref_linesize = ref_linesize,
+        .w = w, .h = h,
+        .t = (w/16)*(h/16)*decimate->frac / (decimate->step * decimate->step),
+    };
+    const int rows = h > 7 ? (h - 8) / (4 * decimate->step) + 1 : 0;
+    const int nb_jobs = FFMAX(1, FFMIN(decimate->nb_threads, rows));
+    int i, c = 0;
+
+    ff_filter_execute(ctx, diff_slice, &td, NULL, nb_jobs);
+    for (i = 0; i < nb_jobs; i++) {
+        if (decimate->job_count[i] < 0)
+            return 1;
+        c += decimate->job_count[i];
+    }
+    if (c > td.t) {
+        av_log(ctx, AV_LOG_DEBUG, "lo:%d>=%d ", c, td.t);
+        return 1;
+    }
+
+    av_log(ctx, AV_LOG_DEBUG, "lo:%d<%d ", c, td.t);
     return 0;
 }
 
@@ -131,13 +184,10 @@ static int decimate_frame(AVFilterContext *ctx,
                         cur->data[plane], cur->linesize[plane],
                         ref->data[plane], ref->linesize[plane],
                         AV_CEIL_RSHIFT(ref->width,  hsub),
-                        AV_CEIL_RSHIFT(ref->height, vsub))) {
-            emms_c();
+                        AV_CEIL_RSHIFT(ref->height, vsub)))
             return 0;
-        }
     }
 
-    emms_c();
     return 1;
 }
 
@@ -159,6 +209,7 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     DecimateContext *decimate = ctx->priv;
     av_frame_free(&decimate->ref);
+    av_freep(&decimate->job_count);
 }
 
 static const enum AVPixelFormat pix_fmts[] = {
@@ -185,6 +236,12 @@ static int config_input(AVFilterLink *inlink)
     decimate->hsub = pix_desc->log2_chroma_w;
     decimate->vsub = pix_desc->log2_chroma_h;
 
+    decimate->nb_threads = ff_filter_get_nb_threads(ctx);
+    av_freep(&decimate->job_count);
+    decimate->job_count = av_calloc(decimate->nb_threads, sizeof(*decimate->job_count));
+    if (!decimate->job_count)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -240,6 +297,7 @@ const AVFilter ff_vf_mpdecimate = {
     .uninit        = uninit,
     .priv_size     = sizeof(DecimateContext),
     .priv_class    = &mpdecimate_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
     FILTER_INPUTS(mpdecimate_inputs),
     FILTER_OUTPUTS(mpdecimate_outputs),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
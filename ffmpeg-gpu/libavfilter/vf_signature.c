@@ -96,6 +96,12 @@ static int config_input(AVFilterLink *inlink)
     }
     sc->w = inlink->w;
     sc->h = inlink->h;
+
+    /* first column and line of each of the 32x32 blocks of the integral image */
+    for (int i = 0; i <= 32; i++) {
+        sc->xbound[i] = (i * inlink->w + 31) / 32;
+        sc->ybound[i] = (i * inlink->h + 31) / 32;
+    }
     return 0;
 }
 
@@ -127,10 +133,73 @@ static uint64_t get_block_sum(StreamContext *sc, uint64_t intpic[32][32], const
     return sum;
 }
 
-static int cmp(const void *x, const void *y)
+/**
+ * @return the k-th smallest of the n values in a, reordering them
+ */
+static uint64_t select_kth(uint64_t *a, int n, int k)
 {
-    const uint64_t *a = x, *b = y;
-    return *a < *b ? -1 : ( *a > *b ? 1 : 0 );
+    int lo = 0, hi = n - 1;
+
+    while (lo < hi) {
+        uint64_t pivot = a[lo + (hi - lo) / 2];
+        int i = lo, j = hi;
+
+        while (i <= j) {
+            while (a[i] < pivot)
+                i++;
+            while (a[j] > pivot)
+                j--;
+            if (i <= j) {
+                FFSWAP(uint64_t, a[i], a[j]);
+                i++;
+                j--;
+            }
+        }
+        if (k <= j)
+            hi = j;
+        else if (k >= i)
+            lo = i;
+        else
+            break;
+    }
+    return a[k];
+}
+
+static uint32_t sum_pixels(const uint8_t *p, int n)
+{
+    uint32_t sum = 0;
+
+    for (int i = 0; i < n; i++)
+        sum += p[i];
+    return sum;
+}
+
+typedef struct ThreadData {
+    const AVFrame *picref;
+    const StreamContext *sc;
+    uint64_t (*intpic)[32];
+} ThreadData;
+
+/* sums the pixels of each block of a band of block lines */
+static int sum_blocks(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    const ThreadData *td = arg;
+    const StreamContext *sc = td->sc;
+    const int b0 = (32 *  jobnr     ) / nb_jobs;
+    const int b1 = (32 * (jobnr + 1)) / nb_jobs;
+
+    for (int i = b0; i < b1; i++) {
+        uint64_t *row = td->intpic[i];
+        const uint8_t *p = td->picref->data[0] + sc->ybound[i] * (ptrdiff_t)td->picref->linesize[0];
+
+        memset(row, 0, 32 * sizeof(*row));
+        for (int y = sc->ybound[i]; y < sc->ybound[i + 1]; y++) {
+            for (int j = 0; j < 32; j++)
+                row[j] += sum_pixels(p + sc->xbound[j], sc->xbound[j + 1] - sc->xbound[j]);
+            p += td->picref->linesize[0];
+        }
+    }
+    return 0;
 }
 
 /**
@@ -159,9 +228,9 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     uint8_t wordt2b[5] = { 0, 0, 0, 0, 0 }; /* word ternary to binary */
     uint64_t intpic[32][32];
     uint64_t rowcount;
-    uint8_t *p = picref->data[0];
-    int inti, intj;
-    int *intjlut;
+    int64_t elemsignature[SIGELEM_SIZE];
+    uint64_t sortsignature[SIGELEM_SIZE];
+    ThreadData td;
 
     uint64_t conflist[DIFFELEM_SIZE];
     int f = 0, g = 0, w = 0;
@@ -191,23 +260,11 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     fs->pts = picref->pts;
     fs->index = sc->lastindex++;
 
-    memset(intpic, 0, sizeof(uint64_t)*32*32);
-    intjlut = av_malloc_array(inlink->w, sizeof(int));
-    if (!intjlut)
-        return AVERROR(ENOMEM);
-    for (i = 0; i < inlink->w; i++) {
-        intjlut[i] = (i*32)/inlink->w;
-    }
-
-    for (i = 0; i < inlink->h; i++) {
-        inti = (i*32)/inlink->h;
-        for (j = 0; j < inlink->w; j++) {
-            intj = intjlut[j];
-            intpic[inti][intj] += p[j];
-        }
-        p += picref->linesize[0];
-    }
-    av_freep(&intjlut);
+    td.picref = picref;
+    td.sc     = sc;
+    td.intpic = intpic;
+    ff_filter_execute(ctx, sum_blocks, &td, NULL,
+                      FFMIN(32, ff_filter_get_nb_threads(ctx)));
 
     /* The following calculates a summed area table (intpic) and brings the numbers
      * in intpic to the same denominator.
@@ -249,17 +306,6 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
 
     for (i = 0; i < ELEMENT_COUNT; i++) {
         const ElemCat* elemcat = elements[i];
-        int64_t* elemsignature;
-        uint64_t* sortsignature;
-
-        elemsignature = av_malloc_array(elemcat->elem_count, sizeof(int64_t));
-        if (!elemsignature)
-            return AVERROR(ENOMEM);
-        sortsignature = av_malloc_array(elemcat->elem_count, sizeof(int64_t));
-        if (!sortsignature) {
-            av_freep(&elemsignature);
-            return AVERROR(ENOMEM);
-        }
 
         for (j = 0; j < elemcat->elem_count; j++) {
             blocksum = 0;
@@ -287,8 +333,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
         }
 
         /* get threshold */
-        qsort(sortsignature, elemcat->elem_count, sizeof(uint64_t), cmp);
-        th = sortsignature[(int) (elemcat->elem_count*0.333)];
+        th = select_kth(sortsignature, elemcat->elem_count, (int) (elemcat->elem_count*0.333));
 
         /* ternarize */
         for (j = 0; j < elemcat->elem_count; j++) {
@@ -308,13 +353,10 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
             }
             f++;
         }
-        av_freep(&elemsignature);
-        av_freep(&sortsignature);
     }
 
     /* confidence */
-    qsort(conflist, DIFFELEM_SIZE, sizeof(uint64_t), cmp);
-    fs->confidence = FFMIN(conflist[DIFFELEM_SIZE/2], 255);
+    fs->confidence = FFMIN(select_kth(conflist, DIFFELEM_SIZE, DIFFELEM_SIZE/2), 255);
 
     /* coarsesignature */
     if (sc->coarsecount == 0) {
@@ -679,6 +721,9 @@ static av_cold int init(AVFilterContext *ctx)
         sc->midcoarse = 0;
     }
 
+    if (sic->mode != MODE_OFF)
+        fill_l1distlut(sic->l1distlut);
+
     /* check filename */
     if (sic->nb_inputs > 1 && strlen(sic->filename) > 0 && av_get_frame_filename(tmp, sizeof(tmp), sic->filename, 0) == -1) {
         av_log(ctx, AV_LOG_ERROR, "The filename must contain %%d or %%0nd, if you have more than one input.\n");
@@ -758,5 +803,5 @@ const AVFilter ff_vf_signature = {
     FILTER_OUTPUTS(signature_outputs),
     .inputs        = NULL,
     FILTER_PIXFMTS_ARRAY(pix_fmts),
-    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
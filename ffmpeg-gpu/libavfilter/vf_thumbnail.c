@@ -33,6 +33,7 @@
 #include "internal.h"
 
 #define HIST_SIZE (3*256)
+#define HIST_WAYS 4
 
 struct thumb_frame {
     AVFrame *buf;               ///< cached frame
@@ -45,9 +46,17 @@ typedef struct ThumbContext {
     int n_frames;               ///< number of frames for analysis
     struct thumb_frame *frames; ///< the n_frames frames
     AVRational tb;              ///< copy of the input timebase to ease access
+    int step;                   ///< analyze one sample out of step in both directions
 
-    int planewidth[4];
-    int planeheight[4];
+    int nb_threads;
+    int *thread_histogram;      ///< HIST_WAYS histograms per slice job
+
+    /* the 3 histogram channels, in memory order */
+    int plane[3];
+    int offset[3];
+    int pixstep[3];
+    int width[3];
+    int height[3];
 } ThumbContext;
 
 #define OFFSET(x) offsetof(ThumbContext, x)
@@ -55,6 +64,7 @@ typedef struct ThumbContext {
 
 static const AVOption thumbnail_options[] = {
     { "n", "set the frames batch size", OFFSET(n_frames), AV_OPT_TYPE_INT, {.i64=100}, 2, INT_MAX, FLAGS },
+    { "step", "set the sampling step of the analysis", OFFSET(step), AV_OPT_TYPE_INT, {.i64=1}, 1, 64, FLAGS },
     { NULL }
 };
 
@@ -132,67 +142,78 @@ static AVFrame *get_best_frame(AVFilterContext *ctx)
     return picref;
 }
 
+/**
+ * Count one sample out of step of the rows [y0, y1) of a channel. Successive
+ * samples go to HIST_WAYS interleaved histograms, so that runs of identical
+ * values do not serialize on the increment of a single bin.
+ */
+static void update_histogram(int *hist, const uint8_t *p, ptrdiff_t linesize,
+                             int pixstep, int w, int y0, int y1, int step)
+{
+    const int xstep = pixstep * step;
+    const int nb_samples = (w + step - 1) / step;
+    int x, y;
+
+    y0 = (y0 + step - 1) / step * step;
+    p += y0 * linesize;
+    for (y = y0; y < y1; y += step) {
+        const uint8_t *q = p;
+
+        for (x = 0; x + 4 <= nb_samples; x += 4, q += 4 * xstep) {
+            hist[      q[0        ]]++;
+            hist[256 + q[    xstep]]++;
+            hist[512 + q[2 * xstep]]++;
+            hist[768 + q[3 * xstep]]++;
+        }
+        for (; x < nb_samples; x++, q += xstep)
+            hist[q[0]]++;
+        p += step * linesize;
+    }
+}
+
+static int do_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ThumbContext *s = ctx->priv;
+    AVFrame *frame = arg;
+    int *hist = s->thread_histogram + HIST_WAYS * HIST_SIZE * jobnr;
+
+    memset(hist, 0, HIST_WAYS * HIST_SIZE * sizeof(*hist));
+
+    for (int c = 0; c < 3; c++) {
+        const int slice_start = (s->height[c] *  jobnr   ) / nb_jobs;
+        const int slice_end   = (s->height[c] * (jobnr+1)) / nb_jobs;
+        int *chist = hist + HIST_WAYS * 256 * c;
+
+        update_histogram(chist, frame->data[s->plane[c]] + s->offset[c],
+                         frame->linesize[s->plane[c]], s->pixstep[c],
+                         s->width[c], slice_start, slice_end, s->step);
+
+        // fold the interleaved histograms into the first one
+        for (int i = 0; i < 256; i++)
+            chist[i] += chist[256 + i] + chist[512 + i] + chist[768 + i];
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
-    int i, j;
     AVFilterContext *ctx  = inlink->dst;
     ThumbContext *s   = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
     int *hist = s->frames[s->n].histogram;
-    const uint8_t *p = frame->data[0];
+    const int nb_jobs = FFMIN(inlink->h, s->nb_threads);
 
     // keep a reference of each frame
     s->frames[s->n].buf = frame;
 
     // update current frame histogram
-    switch (inlink->format) {
-    case AV_PIX_FMT_RGB24:
-    case AV_PIX_FMT_BGR24:
-        for (j = 0; j < inlink->h; j++) {
-            for (i = 0; i < inlink->w; i++) {
-                hist[0*256 + p[i*3    ]]++;
-                hist[1*256 + p[i*3 + 1]]++;
-                hist[2*256 + p[i*3 + 2]]++;
-            }
-            p += frame->linesize[0];
-        }
-        break;
-    case AV_PIX_FMT_RGB0:
-    case AV_PIX_FMT_BGR0:
-    case AV_PIX_FMT_RGBA:
-    case AV_PIX_FMT_BGRA:
-        for (j = 0; j < inlink->h; j++) {
-            for (i = 0; i < inlink->w; i++) {
-                hist[0*256 + p[i*4    ]]++;
-                hist[1*256 + p[i*4 + 1]]++;
-                hist[2*256 + p[i*4 + 2]]++;
-            }
-            p += frame->linesize[0];
-        }
-        break;
-    case AV_PIX_FMT_0RGB:
-    case AV_PIX_FMT_0BGR:
-    case AV_PIX_FMT_ARGB:
-    case AV_PIX_FMT_ABGR:
-        for (j = 0; j < inlink->h; j++) {
-            for (i = 0; i < inlink->w; i++) {
-                hist[0*256 + p[i*4 + 1]]++;
-                hist[1*256 + p[i*4 + 2]]++;
-                hist[2*256 + p[i*4 + 3]]++;
-            }
-            p += frame->linesize[0];
-        }
-        break;
-    default:
-        for (int plane = 0; plane < 3; plane++) {
-            const uint8_t *p = frame->data[plane];
-            for (j = 0; j < s->planeheight[plane]; j++) {
-                for (i = 0; i < s->planewidth[plane]; i++)
-                    hist[256*plane + p[i]]++;
-                p += frame->linesize[plane];
-            }
-        }
-        break;
+    ff_filter_execute(ctx, do_slice, frame, NULL, nb_jobs);
+    for (int j = 0; j < nb_jobs; j++) {
+        const int *thread_histogram = s->thread_histogram + HIST_WAYS * HIST_SIZE * j;
+        for (int c = 0; c < 3; c++)
+            for (int i = 0; i < 256; i++)
+                hist[256 * c + i] += thread_histogram[HIST_WAYS * 256 * c + i];
     }
 
     // no selection until the buffer of N frames is filled up
@@ -210,6 +231,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     for (i = 0; i < s->n_frames && s->frames && s->frames[i].buf; i++)
         av_frame_free(&s->frames[i].buf);
     av_freep(&s->frames);
+    av_freep(&s->thread_histogram);
 }
 
 static int request_frame(AVFilterLink *link)
@@ -234,12 +256,36 @@ static int config_props(AVFilterLink *inlink)
     AVFilterContext *ctx = inlink->dst;
     ThumbContext *s = ctx->priv;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+    int order[3] = { 0, 1, 2 };
 
     s->tb = inlink->time_base;
-    s->planewidth[1]  = s->planewidth[2]  = AV_CEIL_RSHIFT(inlink->w, desc->log2_chroma_w);
-    s->planewidth[0]  = s->planewidth[3]  = inlink->w;
-    s->planeheight[1] = s->planeheight[2] = AV_CEIL_RSHIFT(inlink->h, desc->log2_chroma_h);
-    s->planeheight[0] = s->planeheight[3] = inlink->h;
+
+    // walk the components in memory order, alpha is ignored
+    for (int i = 1; i < 3; i++) {
+        for (int j = i; j > 0; j--) {
+            const AVComponentDescriptor *a = &desc->comp[order[j - 1]];
+            const AVComponentDescriptor *b = &desc->comp[order[j]];
+            if (a->plane < b->plane || (a->plane == b->plane && a->offset < b->offset))
+                break;
+            FFSWAP(int, order[j - 1], order[j]);
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        const AVComponentDescriptor *comp = &desc->comp[order[c]];
+        const int chroma = order[c] == 1 || order[c] == 2;
+
+        s->plane[c]   = comp->plane;
+        s->offset[c]  = comp->offset;
+        s->pixstep[c] = comp->step;
+        s->width[c]   = chroma ? AV_CEIL_RSHIFT(inlink->w, desc->log2_chroma_w) : inlink->w;
+        s->height[c]  = chroma ? AV_CEIL_RSHIFT(inlink->h, desc->log2_chroma_h) : inlink->h;
+    }
+
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    av_freep(&s->thread_histogram);
+    s->thread_histogram = av_calloc(s->nb_threads, HIST_WAYS * HIST_SIZE * sizeof(*s->thread_histogram));
+    if (!s->thread_histogram)
+        return AVERROR(ENOMEM);
 
     return 0;
 }
@@ -257,6 +303,7 @@ static const enum AVPixelFormat pix_fmts[] = {
     AV_PIX_FMT_YUVJ440P, AV_PIX_FMT_YUVJ444P,
     AV_PIX_FMT_YUVJ411P,
     AV_PIX_FMT_YUVA420P, AV_PIX_FMT_YUVA422P, AV_PIX_FMT_YUVA444P,
+    AV_PIX_FMT_NV12, AV_PIX_FMT_NV21,
     AV_PIX_FMT_GBRP, AV_PIX_FMT_GBRAP,
     AV_PIX_FMT_NONE
 };
@@ -288,5 +335,6 @@ const AVFilter ff_vf_thumbnail = {
     FILTER_OUTPUTS(thumbnail_outputs),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .priv_class    = &thumbnail_class,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
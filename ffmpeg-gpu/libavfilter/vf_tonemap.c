@@ -51,41 +51,75 @@ enum TonemapAlgorithm {
     TONEMAP_MAX,
 };
 
+/*
+ * Lookup tables are indexed by the bits of a positive float: the exponent
+ * and the top LUT_BITS of the mantissa select the entry, the remaining
+ * mantissa bits interpolate linearly to the next one. This gives 256 entries
+ * per octave, with a constant relative step over the whole range.
+ */
+#define LUT_BITS       8
+#define LUT_FRAC_BITS  (23 - LUT_BITS)
+#define LUT_MIN_EXP    (-20)                /* below the 1e-6 signal floor */
+#define GAIN_MAX_EXP   8                    /* 25600 nits */
+#define GAIN_LUT_SIZE  ((GAIN_MAX_EXP - LUT_MIN_EXP) << LUT_BITS)
+#define TRC_LUT_SIZE   ((0 - LUT_MIN_EXP) << LUT_BITS)
+
+#define ST2084_M1 0.1593017578125f
+#define ST2084_M2 78.84375f
+#define ST2084_C1 0.8359375f
+#define ST2084_C2 18.8515625f
+#define ST2084_C3 18.6875f
+
 typedef struct TonemapContext {
     const AVClass *class;
 
     enum TonemapAlgorithm tonemap;
+    enum AVColorTransferCharacteristic trc;
+    enum AVColorSpace colorspace;
+    enum AVColorPrimaries primaries;
+    enum AVColorRange range;
+    enum AVPixelFormat format;
     double param;
     double desat;
     double peak;
 
     const AVLumaCoefficients *coeffs;
-} TonemapContext;
 
-static av_cold int init(AVFilterContext *ctx)
-{
-    TonemapContext *s = ctx->priv;
+    float *gain_lut;            ///< tone curve divided by the signal
+    double gain_lut_peak;       ///< peak the gain table was built for
+    int gain_lut_kink;          ///< entry holding a corner of the curve, or -1
+    float *pq_lut;              ///< SMPTE ST 2084 EOTF, relative to 100 nits
+    float *gamma_lut;           ///< inverse BT.1886 EOTF
+
+    /* per frame state for the YUV input and output paths */
+    int in_yuv, out_yuv;
+    int in_hsub, in_vsub, out_hsub, out_vsub, out_depth;
+    enum AVChromaLocation chroma_loc;
+    float yuv2rgb[3][3], rgb2yuv[3][3], rgb2rgb[3][3];
+    int rgb2rgb_passthrough;
+    float in_scale[3], in_offset[3], out_scale[3], out_offset[3];
+
+    float *buf;                 ///< two rows of RGB per job for YUV output
+    int buf_stride;
+} TonemapContext;
 
-    switch(s->tonemap) {
-    case TONEMAP_GAMMA:
-        if (isnan(s->param))
-            s->param = 1.8f;
-        break;
-    case TONEMAP_REINHARD:
-        if (!isnan(s->param))
-            s->param = (1.0f - s->param) / s->param;
-        break;
-    case TONEMAP_MOBIUS:
-        if (isnan(s->param))
-            s->param = 0.3f;
-        break;
-    }
+static const enum AVPixelFormat in_pix_fmts[] = {
+    AV_PIX_FMT_GBRPF32, AV_PIX_FMT_GBRAPF32,
+    AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_NONE
+};
 
-    if (isnan(s->param))
-        s->param = 1.0f;
+static const enum AVPixelFormat float_pix_fmts[] = {
+    AV_PIX_FMT_GBRPF32, AV_PIX_FMT_GBRAPF32,
+    AV_PIX_FMT_NONE
+};
 
-    return 0;
-}
+static const enum AVPixelFormat out_pix_fmts[] = {
+    AV_PIX_FMT_GBRPF32, AV_PIX_FMT_GBRAPF32,
+    AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV444P,
+    AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_NONE
+};
 
 static float hable(float in)
 {
@@ -106,39 +140,8 @@ static float mobius(float in, float j, double peak)
     return (b * b + 2.0f * b * j + j * j) / (b - a) * (in + a) / (in + b);
 }
 
-#define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
-static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
-                    const AVPixFmtDescriptor *desc, int x, int y, double peak)
+static float tonemap_curve(const TonemapContext *s, float sig, double peak)
 {
-    int map[3] = { desc->comp[0].plane, desc->comp[1].plane, desc->comp[2].plane };
-    const float *r_in = (const float *)(in->data[map[0]] + x * desc->comp[map[0]].step + y * in->linesize[map[0]]);
-    const float *g_in = (const float *)(in->data[map[1]] + x * desc->comp[map[1]].step + y * in->linesize[map[1]]);
-    const float *b_in = (const float *)(in->data[map[2]] + x * desc->comp[map[2]].step + y * in->linesize[map[2]]);
-    float *r_out = (float *)(out->data[map[0]] + x * desc->comp[map[0]].step + y * out->linesize[map[0]]);
-    float *g_out = (float *)(out->data[map[1]] + x * desc->comp[map[1]].step + y * out->linesize[map[1]]);
-    float *b_out = (float *)(out->data[map[2]] + x * desc->comp[map[2]].step + y * out->linesize[map[2]]);
-    float sig, sig_orig;
-
-    /* load values */
-    *r_out = *r_in;
-    *g_out = *g_in;
-    *b_out = *b_in;
-
-    /* desaturate to prevent unnatural colors */
-    if (s->desat > 0) {
-        float luma = av_q2d(s->coeffs->cr) * *r_in + av_q2d(s->coeffs->cg) * *g_in + av_q2d(s->coeffs->cb) * *b_in;
-        float overbright = FFMAX(luma - s->desat, 1e-6) / FFMAX(luma, 1e-6);
-        *r_out = MIX(*r_in, luma, overbright);
-        *g_out = MIX(*g_in, luma, overbright);
-        *b_out = MIX(*b_in, luma, overbright);
-    }
-
-    /* pick the brightest component, reducing the value range as necessary
-     * to keep the entire signal in range and preventing discoloration due to
-     * out-of-bounds clipping */
-    sig = FFMAX(FFMAX3(*r_out, *g_out, *b_out), 1e-6);
-    sig_orig = sig;
-
     switch(s->tonemap) {
     default:
     case TONEMAP_NONE:
@@ -164,17 +167,335 @@ static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
         sig = mobius(sig, s->param, peak);
         break;
     }
+    return sig;
+}
+
+static float pq_eotf(float x)
+{
+    float p = powf(av_clipf(x, 0.0f, 1.0f), 1.0f / ST2084_M2);
+    return powf(FFMAX(p - ST2084_C1, 0.0f) / (ST2084_C2 - ST2084_C3 * p),
+                1.0f / ST2084_M1) * (10000.0f / REFERENCE_WHITE);
+}
+
+static float bt1886_inverse_eotf(float x)
+{
+    return powf(av_clipf(x, 0.0f, 1.0f), 1.0f / 2.4f);
+}
+
+/* table entry of x, or -1 if x is outside of [2^LUT_MIN_EXP, 2^max_exp) */
+static av_always_inline int lut_index(float x, int size, float *frac)
+{
+    unsigned bits = av_float2int(x);
+    unsigned idx  = (bits >> LUT_FRAC_BITS) - ((127 + LUT_MIN_EXP) << LUT_BITS);
+
+    *frac = (bits & ((1 << LUT_FRAC_BITS) - 1)) * (1.0f / (1 << LUT_FRAC_BITS));
+    return idx < size ? idx : -1;
+}
+
+static av_always_inline float lut_value(int idx)
+{
+    return av_int2float((idx + ((127 + LUT_MIN_EXP) << LUT_BITS)) << LUT_FRAC_BITS);
+}
+
+static av_always_inline float lut_interp(const float *lut, int idx, float frac)
+{
+    return lut[idx] + frac * (lut[idx + 1] - lut[idx]);
+}
+
+static int fill_lut(float **lut, int size, float (*fn)(float))
+{
+    if (!*lut && !(*lut = av_malloc_array(size + 1, sizeof(**lut))))
+        return AVERROR(ENOMEM);
+    for (int i = 0; i <= size; i++)
+        (*lut)[i] = fn(lut_value(i));
+    return 0;
+}
+
+static int build_gain_lut(TonemapContext *s, double peak)
+{
+    float corner = -1.0f, frac;
+
+    if (!s->gain_lut &&
+        !(s->gain_lut = av_malloc_array(GAIN_LUT_SIZE + 1, sizeof(*s->gain_lut))))
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i <= GAIN_LUT_SIZE; i++) {
+        float x = lut_value(i);
+        s->gain_lut[i] = tonemap_curve(s, x, peak) / x;
+    }
+
+    /* interpolating across a corner of the curve is not accurate enough,
+     * the entry containing it is evaluated directly */
+    switch (s->tonemap) {
+    case TONEMAP_GAMMA:  corner = 0.05f;           break;
+    case TONEMAP_CLIP:   corner = 1.0f / s->param; break;
+    case TONEMAP_MOBIUS: corner = s->param;        break;
+    }
+    s->gain_lut_kink = corner > 0 ? lut_index(corner, GAIN_LUT_SIZE, &frac) : -1;
+    s->gain_lut_peak = peak;
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    TonemapContext *s = ctx->priv;
+    int ret;
+
+    switch(s->tonemap) {
+    case TONEMAP_GAMMA:
+        if (isnan(s->param))
+            s->param = 1.8f;
+        break;
+    case TONEMAP_REINHARD:
+        if (!isnan(s->param))
+            s->param = (1.0f - s->param) / s->param;
+        break;
+    case TONEMAP_MOBIUS:
+        if (isnan(s->param))
+            s->param = 0.3f;
+        break;
+    }
+
+    if (isnan(s->param))
+        s->param = 1.0f;
+
+    if (s->format != AV_PIX_FMT_NONE) {
+        int i;
+        for (i = 0; out_pix_fmts[i] != AV_PIX_FMT_NONE; i++)
+            if (out_pix_fmts[i] == s->format)
+                break;
+        if (out_pix_fmts[i] == AV_PIX_FMT_NONE) {
+            av_log(ctx, AV_LOG_ERROR, "Unsupported output format '%s'\n",
+                   av_get_pix_fmt_name(s->format));
+            return AVERROR(EINVAL);
+        }
+    }
+    if (s->trc != AVCOL_TRC_BT709 && s->trc != AVCOL_TRC_BT2020_10) {
+        av_log(ctx, AV_LOG_ERROR, "Unsupported output transfer '%s'\n",
+               av_color_transfer_name(s->trc));
+        return AVERROR(EINVAL);
+    }
+
+    if ((ret = fill_lut(&s->pq_lut, TRC_LUT_SIZE, pq_eotf)) < 0 ||
+        (ret = fill_lut(&s->gamma_lut, TRC_LUT_SIZE, bt1886_inverse_eotf)) < 0)
+        return ret;
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    TonemapContext *s = ctx->priv;
+
+    av_freep(&s->gain_lut);
+    av_freep(&s->pq_lut);
+    av_freep(&s->gamma_lut);
+    av_freep(&s->buf);
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    TonemapContext *s = ctx->priv;
+    const enum AVPixelFormat out_fmt[] = { s->format, AV_PIX_FMT_NONE };
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(s->format);
+    int ret;
+
+    /* YUV input must be PQ coded, so it is only taken directly when YUV
+     * output is requested, otherwise it is converted to float RGB upstream */
+    ret = ff_formats_ref(ff_make_format_list(desc && !(desc->flags & AV_PIX_FMT_FLAG_RGB) ?
+                                             in_pix_fmts : float_pix_fmts),
+                         &ctx->inputs[0]->outcfg.formats);
+    if (ret < 0)
+        return ret;
+
+    /* without an explicit output format the output stays float RGB */
+    return ff_formats_ref(ff_make_format_list(s->format == AV_PIX_FMT_NONE ?
+                                              float_pix_fmts : out_fmt),
+                          &ctx->outputs[0]->incfg.formats);
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    TonemapContext *s = ctx->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(outlink->format);
+    int nb_jobs = ff_filter_get_nb_threads(ctx);
+
+    av_freep(&s->buf);
+    if (desc->flags & AV_PIX_FMT_FLAG_RGB)
+        return 0;
+
+    s->buf_stride = FFALIGN(ctx->inputs[0]->w, 16);
+    s->buf = av_malloc_array(nb_jobs * 6, s->buf_stride * sizeof(*s->buf));
+    if (!s->buf)
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+static av_always_inline float linearize(const TonemapContext *s, float x)
+{
+    float frac;
+    int idx = lut_index(x, TRC_LUT_SIZE, &frac);
+    return idx >= 0 ? lut_interp(s->pq_lut, idx, frac) : pq_eotf(x);
+}
+
+static av_always_inline float delinearize(const TonemapContext *s, float x)
+{
+    float frac;
+    int idx = lut_index(x, TRC_LUT_SIZE, &frac);
+    return idx >= 0 ? lut_interp(s->gamma_lut, idx, frac) : bt1886_inverse_eotf(x);
+}
+
+/*
+ * FFMAX(x, 1e-6f) on the bits of x: positive floats order like their bits as
+ * signed integers and negative ones are below the floor anyway. Unlike the
+ * float comparison this compiles to conditional moves, the float version
+ * branches on which component is the largest.
+ */
+#define SIG_FLOOR_BITS 0x358637bd
+static av_always_inline int32_t floor_bits(float x)
+{
+    return FFMAX((int32_t)av_float2int(x), SIG_FLOOR_BITS);
+}
+
+#define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
+static void tonemap_row(const TonemapContext *s, float *dst[3],
+                        const float *src[3], int w, double peak)
+{
+    const float cr = av_q2d(s->coeffs->cr);
+    const float cg = av_q2d(s->coeffs->cg);
+    const float cb = av_q2d(s->coeffs->cb);
+    const float desat = s->desat;
+    const float *lut = s->gain_lut;
+    const int kink = s->gain_lut_kink;
+
+    for (int x = 0; x < w; x++) {
+        float r = src[0][x], g = src[1][x], b = src[2][x];
+        float sig, gain, frac;
+        int32_t bits;
+        int idx;
+
+        /* desaturate to prevent unnatural colors */
+        if (desat > 0) {
+            float luma = cr * r + cg * g + cb * b;
+            float overbright = av_int2float(floor_bits(luma - desat)) /
+                               av_int2float(floor_bits(luma));
+            r = MIX(r, luma, overbright);
+            g = MIX(g, luma, overbright);
+            b = MIX(b, luma, overbright);
+        }
+
+        /* pick the brightest component, reducing the value range as necessary
+         * to keep the entire signal in range and preventing discoloration due to
+         * out-of-bounds clipping */
+        bits = FFMAX3(floor_bits(r), floor_bits(g), floor_bits(b));
+        sig  = av_int2float(bits);
+
+        idx = lut_index(sig, GAIN_LUT_SIZE, &frac);
+        if (idx >= 0 && idx != kink)
+            gain = lut_interp(lut, idx, frac);
+        else
+            gain = tonemap_curve(s, sig, peak) / sig;
+
+        /* apply the computed scale factor to the color,
+         * linearly to prevent discoloration */
+        dst[0][x] = r * gain;
+        dst[1][x] = g * gain;
+        dst[2][x] = b * gain;
+    }
+
+    if (!s->rgb2rgb_passthrough) {
+        const float (*m)[3] = s->rgb2rgb;
+        for (int x = 0; x < w; x++) {
+            float r = dst[0][x], g = dst[1][x], b = dst[2][x];
+            dst[0][x] = m[0][0] * r + m[0][1] * g + m[0][2] * b;
+            dst[1][x] = m[1][0] * r + m[1][1] * g + m[1][2] * b;
+            dst[2][x] = m[2][0] * r + m[2][1] * g + m[2][2] * b;
+        }
+    }
+}
+
+/* PQ coded YUV to linear RGB */
+static void load_yuv_row(const TonemapContext *s, const AVFrame *in, int y,
+                         float *rgb[3])
+{
+    const uint16_t *py = (const uint16_t *)(in->data[0] + y * in->linesize[0]);
+    const uint16_t *pu = (const uint16_t *)(in->data[1] + (y >> s->in_vsub) * in->linesize[1]);
+    const uint16_t *pv = (const uint16_t *)(in->data[2] + (y >> s->in_vsub) * in->linesize[2]);
+    const float (*m)[3] = s->yuv2rgb;
+    const int hsub = s->in_hsub;
+
+    for (int x = 0; x < in->width; x++) {
+        float luma = py[x]         * s->in_scale[0] + s->in_offset[0];
+        float u    = pu[x >> hsub] * s->in_scale[1] + s->in_offset[1];
+        float v    = pv[x >> hsub] * s->in_scale[2] + s->in_offset[2];
+        rgb[0][x] = linearize(s, m[0][0] * luma + m[0][1] * u + m[0][2] * v);
+        rgb[1][x] = linearize(s, m[1][0] * luma + m[1][1] * u + m[1][2] * v);
+        rgb[2][x] = linearize(s, m[2][0] * luma + m[2][1] * u + m[2][2] * v);
+    }
+}
+
+static av_always_inline void put_pixel(uint8_t *row, int x, float v, int depth)
+{
+    int code = av_clipf(v, 0.0f, (1 << depth) - 1) + 0.5f;
+
+    if (depth > 8)
+        ((uint16_t *)row)[x] = code;
+    else
+        row[x] = code;
+}
+
+/* linear RGB to gamma coded YUV, rows y and y + 1 when subsampled */
+static void store_yuv_rows(const TonemapContext *s, AVFrame *out, int y,
+                           int nb_rows, float *rgb[2][3])
+{
+    const float (*m)[3] = s->rgb2yuv;
+    const int depth = s->out_depth, w = out->width;
+    const enum AVChromaLocation loc = s->chroma_loc;
+    const int avg_x = loc == AVCHROMA_LOC_CENTER || loc == AVCHROMA_LOC_TOP ||
+                      loc == AVCHROMA_LOC_BOTTOM;
+    const int avg_y = loc == AVCHROMA_LOC_UNSPECIFIED || loc == AVCHROMA_LOC_LEFT ||
+                      loc == AVCHROMA_LOC_CENTER;
+    const int row_c = (loc == AVCHROMA_LOC_BOTTOMLEFT || loc == AVCHROMA_LOC_BOTTOM) &&
+                      nb_rows > 1;
+    uint8_t *pu = out->data[1] + (y >> s->out_vsub) * out->linesize[1];
+    uint8_t *pv = out->data[2] + (y >> s->out_vsub) * out->linesize[2];
+
+    for (int i = 0; i < nb_rows; i++) {
+        uint8_t *py = out->data[0] + (y + i) * out->linesize[0];
+        for (int x = 0; x < w; x++) {
+            float r = rgb[i][0][x] = delinearize(s, rgb[i][0][x]);
+            float g = rgb[i][1][x] = delinearize(s, rgb[i][1][x]);
+            float b = rgb[i][2][x] = delinearize(s, rgb[i][2][x]);
+            put_pixel(py, x, (m[0][0] * r + m[0][1] * g + m[0][2] * b) *
+                             s->out_scale[0] + s->out_offset[0], depth);
+        }
+    }
 
-    /* apply the computed scale factor to the color,
-     * linearly to prevent discoloration */
-    *r_out *= sig / sig_orig;
-    *g_out *= sig / sig_orig;
-    *b_out *= sig / sig_orig;
+    for (int x = 0; x < w; x += 1 << s->out_hsub) {
+        float c[3];
+
+        if (!s->out_hsub) {
+            c[0] = rgb[0][0][x];
+            c[1] = rgb[0][1][x];
+            c[2] = rgb[0][2][x];
+        } else {
+            const int x1 = avg_x && x + 1 < w ? x + 1 : x;
+            const int r1 = avg_y && nb_rows > 1 ? 1 : row_c;
+            for (int p = 0; p < 3; p++)
+                c[p] = 0.25f * (rgb[row_c][p][x] + rgb[row_c][p][x1] +
+                                rgb[r1][p][x] + rgb[r1][p][x1]);
+        }
+        put_pixel(pu, x >> s->out_hsub, (m[1][0] * c[0] + m[1][1] * c[1] + m[1][2] * c[2]) *
+                                        s->out_scale[1] + s->out_offset[1], depth);
+        put_pixel(pv, x >> s->out_hsub, (m[2][0] * c[0] + m[2][1] * c[1] + m[2][2] * c[2]) *
+                                        s->out_scale[2] + s->out_offset[2], depth);
+    }
 }
 
 typedef struct ThreadData {
     AVFrame *in, *out;
-    const AVPixFmtDescriptor *desc;
+    const AVPixFmtDescriptor *desc, *odesc;
     double peak;
 } ThreadData;
 
@@ -185,13 +506,167 @@ static int tonemap_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs
     AVFrame *in = td->in;
     AVFrame *out = td->out;
     const AVPixFmtDescriptor *desc = td->desc;
-    const int slice_start = (in->height * jobnr) / nb_jobs;
-    const int slice_end = (in->height * (jobnr+1)) / nb_jobs;
+    const AVPixFmtDescriptor *odesc = td->odesc;
+    /* slices start on a chroma row */
+    const int step = 1 << FFMAX(s->in_vsub, s->out_vsub);
+    const int groups = (in->height + step - 1) / step;
+    const int slice_start = (groups * jobnr / nb_jobs) * step;
+    const int slice_end = FFMIN((groups * (jobnr+1) / nb_jobs) * step, in->height);
+    int map[3]  = {  desc->comp[0].plane,  desc->comp[1].plane,  desc->comp[2].plane };
+    int omap[3] = { odesc->comp[0].plane, odesc->comp[1].plane, odesc->comp[2].plane };
+    float *buf = s->out_yuv ? s->buf + jobnr * 6 * s->buf_stride : NULL;
     double peak = td->peak;
 
-    for (int y = slice_start; y < slice_end; y++)
-        for (int x = 0; x < out->width; x++)
-            tonemap(s, out, in, desc, x, y, peak);
+    for (int y = slice_start; y < slice_end; y += step) {
+        const int nb_rows = FFMIN(step, slice_end - y);
+        float *rgb[2][3];
+
+        for (int i = 0; i < nb_rows; i++) {
+            const float *src[3];
+
+            for (int p = 0; p < 3; p++)
+                rgb[i][p] = s->out_yuv ? buf + (i * 3 + p) * s->buf_stride :
+                            (float *)(out->data[omap[p]] + (y + i) * out->linesize[omap[p]]);
+
+            if (s->in_yuv) {
+                load_yuv_row(s, in, y + i, rgb[i]);
+                for (int p = 0; p < 3; p++)
+                    src[p] = rgb[i][p];
+            } else {
+                for (int p = 0; p < 3; p++)
+                    src[p] = (const float *)(in->data[map[p]] + (y + i) * in->linesize[map[p]]);
+            }
+            tonemap_row(s, rgb[i], src, out->width, peak);
+        }
+
+        if (s->out_yuv)
+            store_yuv_rows(s, out, y, nb_rows, rgb);
+    }
+
+    return 0;
+}
+
+static void get_range_scale(enum AVColorRange range, int depth,
+                            float scale[3], float offset[3])
+{
+    if (range == AVCOL_RANGE_JPEG) {
+        scale[0] = scale[1] = scale[2] = (1 << depth) - 1;
+        offset[0] = 0;
+        offset[1] = offset[2] = 1 << (depth - 1);
+    } else {
+        scale[0]  = 219 << (depth - 8);
+        offset[0] =  16 << (depth - 8);
+        scale[1]  = scale[2]  = 224 << (depth - 8);
+        offset[1] = offset[2] = 128 << (depth - 8);
+    }
+}
+
+static int get_rgb2rgb_matrix(enum AVColorPrimaries in, enum AVColorPrimaries out,
+                              double rgb2rgb[3][3]) {
+    double rgb2xyz[3][3], xyz2rgb[3][3];
+
+    const AVColorPrimariesDesc *in_primaries = av_csp_primaries_desc_from_id(in);
+    const AVColorPrimariesDesc *out_primaries = av_csp_primaries_desc_from_id(out);
+
+    if (!in_primaries || !out_primaries)
+        return AVERROR(EINVAL);
+
+    ff_fill_rgb2xyz_table(&out_primaries->prim, &out_primaries->wp, rgb2xyz);
+    ff_matrix_invert_3x3(rgb2xyz, xyz2rgb);
+    ff_fill_rgb2xyz_table(&in_primaries->prim, &in_primaries->wp, rgb2xyz);
+    ff_matrix_mul_3x3(rgb2rgb, rgb2xyz, xyz2rgb);
+
+    return 0;
+}
+
+static void copy_matrix(float dst[3][3], const double src[3][3])
+{
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            dst[i][j] = src[i][j];
+}
+
+/* set up the YUV conversions and the output color properties */
+static int config_frame(AVFilterContext *ctx, AVFrame *out, const AVFrame *in,
+                        const AVPixFmtDescriptor *desc,
+                        const AVPixFmtDescriptor *odesc)
+{
+    TonemapContext *s = ctx->priv;
+    double m[3][3], rgb2yuv[3][3];
+
+    s->in_yuv   = !(desc->flags & AV_PIX_FMT_FLAG_RGB);
+    s->out_yuv  = !(odesc->flags & AV_PIX_FMT_FLAG_RGB);
+    s->in_hsub  = s->in_yuv  ? desc->log2_chroma_w  : 0;
+    s->in_vsub  = s->in_yuv  ? desc->log2_chroma_h  : 0;
+    s->out_hsub = s->out_yuv ? odesc->log2_chroma_w : 0;
+    s->out_vsub = s->out_yuv ? odesc->log2_chroma_h : 0;
+    s->out_depth = odesc->comp[0].depth;
+
+    if (s->in_yuv) {
+        const AVLumaCoefficients *coeffs;
+        enum AVColorSpace spc = in->colorspace;
+
+        if (in->color_trc != AVCOL_TRC_SMPTE2084) {
+            av_log(ctx, AV_LOG_ERROR, "Unsupported input transfer '%s', "
+                   "YUV input must be SMPTE ST 2084 coded\n",
+                   av_color_transfer_name(in->color_trc));
+            return AVERROR(ENOSYS);
+        }
+        if (!(coeffs = av_csp_luma_coeffs_from_avcsp(spc)) || spc == AVCOL_SPC_RGB) {
+            av_log(ctx, AV_LOG_WARNING, "Missing or unsupported input color space, "
+                   "assuming bt2020nc\n");
+            spc = AVCOL_SPC_BT2020_NCL;
+            coeffs = av_csp_luma_coeffs_from_avcsp(spc);
+        }
+        ff_fill_rgb2yuv_table(coeffs, rgb2yuv);
+        ff_matrix_invert_3x3(rgb2yuv, m);
+        copy_matrix(s->yuv2rgb, m);
+        get_range_scale(in->color_range, desc->comp[0].depth,
+                        s->in_scale, s->in_offset);
+        for (int i = 0; i < 3; i++) {
+            s->in_scale[i]  = 1.0f / s->in_scale[i];
+            s->in_offset[i] = -s->in_offset[i] * s->in_scale[i];
+        }
+        out->color_trc = AVCOL_TRC_LINEAR;
+        out->colorspace = spc;
+    }
+
+    s->rgb2rgb_passthrough = 1;
+    if (s->primaries != -1 && s->primaries != in->color_primaries) {
+        if (get_rgb2rgb_matrix(in->color_primaries, s->primaries, m) < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Unsupported primaries conversion from %s to %s\n",
+                   av_color_primaries_name(in->color_primaries),
+                   av_color_primaries_name(s->primaries));
+            return AVERROR(ENOSYS);
+        }
+        copy_matrix(s->rgb2rgb, m);
+        s->rgb2rgb_passthrough = 0;
+        out->color_primaries = s->primaries;
+    }
+
+    if (s->out_yuv) {
+        const AVLumaCoefficients *coeffs;
+
+        if (s->colorspace != -1)
+            out->colorspace = s->colorspace;
+        coeffs = av_csp_luma_coeffs_from_avcsp(out->colorspace);
+        if (!coeffs || out->colorspace == AVCOL_SPC_RGB) {
+            out->colorspace = AVCOL_SPC_BT709;
+            coeffs = av_csp_luma_coeffs_from_avcsp(out->colorspace);
+        }
+        ff_fill_rgb2yuv_table(coeffs, rgb2yuv);
+        copy_matrix(s->rgb2yuv, rgb2yuv);
+
+        if (s->range != -1)
+            out->color_range = s->range;
+        else if (!s->in_yuv || out->color_range == AVCOL_RANGE_UNSPECIFIED)
+            out->color_range = AVCOL_RANGE_MPEG;
+        get_range_scale(out->color_range, s->out_depth,
+                        s->out_scale, s->out_offset);
+
+        out->color_trc = s->trc;
+        s->chroma_loc = out->chroma_location;
+    }
 
     return 0;
 }
@@ -227,11 +702,13 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     }
 
     /* input and output transfer will be linear */
-    if (in->color_trc == AVCOL_TRC_UNSPECIFIED) {
-        av_log(s, AV_LOG_WARNING, "Untagged transfer, assuming linear light\n");
-        out->color_trc = AVCOL_TRC_LINEAR;
-    } else if (in->color_trc != AVCOL_TRC_LINEAR)
-        av_log(s, AV_LOG_WARNING, "Tonemapping works on linear light only\n");
+    if (desc->flags & AV_PIX_FMT_FLAG_RGB) {
+        if (in->color_trc == AVCOL_TRC_UNSPECIFIED) {
+            av_log(s, AV_LOG_WARNING, "Untagged transfer, assuming linear light\n");
+            out->color_trc = AVCOL_TRC_LINEAR;
+        } else if (in->color_trc != AVCOL_TRC_LINEAR)
+            av_log(s, AV_LOG_WARNING, "Tonemapping works on linear light only\n");
+    }
 
     /* read peak from side data if not passed in */
     if (!peak) {
@@ -250,11 +727,21 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         av_log(s, AV_LOG_WARNING, "desaturation is disabled\n");
         s->desat = 0;
     }
+    if (!s->coeffs)
+        s->coeffs = av_csp_luma_coeffs_from_avcsp(AVCOL_SPC_BT709);
+
+    if ((ret = config_frame(ctx, out, in, desc, odesc)) < 0 ||
+        (peak != s->gain_lut_peak && (ret = build_gain_lut(s, peak)) < 0)) {
+        av_frame_free(&in);
+        av_frame_free(&out);
+        return ret;
+    }
 
     /* do the tone map */
     td.out = out;
     td.in = in;
     td.desc = desc;
+    td.odesc = odesc;
     td.peak = peak;
     ff_filter_execute(ctx, tonemap_slice, &td, NULL,
                       FFMIN(in->height, ff_filter_get_nb_threads(ctx)));
@@ -291,6 +778,25 @@ static const AVOption tonemap_options[] = {
     {     "reinhard", 0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_REINHARD},          0, 0, FLAGS, "tonemap" },
     {     "hable",    0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_HABLE},             0, 0, FLAGS, "tonemap" },
     {     "mobius",   0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_MOBIUS},            0, 0, FLAGS, "tonemap" },
+    { "transfer", "set transfer characteristic", OFFSET(trc), AV_OPT_TYPE_INT, {.i64 = AVCOL_TRC_BT709}, -1, INT_MAX, FLAGS, "transfer" },
+    { "t",        "set transfer characteristic", OFFSET(trc), AV_OPT_TYPE_INT, {.i64 = AVCOL_TRC_BT709}, -1, INT_MAX, FLAGS, "transfer" },
+    {     "bt709",            0,       0,                 AV_OPT_TYPE_CONST, {.i64 = AVCOL_TRC_BT709},         0, 0, FLAGS, "transfer" },
+    {     "bt2020",           0,       0,                 AV_OPT_TYPE_CONST, {.i64 = AVCOL_TRC_BT2020_10},     0, 0, FLAGS, "transfer" },
+    { "matrix", "set colorspace matrix", OFFSET(colorspace), AV_OPT_TYPE_INT, {.i64 = -1}, -1, INT_MAX, FLAGS, "matrix" },
+    { "m",      "set colorspace matrix", OFFSET(colorspace), AV_OPT_TYPE_INT, {.i64 = -1}, -1, INT_MAX, FLAGS, "matrix" },
+    {     "bt709",            0,       0,                 AV_OPT_TYPE_CONST, {.i64 = AVCOL_SPC_BT709},         0, 0, FLAGS, "matrix" },
+    {     "bt2020",           0,       0,                 AV_OPT_TYPE_CONST, {.i64 = AVCOL_SPC_BT2020_NCL},    0, 0, FLAGS, "matrix" },
+    { "primaries", "set color primaries", OFFSET(primaries), AV_OPT_TYPE_INT, {.i64 = -1}, -1, INT_MAX, FLAGS, "primaries" },
+    { "p",         "set color primaries", OFFSET(primaries), AV_OPT_TYPE_INT, {.i64 = -1}, -1, INT_MAX, FLAGS, "primaries" },
+    {     "bt709",            0,       0,                 AV_OPT_TYPE_CONST, {.i64 = AVCOL_PRI_BT709},         0, 0, FLAGS, "primaries" },
+    {     "bt2020",           0,       0,                 AV_OPT_TYPE_CONST, {.i64 = AVCOL_PRI_BT2020},        0, 0, FLAGS, "primaries" },
+    { "range",         "set color range", OFFSET(range), AV_OPT_TYPE_INT, {.i64 = -1}, -1, INT_MAX, FLAGS, "range" },
+    { "r",             "set color range", OFFSET(range), AV_OPT_TYPE_INT, {.i64 = -1}, -1, INT_MAX, FLAGS, "range" },
+    {     "tv",            0,       0,                 AV_OPT_TYPE_CONST, {.i64 = AVCOL_RANGE_MPEG},         0, 0, FLAGS, "range" },
+    {     "pc",            0,       0,                 AV_OPT_TYPE_CONST, {.i64 = AVCOL_RANGE_JPEG},         0, 0, FLAGS, "range" },
+    {     "limited",       0,       0,                 AV_OPT_TYPE_CONST, {.i64 = AVCOL_RANGE_MPEG},         0, 0, FLAGS, "range" },
+    {     "full",          0,       0,                 AV_OPT_TYPE_CONST, {.i64 = AVCOL_RANGE_JPEG},         0, 0, FLAGS, "range" },
+    { "format",       "output pixel format", OFFSET(format), AV_OPT_TYPE_PIXEL_FMT, {.i64 = AV_PIX_FMT_NONE}, AV_PIX_FMT_NONE, INT_MAX, FLAGS },
     { "param",        "tonemap parameter", OFFSET(param), AV_OPT_TYPE_DOUBLE, {.dbl = NAN}, DBL_MIN, DBL_MAX, FLAGS },
     { "desat",        "desaturation strength", OFFSET(desat), AV_OPT_TYPE_DOUBLE, {.dbl = 2}, 0, DBL_MAX, FLAGS },
     { "peak",         "signal peak override", OFFSET(peak), AV_OPT_TYPE_DOUBLE, {.dbl = 0}, 0, DBL_MAX, FLAGS },
@@ -311,6 +817,7 @@ static const AVFilterPad tonemap_outputs[] = {
     {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_output,
     },
 };
 
@@ -318,10 +825,11 @@ const AVFilter ff_vf_tonemap = {
     .name            = "tonemap",
     .description     = NULL_IF_CONFIG_SMALL("Conversion to/from different dynamic ranges."),
     .init            = init,
+    .uninit          = uninit,
     .priv_size       = sizeof(TonemapContext),
     .priv_class      = &tonemap_class,
     FILTER_INPUTS(tonemap_inputs),
     FILTER_OUTPUTS(tonemap_outputs),
-    FILTER_PIXFMTS(AV_PIX_FMT_GBRPF32, AV_PIX_FMT_GBRAPF32),
+    FILTER_QUERY_FUNC(query_formats),
     .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
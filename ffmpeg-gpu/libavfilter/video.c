@@ -45,6 +45,7 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
     int pool_height = 0;
     int pool_align = 0;
     enum AVPixelFormat pool_format = AV_PIX_FMT_NONE;
+    FFFrameAllocator *allocator = link->graph ? link->graph->internal->frame_allocator : NULL;
 
     if (link->hw_frames_ctx &&
         ((AVHWFramesContext*)link->hw_frames_ctx->data)->format == link->format) {
@@ -62,8 +63,8 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
     }
 
     if (!link->frame_pool) {
-        link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
-                                                    link->format, align);
+        link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, allocator,
+                                                    w, h, link->format, align);
         if (!link->frame_pool)
             return NULL;
     } else {
@@ -77,8 +78,8 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
             pool_format != link->format || pool_align != align) {
 
             ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
-            link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
-                                                        link->format, align);
+            link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, allocator,
+                                                        w, h, link->format, align);
             if (!link->frame_pool)
                 return NULL;
         }
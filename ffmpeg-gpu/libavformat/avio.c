@@ -425,6 +425,45 @@ int ffurl_write(URLContext *h, const unsigned char *buf, int size)
                                   h->prot->url_write);
 }
 
+int ffurl_write_vec(URLContext *h, const URLIOVec *iov, int iovcnt)
+{
+    int64_t total = 0;
+    int i, ret, written = 0;
+
+    if (!(h->flags & AVIO_FLAG_WRITE))
+        return AVERROR(EIO);
+    for (i = 0; i < iovcnt; i++)
+        total += iov[i].size;
+    if (total > INT_MAX)
+        return AVERROR(EINVAL);
+    /* avoid sending too big packets */
+    if (h->max_packet_size && total > h->max_packet_size)
+        return AVERROR(EIO);
+
+    if (h->prot->url_write_vec && !(h->flags & AVIO_FLAG_NONBLOCK)) {
+        if (ff_check_interrupt(&h->interrupt_callback))
+            return AVERROR_EXIT;
+        ret = h->prot->url_write_vec(h, iov, iovcnt);
+        if (ret >= 0)
+            written = ret;
+        else if (ret != AVERROR(ENOSYS) && ret != AVERROR(EAGAIN) &&
+                 ret != AVERROR(EINTR))
+            return ret;
+    }
+
+    /* write whatever the gathered write left over one buffer at a time */
+    for (i = 0; i < iovcnt; i++) {
+        int skip = FFMIN(written, iov[i].size);
+        written -= skip;
+        if (skip < iov[i].size) {
+            ret = ffurl_write(h, iov[i].data + skip, iov[i].size - skip);
+            if (ret < 0)
+                return ret;
+        }
+    }
+    return total;
+}
+
 int64_t ffurl_seek(URLContext *h, int64_t pos, int whence)
 {
     int64_t ret;
@@ -77,6 +77,25 @@ typedef struct FFIOContext {
      * is updated each time a successful writeout ends up further position-wise
      */
     int64_t written_output_size;
+
+    /**
+     * Bounds for the adaptive buffer size, only set for contexts backed by
+     * a stream protocol (see ffio_fdopen()). A zero max_buffer_size disables
+     * both the adaptation and the bypass of the buffer for large writes.
+     */
+    int min_buffer_size;
+    int max_buffer_size;
+
+    /**
+     * Number of consecutive transfers that used the whole buffer
+     */
+    int full_transfers;
+
+    /**
+     * Optional gathered write callback, used to write the buffered data
+     * and a large payload in one go.
+     */
+    int (*write_vec)(void *opaque, const URLIOVec *iov, int iovcnt);
 } FFIOContext;
 
 static av_always_inline FFIOContext *ffiocontext(AVIOContext *ctx)
@@ -36,6 +36,14 @@
 
 #define IO_BUFFER_SIZE 32768
 
+/**
+ * Upper bound for the buffer of protocol backed contexts, which grows
+ * by doubling after IO_BUFFER_GROW_COUNT consecutive transfers of the
+ * whole buffer, and goes back to its initial size after a protocol seek.
+ */
+#define IO_BUFFER_MAX_SIZE   262144
+#define IO_BUFFER_GROW_COUNT 4
+
 /**
  * Do seeks within this distance ahead of the current buffer by skipping
  * data instead of calling the protocol seek function, for seekable
@@ -154,18 +162,30 @@ void avio_context_free(AVIOContext **ps)
     av_freep(ps);
 }
 
-static void writeout(AVIOContext *s, const uint8_t *data, int len)
+static void writeout_vec(AVIOContext *s, const URLIOVec *iov, int iovcnt)
 {
     FFIOContext *const ctx = ffiocontext(s);
+    int i, len = 0;
+
+    for (i = 0; i < iovcnt; i++)
+        len += iov[i].size;
+
     if (!s->error) {
         int ret = 0;
-        if (s->write_data_type)
-            ret = s->write_data_type(s->opaque, (uint8_t *)data,
-                                     len,
-                                     ctx->current_type,
-                                     ctx->last_time);
-        else if (s->write_packet)
-            ret = s->write_packet(s->opaque, (uint8_t *)data, len);
+        if (iovcnt > 1 && ctx->write_vec) {
+            ret = ctx->write_vec(s->opaque, iov, iovcnt);
+        } else {
+            for (i = 0; i < iovcnt && ret >= 0; i++) {
+                if (s->write_data_type)
+                    ret = s->write_data_type(s->opaque, (uint8_t *)iov[i].data,
+                                             iov[i].size,
+                                             ctx->current_type,
+                                             ctx->last_time);
+                else if (s->write_packet)
+                    ret = s->write_packet(s->opaque, (uint8_t *)iov[i].data,
+                                          iov[i].size);
+            }
+        }
         if (ret < 0) {
             s->error = ret;
         } else {
@@ -191,9 +211,62 @@ FF_ENABLE_DEPRECATION_WARNINGS
     s->pos += len;
 }
 
+static void writeout(AVIOContext *s, const uint8_t *data, int len)
+{
+    const URLIOVec iov = { data, len };
+    writeout_vec(s, &iov, 1);
+}
+
+/**
+ * Replace the buffer of an adaptive context by one of buf_size bytes,
+ * keeping the data not written yet. Read buffers must be empty.
+ */
+static void adapt_buf_size(AVIOContext *s, int buf_size)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    ptrdiff_t filled = s->write_flag ? FFMAX(s->buf_ptr, s->buf_ptr_max) - s->buffer : 0;
+    uint8_t *buffer;
+
+    ctx->full_transfers = 0;
+    if (buf_size == s->buffer_size || filled > buf_size)
+        return;
+    buffer = av_malloc(buf_size);
+    if (!buffer) {
+        /* keep the current buffer and stop adapting */
+        ctx->max_buffer_size = 0;
+        return;
+    }
+    memcpy(buffer, s->buffer, filled);
+    if (s->write_flag) {
+        s->buf_ptr     = buffer + (s->buf_ptr     - s->buffer);
+        s->buf_ptr_max = buffer + (s->buf_ptr_max - s->buffer);
+        s->buf_end     = buffer + buf_size;
+    } else {
+        s->buf_ptr = s->buf_end = buffer;
+    }
+    av_free(s->buffer);
+    s->buffer       = buffer;
+    s->checksum_ptr = buffer;
+    ctx->orig_buffer_size =
+    s->buffer_size        = buf_size;
+}
+
+static void grow_write_buf(AVIOContext *s)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+
+    if (ctx->full_transfers >= IO_BUFFER_GROW_COUNT &&
+        s->buffer_size < ctx->max_buffer_size)
+        adapt_buf_size(s, FFMIN(2 * s->buffer_size, ctx->max_buffer_size));
+}
+
 static void flush_buffer(AVIOContext *s)
 {
+    FFIOContext *const ctx = ffiocontext(s);
+    int full;
+
     s->buf_ptr_max = FFMAX(s->buf_ptr, s->buf_ptr_max);
+    full = s->buf_ptr_max >= s->buf_end;
     if (s->write_flag && s->buf_ptr_max > s->buffer) {
         writeout(s, s->buffer, s->buf_ptr_max - s->buffer);
         if (s->update_checksum) {
@@ -205,6 +278,11 @@ static void flush_buffer(AVIOContext *s)
     s->buf_ptr = s->buf_ptr_max = s->buffer;
     if (!s->write_flag)
         s->buf_end = s->buffer;
+
+    if (s->write_flag && ctx->max_buffer_size) {
+        ctx->full_transfers = full ? ctx->full_transfers + 1 : 0;
+        grow_write_buf(s);
+    }
 }
 
 void avio_w8(AVIOContext *s, int b)
@@ -229,6 +307,47 @@ void ffio_fill(AVIOContext *s, int b, int64_t count)
     }
 }
 
+/**
+ * Write size >= buffer_size bytes without copying them through the buffer.
+ * The buffered data and the payload are written up to the largest multiple
+ * of the buffer size, the rest is left in the buffer. This is the same
+ * amount of data the copying loop would write, so the position, and the
+ * data that can still be sought back to, are unchanged.
+ */
+static void write_bypass(AVIOContext *s, const unsigned char *buf, int size)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    int pending = s->buf_ptr - s->buffer;
+    int64_t total = (int64_t)pending + size;
+    int direct = total - total % s->buffer_size - pending;
+
+    if (pending && ctx->write_vec) {
+        const URLIOVec iov[2] = { { s->buffer, pending }, { buf, direct } };
+        writeout_vec(s, iov, 2);
+        s->buf_ptr = s->buf_ptr_max = s->buffer;
+    } else {
+        if (pending) {
+            int len = s->buf_end - s->buf_ptr;
+            memcpy(s->buf_ptr, buf, len);
+            s->buf_ptr += len;
+            flush_buffer(s);
+            buf    += len;
+            size   -= len;
+            direct -= len;
+        }
+        if (direct > 0)
+            writeout(s, buf, direct);
+    }
+    buf  += direct;
+    size -= direct;
+    memcpy(s->buf_ptr, buf, size);
+    s->buf_ptr += size;
+
+    /* medium sized writes are better coalesced in a larger buffer */
+    ctx->full_transfers++;
+    grow_write_buf(s);
+}
+
 void avio_write(AVIOContext *s, const unsigned char *buf, int size)
 {
     if (s->direct && !s->update_checksum) {
@@ -236,6 +355,12 @@ void avio_write(AVIOContext *s, const unsigned char *buf, int size)
         writeout(s, buf, size);
         return;
     }
+    if (size >= s->buffer_size && ffiocontext(s)->max_buffer_size &&
+        s->write_flag && !s->update_checksum && !s->write_data_type &&
+        s->buf_ptr >= s->buf_ptr_max) {
+        write_bypass(s, buf, size);
+        return;
+    }
     while (size > 0) {
         int len = FFMIN(s->buf_end - s->buf_ptr, size);
         memcpy(s->buf_ptr, buf, len);
@@ -339,6 +464,9 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
             s->buf_end = s->buffer;
         s->buf_ptr = s->buf_ptr_max = s->buffer;
         s->pos = offset;
+        /* random access, the buffer does not need to be large */
+        if (ctx->max_buffer_size && s->buffer_size == ctx->orig_buffer_size)
+            adapt_buf_size(s, ctx->min_buffer_size);
     }
     s->eof_reached = 0;
     return offset;
@@ -545,6 +673,7 @@ static void fill_buffer(AVIOContext *s)
     uint8_t *dst        = s->buf_end - s->buffer + max_buffer_size <= s->buffer_size ?
                           s->buf_end : s->buffer;
     int len             = s->buffer_size - (dst - s->buffer);
+    int ret;
 
     /* can't fill the buffer without read_packet, just set EOF if appropriate */
     if (!s->read_packet && s->buf_ptr >= s->buf_end)
@@ -561,6 +690,16 @@ static void fill_buffer(AVIOContext *s)
         s->checksum_ptr = s->buffer;
     }
 
+    /* grow the buffer if it is consumed sequentially and filled completely */
+    if (ctx->max_buffer_size && dst == s->buffer && s->buf_ptr >= s->buf_end &&
+        ctx->full_transfers >= IO_BUFFER_GROW_COUNT &&
+        s->buffer_size == ctx->orig_buffer_size &&
+        s->buffer_size <  ctx->max_buffer_size) {
+        adapt_buf_size(s, FFMIN(2 * s->buffer_size, ctx->max_buffer_size));
+        dst = s->buffer;
+        len = s->buffer_size;
+    }
+
     /* make buffer smaller in case it ended up large after probing */
     if (s->read_packet && ctx->orig_buffer_size &&
         s->buffer_size > ctx->orig_buffer_size  && len >= ctx->orig_buffer_size) {
@@ -574,7 +713,9 @@ static void fill_buffer(AVIOContext *s)
         len = ctx->orig_buffer_size;
     }
 
-    len = read_packet_wrapper(s, dst, len);
+    ret = read_packet_wrapper(s, dst, len);
+    ctx->full_transfers = ret == len ? ctx->full_transfers + 1 : 0;
+    len = ret;
     if (len == AVERROR_EOF) {
         /* do not modify buffer if EOF reached so that a seek back can
            be done without rereading data */
@@ -1005,6 +1146,15 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
             (*s)->seekable |= AVIO_SEEKABLE_TIME;
     }
     ((FFIOContext*)(*s))->short_seek_get = (int (*)(void *))ffurl_get_short_seek;
+    if (!max_packet_size && !(*s)->direct) {
+        FFIOContext *const ctx = ffiocontext(*s);
+        ctx->min_buffer_size = buffer_size;
+        ctx->max_buffer_size = FFMAX3(buffer_size, IO_BUFFER_MAX_SIZE,
+                                      h->min_packet_size);
+        if ((h->flags & AVIO_FLAG_WRITE) && !(h->flags & AVIO_FLAG_NONBLOCK) &&
+            h->prot && h->prot->url_write_vec)
+            ctx->write_vec = (int (*)(void *, const URLIOVec *, int))ffurl_write_vec;
+    }
     (*s)->av_class = &ff_avio_class;
     return 0;
 }
@@ -1147,6 +1297,9 @@ int ffio_realloc_buf(AVIOContext *s, int buf_size)
     if (!buffer)
         return AVERROR(ENOMEM);
 
+    /* the caller asked for a specific size, stop adapting it */
+    ffiocontext(s)->max_buffer_size = 0;
+
     data_size = s->write_flag ? (s->buf_ptr - s->buffer) : (s->buf_end - s->buf_ptr);
     if (data_size > 0)
         memcpy(buffer, s->write_flag ? s->buffer : s->buf_ptr, data_size);
@@ -36,6 +36,9 @@
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#if HAVE_WRITEV
+#include <sys/uio.h>
+#endif
 #include <stdlib.h>
 #include "os_support.h"
 #include "url.h"
@@ -130,6 +133,27 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
     return (ret == -1) ? AVERROR(errno) : ret;
 }
 
+#if HAVE_WRITEV
+#define FILE_MAX_IOV 8
+
+static int file_write_vec(URLContext *h, const URLIOVec *iov, int iovcnt)
+{
+    FileContext *c = h->priv_data;
+    struct iovec vec[FILE_MAX_IOV];
+    int i, ret;
+
+    /* let the caller split the writes */
+    if (c->blocksize != INT_MAX || iovcnt > FILE_MAX_IOV)
+        return AVERROR(ENOSYS);
+    for (i = 0; i < iovcnt; i++) {
+        vec[i].iov_base = (void *)iov[i].data;
+        vec[i].iov_len  = iov[i].size;
+    }
+    ret = writev(c->fd, vec, iovcnt);
+    return (ret == -1) ? AVERROR(errno) : ret;
+}
+#endif
+
 static int file_get_handle(URLContext *h)
 {
     FileContext *c = h->priv_data;
@@ -234,9 +258,10 @@ static int file_open(URLContext *h, const char *filename, int flags)
     h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
 
     /* Buffer writes more than the default 32k to improve throughput especially
-     * with networked file systems */
+     * with networked file systems: flush points are only honoured once this
+     * much data is buffered, and the buffer grows up to it (see ffio_fdopen()) */
     if (!h->is_streamed && flags & AVIO_FLAG_WRITE)
-        h->min_packet_size = h->max_packet_size = 262144;
+        h->min_packet_size = 262144;
 
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
@@ -357,6 +382,9 @@ const URLProtocol ff_file_protocol = {
     .url_open            = file_open,
     .url_read            = file_read,
     .url_write           = file_write,
+#if HAVE_WRITEV
+    .url_write_vec       = file_write_vec,
+#endif
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
@@ -403,6 +431,9 @@ const URLProtocol ff_pipe_protocol = {
     .url_open            = pipe_open,
     .url_read            = file_read,
     .url_write           = file_write,
+#if HAVE_WRITEV
+    .url_write_vec       = file_write_vec,
+#endif
     .url_get_file_handle = file_get_handle,
     .url_check           = file_check,
     .priv_data_size      = sizeof(FileContext),
@@ -73,6 +73,13 @@ typedef enum {
 #define BUFSIZE (16 * 1024)
 #define POSTFIX_PATTERN "_%d"
 
+typedef struct HLSPart {
+    double duration; /* in seconds */
+    int64_t pos;
+    int64_t size;
+    int independent;
+} HLSPart;
+
 typedef struct HLSSegment {
     char filename[MAX_URL_SIZE];
     char sub_filename[MAX_URL_SIZE];
@@ -87,6 +94,9 @@ typedef struct HLSSegment {
     char key_uri[LINE_BUFFER_SIZE + 1];
     char iv_string[KEYSIZE*2 + 1];
 
+    HLSPart *parts;
+    int nb_parts;
+
     struct HLSSegment *next;
     double discont_program_date_time;
 } HLSSegment;
@@ -153,6 +163,13 @@ typedef struct VariantStream {
     HLSSegment *last_segment;
     HLSSegment *old_segments;
 
+    AVIOContext *part_out;  // segment file kept open while its parts are written
+    HLSPart *parts;         // parts of the segment being written
+    int nb_parts;
+    int64_t part_pos;       // bytes written so far to the current segment file
+    int64_t part_start_pts;
+    int part_independent;
+
     char *basename_tmp;
     char *basename;
     char *vtt_basename;
@@ -198,6 +215,7 @@ typedef struct HLSContext {
 
     int64_t time;          // Set by a private option.
     int64_t init_time;     // Set by a private option.
+    int64_t part_time;     // Set by a private option.
     int max_nb_segments;   // Set by a private option.
     int hls_delete_threshold; // Set by a private option.
     uint32_t flags;        // enum HLSFlags
@@ -529,7 +547,7 @@ static void write_styp(AVIOContext *pb)
     ffio_wfourcc(pb, "msix");
 }
 
-static int flush_dynbuf(VariantStream *vs, int *range_length)
+static int flush_dynbuf(VariantStream *vs, AVIOContext *out, int *range_length)
 {
     AVFormatContext *ctx = vs->avf;
 
@@ -543,8 +561,8 @@ static int flush_dynbuf(VariantStream *vs, int *range_length)
     // write out to file
     *range_length = avio_close_dyn_buf(ctx->pb, &vs->temp_buffer);
     ctx->pb = NULL;
-    avio_write(vs->out, vs->temp_buffer, *range_length);
-    avio_flush(vs->out);
+    avio_write(out, vs->temp_buffer, *range_length);
+    avio_flush(out);
 
     // re-open buffer
     return avio_open_dyn_buf(&ctx->pb);
@@ -936,6 +954,9 @@ static int hls_mux_init(AVFormatContext *s, VariantStream *vs)
     if (hls->segment_type == SEGMENT_TYPE_FMP4) {
         av_dict_set(&options, "fflags", "-autobsf", 0);
         av_dict_set(&options, "movflags", "+frag_custom+dash+delay_moov", AV_DICT_APPEND);
+        /* A sidx per part is only overhead for the low-latency parts. */
+        if (hls->part_time > 0)
+            av_dict_set(&options, "movflags", "+skip_sidx", AV_DICT_APPEND);
     } else {
         /* We only require one PAT/PMT per segment. */
         char period[21];
@@ -1143,6 +1164,10 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
     en->next     = NULL;
     en->discont  = 0;
     en->discont_program_date_time = 0;
+    en->parts    = vs->parts;
+    en->nb_parts = vs->nb_parts;
+    vs->parts    = NULL;
+    vs->nb_parts = 0;
 
     if (vs->discontinuity) {
         en->discont = 1;
@@ -1170,6 +1195,8 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
         if (!en->next->discont_program_date_time && !en->discont_program_date_time)
             vs->initial_prog_date_time += en->duration;
         vs->segments = en->next;
+        av_freep(&en->parts);
+        en->nb_parts = 0;
         if (en && hls->flags & HLS_DELETE_SEGMENTS &&
                 !(hls->flags & HLS_SINGLE_FILE)) {
             en->next = vs->old_segments;
@@ -1309,6 +1336,7 @@ static void hls_free_segments(HLSSegment *p)
     while (p) {
         en = p;
         p = p->next;
+        av_freep(&en->parts);
         av_freep(&en);
     }
 }
@@ -1535,6 +1563,7 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     HLSContext *hls = s->priv_data;
     HLSSegment *en;
     int target_duration = 0;
+    double total_duration = 0, elapsed = 0;
     int ret = 0;
     char temp_filename[MAX_URL_SIZE];
     char temp_vtt_filename[MAX_URL_SIZE];
@@ -1586,7 +1615,11 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     for (en = vs->segments; en; en = en->next) {
         if (target_duration <= en->duration)
             target_duration = lrint(en->duration);
+        total_duration += en->duration;
     }
+    /* With parts, the playlist is published before the first segment is complete. */
+    if (hls->part_time > 0 && !target_duration)
+        target_duration = FFMAX(lrint(hls->time / (double)AV_TIME_BASE), 1);
 
     vs->discontinuity_set = 0;
     ff_hls_write_playlist_header(byterange_mode ? hls->m3u8_out : vs->out, hls->version, hls->allowcache,
@@ -1599,7 +1632,11 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     if (vs->has_video && (hls->flags & HLS_INDEPENDENT_SEGMENTS)) {
         avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-INDEPENDENT-SEGMENTS\n");
     }
+    if (hls->part_time > 0)
+        ff_hls_write_part_inf(vs->out, hls->part_time / (double)AV_TIME_BASE);
     for (en = vs->segments; en; en = en->next) {
+        int insert_discont = en->discont;
+
         if ((hls->encrypt || hls->key_info_file) && (!key_uri || strcmp(en->key_uri, key_uri) ||
                                     av_strcasecmp(en->iv_string, iv_string))) {
             avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"", en->key_uri);
@@ -1615,7 +1652,24 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
                                    hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
         }
 
-        ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, en->discont, byterange_mode,
+        /* Parts are only listed for the segments close to the live edge,
+         * older ones cannot be part of the playlist again. */
+        if (en->nb_parts && elapsed + en->duration < total_duration - 3 * target_duration) {
+            av_freep(&en->parts);
+            en->nb_parts = 0;
+        }
+        if (en->nb_parts) {
+            if (insert_discont)
+                avio_printf(vs->out, "#EXT-X-DISCONTINUITY\n");
+            insert_discont = 0;
+            for (int i = 0; i < en->nb_parts; i++)
+                ff_hls_write_part(vs->out, en->parts[i].duration, hls->baseurl,
+                                  en->filename, en->parts[i].size,
+                                  en->parts[i].pos, en->parts[i].independent);
+        }
+        elapsed += en->duration;
+
+        ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, insert_discont, byterange_mode,
                                       en->duration, hls->flags & HLS_ROUND_DURATIONS,
                                       en->size, en->pos, hls->baseurl,
                                       en->filename,
@@ -1628,6 +1682,18 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         }
     }
 
+    if (!last && vs->part_out) {
+        const char *filename = hls->use_localtime_mkdir ? vs->avf->url : av_basename(vs->avf->url);
+
+        if (!vs->segments)
+            ff_hls_write_init_file(vs->out, vs->fmp4_init_filename, 0, 0, 0);
+        for (int i = 0; i < vs->nb_parts; i++)
+            ff_hls_write_part(vs->out, vs->parts[i].duration, hls->baseurl,
+                              filename, vs->parts[i].size,
+                              vs->parts[i].pos, vs->parts[i].independent);
+        ff_hls_write_preload_hint(vs->out, hls->baseurl, filename, vs->part_pos);
+    }
+
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         ff_hls_write_end_list(byterange_mode ? hls->m3u8_out : vs->out);
 
@@ -2400,6 +2466,105 @@ static int64_t append_single_file(AVFormatContext *s, VariantStream *vs)
 
     return ret;
 }
+static int hls_write_init_file(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int range_length;
+
+    range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
+    if (range_length <= 0)
+        return AVERROR(EINVAL);
+    avio_write(vs->out, vs->init_buffer, range_length);
+    if (!hls->resend_init_file)
+        av_freep(&vs->init_buffer);
+    vs->init_range_length = range_length;
+    avio_open_dyn_buf(&oc->pb);
+    vs->packets_written = 0;
+    vs->start_pos = range_length;
+    if (!byterange_mode) {
+        hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+    }
+
+    return 0;
+}
+
+static int hls_open_part_segment(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVDictionary *options = NULL;
+    int ret;
+
+    if (vs->part_out)
+        return 0;
+
+    set_http_options(s, &options, hls);
+    ret = hlsenc_io_open(s, &vs->part_out, vs->avf->url, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Failed to open file '%s'\n", vs->avf->url);
+        return ret;
+    }
+    write_styp(vs->part_out);
+    avio_flush(vs->part_out);
+    vs->part_pos = avio_tell(vs->part_out);
+
+    return 0;
+}
+
+/**
+ * Close the fragment buffered so far and append it to the segment file
+ * as a new part.
+ */
+static int hls_flush_part(AVFormatContext *s, VariantStream *vs, double duration)
+{
+    AVFormatContext *oc = vs->avf;
+    HLSPart *part;
+    int range_length = 0;
+    int ret;
+
+    if (!vs->init_range_length) {
+        av_write_frame(oc, NULL); /* Flush the delayed moov */
+        ret = hls_write_init_file(s, vs);
+        if (ret < 0)
+            return ret;
+    }
+
+    ret = hls_open_part_segment(s, vs);
+    if (ret < 0)
+        return ret;
+
+    ret = flush_dynbuf(vs, vs->part_out, &range_length);
+    av_freep(&vs->temp_buffer);
+    if (ret < 0)
+        return ret;
+    if (!range_length)
+        return 0;
+
+    part = av_dynarray2_add((void **)&vs->parts, &vs->nb_parts, sizeof(*part), NULL);
+    if (!part)
+        return AVERROR(ENOMEM);
+    part->duration    = duration;
+    part->pos         = vs->part_pos;
+    part->size        = range_length;
+    part->independent = vs->part_independent;
+    vs->part_pos     += range_length;
+
+    return 0;
+}
+
+static int hls_close_part_segment(AVFormatContext *s, VariantStream *vs, double duration)
+{
+    int ret = hls_flush_part(s, vs, duration);
+    if (ret < 0)
+        return ret;
+
+    vs->size = vs->part_pos;
+    vs->part_start_pts = AV_NOPTS_VALUE;
+    return hlsenc_io_close(s, &vs->part_out, vs->avf->url);
+}
+
 static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
     HLSContext *hls = s->priv_data;
@@ -2502,19 +2667,9 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         avio_flush(oc->pb);
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
             if (!vs->init_range_length) {
-                range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
-                if (range_length <= 0)
-                    return AVERROR(EINVAL);
-                avio_write(vs->out, vs->init_buffer, range_length);
-                if (!hls->resend_init_file)
-                    av_freep(&vs->init_buffer);
-                vs->init_range_length = range_length;
-                avio_open_dyn_buf(&oc->pb);
-                vs->packets_written = 0;
-                vs->start_pos = range_length;
-                if (!byterange_mode) {
-                    hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
-                }
+                ret = hls_write_init_file(s, vs);
+                if (ret < 0)
+                    return ret;
             }
         }
         if (!byterange_mode) {
@@ -2523,8 +2678,14 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             }
         }
 
-        if (hls->flags & HLS_SINGLE_FILE) {
-            ret = flush_dynbuf(vs, &range_length);
+        if (hls->part_time > 0) {
+            double part_duration = vs->part_start_pts == AV_NOPTS_VALUE ? 0 :
+                                   (double)(pkt->dts - vs->part_start_pts) * st->time_base.num / st->time_base.den;
+            ret = hls_close_part_segment(s, vs, part_duration);
+            if (ret < 0)
+                return ret;
+        } else if (hls->flags & HLS_SINGLE_FILE) {
+            ret = flush_dynbuf(vs, vs->out, &range_length);
             av_freep(&vs->temp_buffer);
             if (ret < 0) {
                 return ret;
@@ -2571,7 +2732,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
                 if (hls->segment_type == SEGMENT_TYPE_FMP4) {
                     write_styp(vs->out);
                 }
-                ret = flush_dynbuf(vs, &range_length);
+                ret = flush_dynbuf(vs, vs->out, &range_length);
                 if (ret < 0) {
                     av_freep(&filename);
                     av_dict_free(&options);
@@ -2612,7 +2773,8 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
 
         // if we're building a VOD playlist, skip writing the manifest multiple times, and just wait until the end
-        if (hls->pl_type != PLAYLIST_TYPE_VOD) {
+        // with parts, the manifest is written once the next segment is open
+        if (hls->pl_type != PLAYLIST_TYPE_VOD && !hls->part_time) {
             if ((ret = hls_window(s, 0, vs)) < 0) {
                 av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
                 ff_format_io_close(s, &vs->out);
@@ -2660,6 +2822,34 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         if (ret < 0) {
             return ret;
         }
+
+        if (hls->part_time > 0) {
+            /* Open the next segment right away so that the preload hint
+             * of the playlist points to an existing file. */
+            ret = hls_open_part_segment(s, vs);
+            if (ret < 0)
+                return ret;
+            if (hls->pl_type != PLAYLIST_TYPE_VOD && (ret = hls_window(s, 0, vs)) < 0)
+                return ret;
+        }
+    }
+
+    if (hls->part_time > 0 && is_ref_pkt && pkt->dts != AV_NOPTS_VALUE) {
+        if (vs->part_start_pts == AV_NOPTS_VALUE) {
+            vs->part_start_pts   = pkt->dts;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+        } else if (av_compare_ts(pkt->dts + pkt->duration - vs->part_start_pts, st->time_base,
+                                 hls->part_time, AV_TIME_BASE_Q) > 0) {
+            double part_duration = (double)(pkt->dts - vs->part_start_pts) * st->time_base.num / st->time_base.den;
+
+            ret = hls_flush_part(s, vs, part_duration);
+            if (ret < 0)
+                return ret;
+            vs->part_start_pts   = pkt->dts;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+            if (hls->pl_type != PLAYLIST_TYPE_VOD && (ret = hls_window(s, 0, vs)) < 0)
+                return ret;
+        }
     }
 
     vs->packets_written++;
@@ -2693,6 +2883,8 @@ static void hls_deinit(AVFormatContext *s)
         av_freep(&vs->vtt_basename);
         av_freep(&vs->vtt_m3u8_name);
 
+        ff_format_io_close(s, &vs->part_out);
+        av_freep(&vs->parts);
         avformat_free_context(vs->vtt_avf);
         avformat_free_context(vs->avf);
         if (hls->resend_init_file)
@@ -2768,6 +2960,16 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 }
             }
         }
+        if (hls->part_time > 0) {
+            double part_duration = vs->duration + vs->dpp;
+
+            for (int j = 0; j < vs->nb_parts; j++)
+                part_duration -= vs->parts[j].duration;
+            ret = hls_close_part_segment(s, vs, FFMAX(part_duration, 0));
+            if (ret < 0)
+                av_log(s, AV_LOG_WARNING, "Failed to upload file '%s' at the end.\n", oc->url);
+            goto failed;
+        }
         if (!(hls->flags & HLS_SINGLE_FILE)) {
             set_http_options(s, &options, hls);
             ret = hlsenc_io_open(s, &vs->out, filename, &options);
@@ -2778,7 +2980,7 @@ static int hls_write_trailer(struct AVFormatContext *s)
             if (hls->segment_type == SEGMENT_TYPE_FMP4)
                 write_styp(vs->out);
         }
-        ret = flush_dynbuf(vs, &range_length);
+        ret = flush_dynbuf(vs, vs->out, &range_length);
         if (ret < 0)
             goto failed;
 
@@ -2938,6 +3140,26 @@ static int hls_init(AVFormatContext *s)
 
     hls->recording_time = hls->init_time ? hls->init_time : hls->time;
 
+    if (hls->part_time > 0) {
+        if (hls->segment_type != SEGMENT_TYPE_FMP4) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time requires the fmp4 segment type\n");
+            return AVERROR(EINVAL);
+        }
+        if ((hls->flags & (HLS_SINGLE_FILE | HLS_TEMP_FILE |
+                           HLS_SECOND_LEVEL_SEGMENT_DURATION |
+                           HLS_SECOND_LEVEL_SEGMENT_SIZE)) ||
+            hls->max_seg_size > 0) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time cannot be used with single_file, "
+                   "temp_file, second_level_segment_duration, "
+                   "second_level_segment_size or hls_segment_size\n");
+            return AVERROR(EINVAL);
+        }
+        if (hls->part_time > hls->time) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time must not be larger than hls_time\n");
+            return AVERROR(EINVAL);
+        }
+    }
+
     if (hls->flags & HLS_SPLIT_BY_TIME && hls->flags & HLS_INDEPENDENT_SEGMENTS) {
         // Independent segments cannot be guaranteed when splitting by time
         hls->flags &= ~HLS_INDEPENDENT_SEGMENTS;
@@ -2956,6 +3178,7 @@ static int hls_init(AVFormatContext *s)
         vs->sequence  = hls->start_sequence;
         vs->start_pts = AV_NOPTS_VALUE;
         vs->end_pts   = AV_NOPTS_VALUE;
+        vs->part_start_pts = AV_NOPTS_VALUE;
         vs->current_segment_final_filename_fmt[0] = '\0';
         vs->initial_prog_date_time = initial_program_date_time;
 
@@ -3107,6 +3330,7 @@ static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length",                      OFFSET(time),          AV_OPT_TYPE_DURATION, {.i64 = 2000000}, 0, INT64_MAX, E},
     {"hls_init_time", "set segment length at init list",         OFFSET(init_time),     AV_OPT_TYPE_DURATION, {.i64 = 0},       0, INT64_MAX, E},
+    {"hls_part_time", "set part length of low-latency segments", OFFSET(part_time),     AV_OPT_TYPE_DURATION, {.i64 = 0},       0, INT64_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_delete_threshold", "set number of unreferenced segments to keep before deleting",  OFFSET(hls_delete_threshold),    AV_OPT_TYPE_INT,    {.i64 = 1},     1, INT_MAX, E},
 #if FF_HLS_TS_OPTIONS
@@ -2956,6 +2956,35 @@ static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size,
     return 0;
 }
 
+/**
+ * Count how many of the packets at the start of buf would be ignored by
+ * handle_packet() without any side effect: packets which are in sync and
+ * belong to a PID without filter, or to a discarded PID and do not start
+ * a new payload unit.
+ */
+static int count_ignored_packets(MpegTSContext *ts, const uint8_t *buf, int size,
+                                 int raw_packet_size, int max_packets)
+{
+    const uint8_t *p = buf;
+    int n;
+
+    for (n = 0; n < max_packets && size >= raw_packet_size; n++) {
+        MpegTSFilter *tss;
+        int pid, is_start;
+
+        if (p[0] != 0x47)
+            break;
+        pid      = AV_RB16(p + 1) & 0x1fff;
+        is_start = p[1] & 0x40;
+        tss      = ts->pids[pid];
+        if (tss ? !tss->discard || is_start : ts->auto_guess && is_start)
+            break;
+        p    += raw_packet_size;
+        size -= raw_packet_size;
+    }
+    return n;
+}
+
 static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
 {
     AVIOContext *pb = s->pb;
@@ -3005,6 +3034,21 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        /* Skip whole runs of uninteresting packets still in the I/O
+         * buffer without copying and dispatching them one by one. */
+        if (s->pb->buf_end - s->pb->buf_ptr >= ts->raw_packet_size) {
+            int64_t max_packets = nb_packets ? nb_packets - packet_num : INT_MAX;
+            int skipped = count_ignored_packets(ts, s->pb->buf_ptr,
+                                                s->pb->buf_end - s->pb->buf_ptr,
+                                                ts->raw_packet_size,
+                                                FFMIN(max_packets, INT_MAX));
+            if (skipped) {
+                avio_skip(s->pb, (int64_t)skipped * ts->raw_packet_size);
+                packet_num += skipped - 1;
+                continue;
+            }
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
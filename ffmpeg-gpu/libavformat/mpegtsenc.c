@@ -965,6 +965,49 @@ static void write_packet(AVFormatContext *s, const uint8_t *packet)
     ts->total_size += TS_PACKET_SIZE;
 }
 
+/* number of TS packets assembled per avio_write() by write_pes_payload_packets() */
+#define TS_PACKET_BATCH 32
+
+/**
+ * Write nb_packets TS packets, each carrying TS_PACKET_SIZE - 4 bytes of
+ * PES payload and no adaptation field, building them in a contiguous
+ * block instead of going through write_packet() one by one.
+ */
+static void write_pes_payload_packets(AVFormatContext *s, AVStream *st,
+                                      const uint8_t *payload, int nb_packets)
+{
+    MpegTSWrite *ts = s->priv_data;
+    MpegTSWriteStream *ts_st = st->priv_data;
+    uint8_t block[TS_PACKET_BATCH * (4 + TS_PACKET_SIZE)];
+    uint8_t pid_hi = ts_st->pid >> 8;
+
+    if (ts->m2ts_mode && st->codecpar->codec_id == AV_CODEC_ID_AC3)
+        pid_hi |= 0x20;
+
+    while (nb_packets > 0) {
+        int n = FFMIN(nb_packets, TS_PACKET_BATCH);
+        uint8_t *q = block;
+
+        for (int i = 0; i < n; i++) {
+            if (ts->m2ts_mode) {
+                AV_WB32(q, get_pcr(ts) % 0x3fffffff);
+                q += 4;
+            }
+            ts_st->cc = ts_st->cc + 1 & 0xf;
+            q[0] = 0x47;
+            q[1] = pid_hi;
+            q[2] = ts_st->pid;
+            q[3] = 0x10 | ts_st->cc;
+            memcpy(q + 4, payload, TS_PACKET_SIZE - 4);
+            payload        += TS_PACKET_SIZE - 4;
+            q              += TS_PACKET_SIZE;
+            ts->total_size += TS_PACKET_SIZE;
+        }
+        avio_write(s->pb, block, q - block);
+        nb_packets -= n;
+    }
+}
+
 static void section_write_packet(MpegTSSection *s, const uint8_t *packet)
 {
     AVFormatContext *ctx = s->opaque;
@@ -1479,6 +1522,12 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
     int force_pat = st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && key && !ts_st->prev_payload_key;
     int force_sdt = 0;
     int force_nit = 0;
+    /* In VBR mode, once the first TS packet of the PES is out, neither PCR
+     * nor SI tables can be inserted before the last one, as the PCR used
+     * to schedule them does not change within the PES. */
+    int batch_payload = ts->mux_rate <= 1 &&
+                        (dts == AV_NOPTS_VALUE ||
+                         ts->pat_period > 0 && ts->sdt_period > 0 && ts->nit_period > 0);
 
     av_assert0(ts_st->payload != buf || st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO);
     if (ts->flags & MPEGTS_FLAG_PAT_PMT_AT_FRAMES && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
@@ -1495,6 +1544,15 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
     is_start = 1;
     while (payload_size > 0) {
         int64_t pcr = AV_NOPTS_VALUE;
+
+        if (batch_payload && !is_start && payload_size > TS_PACKET_SIZE - 4) {
+            /* Leave the last packet, which may need stuffing, to the generic code. */
+            int nb_packets = (payload_size - 1) / (TS_PACKET_SIZE - 4);
+            write_pes_payload_packets(s, st, payload, nb_packets);
+            payload      += nb_packets * (TS_PACKET_SIZE - 4);
+            payload_size -= nb_packets * (TS_PACKET_SIZE - 4);
+        }
+
         if (ts->mux_rate > 1)
             pcr = get_pcr(ts);
         else if (dts != AV_NOPTS_VALUE)
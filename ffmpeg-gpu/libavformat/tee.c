@@ -20,9 +20,14 @@
  */
 
 
+#include "config.h"
 #include "libavutil/avutil.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
+#if HAVE_THREADS
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+#endif
 #include "libavcodec/bsf.h"
 #include "internal.h"
 #include "avformat.h"
@@ -36,6 +41,23 @@ typedef enum {
 
 #define DEFAULT_SLAVE_FAILURE_POLICY ON_SLAVE_FAILURE_ABORT
 
+/** What to do when the queue of a threaded slave is full */
+typedef enum {
+    ON_QUEUE_OVERFLOW_BLOCK = 0, ///< wait for the slave writer thread
+    ON_QUEUE_OVERFLOW_DROP  = 1, ///< drop non-key packets until the next key packet
+    ON_QUEUE_OVERFLOW_ABORT = 2, ///< treat the slave as failed
+} QueueOverflowPolicy;
+
+typedef enum {
+    TEE_MSG_PACKET,
+    TEE_MSG_FLUSH,
+} TeeMessageType;
+
+typedef struct TeeMessage {
+    TeeMessageType type;
+    AVPacket pkt;
+} TeeMessage;
+
 typedef struct {
     AVFormatContext *avf;
     AVBSFContext **bsfs; ///< bitstream filters per stream
@@ -48,6 +70,18 @@ typedef struct {
      * disabled output streams are set to -1 */
     int *stream_map;
     int header_written;
+
+    int use_threads;
+    int queue_size;
+    QueueOverflowPolicy overflow;
+#if HAVE_THREADS
+    AVThreadMessageQueue *queue;
+    pthread_t writer_thread;
+    int thread_started;
+    int thread_ret;         ///< error which terminated the writer thread
+    uint8_t *drop_until_key; ///< per output stream, set after an overflow drop
+    unsigned nb_dropped;
+#endif
 } TeeSlave;
 
 typedef struct TeeContext {
@@ -57,6 +91,9 @@ typedef struct TeeContext {
     TeeSlave *slaves;
     int use_fifo;
     AVDictionary *fifo_options;
+    int use_threads;
+    int queue_size;
+    int overflow;
 } TeeContext;
 
 static const char *const slave_delim     = "|";
@@ -69,6 +106,19 @@ static const AVOption options[] = {
          OFFSET(use_fifo), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
         {"fifo_options", "fifo pseudo-muxer options", OFFSET(fifo_options),
          AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM},
+        {"use_threads", "Write each slave from its own thread through a bounded packet queue",
+         OFFSET(use_threads), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
+        {"queue_size", "Size of the packet queue of each threaded slave",
+         OFFSET(queue_size), AV_OPT_TYPE_INT, {.i64 = 60}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
+        {"overflow", "Behaviour when the queue of a threaded slave is full",
+         OFFSET(overflow), AV_OPT_TYPE_INT, {.i64 = ON_QUEUE_OVERFLOW_BLOCK},
+         ON_QUEUE_OVERFLOW_BLOCK, ON_QUEUE_OVERFLOW_ABORT, AV_OPT_FLAG_ENCODING_PARAM, "overflow"},
+            {"block", "Wait until the slave has room in its queue", 0, AV_OPT_TYPE_CONST,
+             {.i64 = ON_QUEUE_OVERFLOW_BLOCK}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM, "overflow"},
+            {"drop",  "Drop non-key packets until the next key packet", 0, AV_OPT_TYPE_CONST,
+             {.i64 = ON_QUEUE_OVERFLOW_DROP},  0, 0, AV_OPT_FLAG_ENCODING_PARAM, "overflow"},
+            {"abort", "Handle the slave as failed, according to its onfail policy", 0, AV_OPT_TYPE_CONST,
+             {.i64 = ON_QUEUE_OVERFLOW_ABORT}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM, "overflow"},
         {NULL}
 };
 
@@ -115,6 +165,214 @@ static int parse_slave_fifo_options(const char *fifo_options, TeeSlave *tee_slav
     return av_dict_parse_string(&tee_slave->fifo_options, fifo_options, "=", ":", 0);
 }
 
+static int parse_slave_threads_policy(const char *use_threads, TeeSlave *tee_slave)
+{
+    if (av_match_name(use_threads, "true,y,yes,enable,enabled,on,1")) {
+        tee_slave->use_threads = 1;
+    } else if (av_match_name(use_threads, "false,n,no,disable,disabled,off,0")) {
+        tee_slave->use_threads = 0;
+    } else {
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+static int parse_slave_queue_size(const char *queue_size, TeeSlave *tee_slave)
+{
+    char *end;
+    long size = strtol(queue_size, &end, 10);
+
+    if (*end || size < 1 || size > INT_MAX)
+        return AVERROR(EINVAL);
+    tee_slave->queue_size = size;
+    return 0;
+}
+
+static int parse_slave_overflow_policy(const char *overflow, TeeSlave *tee_slave)
+{
+    if (!av_strcasecmp("block", overflow)) {
+        tee_slave->overflow = ON_QUEUE_OVERFLOW_BLOCK;
+    } else if (!av_strcasecmp("drop", overflow)) {
+        tee_slave->overflow = ON_QUEUE_OVERFLOW_DROP;
+    } else if (!av_strcasecmp("abort", overflow)) {
+        tee_slave->overflow = ON_QUEUE_OVERFLOW_ABORT;
+    } else {
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+/**
+ * Run the packet through the bitstream filters of the slave and write
+ * the result. pkt must be a reference owned by the caller, its
+ * stream_index is already mapped to the slave stream.
+ */
+static int write_slave_packet(TeeSlave *tee_slave, AVPacket *pkt, void *log_ctx)
+{
+    AVFormatContext *avf2 = tee_slave->avf;
+    int s2 = pkt->stream_index;
+    AVBSFContext *bsfs = tee_slave->bsfs[s2];
+    int ret;
+
+    ret = av_bsf_send_packet(bsfs, pkt);
+    if (ret < 0) {
+        av_packet_unref(pkt);
+        av_log(log_ctx, AV_LOG_ERROR, "Error while sending packet to bitstream filter: %s\n",
+               av_err2str(ret));
+        return ret;
+    }
+
+    while(1) {
+        ret = av_bsf_receive_packet(bsfs, pkt);
+        if (ret == AVERROR(EAGAIN)) {
+            ret = 0;
+            break;
+        } else if (ret < 0) {
+            break;
+        }
+
+        av_packet_rescale_ts(pkt, bsfs->time_base_out,
+                             avf2->streams[s2]->time_base);
+        ret = av_interleaved_write_frame(avf2, pkt);
+        if (ret < 0)
+            break;
+    };
+
+    return ret;
+}
+
+#if HAVE_THREADS
+static void free_message(void *msg)
+{
+    TeeMessage *tee_msg = msg;
+    av_packet_unref(&tee_msg->pkt);
+}
+
+static void *slave_writer_thread(void *arg)
+{
+    TeeSlave *tee_slave = arg;
+    AVFormatContext *avf2 = tee_slave->avf;
+    TeeMessage msg;
+    int ret;
+
+    while (1) {
+        ret = av_thread_message_queue_recv(tee_slave->queue, &msg, 0);
+        if (ret < 0)
+            break;
+
+        if (msg.type == TEE_MSG_FLUSH)
+            ret = av_interleaved_write_frame(avf2, NULL);
+        else
+            ret = write_slave_packet(tee_slave, &msg.pkt, avf2);
+        av_packet_unref(&msg.pkt);
+
+        if (ret < 0) {
+            tee_slave->thread_ret = ret;
+            /* Report the error to the next send from the main thread. */
+            av_thread_message_queue_set_err_send(tee_slave->queue, ret);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static int start_slave_thread(AVFormatContext *avf, TeeSlave *tee_slave)
+{
+    int ret;
+
+    tee_slave->drop_until_key = av_calloc(tee_slave->avf->nb_streams,
+                                          sizeof(*tee_slave->drop_until_key));
+    if (!tee_slave->drop_until_key)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_alloc(&tee_slave->queue, tee_slave->queue_size,
+                                        sizeof(TeeMessage));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(tee_slave->queue, free_message);
+
+    ret = pthread_create(&tee_slave->writer_thread, NULL, slave_writer_thread, tee_slave);
+    if (ret) {
+        av_log(avf, AV_LOG_ERROR, "Failed to start thread: %s\n",
+               av_err2str(AVERROR(ret)));
+        return AVERROR(ret);
+    }
+    tee_slave->thread_started = 1;
+    return 0;
+}
+
+/**
+ * Wait until the writer thread has written everything still queued
+ * (unless discard is set) and terminate it.
+ *
+ * @return the error which terminated the thread, 0 if none
+ */
+static int stop_slave_thread(TeeSlave *tee_slave, int discard)
+{
+    int ret = 0;
+
+    if (tee_slave->thread_started) {
+        if (discard)
+            av_thread_message_flush(tee_slave->queue);
+        av_thread_message_queue_set_err_recv(tee_slave->queue, AVERROR_EOF);
+        pthread_join(tee_slave->writer_thread, NULL);
+        tee_slave->thread_started = 0;
+        ret = tee_slave->thread_ret;
+    }
+    av_thread_message_queue_free(&tee_slave->queue);
+    av_freep(&tee_slave->drop_until_key);
+    return ret;
+}
+
+/**
+ * Hand a message over to the writer thread of the slave, applying the
+ * overflow policy if its queue is full. The packet of the message is
+ * owned by the queue on success and unreferenced otherwise.
+ */
+static int queue_slave_message(AVFormatContext *avf, TeeSlave *tee_slave,
+                               TeeMessage *msg)
+{
+    AVPacket *pkt = &msg->pkt;
+    int s2 = pkt->stream_index;
+    int flags = 0;
+    int ret;
+
+    if (msg->type == TEE_MSG_PACKET && tee_slave->overflow != ON_QUEUE_OVERFLOW_BLOCK) {
+        if (tee_slave->drop_until_key[s2]) {
+            if (!(pkt->flags & AV_PKT_FLAG_KEY))
+                goto drop;
+            tee_slave->drop_until_key[s2] = 0;
+        }
+        flags = AV_THREAD_MESSAGE_NONBLOCK;
+    }
+
+    ret = av_thread_message_queue_send(tee_slave->queue, msg, flags);
+    if (ret == AVERROR(EAGAIN)) {
+        if (tee_slave->overflow == ON_QUEUE_OVERFLOW_ABORT) {
+            av_log(avf, AV_LOG_ERROR, "Queue of slave '%s' is full.\n",
+                   tee_slave->avf->url);
+            ret = AVERROR(ENOBUFS);
+        } else if (pkt->flags & AV_PKT_FLAG_KEY) {
+            /* Key packets are never dropped, they resynchronize the stream. */
+            ret = av_thread_message_queue_send(tee_slave->queue, msg, 0);
+        } else {
+            tee_slave->drop_until_key[s2] = 1;
+            goto drop;
+        }
+    }
+    if (ret < 0)
+        av_packet_unref(pkt);
+    return ret;
+
+drop:
+    if (!tee_slave->nb_dropped++)
+        av_log(avf, AV_LOG_WARNING, "Queue of slave '%s' is full, dropping packets "
+               "until the next key packet.\n", tee_slave->avf->url);
+    av_packet_unref(pkt);
+    return 0;
+}
+#endif
+
 static int close_slave(TeeSlave *tee_slave)
 {
     AVFormatContext *avf;
@@ -126,8 +384,18 @@ static int close_slave(TeeSlave *tee_slave)
     if (!avf)
         return 0;
 
-    if (tee_slave->header_written)
-        ret = av_write_trailer(avf);
+#if HAVE_THREADS
+    ret = stop_slave_thread(tee_slave, 0);
+    if (tee_slave->nb_dropped)
+        av_log(avf, AV_LOG_VERBOSE, "%u packets dropped on queue overflow\n",
+               tee_slave->nb_dropped);
+#endif
+
+    if (tee_slave->header_written) {
+        int ret2 = av_write_trailer(avf);
+        if (!ret)
+            ret = ret2;
+    }
 
     if (tee_slave->bsfs) {
         for (i = 0; i < avf->nb_streams; ++i)
@@ -161,6 +429,7 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     char *filename;
     char *format = NULL, *select = NULL, *on_fail = NULL;
     char *use_fifo = NULL, *fifo_options_str = NULL;
+    char *use_threads = NULL, *queue_size = NULL, *overflow = NULL;
     AVFormatContext *avf2 = NULL;
     AVStream *st, *st2;
     int stream_count;
@@ -195,6 +464,23 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
                           av_err2str(ret)););
     PROCESS_OPTION("fifo_options", fifo_options_str,
                    parse_slave_fifo_options(fifo_options_str, tee_slave), ;);
+    PROCESS_OPTION("use_threads", use_threads,
+                   parse_slave_threads_policy(use_threads, tee_slave),
+                   av_log(avf, AV_LOG_ERROR, "Invalid use_threads option value\n"););
+    PROCESS_OPTION("queue_size", queue_size,
+                   parse_slave_queue_size(queue_size, tee_slave),
+                   av_log(avf, AV_LOG_ERROR, "Invalid queue_size option value\n"););
+    PROCESS_OPTION("overflow", overflow,
+                   parse_slave_overflow_policy(overflow, tee_slave),
+                   av_log(avf, AV_LOG_ERROR, "Invalid overflow option value, "
+                          "valid options are 'block', 'drop' and 'abort'\n"););
+#if !HAVE_THREADS
+    if (tee_slave->use_threads) {
+        av_log(avf, AV_LOG_ERROR, "Threaded slaves require thread support\n");
+        ret = AVERROR(ENOSYS);
+        goto end;
+    }
+#endif
     entry = NULL;
     while ((entry = av_dict_get(options, "bsfs", entry, AV_DICT_IGNORE_SUFFIX))) {
         /* trim out strlen("bsfs") characters from key */
@@ -398,6 +684,11 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
         goto end;
     }
 
+#if HAVE_THREADS
+    if (tee_slave->use_threads)
+        ret = start_slave_thread(avf, tee_slave);
+#endif
+
 end:
     av_free(format);
     av_free(select);
@@ -434,6 +725,10 @@ static int tee_process_slave_failure(AVFormatContext *avf, unsigned slave_idx, i
 
     tee->nb_alive--;
 
+#if HAVE_THREADS
+    /* Whatever is still queued for a failed slave is discarded. */
+    stop_slave_thread(tee_slave, 1);
+#endif
     close_slave(tee_slave);
 
     if (!tee->nb_alive) {
@@ -481,6 +776,9 @@ static int tee_write_header(AVFormatContext *avf)
     for (i = 0; i < nb_slaves; i++) {
 
         tee->slaves[i].use_fifo = tee->use_fifo;
+        tee->slaves[i].use_threads = tee->use_threads;
+        tee->slaves[i].queue_size  = tee->queue_size;
+        tee->slaves[i].overflow    = tee->overflow;
         ret = av_dict_copy(&tee->slaves[i].fifo_options, tee->fifo_options, 0);
         if (ret < 0)
             goto fail;
@@ -536,18 +834,27 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
 {
     TeeContext *tee = avf->priv_data;
     AVFormatContext *avf2;
-    AVBSFContext *bsfs;
     AVPacket *const pkt2 = ffformatcontext(avf)->pkt;
     int ret_all = 0, ret;
     unsigned i, s;
     int s2;
 
     for (i = 0; i < tee->nb_slaves; i++) {
-        if (!(avf2 = tee->slaves[i].avf))
+        TeeSlave *tee_slave = &tee->slaves[i];
+#if HAVE_THREADS
+        TeeMessage msg = { .type = pkt ? TEE_MSG_PACKET : TEE_MSG_FLUSH };
+#endif
+
+        if (!(avf2 = tee_slave->avf))
             continue;
 
         /* Flush slave if pkt is NULL*/
         if (!pkt) {
+#if HAVE_THREADS
+            if (tee_slave->queue)
+                ret = queue_slave_message(avf, tee_slave, &msg);
+            else
+#endif
             ret = av_interleaved_write_frame(avf2, NULL);
             if (ret < 0) {
                 ret = tee_process_slave_failure(avf, i, ret);
@@ -558,7 +865,7 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
         }
 
         s = pkt->stream_index;
-        s2 = tee->slaves[i].stream_map[s];
+        s2 = tee_slave->stream_map[s];
         if (s2 < 0)
             continue;
 
@@ -567,34 +874,15 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
                 ret_all = ret;
             continue;
         }
-        bsfs = tee->slaves[i].bsfs[s2];
         pkt2->stream_index = s2;
 
-        ret = av_bsf_send_packet(bsfs, pkt2);
-        if (ret < 0) {
-            av_packet_unref(pkt2);
-            av_log(avf, AV_LOG_ERROR, "Error while sending packet to bitstream filter: %s\n",
-                   av_err2str(ret));
-            ret = tee_process_slave_failure(avf, i, ret);
-            if (!ret_all && ret < 0)
-                ret_all = ret;
-        }
-
-        while(1) {
-            ret = av_bsf_receive_packet(bsfs, pkt2);
-            if (ret == AVERROR(EAGAIN)) {
-                ret = 0;
-                break;
-            } else if (ret < 0) {
-                break;
-            }
-
-            av_packet_rescale_ts(pkt2, bsfs->time_base_out,
-                                 avf2->streams[s2]->time_base);
-            ret = av_interleaved_write_frame(avf2, pkt2);
-            if (ret < 0)
-                break;
-        };
+#if HAVE_THREADS
+        if (tee_slave->queue) {
+            av_packet_move_ref(&msg.pkt, pkt2);
+            ret = queue_slave_message(avf, tee_slave, &msg);
+        } else
+#endif
+        ret = write_slave_packet(tee_slave, pkt2, avf);
 
         if (ret < 0) {
             ret = tee_process_slave_failure(avf, i, ret);
@@ -0,0 +1,251 @@
+/*
+ * AVIOContext buffering test and benchmark
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+#include "libavformat/avio_internal.h"
+
+#define REF_SIZE (4 << 20)
+
+static uint8_t *ref;
+static int64_t ref_size;
+
+static void fill_random(AVLFG *lfg, uint8_t *buf, int size)
+{
+    int i;
+    for (i = 0; i < size; i++)
+        buf[i] = av_lfg_get(lfg);
+}
+
+static int write_ref(AVIOContext *pb, AVLFG *lfg, int size)
+{
+    int64_t pos = avio_tell(pb);
+
+    if (pos + size > REF_SIZE)
+        return AVERROR(ENOSPC);
+    fill_random(lfg, ref + pos, size);
+    avio_write(pb, ref + pos, size);
+    ref_size = FFMAX(ref_size, pos + size);
+    return 0;
+}
+
+static int test_write(const char *path)
+{
+    static const int large[] = { 100000, 262144, 5, 300001, 1 << 20, 77777 };
+    AVIOContext *pb = NULL;
+    AVLFG lfg;
+    int64_t end;
+    int i, ret, seeks, back;
+
+    av_lfg_init(&lfg, 0xA510);
+    ret = avio_open(&pb, path, AVIO_FLAG_WRITE);
+    if (ret < 0)
+        return ret;
+
+    /* placeholder for a size field, written at the end */
+    avio_wb32(pb, 0);
+    ref_size = 4;
+
+    /* many small writes make the buffer grow */
+    for (i = 0; i < 1 << 16; i++) {
+        if ((ret = write_ref(pb, &lfg, 1 + (i & 7))) < 0)
+            goto end;
+    }
+    printf("write: buffer size after small writes %d\n", pb->buffer_size);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(large); i++) {
+        if ((ret = write_ref(pb, &lfg, 3 + i)) < 0 ||
+            (ret = write_ref(pb, &lfg, large[i])) < 0)
+            goto end;
+
+        /* the end of a large write can still be sought back to */
+        back  = FFMIN(16, pb->buf_ptr - pb->buffer);
+        back  = back >= 4 ? back : 0;
+        seeks = ffiocontext(pb)->seek_count;
+        end   = avio_tell(pb);
+        if (back) {
+            avio_seek(pb, end - back, SEEK_SET);
+            AV_WB32(ref + end - back, 0xdeadbeef);
+            avio_wb32(pb, 0xdeadbeef);
+            avio_seek(pb, end, SEEK_SET);
+        }
+        printf("write: %d bytes, sought back %d bytes with %d protocol seeks\n",
+               large[i], back, ffiocontext(pb)->seek_count - seeks);
+    }
+
+    /* patch the size field, the buffer goes back to its initial size */
+    end = avio_tell(pb);
+    avio_seek(pb, 0, SEEK_SET);
+    avio_wb32(pb, end);
+    AV_WB32(ref, end);
+    avio_seek(pb, end, SEEK_SET);
+    printf("write: buffer size after seek %d\n", pb->buffer_size);
+
+    if ((ret = write_ref(pb, &lfg, 70000)) < 0)
+        goto end;
+    ret = pb->error;
+
+end:
+    if (ret < 0)
+        avio_close(pb);
+    else
+        ret = avio_close(pb);
+    return ret;
+}
+
+static int check(const char *what, const uint8_t *buf, int64_t pos, int size)
+{
+    if (memcmp(buf, ref + pos, size)) {
+        printf("%s: mismatch at %"PRId64"\n", what, pos);
+        return AVERROR_BUG;
+    }
+    return 0;
+}
+
+static int test_read(const char *path)
+{
+    static const int64_t seeks[] = { 1 << 20, 12345, 2 << 20, 0 };
+    AVIOContext *pb = NULL;
+    uint8_t *buf = NULL;
+    int64_t pos = 0;
+    int i, ret;
+
+    ret = avio_open(&pb, path, AVIO_FLAG_READ);
+    if (ret < 0)
+        return ret;
+    if (avio_size(pb) != ref_size) {
+        printf("read: size %"PRId64" expected %"PRId64"\n", avio_size(pb), ref_size);
+        ret = AVERROR_BUG;
+        goto end;
+    }
+    buf = av_malloc(ref_size);
+    if (!buf) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    /* sequential reads make the buffer grow */
+    while (pos < ref_size) {
+        int size = FFMIN(1000, ref_size - pos);
+        if ((ret = avio_read(pb, buf, size)) != size) {
+            ret = ret < 0 ? ret : AVERROR_BUG;
+            goto end;
+        }
+        if ((ret = check("read", buf, pos, size)) < 0)
+            goto end;
+        pos += size;
+    }
+    printf("read: buffer size after sequential reads %d\n", pb->buffer_size);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(seeks); i++) {
+        int size = FFMIN(300000, ref_size - seeks[i]);
+        if ((ret = avio_seek(pb, seeks[i], SEEK_SET)) < 0)
+            goto end;
+        if ((ret = avio_read(pb, buf, size)) != size) {
+            ret = ret < 0 ? ret : AVERROR_BUG;
+            goto end;
+        }
+        if ((ret = check("seek", buf, seeks[i], size)) < 0)
+            goto end;
+        printf("read: %d bytes at %"PRId64", buffer size %d\n",
+               size, seeks[i], pb->buffer_size);
+    }
+    ret = 0;
+
+end:
+    av_free(buf);
+    avio_close(pb);
+    return ret;
+}
+
+static int benchmark(const char *path, int64_t total)
+{
+    static const int sizes[] = { 16, 188, 4096, 65536, 1 << 20 };
+    AVIOContext *pb;
+    uint8_t *buf;
+    int i, ret = 0;
+
+    buf = av_mallocz(sizes[FF_ARRAY_ELEMS(sizes) - 1]);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(sizes); i++) {
+        int64_t t, done = 0;
+        int writeouts;
+
+        if ((ret = avio_open(&pb, path, AVIO_FLAG_WRITE)) < 0)
+            break;
+        t = av_gettime_relative();
+        for (done = 0; done < total; done += sizes[i])
+            avio_write(pb, buf, sizes[i]);
+        avio_flush(pb);
+        t = av_gettime_relative() - t;
+        writeouts = ffiocontext(pb)->writeout_count;
+        printf("write %7d byte chunks: %6d writeouts, buffer %6d, %8.1f MiB/s\n",
+               sizes[i], writeouts, pb->buffer_size,
+               done / (1048576.0 * FFMAX(t, 1) / 1000000));
+        if ((ret = avio_close(pb)) < 0)
+            break;
+
+        if ((ret = avio_open(&pb, path, AVIO_FLAG_READ)) < 0)
+            break;
+        t = av_gettime_relative();
+        for (done = 0; (ret = avio_read(pb, buf, sizes[i])) > 0; done += ret)
+            ;
+        t = av_gettime_relative() - t;
+        printf("read  %7d byte chunks: buffer %6d, %8.1f MiB/s\n",
+               sizes[i], pb->buffer_size,
+               done / (1048576.0 * FFMAX(t, 1) / 1000000));
+        avio_close(pb);
+        ret = 0;
+    }
+    av_free(buf);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int ret;
+
+    if (argc > 2 && !strcmp(argv[1], "-b"))
+        return benchmark(argv[2], (argc > 3 ? atoi(argv[3]) : 256) * 1048576LL) < 0;
+
+    if (argc < 2) {
+        printf("usage: %s [-b] file [MiB]\n", argv[0]);
+        return 1;
+    }
+
+    ref = av_mallocz(REF_SIZE);
+    if (!ref)
+        return 1;
+    ret = test_write(argv[1]);
+    if (ret >= 0)
+        ret = test_read(argv[1]);
+    if (ret < 0)
+        printf("failed: %s\n", av_err2str(ret));
+    av_free(ref);
+    return ret < 0;
+}
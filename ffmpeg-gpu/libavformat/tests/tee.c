@@ -0,0 +1,245 @@
+/*
+ * Tee muxer threaded slaves test
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+#define SLEEPTIME_100_MS 100000
+#define WAIT_TIMEOUT_US  10000000
+
+/* The "slow" output either blocks in its write callback until the gate is
+ * opened, or sleeps for a while on each write. The "fast" output never
+ * blocks. Each one counts the framecrc lines it received. */
+typedef struct TestOutput {
+    const char *name;
+    int nb_packets;
+    int at_line_start;
+    int in_comment;
+    int entered;
+    int gated;
+    int sleep_us;
+} TestOutput;
+
+static TestOutput outputs[2];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static int output_write(void *opaque, uint8_t *buf, int size)
+{
+    TestOutput *out = opaque;
+    int i;
+
+    pthread_mutex_lock(&lock);
+    out->entered++;
+    pthread_cond_broadcast(&cond);
+    while (out->gated)
+        pthread_cond_wait(&cond, &lock);
+    pthread_mutex_unlock(&lock);
+
+    if (out->sleep_us)
+        av_usleep(out->sleep_us);
+
+    pthread_mutex_lock(&lock);
+    for (i = 0; i < size; i++) {
+        if (out->at_line_start)
+            out->in_comment = buf[i] == '#';
+        out->at_line_start = buf[i] == '\n';
+        if (out->at_line_start && !out->in_comment)
+            out->nb_packets++;
+    }
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+    return size;
+}
+
+static int io_open(AVFormatContext *s, AVIOContext **pb, const char *url,
+                   int flags, AVDictionary **options)
+{
+    TestOutput *out = !strcmp(url, "slow") ? &outputs[1] : &outputs[0];
+    uint8_t *buf = av_malloc(4096);
+
+    if (!buf)
+        return AVERROR(ENOMEM);
+    *pb = avio_alloc_context(buf, 4096, 1, out, NULL, output_write, NULL);
+    if (!*pb) {
+        av_free(buf);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static int io_close2(AVFormatContext *s, AVIOContext *pb)
+{
+    avio_flush(pb);
+    av_freep(&pb->buffer);
+    avio_context_free(&pb);
+    return 0;
+}
+
+static int wait_for(int *value, int target)
+{
+    int64_t deadline = av_gettime_relative() + WAIT_TIMEOUT_US;
+    int ret = 0;
+
+    pthread_mutex_lock(&lock);
+    while (*value < target && av_gettime_relative() < deadline) {
+        pthread_mutex_unlock(&lock);
+        av_usleep(1000);
+        pthread_mutex_lock(&lock);
+    }
+    if (*value < target)
+        ret = AVERROR(ETIMEDOUT);
+    pthread_mutex_unlock(&lock);
+    return ret;
+}
+
+static void set_gate(int gated)
+{
+    pthread_mutex_lock(&lock);
+    outputs[1].gated = gated;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+static int write_packet(AVFormatContext *oc, AVPacket *pkt, int64_t pts, int key)
+{
+    int ret = av_new_packet(pkt, 16);
+    if (ret < 0)
+        return ret;
+    memset(pkt->data, pts, pkt->size);
+    pkt->pts = pkt->dts = pts;
+    pkt->duration = 1;
+    pkt->flags = key ? AV_PKT_FLAG_KEY : 0;
+    return av_write_frame(oc, pkt);
+}
+
+/**
+ * Write nb_stalled packets (only the first one being a key packet) while
+ * the slow output is stalled, then a key packet once it runs again.
+ */
+static int run_test(const char *name, const char *slow_opts, int gated,
+                    int nb_stalled)
+{
+    AVFormatContext *oc = NULL;
+    AVDictionary *opts = NULL;
+    AVPacket *pkt = NULL;
+    AVStream *st;
+    char url[256];
+    int i, ret, fast_stalled, slow_entered;
+
+    memset(outputs, 0, sizeof(outputs));
+    outputs[0].name = "fast";
+    outputs[1].name = "slow";
+    outputs[0].at_line_start = outputs[1].at_line_start = 1;
+    if (!gated)
+        outputs[1].sleep_us = SLEEPTIME_100_MS;
+
+    snprintf(url, sizeof(url),
+             "[f=framecrc:flush_packets=1:queue_size=%d]fast|"
+             "[f=framecrc:flush_packets=1:onfail=ignore:%s]slow",
+             nb_stalled + 1, slow_opts);
+
+    ret = avformat_alloc_output_context2(&oc, NULL, "tee", url);
+    if (ret < 0)
+        goto end;
+    oc->io_open   = io_open;
+    oc->io_close2 = io_close2;
+
+    st = avformat_new_stream(oc, NULL);
+    pkt = av_packet_alloc();
+    if (!st || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    /* Packets of intra-only codecs are all flagged as key packets. */
+    st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    st->codecpar->codec_id   = AV_CODEC_ID_H264;
+    st->codecpar->width      = 16;
+    st->codecpar->height     = 16;
+    st->time_base            = (AVRational){ 1, 25 };
+
+    av_dict_set(&opts, "use_threads", "1", 0);
+    ret = avformat_write_header(oc, &opts);
+    if (ret < 0)
+        goto end;
+
+    pthread_mutex_lock(&lock);
+    slow_entered = outputs[1].entered;
+    pthread_mutex_unlock(&lock);
+    set_gate(gated);
+
+    /* Let the slow output take the first packet before filling its queue. */
+    ret = write_packet(oc, pkt, 0, 1);
+    if (ret < 0)
+        goto end;
+    if ((ret = wait_for(&outputs[1].entered, slow_entered + 1)) < 0)
+        goto end;
+
+    for (i = 1; i < nb_stalled; i++) {
+        ret = write_packet(oc, pkt, i, 0);
+        if (ret < 0)
+            goto end;
+    }
+    if ((ret = wait_for(&outputs[0].nb_packets, nb_stalled)) < 0)
+        goto end;
+
+    pthread_mutex_lock(&lock);
+    fast_stalled = outputs[0].nb_packets;
+    pthread_mutex_unlock(&lock);
+    set_gate(0);
+
+    ret = write_packet(oc, pkt, nb_stalled, 1);
+    if (ret < 0)
+        goto end;
+
+    ret = av_write_trailer(oc);
+    if (ret < 0)
+        goto end;
+
+    printf("%s: fast output got %d packets while slow output was stalled, "
+           "final packets fast %d slow %d\n", name, fast_stalled,
+           outputs[0].nb_packets, outputs[1].nb_packets);
+
+end:
+    if (ret < 0)
+        printf("%s: failed: %s\n", name, av_err2str(ret));
+    set_gate(0);
+    av_dict_free(&opts);
+    av_packet_free(&pkt);
+    avformat_free_context(oc);
+    return ret;
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    ret |= run_test("block", "queue_size=64:overflow=block", 1, 30);
+    ret |= run_test("drop",  "queue_size=4:overflow=drop",   1, 30);
+    ret |= run_test("abort", "queue_size=4:overflow=abort",  0, 30);
+
+    return ret < 0 ? 1 : 0;
+}
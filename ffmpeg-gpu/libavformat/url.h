@@ -50,6 +50,14 @@ typedef struct URLContext {
     int min_packet_size;        /**< if non zero, the stream is packetized with this min packet size */
 } URLContext;
 
+/**
+ * One element of a gathered write, see URLProtocol.url_write_vec.
+ */
+typedef struct URLIOVec {
+    const uint8_t *data;
+    int size;
+} URLIOVec;
+
 typedef struct URLProtocol {
     const char *name;
     int     (*url_open)( URLContext *h, const char *url, int flags);
@@ -76,6 +84,13 @@ typedef struct URLProtocol {
      */
     int     (*url_read)( URLContext *h, unsigned char *buf, int size);
     int     (*url_write)(URLContext *h, const unsigned char *buf, int size);
+    /**
+     * Write the iovcnt buffers of iov in order, as one operation if possible.
+     * Same semantics as url_write otherwise: return the number of bytes
+     * written, which may be less than the total, or an AVERROR code.
+     * AVERROR(ENOSYS) makes the caller fall back to url_write.
+     */
+    int     (*url_write_vec)(URLContext *h, const URLIOVec *iov, int iovcnt);
     int64_t (*url_seek)( URLContext *h, int64_t pos, int whence);
     int     (*url_close)(URLContext *h);
     int (*url_read_pause)(URLContext *h, int pause);
@@ -198,6 +213,15 @@ int ffurl_read_complete(URLContext *h, unsigned char *buf, int size);
  */
 int ffurl_write(URLContext *h, const unsigned char *buf, int size);
 
+/**
+ * Write the iovcnt buffers of iov, in order, to the resource accessed by h,
+ * using a single gathered write where the protocol supports it.
+ *
+ * @return the number of bytes actually written, or a negative value
+ * corresponding to an AVERROR code in case of failure
+ */
+int ffurl_write_vec(URLContext *h, const URLIOVec *iov, int iovcnt);
+
 /**
  * Change the position that will be used by the next read/write
  * operation on the resource accessed by h.
@@ -110,6 +110,21 @@ int av_cpu_count(void);
  */
 void av_cpu_force_count(int count);
 
+/**
+ * Run the slice threads of the codec contexts and filter graphs created
+ * after this call on one process-wide pool of threads, instead of threads
+ * owned by each context. A context still runs at most as many jobs at once
+ * as its thread count, and the contexts get the pool threads in turn.
+ * Frame threads are not affected.
+ *
+ * The pool threads are started on first use and live until the process
+ * exits; the pool can grow but not shrink.
+ *
+ * @param nb_threads number of pool threads, 0 for the number of CPUs,
+ *                   < 0 to give the contexts created later their own threads
+ */
+void av_cpu_set_thread_pool(int nb_threads);
+
 /**
  * Get the maximum data alignment that may be required by FFmpeg.
  *
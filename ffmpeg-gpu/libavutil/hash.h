@@ -102,6 +102,9 @@
  * If the Murmur3 hash is selected, the default seed will be used. See @ref
  * lavu_murmur3_seedinfo "Murmur3" for more information.
  *
+ * If the XXH64 hash is selected, the seed is 0. It is not a cryptographic
+ * hash, but the fastest of the list; see @ref lavu_xxhash "xxHash64".
+ *
  * @{
  */
 
@@ -23,6 +23,7 @@
 
 #include "avassert.h"
 #include "common.h"
+#include "cpu.h"
 #include "imgutils.h"
 #include "imgutils_internal.h"
 #include "internal.h"
@@ -31,6 +32,13 @@
 #include "mathematics.h"
 #include "pixdesc.h"
 #include "rational.h"
+#include "slicethread.h"
+
+/* minimum number of bytes copied by a pool thread */
+#define COPY_JOB_SIZE        (1 << 20)
+/* minimum number of bytes copied by a thread started for the copy, which
+ * takes about as long to start and join as copying 1 MiB */
+#define COPY_NEW_THREAD_SIZE (1 << 22)
 
 void av_image_fill_max_pixsteps(int max_pixsteps[4], int max_pixstep_comps[4],
                                 const AVPixFmtDescriptor *pixdesc)
@@ -349,6 +357,10 @@ static void image_copy_plane(uint8_t       *dst, ptrdiff_t dst_linesize,
         return;
     av_assert0(FFABS(src_linesize) >= bytewidth);
     av_assert0(FFABS(dst_linesize) >= bytewidth);
+    if (height > 1 && dst_linesize == bytewidth && src_linesize == bytewidth) {
+        bytewidth *= height;
+        height     = 1;
+    }
     for (;height > 0; height--) {
         memcpy(dst, src, bytewidth);
         dst += dst_linesize;
@@ -443,6 +455,80 @@ void av_image_copy_uc_from(uint8_t *dst_data[4], const ptrdiff_t dst_linesizes[4
                width, height, av_image_copy_plane_uc_from);
 }
 
+typedef struct ImageCopyThread {
+    uint8_t *const       *dst_data;
+    const ptrdiff_t      *dst_linesizes;
+    const uint8_t *const *src_data;
+    const ptrdiff_t      *src_linesizes;
+    enum AVPixelFormat    pix_fmt;
+    int                   width, height;
+    int                   log2_chroma_h;
+} ImageCopyThread;
+
+static void image_copy_worker(void *priv, int jobnr, int threadnr,
+                              int nb_jobs, int nb_threads)
+{
+    const ImageCopyThread *c = priv;
+    /* the rows of a job start on a chroma row */
+    const int mask = -(1 << c->log2_chroma_h);
+    int y0 =  (int)((int64_t)c->height *  jobnr      / nb_jobs) & mask;
+    int y1 = jobnr == nb_jobs - 1 ? c->height :
+              (int)((int64_t)c->height * (jobnr + 1) / nb_jobs) & mask;
+    uint8_t *dst_data[4];
+    const uint8_t *src_data[4];
+
+    if (y0 >= y1)
+        return;
+
+    for (int i = 0; i < 4; i++) {
+        int y = i == 1 || i == 2 ? y0 >> c->log2_chroma_h : y0;
+        dst_data[i] = c->dst_data[i] ? c->dst_data[i] + y * c->dst_linesizes[i] : NULL;
+        src_data[i] = c->src_data[i] ? c->src_data[i] + y * c->src_linesizes[i] : NULL;
+    }
+    image_copy(dst_data, c->dst_linesizes, src_data, c->src_linesizes,
+               c->pix_fmt, c->width, y1 - y0, image_copy_plane);
+}
+
+void av_image_copy_threads(uint8_t *dst_data[4],       const ptrdiff_t dst_linesizes[4],
+                           const uint8_t *src_data[4], const ptrdiff_t src_linesizes[4],
+                           enum AVPixelFormat pix_fmt, int width, int height,
+                           int nb_threads)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+    int size = av_image_get_buffer_size(pix_fmt, width, height, 1);
+    /* without the pool, each call starts and joins its threads */
+    int nb_jobs = size / (avpriv_slicethread_pool_size() ? COPY_JOB_SIZE :
+                                                          COPY_NEW_THREAD_SIZE);
+
+    nb_threads = FFMIN(nb_threads ? nb_threads : av_cpu_count(), nb_jobs);
+    if (nb_threads > 1 &&
+        desc && !(desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+        ImageCopyThread c = {
+            .dst_data      = dst_data,
+            .dst_linesizes = dst_linesizes,
+            .src_data      = src_data,
+            .src_linesizes = src_linesizes,
+            .pix_fmt       = pix_fmt,
+            .width         = width,
+            .height        = height,
+            .log2_chroma_h = desc->log2_chroma_h,
+        };
+        AVSliceThread *thread = NULL;
+        int ret = avpriv_slicethread_create(&thread, &c, image_copy_worker,
+                                            NULL, nb_threads);
+
+        if (ret > 1) {
+            avpriv_slicethread_execute(thread, FFMIN(nb_jobs, ret), 0);
+            avpriv_slicethread_free(&thread);
+            return;
+        }
+        avpriv_slicethread_free(&thread);
+    }
+
+    image_copy(dst_data, dst_linesizes, src_data, src_linesizes, pix_fmt,
+               width, height, image_copy_plane);
+}
+
 int av_image_fill_arrays(uint8_t *dst_data[4], int dst_linesize[4],
                          const uint8_t *src, enum AVPixelFormat pix_fmt,
                          int width, int height, int align)
@@ -172,6 +172,24 @@ void av_image_copy_uc_from(uint8_t *dst_data[4],       const ptrdiff_t dst_lines
                            const uint8_t *src_data[4], const ptrdiff_t src_linesizes[4],
                            enum AVPixelFormat pix_fmt, int width, int height);
 
+/**
+ * Copy image in src_data to dst_data like av_image_copy(), splitting the rows
+ * of large images between several threads. The threads are taken from the
+ * pool set up with av_cpu_set_thread_pool() if it is enabled. Otherwise they
+ * are started for the call, and only for images large enough to make up for
+ * starting them. Small images and palettized formats are copied by the
+ * calling thread.
+ *
+ * @note The linesize parameters have the type ptrdiff_t here, while they are
+ *       int for av_image_copy().
+ *
+ * @param nb_threads maximum number of threads, 0 for the number of CPUs
+ */
+void av_image_copy_threads(uint8_t *dst_data[4],       const ptrdiff_t dst_linesizes[4],
+                           const uint8_t *src_data[4], const ptrdiff_t src_linesizes[4],
+                           enum AVPixelFormat pix_fmt, int width, int height,
+                           int nb_threads);
+
 /**
  * Setup the data pointers and linesizes based on the specified image
  * parameters and the provided array.
@@ -17,6 +17,7 @@
  */
 
 #include <stdatomic.h>
+#include "common.h"
 #include "cpu.h"
 #include "internal.h"
 #include "slicethread.h"
@@ -50,8 +51,200 @@ struct AVSliceThread {
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
+
+    /* the jobs are run by the threads of the shared pool, the fields below
+     * are protected by the pool mutex */
+    int             shared;
+    AVSliceThread   *next;              ///< next context waiting for pool threads
+    int             nb_helpers_wanted;  ///< pool threads still wanted by this execution
+    int             nb_helpers;         ///< pool threads running this execution
 };
 
+/**
+ * Process-wide pool of worker threads, for the contexts created while it is
+ * enabled. The contexts waiting for pool threads form a queue, a context gets
+ * one thread and goes back to the end of the queue if it wants more, so that
+ * the pool is shared in turn by all running executions. The thread calling
+ * avpriv_slicethread_execute() runs jobs as well, and only as many threads
+ * as the context has slots run its jobs at once.
+ */
+typedef struct ThreadPool {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    pthread_t       *threads;
+    int             nb_threads;
+    int             size;               ///< requested number of threads, < 0 if disabled
+
+    AVSliceThread   *first, *last;
+} ThreadPool;
+
+static ThreadPool pool;
+static AVOnce pool_init_once = AV_ONCE_INIT;
+
+static void pool_init(void)
+{
+    pthread_mutex_init(&pool.mutex, NULL);
+    pthread_cond_init(&pool.cond, NULL);
+    pool.size = -1;
+}
+
+/* run jobs of the current execution in a thread slot, if one is left.
+ * As with threads of its own, slot k runs job k first. The slots nobody has
+ * taken yet are taken in turn before the remaining jobs, so that whenever a
+ * job waits for an earlier one, that one has been started by some thread. */
+static void run_jobs_shared(AVSliceThread *ctx)
+{
+    unsigned nb_jobs           = ctx->nb_jobs;
+    unsigned nb_active_threads = ctx->nb_active_threads;
+    unsigned threadnr = atomic_fetch_add_explicit(&ctx->first_job, 1, memory_order_acq_rel);
+    unsigned next, jobnr;
+
+    if (threadnr >= nb_active_threads)
+        return;
+    while (1) {
+        ctx->worker_func(ctx->priv, threadnr, threadnr, nb_jobs, nb_active_threads);
+        next = atomic_fetch_add_explicit(&ctx->first_job, 1, memory_order_acq_rel);
+        if (next >= nb_active_threads)
+            break;
+        threadnr = next;
+    }
+    while ((jobnr = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs)
+        ctx->worker_func(ctx->priv, jobnr, threadnr, nb_jobs, nb_active_threads);
+}
+
+static void pool_push(AVSliceThread *ctx)
+{
+    ctx->next = NULL;
+    if (pool.last)
+        pool.last->next = ctx;
+    else
+        pool.first = ctx;
+    pool.last = ctx;
+}
+
+static void pool_remove(AVSliceThread *ctx)
+{
+    AVSliceThread **p = &pool.first, *prev = NULL;
+
+    while (*p && *p != ctx) {
+        prev = *p;
+        p    = &prev->next;
+    }
+    if (!*p)
+        return;
+    *p = ctx->next;
+    if (pool.last == ctx)
+        pool.last = prev;
+    ctx->next = NULL;
+}
+
+static void *attribute_align_arg pool_worker(void *arg)
+{
+    pthread_mutex_lock(&pool.mutex);
+    while (1) {
+        AVSliceThread *ctx = pool.first;
+
+        if (!ctx) {
+            pthread_cond_wait(&pool.cond, &pool.mutex);
+            continue;
+        }
+
+        pool_remove(ctx);
+        if (--ctx->nb_helpers_wanted)
+            pool_push(ctx);
+        ctx->nb_helpers++;
+        pthread_mutex_unlock(&pool.mutex);
+
+        run_jobs_shared(ctx);
+
+        pthread_mutex_lock(&pool.mutex);
+        if (!--ctx->nb_helpers)
+            pthread_cond_signal(&ctx->done_cond);
+    }
+    return NULL;
+}
+
+/* start the missing pool threads, return the number of pool threads or 0
+ * if the pool is disabled */
+static int pool_start(void)
+{
+    int nb_threads;
+
+    ff_thread_once(&pool_init_once, pool_init);
+    pthread_mutex_lock(&pool.mutex);
+    while (pool.nb_threads < pool.size) {
+        pthread_t *threads = av_realloc_array(pool.threads, pool.size, sizeof(*threads));
+        if (!threads)
+            break;
+        pool.threads = threads;
+        if (pthread_create(&pool.threads[pool.nb_threads], NULL, pool_worker, NULL))
+            break;
+        pool.nb_threads++;
+    }
+    nb_threads = pool.size < 0 ? 0 : pool.nb_threads;
+    pthread_mutex_unlock(&pool.mutex);
+
+    return nb_threads;
+}
+
+void av_cpu_set_thread_pool(int nb_threads)
+{
+    ff_thread_once(&pool_init_once, pool_init);
+    pthread_mutex_lock(&pool.mutex);
+    pool.size = nb_threads < 0 ? -1 : nb_threads ? nb_threads : av_cpu_count();
+    pthread_mutex_unlock(&pool.mutex);
+}
+
+int avpriv_slicethread_pool_size(void)
+{
+    int size;
+
+    ff_thread_once(&pool_init_once, pool_init);
+    pthread_mutex_lock(&pool.mutex);
+    size = FFMAX(pool.size, 0);
+    pthread_mutex_unlock(&pool.mutex);
+
+    return size;
+}
+
+static void execute_shared(AVSliceThread *ctx, int nb_jobs, int execute_main)
+{
+    int run_main = ctx->main_func && execute_main;
+    int nb_helpers;
+
+    ctx->nb_jobs           = nb_jobs;
+    ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
+    atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
+    atomic_store_explicit(&ctx->current_job, ctx->nb_active_threads, memory_order_relaxed);
+    nb_helpers             = ctx->nb_active_threads - !run_main;
+
+    if (!nb_helpers) {
+        run_jobs_shared(ctx);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.mutex);
+    ctx->nb_helpers_wanted = nb_helpers;
+    pool_push(ctx);
+    for (int i = 0; i < FFMIN(nb_helpers, pool.nb_threads); i++)
+        pthread_cond_signal(&pool.cond);
+    pthread_mutex_unlock(&pool.mutex);
+
+    if (run_main)
+        ctx->main_func(ctx->priv);
+    /* afterwards every slot has been taken, by this thread or by a pool
+     * thread counted in nb_helpers */
+    run_jobs_shared(ctx);
+
+    pthread_mutex_lock(&pool.mutex);
+    while (ctx->nb_helpers)
+        pthread_cond_wait(&ctx->done_cond, &pool.mutex);
+    if (ctx->nb_helpers_wanted)
+        pool_remove(ctx);
+    ctx->nb_helpers_wanted = 0;
+    pthread_mutex_unlock(&pool.mutex);
+}
+
 static int run_jobs(AVSliceThread *ctx)
 {
     unsigned nb_jobs    = ctx->nb_jobs;
@@ -99,7 +292,7 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               int nb_threads)
 {
     AVSliceThread *ctx;
-    int nb_workers, i;
+    int nb_workers, shared, i;
 
     av_assert0(nb_threads >= 0);
     if (!nb_threads) {
@@ -113,6 +306,9 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     nb_workers = nb_threads;
     if (!main_func)
         nb_workers--;
+    shared = nb_workers && pool_start() > 0;
+    if (shared)
+        nb_workers = 0;
 
     *pctx = ctx = av_mallocz(sizeof(*ctx));
     if (!ctx)
@@ -127,6 +323,7 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     ctx->worker_func = worker_func;
     ctx->main_func   = main_func;
     ctx->nb_threads  = nb_threads;
+    ctx->shared      = shared;
     ctx->nb_active_threads = 0;
     ctx->nb_jobs     = 0;
     ctx->finished    = 0;
@@ -168,6 +365,11 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     int nb_workers, i, is_last = 0;
 
     av_assert0(nb_jobs > 0);
+    if (ctx->shared) {
+        execute_shared(ctx, nb_jobs, execute_main);
+        return;
+    }
+
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
@@ -210,6 +412,8 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
     nb_workers = ctx->nb_threads;
     if (!ctx->main_func)
         nb_workers--;
+    if (ctx->shared)
+        nb_workers = 0;
 
     ctx->finished = 1;
     for (i = 0; i < nb_workers; i++) {
@@ -254,4 +458,13 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
     av_assert0(!pctx || !*pctx);
 }
 
+void av_cpu_set_thread_pool(int nb_threads)
+{
+}
+
+int avpriv_slicethread_pool_size(void)
+{
+    return 0;
+}
+
 #endif /* HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS32THREADS */
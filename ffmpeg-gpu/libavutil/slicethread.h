@@ -43,6 +43,13 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
  */
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main);
 
+/**
+ * Get the size of the shared pool set with av_cpu_set_thread_pool(). The
+ * contexts created while it is enabled do not start threads of their own.
+ * @return number of threads of the pool, 0 if it is disabled
+ */
+int avpriv_slicethread_pool_size(void);
+
 /**
  * Destroy slice threading context.
  * @param pctx pointer to context
@@ -17,13 +17,213 @@
  */
 
 #include "libavutil/imgutils.c"
+#include "libavutil/lfg.h"
+#include "libavutil/time.h"
 
 #undef printf
 
-int main(void)
+static void fill_random(AVLFG *lfg, uint8_t *buf, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        buf[i] = av_lfg_get(lfg);
+}
+
+/* a plane copied row by row, and its untouched padding */
+static int check_plane(const uint8_t *dst, ptrdiff_t dst_linesize,
+                       const uint8_t *src, ptrdiff_t src_linesize,
+                       const uint8_t *orig, ptrdiff_t bytewidth, int height)
+{
+    for (int y = 0; y < height; y++) {
+        if (memcmp(dst + y * dst_linesize, src + y * src_linesize, bytewidth) ||
+            memcmp(dst + y * dst_linesize + bytewidth, orig + y * dst_linesize + bytewidth,
+                   FFABS(dst_linesize) - bytewidth))
+            return AVERROR_BUG;
+    }
+    return 0;
+}
+
+/* small and large planes, with contiguous, padded and unaligned rows */
+static int test_copy_plane(AVLFG *lfg)
+{
+    static const struct {
+        int bytewidth, height, dst_pad, src_pad, dst_offset;
+    } tests[] = {
+        {   64,    1,  0,  0, 0 }, {   17,   5,   0,  3, 1 },
+        { 1920, 1080,  0,  0, 0 }, { 1920, 1080, 64, 32, 0 },
+        { 3840, 2160,  0,  0, 0 }, { 3840, 2160, 64,  0, 0 },
+        { 3840, 2160, 64, 16, 7 }, { 3843, 2161,  5,  0, 0 },
+        { 3833, 2200, 71,  1, 0 }, {   65, 150000, 15, 0, 0 },
+    };
+    int ret = 0;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(tests) && !ret; i++) {
+        int bytewidth = tests[i].bytewidth, h = tests[i].height;
+        ptrdiff_t dst_linesize = bytewidth + tests[i].dst_pad;
+        ptrdiff_t src_linesize = bytewidth + tests[i].src_pad;
+        size_t dst_size = dst_linesize * h + tests[i].dst_offset;
+        uint8_t *dst  = av_malloc(dst_size);
+        uint8_t *orig = av_malloc(dst_size);
+        uint8_t *src  = av_malloc(src_linesize * h);
+
+        if (!dst || !orig || !src) {
+            ret = AVERROR(ENOMEM);
+        } else {
+            fill_random(lfg, src, src_linesize * h);
+            fill_random(lfg, orig, dst_size);
+            for (int flip = 0; flip < 2 && !ret; flip++) {
+                uint8_t *d = dst + tests[i].dst_offset, *s = src, *o = orig + tests[i].dst_offset;
+                ptrdiff_t dl = dst_linesize, sl = src_linesize;
+
+                memcpy(dst, orig, dst_size);
+                if (flip) {
+                    d  += dl * (h - 1);
+                    o  += dl * (h - 1);
+                    s  += sl * (h - 1);
+                    dl  = -dl;
+                    sl  = -sl;
+                }
+                av_image_copy_plane(d, dl, s, sl, bytewidth, h);
+                ret = check_plane(d, dl, s, sl, o, bytewidth, h);
+            }
+            printf("copy plane %5dx%-6d linesizes %5"PTRDIFF_SPECIFIER" %5"PTRDIFF_SPECIFIER
+                   " offset %d: %s\n", bytewidth, h, dst_linesize, src_linesize,
+                   tests[i].dst_offset, ret ? "differ" : "ok");
+        }
+        av_free(dst);
+        av_free(orig);
+        av_free(src);
+    }
+    return ret;
+}
+
+static int test_copy_threads(AVLFG *lfg)
+{
+    static const enum AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12, AV_PIX_FMT_YUV422P10LE,
+        AV_PIX_FMT_YUVA444P, AV_PIX_FMT_BGRA, AV_PIX_FMT_PAL8,
+    };
+    static const int sizes[][2] = { { 352, 288 }, { 1921, 1081 }, { 3840, 2160 } };
+    int ret = 0;
+
+    for (int f = 0; f < FF_ARRAY_ELEMS(pix_fmts) && !ret; f++) {
+        for (int s = 0; s < FF_ARRAY_ELEMS(sizes) && !ret; s++) {
+            int w = sizes[s][0], h = sizes[s][1];
+            uint8_t *src[4] = { NULL }, *dst[4] = { NULL }, *ref[4] = { NULL }, *init;
+            int src_linesizes[4], dst_linesizes[4];
+            ptrdiff_t src_linesizes1[4], dst_linesizes1[4];
+            /* formats with a palette need an alignment of 4 */
+            int src_size = av_image_alloc(src, src_linesizes, w, h, pix_fmts[f], 4);
+            int dst_size = av_image_alloc(dst, dst_linesizes, w, h, pix_fmts[f], 64);
+            int ref_size = av_image_alloc(ref, dst_linesizes, w, h, pix_fmts[f], 64);
+
+            init = av_malloc(FFMAX(ref_size, 1));
+            if (src_size < 0 || dst_size < 0 || ref_size < 0 || !init) {
+                ret = AVERROR(ENOMEM);
+            } else {
+                for (int i = 0; i < 4; i++) {
+                    src_linesizes1[i] = src_linesizes[i];
+                    dst_linesizes1[i] = dst_linesizes[i];
+                }
+                fill_random(lfg, src[0], src_size);
+                fill_random(lfg, ref[0], ref_size);
+                memcpy(init, ref[0], ref_size);
+                av_image_copy(ref, dst_linesizes, (const uint8_t **)src, src_linesizes,
+                              pix_fmts[f], w, h);
+                /* threads started for the copy, then from the shared pool */
+                for (int pool = 0; pool < 2 && !ret; pool++) {
+                    av_cpu_set_thread_pool(pool ? 3 : -1);
+                    for (int t = 1; t <= 4 && !ret; t++) {
+                        memcpy(dst[0], init, dst_size);
+                        av_image_copy_threads(dst, dst_linesizes1, (const uint8_t **)src,
+                                              src_linesizes1, pix_fmts[f], w, h, t);
+                        ret = memcmp(dst[0], ref[0], dst_size) ? AVERROR_BUG : 0;
+                    }
+                }
+                av_cpu_set_thread_pool(-1);
+                printf("copy threads %-14s %4dx%-4d: %s\n", av_get_pix_fmt_name(pix_fmts[f]),
+                       w, h, ret ? "differ" : "ok");
+            }
+            av_freep(&src[0]);
+            av_freep(&dst[0]);
+            av_freep(&ref[0]);
+            av_free(init);
+        }
+    }
+    return ret;
+}
+
+static double bench_gbps(int64_t t, size_t size, int runs)
+{
+    return (double)size * runs / FFMAX(t, 1) / 1000.0;
+}
+
+/* GB/s of the frame copies, against a copy of the rows with memcpy() */
+static int benchmark(void)
+{
+    static const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 }, { 7680, 4320 } };
+
+    for (int s = 0; s < FF_ARRAY_ELEMS(sizes); s++) {
+        int w = sizes[s][0], h = sizes[s][1], runs = FFMAX(8, 400 >> (2 * s));
+        uint8_t *src[4] = { NULL }, *dst[4] = { NULL };
+        int src_linesizes[4], dst_linesizes[4];
+        ptrdiff_t src_linesizes1[4], dst_linesizes1[4];
+        int size = av_image_alloc(src, src_linesizes, w, h, AV_PIX_FMT_YUV420P, 64);
+        int64_t t[4];
+
+        if (size < 0 || av_image_alloc(dst, dst_linesizes, w, h, AV_PIX_FMT_YUV420P, 64) < 0) {
+            av_freep(&src[0]);
+            return AVERROR(ENOMEM);
+        }
+        for (int i = 0; i < 4; i++) {
+            src_linesizes1[i] = src_linesizes[i];
+            dst_linesizes1[i] = dst_linesizes[i];
+        }
+        memset(src[0], 0x80, size);
+        memset(dst[0], 0, size);
+
+        t[0] = av_gettime_relative();
+        for (int r = 0; r < runs; r++) {
+            for (int p = 0; p < 3; p++) {
+                int ph = p ? h >> 1 : h, bw = p ? w >> 1 : w;
+                for (int y = 0; y < ph; y++)
+                    memcpy(dst[p] + y * dst_linesizes[p], src[p] + y * src_linesizes[p], bw);
+            }
+        }
+        t[0] = av_gettime_relative() - t[0];
+
+        t[1] = av_gettime_relative();
+        for (int r = 0; r < runs; r++)
+            av_image_copy(dst, dst_linesizes, (const uint8_t **)src, src_linesizes,
+                          AV_PIX_FMT_YUV420P, w, h);
+        t[1] = av_gettime_relative() - t[1];
+
+        for (int i = 2; i < 4; i++) {
+            t[i] = av_gettime_relative();
+            for (int r = 0; r < runs; r++)
+                av_image_copy_threads(dst, dst_linesizes1, (const uint8_t **)src, src_linesizes1,
+                                      AV_PIX_FMT_YUV420P, w, h, i == 2 ? 2 : 0);
+            t[i] = av_gettime_relative() - t[i];
+        }
+
+        printf("yuv420p %4dx%-4d: rows %6.2f GB/s, av_image_copy %6.2f GB/s, "
+               "2 threads %6.2f GB/s, all threads %6.2f GB/s\n", w, h,
+               bench_gbps(t[0], size, runs), bench_gbps(t[1], size, runs),
+               bench_gbps(t[2], size, runs), bench_gbps(t[3], size, runs));
+        av_freep(&src[0]);
+        av_freep(&dst[0]);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
 {
     const AVPixFmtDescriptor *desc = NULL;
     int64_t x, y;
+    AVLFG lfg;
+    int ret;
+
+    if (argc > 1 && !strcmp(argv[1], "-b"))
+        return benchmark() < 0;
 
     for (y = -1; y<UINT_MAX; y+= y/2 + 1) {
         for (x = -1; x<UINT_MAX; x+= x/2 + 1) {
@@ -69,6 +269,12 @@ int main(void)
             printf(" %5"PTRDIFF_SPECIFIER, offsets[i]);
         printf(", total_size: %d\n", total_size);
     }
+    printf("\n");
 
-    return 0;
+    av_lfg_init(&lfg, 0xC0FFEE);
+    ret = test_copy_plane(&lfg);
+    if (!ret)
+        ret = test_copy_threads(&lfg);
+
+    return ret < 0;
 }
@@ -0,0 +1,270 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/cpu.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define MAX_JOBS    64
+#define MAX_THREADS 8
+
+typedef struct Session {
+    AVSliceThread *thread;
+    pthread_t      tid;
+    int            index;
+    int            nb_threads;
+    int            has_main;
+    int            rounds;
+    atomic_int     errors;
+
+    /* per-execute state */
+    int            nb_jobs;
+    int            wavefront;       ///< each job waits for the previous one
+    atomic_int     count[MAX_JOBS];
+    atomic_int     busy[MAX_THREADS];
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    int            nb_done;         ///< jobs done in order, for the wavefront
+
+    /* benchmark */
+    int            work;
+    int64_t       *latency;
+    volatile unsigned sink;
+} Session;
+
+static void wait_done(Session *s, int n)
+{
+    pthread_mutex_lock(&s->mutex);
+    while (s->nb_done < n)
+        pthread_cond_wait(&s->cond, &s->mutex);
+    pthread_mutex_unlock(&s->mutex);
+}
+
+static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    Session *s = priv;
+
+    if (jobnr < 0 || jobnr >= s->nb_jobs || nb_jobs != s->nb_jobs ||
+        threadnr < 0 || threadnr >= nb_threads || nb_threads > s->nb_threads ||
+        atomic_exchange(&s->busy[threadnr], 1)) {
+        atomic_fetch_add(&s->errors, 1);
+        return;
+    }
+    /* thread k runs job k, decoders set up per thread state for it */
+    if (jobnr < nb_threads && threadnr != jobnr)
+        atomic_fetch_add(&s->errors, 1);
+    atomic_fetch_add(&s->count[jobnr], 1);
+
+    if (s->wavefront)
+        wait_done(s, jobnr);
+    atomic_store(&s->busy[threadnr], 0);
+
+    pthread_mutex_lock(&s->mutex);
+    s->nb_done++;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+}
+
+/* waits for the jobs, like a loop filter following the decoding threads */
+static void main_func(void *priv)
+{
+    Session *s = priv;
+    wait_done(s, s->nb_jobs);
+}
+
+static void *run_session(void *arg)
+{
+    Session *s = arg;
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, s->index);
+    for (int r = 0; r < s->rounds; r++) {
+        s->nb_jobs   = 1 + av_lfg_get(&lfg) % MAX_JOBS;
+        s->wavefront = av_lfg_get(&lfg) & 1;
+        s->nb_done   = 0;
+        for (int i = 0; i < MAX_JOBS; i++)
+            atomic_store(&s->count[i], 0);
+
+        avpriv_slicethread_execute(s->thread, s->nb_jobs, s->has_main);
+
+        for (int i = 0; i < MAX_JOBS; i++)
+            if (atomic_load(&s->count[i]) != (i < s->nb_jobs))
+                atomic_fetch_add(&s->errors, 1);
+        if (s->nb_done != s->nb_jobs)
+            atomic_fetch_add(&s->errors, 1);
+    }
+    return NULL;
+}
+
+static int test_sessions(int nb_sessions, int pool_size)
+{
+    Session *sessions = av_calloc(nb_sessions, sizeof(*sessions));
+    int errors = 0, nb_started = 0, ret;
+
+    if (!sessions)
+        return AVERROR(ENOMEM);
+    av_cpu_set_thread_pool(pool_size);
+
+    for (int i = 0; i < nb_sessions; i++) {
+        Session *s = &sessions[i];
+        s->index    = i;
+        s->has_main = i % 3 == 2;
+        s->rounds   = 200;
+        pthread_mutex_init(&s->mutex, NULL);
+        pthread_cond_init(&s->cond, NULL);
+        ret = avpriv_slicethread_create(&s->thread, s, worker_func,
+                                        s->has_main ? main_func : NULL,
+                                        1 + i % MAX_THREADS);
+        if (ret < 0)
+            goto end;
+        s->nb_threads = ret;
+    }
+    for (; nb_started < nb_sessions; nb_started++)
+        if ((ret = pthread_create(&sessions[nb_started].tid, NULL, run_session,
+                                  &sessions[nb_started]))) {
+            ret = AVERROR(ret);
+            break;
+        }
+    for (int i = 0; i < nb_started; i++) {
+        pthread_join(sessions[i].tid, NULL);
+        errors += atomic_load(&sessions[i].errors);
+    }
+    if (nb_started == nb_sessions)
+        ret = errors ? AVERROR_BUG : 0;
+    printf("%3d sessions, %s: %s\n", nb_sessions,
+           pool_size < 0 ? "own threads" : "shared pool",
+           ret == AVERROR_BUG ? "errors" : ret < 0 ? "failed" : "ok");
+
+end:
+    for (int i = 0; i < nb_sessions; i++) {
+        avpriv_slicethread_free(&sessions[i].thread);
+        pthread_mutex_destroy(&sessions[i].mutex);
+        pthread_cond_destroy(&sessions[i].cond);
+    }
+    av_free(sessions);
+    return ret;
+}
+
+static void bench_worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    Session *s = priv;
+    unsigned x = jobnr;
+
+    for (int i = 0; i < s->work; i++)
+        x = x * 1664525 + 1013904223;
+    s->sink += x;
+}
+
+static void *bench_session(void *arg)
+{
+    Session *s = arg;
+
+    for (int r = 0; r < s->rounds; r++) {
+        int64_t t = av_gettime_relative();
+        avpriv_slicethread_execute(s->thread, MAX_JOBS / 2, 0);
+        s->latency[r] = av_gettime_relative() - t;
+    }
+    return NULL;
+}
+
+static int cmp_int64(const void *a, const void *b)
+{
+    int64_t va = *(const int64_t *)a, vb = *(const int64_t *)b;
+    return (va > vb) - (va < vb);
+}
+
+/* nb_sessions contexts with nb_threads slice threads each, executing 32 jobs
+ * per frame, with threads of their own and with the shared pool */
+static int benchmark(int nb_threads)
+{
+    static const int counts[] = { 1, 10, 100 };
+
+    for (int c = 0; c < FF_ARRAY_ELEMS(counts); c++) {
+        int nb_sessions = counts[c], rounds = FFMAX(4000 / nb_sessions, 20);
+        int64_t *latency = av_malloc_array(nb_sessions * rounds, sizeof(*latency));
+        Session *sessions = av_calloc(nb_sessions, sizeof(*sessions));
+
+        if (!latency || !sessions) {
+            av_free(latency);
+            av_free(sessions);
+            return AVERROR(ENOMEM);
+        }
+        for (int shared = 0; shared < 2; shared++) {
+            int64_t t;
+            int ret = 0, nb_started = 0;
+
+            av_cpu_set_thread_pool(shared ? 0 : -1);
+            for (int i = 0; i < nb_sessions && ret >= 0; i++) {
+                Session *s = &sessions[i];
+                s->rounds  = rounds;
+                s->work    = 20000;
+                s->latency = latency + i * rounds;
+                ret = avpriv_slicethread_create(&s->thread, s, bench_worker, NULL, nb_threads);
+            }
+            t = av_gettime_relative();
+            for (; nb_started < nb_sessions && ret >= 0; nb_started++)
+                if ((ret = -pthread_create(&sessions[nb_started].tid, NULL, bench_session,
+                                           &sessions[nb_started])) < 0)
+                    break;
+            for (int i = 0; i < nb_started; i++)
+                pthread_join(sessions[i].tid, NULL);
+            t = av_gettime_relative() - t;
+            for (int i = 0; i < nb_sessions; i++)
+                avpriv_slicethread_free(&sessions[i].thread);
+            if (ret < 0) {
+                printf("benchmark failed\n");
+                break;
+            }
+
+            qsort(latency, nb_sessions * rounds, sizeof(*latency), cmp_int64);
+            printf("%3d sessions, %-11s: %8.1f frames/s, latency p50 %7.2f ms, p99 %7.2f ms\n",
+                   nb_sessions, shared ? "shared pool" : "own threads",
+                   nb_sessions * rounds * 1000000.0 / FFMAX(t, 1),
+                   latency[nb_sessions * rounds / 2] / 1000.0,
+                   latency[nb_sessions * rounds * 99 / 100] / 1000.0);
+        }
+        av_free(latency);
+        av_free(sessions);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ret = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "-b"))
+        return benchmark(argc > 2 ? atoi(argv[2]) : MAX_THREADS) < 0;
+
+    ret |= test_sessions(1,  -1);
+    ret |= test_sessions(12, -1);
+    /* the pool only grows */
+    ret |= test_sessions(12,  1);
+    ret |= test_sessions(1,   3);
+    ret |= test_sessions(12,  3);
+
+    return ret < 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/lfg.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavutil/xxhash.h"
+
+static const struct {
+    const char *input;
+    uint64_t seed;
+    uint64_t hash;
+} vectors[] = {
+    { "",                                        0, UINT64_C(0xef46db3751d8e999) },
+    { "a",                                       0, UINT64_C(0xd24ec4f1a98c6e5b) },
+    { "abc",                                     0, UINT64_C(0x44bc2cf5ad770999) },
+    { "Nobody inspects the spammish repetition", 0, UINT64_C(0xfbcea83c8a378bf1) },
+    { "The quick brown fox jumps over the lazy dog", 0x9e3779b9,
+                                                    UINT64_C(0xbe8fde2f5a695f49) },
+};
+
+int main(void)
+{
+    struct AVXXHash64 *ctx = av_xxhash64_alloc();
+    uint8_t in[256], *hashes = av_mallocz(256 * 8), *buf = av_malloc(4096);
+    uint8_t hash[8], ref[8];
+    int ret = 0, split_errors = 0;
+    AVLFG lfg;
+
+    if (!ctx || !hashes || !buf)
+        return 1;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(vectors); i++) {
+        av_xxhash64_init(ctx, vectors[i].seed);
+        av_xxhash64_update(ctx, (const uint8_t *)vectors[i].input, strlen(vectors[i].input));
+        av_xxhash64_final(ctx, hash);
+        printf("\"%s\" seed 0x%"PRIx64": 0x%016"PRIx64"\n",
+               vectors[i].input, vectors[i].seed, AV_RB64(hash));
+        ret |= AV_RB64(hash) != vectors[i].hash;
+    }
+
+    /* the hashes of all prefixes of 0, 1, 2, ... 255, with varying seeds */
+    for (int i = 0; i < 256; i++) {
+        in[i] = i;
+        av_xxhash64_init(ctx, 256 - i);
+        av_xxhash64_update(ctx, in, i);
+        av_xxhash64_final(ctx, hashes + 8 * i);
+    }
+    av_xxhash64_init(ctx, 0);
+    av_xxhash64_update(ctx, hashes, 256 * 8);
+    av_xxhash64_final(ctx, hash);
+    printf("prefixes: 0x%016"PRIx64"\n", AV_RB64(hash));
+    ret |= AV_RB64(hash) != UINT64_C(0xc424828fd8a96d4d);
+
+    /* updates of random sizes give the hash of the whole buffer */
+    av_lfg_init(&lfg, 0x5eed);
+    for (int i = 0; i < 4096; i++)
+        buf[i] = av_lfg_get(&lfg);
+    for (int i = 0; i < 200; i++) {
+        int size = av_lfg_get(&lfg) % 4096;
+
+        av_xxhash64_init(ctx, i);
+        av_xxhash64_update(ctx, buf, size);
+        av_xxhash64_final(ctx, ref);
+
+        av_xxhash64_init(ctx, i);
+        for (int pos = 0; pos < size;) {
+            int len = av_lfg_get(&lfg) % 80;
+            len = FFMIN(len, size - pos);
+            av_xxhash64_update(ctx, buf + pos, len);
+            pos += len;
+        }
+        av_xxhash64_final(ctx, hash);
+        split_errors += memcmp(hash, ref, 8) != 0;
+    }
+    printf("split updates: %s\n", split_errors ? "differ" : "ok");
+    ret |= split_errors;
+
+    av_free(hashes);
+    av_free(buf);
+    av_free(ctx);
+    return ret;
+}
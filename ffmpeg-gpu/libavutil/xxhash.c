@@ -0,0 +1,150 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "intreadwrite.h"
+#include "macros.h"
+#include "mem.h"
+#include "xxhash.h"
+
+#define PRIME64_1 UINT64_C(0x9E3779B185EBCA87)
+#define PRIME64_2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define PRIME64_3 UINT64_C(0x165667B19E3779F9)
+#define PRIME64_4 UINT64_C(0x85EBCA77C2B2AE63)
+#define PRIME64_5 UINT64_C(0x27D4EB2F165667C5)
+
+typedef struct AVXXHash64 {
+    uint64_t v[4];
+    uint64_t seed;
+    uint64_t len;
+    uint8_t  state[32];
+    int      state_pos;
+} AVXXHash64;
+
+AVXXHash64 *av_xxhash64_alloc(void)
+{
+    return av_mallocz(sizeof(AVXXHash64));
+}
+
+void av_xxhash64_init(AVXXHash64 *c, uint64_t seed)
+{
+    c->v[0]      = seed + PRIME64_1 + PRIME64_2;
+    c->v[1]      = seed + PRIME64_2;
+    c->v[2]      = seed;
+    c->v[3]      = seed - PRIME64_1;
+    c->seed      = seed;
+    c->len       = 0;
+    c->state_pos = 0;
+}
+
+static inline uint64_t rotl(uint64_t x, int n)
+{
+    return (x << n) | (x >> (64 - n));
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    return rotl(acc, 31) * PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t v)
+{
+    acc ^= xxh64_round(0, v);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+/* the four lanes are independent, which keeps the multipliers busy */
+static const uint8_t *process_stripes(uint64_t v[4], const uint8_t *src, const uint8_t *end)
+{
+    uint64_t v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+
+    while (end - src >= 32) {
+        v0 = xxh64_round(v0, AV_RL64(src     ));
+        v1 = xxh64_round(v1, AV_RL64(src +  8));
+        v2 = xxh64_round(v2, AV_RL64(src + 16));
+        v3 = xxh64_round(v3, AV_RL64(src + 24));
+        src += 32;
+    }
+    v[0] = v0;
+    v[1] = v1;
+    v[2] = v2;
+    v[3] = v3;
+    return src;
+}
+
+void av_xxhash64_update(AVXXHash64 *c, const uint8_t *src, size_t len)
+{
+    const uint8_t *end = src + len;
+
+    c->len += len;
+    if (c->state_pos) {
+        int n = FFMIN(len, 32 - c->state_pos);
+        memcpy(c->state + c->state_pos, src, n);
+        c->state_pos += n;
+        src          += n;
+        if (c->state_pos < 32)
+            return;
+        process_stripes(c->v, c->state, c->state + 32);
+        c->state_pos = 0;
+    }
+    src = process_stripes(c->v, src, end);
+    if (src < end) {
+        memcpy(c->state, src, end - src);
+        c->state_pos = end - src;
+    }
+}
+
+void av_xxhash64_final(AVXXHash64 *c, uint8_t dst[8])
+{
+    const uint8_t *p = c->state, *end = c->state + c->state_pos;
+    uint64_t h;
+
+    if (c->len >= 32) {
+        h = rotl(c->v[0], 1) + rotl(c->v[1], 7) + rotl(c->v[2], 12) + rotl(c->v[3], 18);
+        for (int i = 0; i < 4; i++)
+            h = xxh64_merge(h, c->v[i]);
+    } else {
+        h = c->seed + PRIME64_5;
+    }
+    h += c->len;
+
+    for (; end - p >= 8; p += 8) {
+        h ^= xxh64_round(0, AV_RL64(p));
+        h  = rotl(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (end - p >= 4) {
+        h ^= AV_RL32(p) * PRIME64_1;
+        h  = rotl(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * PRIME64_5;
+        h  = rotl(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    AV_WB64(dst, h);
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * @ingroup lavu_xxhash
+ * Public header for the xxHash64 hash function.
+ */
+
+#ifndef AVUTIL_XXHASH_H
+#define AVUTIL_XXHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @defgroup lavu_xxhash xxHash64
+ * @ingroup lavu_hash
+ * xxHash64 hash function implementation.
+ *
+ * xxHash64 is a fast non-cryptographic hash function with a 64-bit output,
+ * meant for checksums and hash tables rather than for protection against
+ * deliberate collisions. Its throughput is several times that of MD5 or of
+ * the table-driven CRCs, which makes it a good choice to checksum large
+ * amounts of decoded video.
+ *
+ * The output is identical to the XXH64() function of the reference
+ * implementation, in its canonical, big-endian representation.
+ *
+ * @{
+ */
+
+/**
+ * Allocate an AVXXHash64 hash context.
+ *
+ * @return Uninitialized hash context or `NULL` in case of error
+ */
+struct AVXXHash64 *av_xxhash64_alloc(void);
+
+/**
+ * Initialize or reinitialize an AVXXHash64 hash context.
+ *
+ * @param[out] c    Hash context
+ * @param[in]  seed Seed, 0 for the hashes usually published
+ */
+void av_xxhash64_init(struct AVXXHash64 *c, uint64_t seed);
+
+/**
+ * Update hash context with new data.
+ *
+ * @param[out] c    Hash context
+ * @param[in]  src  Input data to update hash with
+ * @param[in]  len  Number of bytes to read from `src`
+ */
+void av_xxhash64_update(struct AVXXHash64 *c, const uint8_t *src, size_t len);
+
+/**
+ * Finish hashing and output digest value.
+ *
+ * @param[in,out] c    Hash context
+ * @param[out]    dst  Buffer where the big-endian digest value is stored
+ */
+void av_xxhash64_final(struct AVXXHash64 *c, uint8_t dst[8]);
+
+/**
+ * @}
+ */
+
+#endif /* AVUTIL_XXHASH_H */
@@ -0,0 +1,69 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "libavcodec/aacenc.h"
+#include "libavcodec/aacenc_utils.h"
+#include "libavutil/mem.h"
+#include "libavutil/mem_internal.h"
+
+#include "checkasm.h"
+
+#define BUF_SIZE 1024
+
+#define randomize(buf, len) do {                                \
+    int i;                                                      \
+    for (i = 0; i < len; i++)                                   \
+        (buf)[i] = (float)rnd() / (UINT_MAX >> 1) - 1.0f;       \
+} while (0)
+
+#define EPS 1e-5
+
+static void test_abs_pow34(AACEncContext *s)
+{
+    LOCAL_ALIGNED_16(float, in,   [BUF_SIZE]);
+    LOCAL_ALIGNED_16(float, out0, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(float, out1, [BUF_SIZE]);
+
+    declare_func(void, float *out, const float *in, const int size);
+
+    if (check_func(s->abs_pow34, "abs_pow34")) {
+        randomize(in, BUF_SIZE);
+        call_ref(out0, in, BUF_SIZE);
+        call_new(out1, in, BUF_SIZE);
+        if (!float_near_abs_eps_array(out0, out1, EPS, BUF_SIZE))
+            fail();
+        bench_new(out1, in, BUF_SIZE);
+    }
+    report("abs_pow34");
+}
+
+void checkasm_check_aacencdsp(void)
+{
+    AACEncContext *s = av_mallocz(sizeof(*s));
+
+    if (!s)
+        return;
+    s->abs_pow34 = abs_pow34_v;
+#if ARCH_X86
+    ff_aac_dsp_init_x86(s);
+#endif
+
+    test_abs_pow34(s);
+
+    av_free(s);
+}
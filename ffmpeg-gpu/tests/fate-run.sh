@@ -171,6 +171,15 @@ md5(){
     do_md5sum $encfile | awk '{print $1}'
 }
 
+signature(){
+    sigfile="${outdir}/${test}.sig"
+    cleanfiles="$cleanfiles $sigfile"
+    filters=$1
+    shift
+    ffmpeg "$@" -vf "${filters}:filename=$(target_path $sigfile)" -f null - || return
+    do_md5sum $sigfile | awk '{print $1}'
+}
+
 pcm(){
     ffmpeg -auto_conversion_filters "$@" -vn -f s16le -
 }
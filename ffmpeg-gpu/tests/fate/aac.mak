@@ -158,6 +158,36 @@ fate-aac-aref-encode: CMP_TARGET = 596
 fate-aac-aref-encode: SIZE_TOLERANCE = 2464
 fate-aac-aref-encode: FUZZ = 89
 
+FATE_AAC_ENCODE += fate-aac-aref-6ch-encode
+fate-aac-aref-6ch-encode: ./tests/data/asynth-44100-6.wav
+fate-aac-aref-6ch-encode: CMD = enc_dec_pcm adts wav s16le $(REF) -c:a aac -aac_pns 0 -b:a 384k -fflags +bitexact -flags +bitexact
+fate-aac-aref-6ch-encode: CMP = stddev
+fate-aac-aref-6ch-encode: REF = ./tests/data/asynth-44100-6.wav
+fate-aac-aref-6ch-encode: CMP_SHIFT = -12288
+fate-aac-aref-6ch-encode: CMP_TARGET = 4284
+fate-aac-aref-6ch-encode: SIZE_TOLERANCE = 7392
+fate-aac-aref-6ch-encode: FUZZ = 10
+
+FATE_AAC_ENCODE += fate-aac-aref-6ch-encode-balanced
+fate-aac-aref-6ch-encode-balanced: ./tests/data/asynth-44100-6.wav
+fate-aac-aref-6ch-encode-balanced: CMD = enc_dec_pcm adts wav s16le $(REF) -c:a aac -aac_preset balanced -aac_pns 0 -b:a 384k -fflags +bitexact -flags +bitexact
+fate-aac-aref-6ch-encode-balanced: CMP = stddev
+fate-aac-aref-6ch-encode-balanced: REF = ./tests/data/asynth-44100-6.wav
+fate-aac-aref-6ch-encode-balanced: CMP_SHIFT = -12288
+fate-aac-aref-6ch-encode-balanced: CMP_TARGET = 4283
+fate-aac-aref-6ch-encode-balanced: SIZE_TOLERANCE = 7392
+fate-aac-aref-6ch-encode-balanced: FUZZ = 10
+
+FATE_AAC_ENCODE += fate-aac-aref-6ch-encode-fast
+fate-aac-aref-6ch-encode-fast: ./tests/data/asynth-44100-6.wav
+fate-aac-aref-6ch-encode-fast: CMD = enc_dec_pcm adts wav s16le $(REF) -c:a aac -aac_preset fast -aac_pns 0 -b:a 384k -fflags +bitexact -flags +bitexact
+fate-aac-aref-6ch-encode-fast: CMP = stddev
+fate-aac-aref-6ch-encode-fast: REF = ./tests/data/asynth-44100-6.wav
+fate-aac-aref-6ch-encode-fast: CMP_SHIFT = -12288
+fate-aac-aref-6ch-encode-fast: CMP_TARGET = 4356
+fate-aac-aref-6ch-encode-fast: SIZE_TOLERANCE = 7392
+fate-aac-aref-6ch-encode-fast: FUZZ = 10
+
 FATE_AAC_ENCODE += fate-aac-ln-encode
 fate-aac-ln-encode: CMD = enc_dec_pcm adts wav s16le $(TARGET_SAMPLES)/audio-reference/luckynight_2ch_44kHz_s16.wav -c:a aac -aac_coder fast -aac_is 0 -aac_pns 0 -aac_ms 0 -aac_tns 0 -b:a 512k -fflags +bitexact -flags +bitexact
 fate-aac-ln-encode: CMP = stddev
@@ -255,9 +285,23 @@ $(FATE_AAC_ALL): FUZZ = 2
 
 FATE_AAC_ENCODE-$(call ENCMUX, AAC, ADTS) += $(FATE_AAC_ENCODE)
 
+# The channel elements are searched in parallel, the packets must not
+# depend on the number of threads, PNS included
+FATE_AAC_ENCODE_THREADS += fate-aac-6ch-pns-encode
+fate-aac-6ch-pns-encode: ./tests/data/asynth-44100-6.wav
+fate-aac-6ch-pns-encode: CMD = framecrc -auto_conversion_filters -i $(TARGET_PATH)/tests/data/asynth-44100-6.wav -c:a aac -aac_pns 1 -b:a 192k -threads 1 -thread_type slice -fflags +bitexact -flags +bitexact
+
+FATE_AAC_ENCODE_THREADS += fate-aac-6ch-pns-encode-threads
+fate-aac-6ch-pns-encode-threads: ./tests/data/asynth-44100-6.wav
+fate-aac-6ch-pns-encode-threads: CMD = framecrc -auto_conversion_filters -i $(TARGET_PATH)/tests/data/asynth-44100-6.wav -c:a aac -aac_pns 1 -b:a 192k -threads 4 -thread_type slice -fflags +bitexact -flags +bitexact
+fate-aac-6ch-pns-encode-threads: REF = $(SRC_PATH)/tests/ref/fate/aac-6ch-pns-encode
+
+FATE_AAC_ENCODE_THREADS-$(call ENCDEC, AAC PCM_S16LE, FRAMECRC WAV) += $(FATE_AAC_ENCODE_THREADS)
+
 FATE_AAC_BSF-$(call ALLYES, AAC_DEMUXER AAC_ADTSTOASC_BSF MATROSKA_MUXER) += fate-aac-autobsf-adtstoasc
 
 FATE_SAMPLES_FFMPEG += $(FATE_AAC_ALL) $(FATE_AAC_ENCODE-yes) $(FATE_AAC_BSF-yes)
+FATE_FFMPEG += $(FATE_AAC_ENCODE_THREADS-yes)
 
-fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_BSF-yes)
+fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_ENCODE_THREADS-yes) $(FATE_AAC_BSF-yes)
 fate-aac-latm: $(FATE_AAC_LATM-yes)
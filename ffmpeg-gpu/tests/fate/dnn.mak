@@ -40,6 +40,10 @@ fate-dnn-layer-avgpool: $(DNNTESTSDIR)/dnn-layer-avgpool$(EXESUF)
 fate-dnn-layer-avgpool: CMD = run $(DNNTESTSDIR)/dnn-layer-avgpool$(EXESUF)
 fate-dnn-layer-avgpool: CMP = null
 
+FATE_DNN += fate-dnn-nms
+fate-dnn-nms: $(DNNTESTSDIR)/dnn-nms$(EXESUF)
+fate-dnn-nms: CMD = run $(DNNTESTSDIR)/dnn-nms$(EXESUF)
+
 FATE-$(CONFIG_DNN) += $(FATE_DNN)
 
 fate-dnn: $(FATE_DNN)
@@ -147,6 +147,11 @@ fate-filter-gradfun: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf gradfun
 FATE_FILTER_VSYNTH_PGMYUV-$(CONFIG_HQDN3D_FILTER) += fate-filter-hqdn3d
 fate-filter-hqdn3d: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf hqdn3d
 
+# the output must not depend on the number of slices
+FATE_FILTER_VSYNTH_PGMYUV-$(CONFIG_HQDN3D_FILTER) += fate-filter-hqdn3d-threads
+fate-filter-hqdn3d-threads: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_threads 5 -vf hqdn3d
+fate-filter-hqdn3d-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-hqdn3d
+
 FATE_FILTER_VSYNTH_PGMYUV-$(CONFIG_INTERLACE_FILTER) += fate-filter-interlace
 fate-filter-interlace: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf interlace
 
@@ -252,6 +257,18 @@ FATE_REMOVEGRAIN-$(call FILTERDEMDEC, REMOVEGRAIN, IMAGE2, PGMYUV) += $(FATE_REM
 fate-filter-removegrain: $(FATE_REMOVEGRAIN-yes)
 FATE_FILTER_VSYNTH-yes += $(FATE_REMOVEGRAIN-yes)
 
+# the exported signatures must not depend on the number of slices
+FATE_FILTER_SIGNATURE-$(CONFIG_SIGNATURE_FILTER) += fate-filter-signature-xml fate-filter-signature-xml-threads
+fate-filter-signature-xml: CMD = signature signature=format=xml -c:v pgmyuv -i $(SRC)
+fate-filter-signature-xml-threads: CMD = signature signature=format=xml -c:v pgmyuv -i $(SRC) -filter_threads 3
+fate-filter-signature-xml-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-signature-xml
+
+# block grid not aligned to the image size, and a semi-planar input
+FATE_FILTER_SIGNATURE-$(call ALLYES, SIGNATURE_FILTER CROP_FILTER FORMAT_FILTER SCALE_FILTER) += fate-filter-signature-binary
+fate-filter-signature-binary: CMD = signature crop=350:282,scale,format=nv12,signature=format=binary -c:v pgmyuv -i $(SRC) -filter_threads 2 -sws_flags +accurate_rnd+bitexact
+FATE_FILTER_VSYNTH_PGMYUV-yes += $(FATE_FILTER_SIGNATURE-yes)
+fate-filter-signature: $(FATE_FILTER_SIGNATURE-yes)
+
 FATE_FILTER_VSYNTH_PGMYUV-$(CONFIG_SEPARATEFIELDS_FILTER) += fate-filter-separatefields
 fate-filter-separatefields: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf separatefields
 
@@ -320,6 +337,16 @@ fate-filter-unsharp: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf unsharp=11:11:-1.5
 FATE_FILTER_VSYNTH-$(call FILTERFRAMECRC, TESTSRC2 SCALE UNSHARP) += fate-filter-unsharp-yuv420p10
 fate-filter-unsharp-yuv420p10: CMD = framecrc -lavfi testsrc2=r=2:d=10,scale,format=yuv420p10,unsharp=11:11:-1.5:11:11:-1.5,scale -pix_fmt yuv420p10le -flags +bitexact -sws_flags +accurate_rnd+bitexact
 
+# PQ coded YUV input, converted directly to YUV output with another matrix and range
+FATE_FILTER_TONEMAP_YUV += fate-filter-tonemap-yuv420p10-yuv420p
+fate-filter-tonemap-yuv420p10-yuv420p: CMD = framecrc -c:v pgmyuv -i $(SRC) -frames:v 5 -vf scale,format=yuv420p10,setparams=range=tv:color_primaries=bt2020:color_trc=smpte2084:colorspace=bt2020nc,tonemap=hable:desat=0:matrix=bt709:primaries=bt709:range=pc:format=yuv420p -sws_flags +accurate_rnd+bitexact
+
+FATE_FILTER_TONEMAP_YUV += fate-filter-tonemap-yuv444p10-yuv444p10
+fate-filter-tonemap-yuv444p10-yuv444p10: CMD = framecrc -c:v pgmyuv -i $(SRC) -frames:v 5 -vf scale,format=yuv444p10,setparams=range=pc:color_primaries=bt2020:color_trc=smpte2084:colorspace=bt2020nc,tonemap=mobius:matrix=bt709:range=tv:format=yuv444p10 -pix_fmt yuv444p10le -sws_flags +accurate_rnd+bitexact
+
+FATE_FILTER_VSYNTH_PGMYUV-$(call ALLYES, TONEMAP_FILTER SETPARAMS_FILTER FORMAT_FILTER SCALE_FILTER) += $(FATE_FILTER_TONEMAP_YUV)
+fate-filter-tonemap-yuv: $(FATE_FILTER_TONEMAP_YUV)
+
 FATE_FILTER_SAMPLES-$(call FILTERDEMDEC, PERMS HQDN3D, SMJPEG, MJPEG) += fate-filter-hqdn3d-sample
 fate-filter-hqdn3d-sample: tests/data/filtergraphs/hqdn3d
 fate-filter-hqdn3d-sample: CMD = framecrc -idct simple -i $(TARGET_SAMPLES)/smjpeg/scenwin.mjpg -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/hqdn3d -an
@@ -367,6 +394,14 @@ fate-filter-decimate: CMD = framecrc -lavfi testsrc2=r=24:d=10,fps=60,decimate=5
 FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 FPS MPDECIMATE) += fate-filter-mpdecimate
 fate-filter-mpdecimate: CMD = framecrc -lavfi testsrc2=r=2:d=10,fps=3,mpdecimate -r 3 -pix_fmt yuv420p
 
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 FPS MPDECIMATE) += fate-filter-mpdecimate-threads
+fate-filter-mpdecimate-threads: CMD = framecrc -filter_threads 3 -lavfi testsrc2=r=2:d=10,fps=3,mpdecimate -r 3 -pix_fmt yuv420p
+fate-filter-mpdecimate-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-mpdecimate
+
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 FPS MPDECIMATE) += fate-filter-mpdecimate-step
+fate-filter-mpdecimate-step: CMD = framecrc -lavfi testsrc2=r=2:d=10,fps=3,mpdecimate=step=2 -r 3 -pix_fmt yuv420p
+fate-filter-mpdecimate-step: REF = $(SRC_PATH)/tests/ref/fate/filter-mpdecimate
+
 FATE_FILTER-$(call FILTERFRAMECRC, FPS TESTSRC2) += $(addprefix fate-filter-fps-, up up-round-down up-round-up down down-round-down down-round-up down-eof-pass start-drop start-fill)
 fate-filter-fps-up: CMD = framecrc -lavfi testsrc2=r=3:d=2,fps=7
 fate-filter-fps-up-round-down: CMD = framecrc -lavfi testsrc2=r=3:d=2,fps=7:round=down
@@ -517,6 +552,9 @@ FATE_FILTER_VSYNTH-yes += $(FATE_STEREO3D-yes)
 FATE_FILTER_VSYNTH_VIDEO_FILTER-$(call ALLYES, SCALE_FILTER THUMBNAIL_FILTER) += fate-filter-thumbnail
 fate-filter-thumbnail: CMD = video_filter "scale,thumbnail=10"
 
+FATE_FILTER_VSYNTH_VIDEO_FILTER-$(call ALLYES, SCALE_FILTER THUMBNAIL_FILTER) += fate-filter-thumbnail-step
+fate-filter-thumbnail-step: CMD = video_filter "scale,thumbnail=10:step=3"
+
 FATE_FILTER_VSYNTH_VIDEO_FILTER-$(CONFIG_TILE_FILTER) += fate-filter-tile
 fate-filter-tile: CMD = video_filter "tile=3x3:nb_frames=5:padding=7:margin=2"
 
@@ -647,10 +685,22 @@ FATE_METADATA_FILTER-$(call ALLYES, $(CROPDETECT_DEPS)) += fate-filter-metadata-
 fate-filter-metadata-cropdetect: SRC = $(TARGET_SAMPLES)/filter/cropdetect.mp4
 fate-filter-metadata-cropdetect: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;movie='$(SRC)',cropdetect=max_outliers=3"
 
+CROPDETECT_LAVFI_DEPS = LAVFI_INDEV TESTSRC2_FILTER FORMAT_FILTER PAD_FILTER \
+                        CROP_FILTER CROPDETECT_FILTER
+CROPDETECT_LAVFI_SRC  = testsrc2=s=160x120:r=5:d=2,format=$(1),pad=240:200:40:40:black,crop=200:170:20+n*3-35*floor(n*3/35):15+n*5-30*floor(n*5/30)
+FATE_METADATA_FILTER-$(call ALLYES, $(CROPDETECT_LAVFI_DEPS)) += fate-filter-metadata-cropdetect-yuv420p fate-filter-metadata-cropdetect-yuv420p10 fate-filter-metadata-cropdetect-rgb24
+fate-filter-metadata-cropdetect-yuv420p: CMD = run $(FILTER_METADATA_COMMAND) "$(call CROPDETECT_LAVFI_SRC,yuv420p),cropdetect=skip=0:round=2:reset=4"
+fate-filter-metadata-cropdetect-yuv420p10: CMD = run $(FILTER_METADATA_COMMAND) "$(call CROPDETECT_LAVFI_SRC,yuv420p10),cropdetect=skip=1:max_outliers=2:limit=0.15"
+fate-filter-metadata-cropdetect-rgb24: CMD = run $(FILTER_METADATA_COMMAND) "$(call CROPDETECT_LAVFI_SRC,rgb24),cropdetect=skip=0:reset=3:interval=2"
+
 FREEZEDETECT_DEPS = LAVFI_INDEV MPTESTSRC_FILTER SCALE_FILTER FREEZEDETECT_FILTER
 FATE_METADATA_FILTER-$(call ALLYES, $(FREEZEDETECT_DEPS)) += fate-filter-metadata-freezedetect
 fate-filter-metadata-freezedetect: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;mptestsrc=r=25:d=10:m=51,freezedetect"
 
+FATE_METADATA_FILTER-$(call ALLYES, $(FREEZEDETECT_DEPS)) += fate-filter-metadata-freezedetect-step
+fate-filter-metadata-freezedetect-step: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;mptestsrc=r=25:d=10:m=51,freezedetect=step=4"
+fate-filter-metadata-freezedetect-step: REF = $(SRC_PATH)/tests/ref/fate/filter-metadata-freezedetect
+
 SIGNALSTATS_DEPS = LAVFI_INDEV COLOR_FILTER SCALE_FILTER SIGNALSTATS_FILTER
 FATE_METADATA_FILTER-$(call ALLYES, $(SIGNALSTATS_DEPS)) += fate-filter-metadata-signalstats-yuv420p fate-filter-metadata-signalstats-yuv420p10
 fate-filter-metadata-signalstats-yuv420p: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;color=white:duration=1:r=1,signalstats"
@@ -715,6 +765,18 @@ FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER SPLIT_FILTER AVGBLUR_FILTER        \
                            METADATA_FILTER WRAPPED_AVFRAME_ENCODER NULL_MUXER \
                            PIPE_PROTOCOL) += $(FATE_FILTER_REFCMP_METADATA-yes)
 
+FATE_FILTER-$(CONFIG_TONEMAP_FILTER) += fate-filter-tonemap
+fate-filter-tonemap: libavfilter/tests/tonemap$(EXESUF)
+fate-filter-tonemap: CMD = run libavfilter/tests/tonemap$(EXESUF)
+
+FATE_FILTER-yes += fate-filter-framepool
+fate-filter-framepool: libavfilter/tests/framepool$(EXESUF)
+fate-filter-framepool: CMD = run libavfilter/tests/framepool$(EXESUF)
+
+FATE_FILTER-$(call ALLYES, COMPOSITE_FILTER OVERLAY_FILTER TESTSRC2_FILTER TRIM_FILTER COLOR_FILTER FORMAT_FILTER GEQ_FILTER LUT_FILTER) += fate-filter-composite
+fate-filter-composite: libavfilter/tests/composite$(EXESUF)
+fate-filter-composite: CMD = run libavfilter/tests/composite$(EXESUF)
+
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)
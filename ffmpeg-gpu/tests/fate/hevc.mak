@@ -209,6 +209,13 @@ FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER SCALE_FILTER) +=         \
                                                     $(HEVC_TESTS_422_10BIN) \
                                                     $(HEVC_TESTS_444_12BIT) \
 
+# tiles decoded in parallel with slice threads must match the serial decode
+HEVC_SAMPLES_TILES = TILES_A_Cisco_2 TILES_B_Cisco_1
+HEVC_TESTS_TILES = $(addprefix fate-hevc-slice-threads-, $(HEVC_SAMPLES_TILES))
+$(HEVC_TESTS_TILES): CMD = threads=4 thread_type=slice framecrc -flags unaligned -i $(TARGET_SAMPLES)/hevc-conformance/$(subst fate-hevc-slice-threads-,,$(@)).bit -pix_fmt yuv420p
+$(HEVC_TESTS_TILES): REF = $(SRC_PATH)/tests/ref/fate/$(@:fate-hevc-slice-threads-%=hevc-conformance-%)
+FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER) += $(HEVC_TESTS_TILES)
+
 fate-hevc-paramchange-yuv420p-yuv420p10: CMD = framecrc -vsync passthrough -i $(TARGET_SAMPLES)/hevc/paramchange_yuv420p_yuv420p10.hevc -sws_flags area+accurate_rnd+bitexact
 FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER SCALE_FILTER LARGE_TESTS) += fate-hevc-paramchange-yuv420p-yuv420p10
 
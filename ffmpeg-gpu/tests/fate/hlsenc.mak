@@ -109,6 +109,18 @@ FATE_HLSENC_PROBE-$(call ALLYES, HLS_DEMUXER EAC3_DEMUXER) += fate-hls-fmp4_ac3
 fate-hls-fmp4_ac3: tests/data/hls_fmp4_ac3.m3u8
 fate-hls-fmp4_ac3: CMD = probeaudiostream $(TARGET_PATH)/tests/data/now_ac3.mp4
 
+tests/data/hls_ll_parts.m3u8: TAG = GEN
+tests/data/hls_ll_parts.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=5" -map 0 -flags +bitexact -codec:a mp2fixed \
+	-hls_segment_type fmp4 -hls_fmp4_init_filename hls_ll_parts_init.mp4 -hls_list_size 0 \
+	-hls_time 2 -hls_part_time 0.5 -hls_segment_filename "$(TARGET_PATH)/tests/data/hls_ll_parts_%d.m4s" \
+	$(TARGET_PATH)/tests/data/hls_ll_parts.m3u8 2>/dev/null
+
+FATE_HLSENC-$(call ALLYES, HLS_MUXER MP4_MUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-ll-parts
+fate-hls-ll-parts: tests/data/hls_ll_parts.m3u8
+fate-hls-ll-parts: CMD = cat $(TARGET_PATH)/tests/data/hls_ll_parts.m3u8
+
 FATE_SAMPLES_FFMPEG += $(FATE_HLSENC-yes)
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_HLSENC_PROBE-yes)
 fate-hlsenc: $(FATE_HLSENC-yes) $(FATE_HLSENC_PROBE-yes)
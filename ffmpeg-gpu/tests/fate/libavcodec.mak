@@ -46,6 +46,10 @@ fate-dct8x8: libavcodec/tests/dct$(EXESUF)
 fate-dct8x8: CMD = run libavcodec/tests/dct$(EXESUF)
 fate-dct8x8: CMP = null
 
+FATE_LIBAVCODEC-$(CONFIG_H264PARSE) += fate-h2645-parse
+fate-h2645-parse: libavcodec/tests/h2645_parse$(EXESUF)
+fate-h2645-parse: CMD = run libavcodec/tests/h2645_parse$(EXESUF)
+
 FATE_LIBAVCODEC-$(CONFIG_H264_METADATA_BSF) += fate-h264-levels
 fate-h264-levels: libavcodec/tests/h264_levels$(EXESUF)
 fate-h264-levels: CMD = run libavcodec/tests/h264_levels$(EXESUF)
@@ -148,6 +148,10 @@ FATE_LIBAVUTIL += fate-sha512
 fate-sha512: libavutil/tests/sha512$(EXESUF)
 fate-sha512: CMD = run libavutil/tests/sha512$(EXESUF)
 
+FATE_LIBAVUTIL-$(HAVE_THREADS) += fate-slicethread
+fate-slicethread: libavutil/tests/slicethread$(EXESUF)
+fate-slicethread: CMD = run libavutil/tests/slicethread$(EXESUF)
+
 FATE_LIBAVUTIL += fate-tree
 fate-tree: libavutil/tests/tree$(EXESUF)
 fate-tree: CMD = run libavutil/tests/tree$(EXESUF)
@@ -162,6 +166,10 @@ FATE_LIBAVUTIL += fate-xtea
 fate-xtea: libavutil/tests/xtea$(EXESUF)
 fate-xtea: CMD = run libavutil/tests/xtea$(EXESUF)
 
+FATE_LIBAVUTIL += fate-xxhash
+fate-xxhash: libavutil/tests/xxhash$(EXESUF)
+fate-xxhash: CMD = run libavutil/tests/xxhash$(EXESUF)
+
 FATE_LIBAVUTIL += fate-tea
 fate-tea: libavutil/tests/tea$(EXESUF)
 fate-tea: CMD = run libavutil/tests/tea$(EXESUF)
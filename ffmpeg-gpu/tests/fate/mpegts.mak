@@ -23,3 +23,18 @@ fate-mpegts-probe-pmt-merge: CMD = run $(PROBE_CODEC_NAME_COMMAND) -merge_pmt_ve
 FATE_SAMPLES_FFPROBE += $(FATE_MPEGTS_PROBE-yes)
 
 fate-mpegts: $(FATE_MPEGTS_PROBE-yes)
+
+#
+# Test demuxing a stream that has packets of other programs and null packets
+# between its own, which the demuxer skips without parsing them
+#
+FATE_MPEGTS_FFMPEG-$(call ALLYES, WAV_DEMUXER PCM_S16LE_DECODER MP2_ENCODER \
+                                  MPEGTS_MUXER MPEGTS_DEMUXER MP2_DECODER \
+                                  MPEGAUDIO_PARSER FRAMECRC_MUXER) += fate-mpegts-skip-ignored
+fate-mpegts-skip-ignored: tests/data/asynth-44100-2.wav
+fate-mpegts-skip-ignored: SRC = $(TARGET_PATH)/tests/data/asynth-44100-2.wav
+fate-mpegts-skip-ignored: CMD = transcode wav $(SRC) mpegts "-map 0:a -map 0:a -c:a mp2 -b:a 64k -program st=0 -program st=1 -muxrate 1000000" "-map 0:p:2 -c copy"
+
+FATE_FFMPEG += $(FATE_MPEGTS_FFMPEG-yes)
+
+fate-mpegts: $(FATE_MPEGTS_FFMPEG-yes)
@@ -472,6 +472,17 @@ VSYNTH3_OFF  = $(RESIZE_OFF) $(INC_PAR_OFF)
 FATE_VCODEC3 = $(filter-out $(VSYNTH3_OFF),$(FATE_VCODEC))
 FATE_VSYNTH3 = $(FATE_VCODEC3:%=fate-vsynth3-%)
 
+# slice threaded deflate, must decode to the frames of vsynth1-mpng
+FATE_VSYNTH1-$(call ENCDEC, PNG RAWVIDEO, AVI RAWVIDEO, SCALE_FILTER) += fate-vsynth1-mpng-slice
+fate-vsynth1-mpng-slice:         CODEC   = png
+fate-vsynth1-mpng-slice:         ENCOPTS = -threads 4 -thread_type slice
+
+# optimal huffman tables with slice threads, must decode to the frames of vsynth1-mjpeg
+FATE_VSYNTH1-$(call ENCDEC, MJPEG RAWVIDEO, AVI RAWVIDEO, SCALE_FILTER) += fate-vsynth1-mjpeg-slice
+fate-vsynth1-mjpeg-slice:        ENCOPTS = -qscale 9 -pix_fmt yuvj420p -huffman optimal \
+                                           -threads 4 -thread_type slice
+FATE_VSYNTH1 += $(FATE_VSYNTH1-yes)
+
 $(FATE_VSYNTH1): tests/data/vsynth1.yuv
 $(FATE_VSYNTH2): tests/data/vsynth2.yuv
 $(FATE_VSYNTH_LENA): tests/data/vsynth_lena.yuv
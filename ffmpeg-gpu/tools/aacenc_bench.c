@@ -0,0 +1,287 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Encode a synthetic signal with the native AAC encoder for several channel
+ * layouts and thread counts, then decode it back. Prints the realtime factor
+ * (seconds of audio encoded per second of wall clock time), the bitrate and
+ * the SNR of the decoded signal. The SNR is only a rough quality measure:
+ * perceptual noise substitution lowers it without lowering the quality.
+ *
+ * make tools/aacenc_bench
+ * tools/aacenc_bench -l stereo,5.1 -t 1,4 -o aac_preset=fast
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/dict.h"
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/avcodec.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#define SAMPLE_RATE 48000
+
+/**
+ * Tones with vibrato and tremolo plus enveloped noise, different in each
+ * channel, with a quiet LFE-like low tone in the 4th channel.
+ */
+static void generate(float **samples, int nb_channels, int nb_samples)
+{
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 0x5eed);
+    for (int ch = 0; ch < nb_channels; ch++) {
+        const double f0 = ch == 3 ? 45.0 : 110.0 * (ch + 2);
+        for (int i = 0; i < nb_samples; i++) {
+            double t = (double)i / SAMPLE_RATE;
+            double noise = (av_lfg_get(&lfg) / 4294967296.0 - 0.5) *
+                           (0.5 + 0.5 * sin(2 * M_PI * (0.7 + ch * 0.3) * t));
+            double v = 0.3 * sin(2 * M_PI * f0 * t + 3 * sin(2 * M_PI * 5 * t)) *
+                       (0.6 + 0.4 * sin(2 * M_PI * 0.25 * t));
+            if (ch != 3)
+                v += 0.08 * sin(2 * M_PI * (2000 + 700 * ch) * t) + 0.15 * noise;
+            samples[ch][i] = v;
+        }
+    }
+}
+
+static int encode_decode(const AVChannelLayout *layout, int nb_threads,
+                         const char *opts, float **samples, int nb_samples,
+                         double *realtime, double *kbps, double *snr)
+{
+    const AVCodec *enc_codec = avcodec_find_encoder_by_name("aac");
+    const AVCodec *dec_codec = avcodec_find_decoder(AV_CODEC_ID_AAC);
+    AVCodecContext *enc = NULL, *dec = NULL;
+    AVDictionary *dict = NULL;
+    AVFrame *frame = av_frame_alloc(), *out = av_frame_alloc();
+    AVPacket *pkt = av_packet_alloc();
+    AVPacket **pkts = NULL;
+    int nb_pkts = 0, pos = 0, decoded = 0, ret;
+    int64_t bytes = 0, t0;
+    double err = 0, sig = 0;
+
+    if (!enc_codec || !dec_codec || !frame || !out || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    enc = avcodec_alloc_context3(enc_codec);
+    dec = avcodec_alloc_context3(dec_codec);
+    if (!enc || !dec) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    enc->sample_fmt   = AV_SAMPLE_FMT_FLTP;
+    enc->sample_rate  = SAMPLE_RATE;
+    enc->thread_count = nb_threads;
+    enc->flags       |= AV_CODEC_FLAG_BITEXACT;
+    if ((ret = av_channel_layout_copy(&enc->ch_layout, layout)) < 0 ||
+        (opts && (ret = av_dict_parse_string(&dict, opts, "=", ":", 0)) < 0) ||
+        (ret = avcodec_open2(enc, enc_codec, &dict)) < 0)
+        goto end;
+    if (av_dict_count(dict)) {
+        fprintf(stderr, "Unknown option %s\n", av_dict_get(dict, "", NULL, AV_DICT_IGNORE_SUFFIX)->key);
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+
+    frame->format      = enc->sample_fmt;
+    frame->nb_samples  = enc->frame_size;
+    frame->sample_rate = enc->sample_rate;
+    if ((ret = av_channel_layout_copy(&frame->ch_layout, layout)) < 0 ||
+        (ret = av_frame_get_buffer(frame, 0)) < 0)
+        goto end;
+
+    t0 = av_gettime_relative();
+    while (1) {
+        if (pos < nb_samples) {
+            if ((ret = av_frame_make_writable(frame)) < 0)
+                goto end;
+            frame->nb_samples = FFMIN(enc->frame_size, nb_samples - pos);
+            for (int ch = 0; ch < layout->nb_channels; ch++)
+                memcpy(frame->extended_data[ch], samples[ch] + pos,
+                       frame->nb_samples * sizeof(float));
+            frame->pts = pos;
+            pos += frame->nb_samples;
+            ret = avcodec_send_frame(enc, frame);
+        } else {
+            ret = avcodec_send_frame(enc, NULL);
+        }
+        if (ret < 0 && ret != AVERROR_EOF)
+            goto end;
+        while ((ret = avcodec_receive_packet(enc, pkt)) >= 0) {
+            if ((ret = av_dynarray_add_nofree(&pkts, &nb_pkts, pkt)) < 0)
+                goto end;
+            bytes += pkt->size;
+            if (!(pkt = av_packet_alloc())) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+        }
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret != AVERROR(EAGAIN))
+            goto end;
+    }
+    *realtime = (double)nb_samples / SAMPLE_RATE / ((av_gettime_relative() - t0) / 1e6);
+    *kbps     = bytes * 8.0 / ((double)nb_samples / SAMPLE_RATE) / 1000;
+
+    /* The decoded signal is delayed by the encoder padding */
+    dec->request_sample_fmt = AV_SAMPLE_FMT_FLTP;
+    if ((ret = avcodec_parameters_to_context(dec, &(AVCodecParameters){
+            .codec_type     = AVMEDIA_TYPE_AUDIO,
+            .codec_id       = AV_CODEC_ID_AAC,
+            .extradata      = enc->extradata,
+            .extradata_size = enc->extradata_size,
+            .sample_rate    = enc->sample_rate,
+            .ch_layout      = enc->ch_layout })) < 0 ||
+        (ret = avcodec_open2(dec, dec_codec, NULL)) < 0)
+        goto end;
+    for (int i = 0; i <= nb_pkts; i++) {
+        if ((ret = avcodec_send_packet(dec, i < nb_pkts ? pkts[i] : NULL)) < 0)
+            goto end;
+        while ((ret = avcodec_receive_frame(dec, out)) >= 0) {
+            for (int j = 0; j < out->nb_samples; j++, decoded++) {
+                int k = decoded - enc->initial_padding;
+                if (k < 0 || k >= nb_samples)
+                    continue;
+                for (int ch = 0; ch < layout->nb_channels; ch++) {
+                    float d = ((float *)out->extended_data[ch])[j] - samples[ch][k];
+                    err += d * d;
+                    sig += samples[ch][k] * samples[ch][k];
+                }
+            }
+            av_frame_unref(out);
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            goto end;
+    }
+    *snr = 10 * log10(sig / FFMAX(err, 1e-20));
+    ret = 0;
+
+end:
+    for (int i = 0; i < nb_pkts; i++)
+        av_packet_free(&pkts[i]);
+    av_freep(&pkts);
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    av_frame_free(&out);
+    av_dict_free(&dict);
+    avcodec_free_context(&enc);
+    avcodec_free_context(&dec);
+    return ret;
+}
+
+static void usage(void)
+{
+    printf("Usage: aacenc_bench [-l layouts] [-t threads] [-d seconds] [-o options]\n"
+           "  -l  comma separated channel layouts (default: mono,stereo,5.1,7.1)\n"
+           "  -t  comma separated thread counts (default: 1)\n"
+           "  -d  duration of the signal in seconds (default: 10)\n"
+           "  -o  encoder options, as key=value pairs separated by ':'\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *layouts = "mono,stereo,5.1,7.1", *threads = "1", *opts = NULL;
+    double duration = 10;
+    float *samples[64] = { NULL };
+    int nb_samples, opt, ret = 0;
+    char *layout_list, *layout_name, *saveptr1;
+
+    while ((opt = getopt(argc, argv, "l:t:d:o:h")) != -1) {
+        switch (opt) {
+        case 'l': layouts  = optarg;       break;
+        case 't': threads  = optarg;       break;
+        case 'd': duration = atof(optarg); break;
+        case 'o': opts     = optarg;       break;
+        default:
+            usage();
+            return opt != 'h';
+        }
+    }
+    nb_samples = FFMAX(duration, 0.1) * SAMPLE_RATE;
+    av_log_set_level(AV_LOG_ERROR);
+
+    printf("%-10s %7s %9s %8s %7s\n", "layout", "threads", "realtime", "kbit/s", "SNR dB");
+    layout_list = av_strdup(layouts);
+    if (!layout_list)
+        return 1;
+    for (layout_name = av_strtok(layout_list, ",", &saveptr1); layout_name;
+         layout_name = av_strtok(NULL, ",", &saveptr1)) {
+        AVChannelLayout layout = { 0 };
+        char *thread_list, *thread_str, *saveptr2;
+
+        if (av_channel_layout_from_string(&layout, layout_name) < 0 ||
+            layout.nb_channels > FF_ARRAY_ELEMS(samples)) {
+            fprintf(stderr, "Invalid channel layout %s\n", layout_name);
+            ret = 1;
+            break;
+        }
+        for (int ch = 0; ch < layout.nb_channels; ch++) {
+            if (!(samples[ch] = av_malloc_array(nb_samples, sizeof(**samples)))) {
+                ret = 1;
+                break;
+            }
+        }
+        if (ret)
+            break;
+        generate(samples, layout.nb_channels, nb_samples);
+
+        if (!(thread_list = av_strdup(threads))) {
+            ret = 1;
+            break;
+        }
+        for (thread_str = av_strtok(thread_list, ",", &saveptr2); thread_str;
+             thread_str = av_strtok(NULL, ",", &saveptr2)) {
+            double realtime, kbps, snr;
+            int err = encode_decode(&layout, atoi(thread_str), opts, samples,
+                                    nb_samples, &realtime, &kbps, &snr);
+            if (err < 0) {
+                fprintf(stderr, "Encoding %s failed: %s\n", layout_name, av_err2str(err));
+                ret = 1;
+                break;
+            }
+            printf("%-10s %7s %8.1fx %8.1f %7.2f\n", layout_name, thread_str, realtime, kbps, snr);
+        }
+        av_free(thread_list);
+        for (int ch = 0; ch < layout.nb_channels; ch++)
+            av_freep(&samples[ch]);
+        av_channel_layout_uninit(&layout);
+        if (ret)
+            break;
+    }
+    av_free(layout_list);
+    return ret;
+}
@@ -0,0 +1,188 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Run the packets of a video stream, read into memory first, through
+ * bitstream filter chains. Prints the packets filtered per second and the
+ * MD5 of the output of each chain, so that the output of two settings of
+ * a filter can be compared along with their speed.
+ *
+ * make tools/bsf_bench
+ * tools/bsf_bench -i in.mp4 h264_metadata h264_metadata=decompose=needed
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavutil/log.h"
+#include "libavutil/md5.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/bsf.h"
+#include "libavformat/avformat.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+static int filter_packets(const char *filters, const AVStream *st,
+                          AVPacket **pkts, int nb_pkts, int runs,
+                          double *pkts_per_sec, uint8_t md5[16])
+{
+    AVBSFContext *bsf = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    struct AVMD5 *ctx = av_md5_alloc();
+    int64_t elapsed = 0;
+    int ret;
+
+    if (!pkt || !ctx) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    for (int run = 0; run < runs; run++) {
+        int64_t t0;
+
+        av_bsf_free(&bsf);
+        if ((ret = av_bsf_list_parse_str(filters, &bsf)) < 0 ||
+            (ret = avcodec_parameters_copy(bsf->par_in, st->codecpar)) < 0)
+            goto end;
+        bsf->time_base_in = st->time_base;
+        if ((ret = av_bsf_init(bsf)) < 0)
+            goto end;
+        /* Only the output of the first run is hashed */
+        if (!run)
+            av_md5_init(ctx);
+
+        t0 = av_gettime_relative();
+        for (int i = 0; i <= nb_pkts; i++) {
+            if (i < nb_pkts && (ret = av_packet_ref(pkt, pkts[i])) < 0)
+                goto end;
+            if ((ret = av_bsf_send_packet(bsf, i < nb_pkts ? pkt : NULL)) < 0)
+                goto end;
+            while ((ret = av_bsf_receive_packet(bsf, pkt)) >= 0) {
+                if (!run)
+                    av_md5_update(ctx, pkt->data, pkt->size);
+                av_packet_unref(pkt);
+            }
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+                goto end;
+        }
+        elapsed += av_gettime_relative() - t0;
+    }
+    av_md5_final(ctx, md5);
+    *pkts_per_sec = (double)nb_pkts * runs / (FFMAX(elapsed, 1) / 1e6);
+    ret = 0;
+
+end:
+    av_bsf_free(&bsf);
+    av_packet_free(&pkt);
+    av_free(ctx);
+    return ret;
+}
+
+static void usage(void)
+{
+    printf("Usage: bsf_bench -i input [-r runs] filters...\n"
+           "  -i  input file, whose first video stream is filtered\n"
+           "  -r  number of times the packets are filtered (default: 10)\n"
+           "  filters are bitstream filter chains, as for the -bsf option of ffmpeg\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *input = NULL;
+    AVFormatContext *fmt = NULL;
+    AVPacket **pkts = NULL, *pkt = NULL;
+    int64_t bytes = 0;
+    int runs = 10, nb_pkts = 0, opt, idx, ret = 1;
+
+    while ((opt = getopt(argc, argv, "i:r:h")) != -1) {
+        switch (opt) {
+        case 'i': input = optarg;                 break;
+        case 'r': runs  = FFMAX(atoi(optarg), 1); break;
+        default:
+            usage();
+            return opt != 'h';
+        }
+    }
+    if (!input || optind >= argc) {
+        usage();
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+    if (avformat_open_input(&fmt, input, NULL, NULL) < 0 ||
+        avformat_find_stream_info(fmt, NULL) < 0) {
+        fprintf(stderr, "Could not read %s\n", input);
+        goto end;
+    }
+    idx = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (idx < 0) {
+        fprintf(stderr, "No video stream in %s\n", input);
+        goto end;
+    }
+
+    while (1) {
+        if (!(pkt = av_packet_alloc()))
+            goto end;
+        if (av_read_frame(fmt, pkt) < 0)
+            break;
+        if (pkt->stream_index != idx) {
+            av_packet_free(&pkt);
+            continue;
+        }
+        bytes += pkt->size;
+        if (av_dynarray_add_nofree(&pkts, &nb_pkts, pkt) < 0)
+            goto end;
+    }
+    av_packet_free(&pkt);
+    printf("%d packets, %"PRId64" bytes\n", nb_pkts, bytes);
+
+    printf("%-50s %10s %8s %s\n", "filters", "packets/s", "MB/s", "md5");
+    for (int i = optind; i < argc; i++) {
+        double pkts_per_sec;
+        uint8_t md5[16];
+        int err = filter_packets(argv[i], fmt->streams[idx], pkts, nb_pkts,
+                                 runs, &pkts_per_sec, md5);
+        if (err < 0) {
+            fprintf(stderr, "Filtering with %s failed: %s\n", argv[i], av_err2str(err));
+            goto end;
+        }
+        printf("%-50s %10.0f %8.1f ", argv[i], pkts_per_sec,
+               pkts_per_sec * bytes / FFMAX(nb_pkts, 1) / 1e6);
+        for (int j = 0; j < 16; j++)
+            printf("%02x", md5[j]);
+        printf("\n");
+    }
+    ret = 0;
+
+end:
+    av_packet_free(&pkt);
+    for (int i = 0; i < nb_pkts; i++)
+        av_packet_free(&pkts[i]);
+    av_freep(&pkts);
+    avformat_close_input(&fmt);
+    return ret;
+}
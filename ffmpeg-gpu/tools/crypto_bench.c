@@ -83,6 +83,7 @@ struct hash_impl {
 #include "libavutil/twofish.h"
 #include "libavutil/rc4.h"
 #include "libavutil/xtea.h"
+#include "libavutil/xxhash.h"
 
 #define IMPL_USE_lavu IMPL_USE
 
@@ -110,6 +111,26 @@ DEFINE_LAVU_MD(sha512,    AVSHA512, sha512, 512);
 DEFINE_LAVU_MD(ripemd128, AVRIPEMD, ripemd, 128);
 DEFINE_LAVU_MD(ripemd160, AVRIPEMD, ripemd, 160);
 
+static void run_lavu_crc32(uint8_t *output,
+                           const uint8_t *input, unsigned size)
+{
+    static const AVCRC *table;
+    if (!table)
+        table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    AV_WB32(output, av_crc(table, UINT32_MAX, input, size) ^ UINT32_MAX);
+}
+
+static void run_lavu_xxh64(uint8_t *output,
+                           const uint8_t *input, unsigned size)
+{
+    static struct AVXXHash64 *h;
+    if (!h && !(h = av_xxhash64_alloc()))
+        fatal_error("out of memory");
+    av_xxhash64_init(h, 0);
+    av_xxhash64_update(h, input, size);
+    av_xxhash64_final(h, output);
+}
+
 static void run_lavu_aes128(uint8_t *output,
                             const uint8_t *input, unsigned size)
 {
@@ -646,6 +667,8 @@ struct hash_impl implementations[] = {
     IMPL(lavu,     "RIPEMD-128", ripemd128, "9ab8bfba2ddccc5d99c9d4cdfb844a5f")
     IMPL(tomcrypt, "RIPEMD-128", ripemd128, "9ab8bfba2ddccc5d99c9d4cdfb844a5f")
     IMPL_ALL("RIPEMD-160", ripemd160, "62a5321e4fc8784903bb43ab7752c75f8b25af00")
+    IMPL(lavu,     "CRC-32",  crc32,   "12554ca6")
+    IMPL(lavu,     "XXH64",   xxh64,   "d823e9a6d9b68986")
     IMPL_ALL("AES-128",    aes128,    "crc:ff6bc888")
     IMPL_ALL("CAMELLIA",   camellia,  "crc:7abb59a7")
     IMPL(lavu,     "CAST-128", cast128, "crc:456aa584")
@@ -0,0 +1,225 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Encode still images one at a time with the MJPEG encoder, as a JPEG
+ * snapshot service does, for several image sizes and slice thread counts.
+ * Prints the latency of each image from avcodec_send_frame() to the end of
+ * avcodec_receive_packet(): the median, the 90th percentile and the
+ * maximum, along with the average size of the images.
+ *
+ * make tools/mjpegenc_bench
+ * tools/mjpegenc_bench -s 1920x1080,3840x2160 -t 1,4 -o huffman=default
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/dict.h"
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/qsort.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/avcodec.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+/**
+ * Smooth gradients with edges and some noise, which moves with the image
+ * index so that no two images are the same.
+ */
+static void generate(AVFrame *frame, int index)
+{
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, index);
+    for (int y = 0; y < frame->height; y++) {
+        uint8_t *row = frame->data[0] + y * frame->linesize[0];
+        for (int x = 0; x < frame->width; x++) {
+            int v = (x + index * 8) * 255 / frame->width / 2 + y * 127 / frame->height;
+            if (((x + index * 4) / 64 + y / 48) & 1)
+                v = 255 - v;
+            row[x] = av_clip_uint8(v + (int)(av_lfg_get(&lfg) & 15) - 8);
+        }
+    }
+    for (int p = 1; p < 3; p++) {
+        for (int y = 0; y < frame->height >> 1; y++) {
+            uint8_t *row = frame->data[p] + y * frame->linesize[p];
+            for (int x = 0; x < frame->width >> 1; x++)
+                row[x] = 128 + (p == 1 ? x : y) * 96 / frame->width - 24;
+        }
+    }
+}
+
+static int cmp_int64(const void *a, const void *b)
+{
+    return FFDIFFSIGN(*(const int64_t *)a, *(const int64_t *)b);
+}
+
+static int encode_images(int width, int height, int nb_threads, const char *opts,
+                         int nb_images, int64_t *latency, int64_t *bytes)
+{
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    AVCodecContext *enc = NULL;
+    AVDictionary *dict = NULL;
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *pkt = av_packet_alloc();
+    int ret;
+
+    if (!codec || !frame || !pkt || !(enc = avcodec_alloc_context3(codec))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    enc->width        = width;
+    enc->height       = height;
+    enc->pix_fmt      = AV_PIX_FMT_YUVJ420P;
+    enc->time_base    = (AVRational){ 1, 25 };
+    enc->thread_count = nb_threads;
+    enc->thread_type  = FF_THREAD_SLICE;
+    enc->flags       |= AV_CODEC_FLAG_QSCALE;
+    enc->global_quality = FF_QP2LAMBDA * 4;
+    if ((opts && (ret = av_dict_parse_string(&dict, opts, "=", ":", 0)) < 0) ||
+        (ret = avcodec_open2(enc, codec, &dict)) < 0)
+        goto end;
+    if (av_dict_count(dict)) {
+        fprintf(stderr, "Unknown option %s\n", av_dict_get(dict, "", NULL, AV_DICT_IGNORE_SUFFIX)->key);
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+
+    frame->format = enc->pix_fmt;
+    frame->width  = width;
+    frame->height = height;
+    if ((ret = av_frame_get_buffer(frame, 0)) < 0)
+        goto end;
+
+    *bytes = 0;
+    /* the first image warms up the encoder and is not counted */
+    for (int i = -1; i < nb_images; i++) {
+        int64_t t0;
+
+        if ((ret = av_frame_make_writable(frame)) < 0)
+            goto end;
+        generate(frame, i + 1);
+        frame->pts = i + 1;
+
+        t0 = av_gettime_relative();
+        if ((ret = avcodec_send_frame(enc, frame)) < 0 ||
+            (ret = avcodec_receive_packet(enc, pkt)) < 0)
+            goto end;
+        if (i >= 0) {
+            latency[i] = av_gettime_relative() - t0;
+            *bytes    += pkt->size;
+        }
+        av_packet_unref(pkt);
+    }
+    ret = 0;
+
+end:
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    av_dict_free(&dict);
+    avcodec_free_context(&enc);
+    return ret;
+}
+
+static void usage(void)
+{
+    printf("Usage: mjpegenc_bench [-s sizes] [-t threads] [-n images] [-o options]\n"
+           "  -s  comma separated image sizes (default: 1280x720,1920x1080,3840x2160)\n"
+           "  -t  comma separated slice thread counts (default: 1)\n"
+           "  -n  number of images per size and thread count (default: 50)\n"
+           "  -o  encoder options, as key=value pairs separated by ':'\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *sizes = "1280x720,1920x1080,3840x2160", *threads = "1", *opts = NULL;
+    int nb_images = 50, opt, ret = 0;
+    char *size_list, *size_str, *saveptr1;
+    int64_t *latency;
+
+    while ((opt = getopt(argc, argv, "s:t:n:o:h")) != -1) {
+        switch (opt) {
+        case 's': sizes     = optarg;                 break;
+        case 't': threads   = optarg;                 break;
+        case 'n': nb_images = FFMAX(atoi(optarg), 1); break;
+        case 'o': opts      = optarg;                 break;
+        default:
+            usage();
+            return opt != 'h';
+        }
+    }
+    av_log_set_level(AV_LOG_ERROR);
+
+    if (!(latency = av_malloc_array(nb_images, sizeof(*latency))) ||
+        !(size_list = av_strdup(sizes))) {
+        av_free(latency);
+        return 1;
+    }
+
+    printf("%-10s %7s %8s %8s %8s %9s\n", "size", "threads", "p50 ms", "p90 ms", "max ms", "kbytes");
+    for (size_str = av_strtok(size_list, ",", &saveptr1); size_str && !ret;
+         size_str = av_strtok(NULL, ",", &saveptr1)) {
+        char *thread_list, *thread_str, *saveptr2;
+        int width, height;
+
+        if (av_parse_video_size(&width, &height, size_str) < 0) {
+            fprintf(stderr, "Invalid image size %s\n", size_str);
+            ret = 1;
+            break;
+        }
+        if (!(thread_list = av_strdup(threads))) {
+            ret = 1;
+            break;
+        }
+        for (thread_str = av_strtok(thread_list, ",", &saveptr2); thread_str;
+             thread_str = av_strtok(NULL, ",", &saveptr2)) {
+            int64_t bytes;
+            int err = encode_images(width, height, atoi(thread_str), opts,
+                                    nb_images, latency, &bytes);
+            if (err < 0) {
+                fprintf(stderr, "Encoding %s failed: %s\n", size_str, av_err2str(err));
+                ret = 1;
+                break;
+            }
+            AV_QSORT(latency, nb_images, int64_t, cmp_int64);
+            printf("%-10s %7s %8.2f %8.2f %8.2f %9.1f\n", size_str, thread_str,
+                   latency[nb_images / 2] / 1000.0,
+                   latency[nb_images * 9 / 10] / 1000.0,
+                   latency[nb_images - 1] / 1000.0,
+                   bytes / 1000.0 / nb_images);
+        }
+        av_free(thread_list);
+    }
+    av_free(size_list);
+    av_free(latency);
+    return ret;
+}
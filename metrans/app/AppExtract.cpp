@@ -1,6 +1,7 @@
 #include <iostream>
 #include <stdint.h>
 #include "FrameExtractor.h"
+#include "KeyFrameExtractor.h"
 #include "NvCodec/NvCommon.h"
 #include "NvCodec/NvDecLite.h"
 
@@ -18,12 +19,15 @@ void ShowHelpAndExit(const char *szBadOption = NULL) {
         << "-gpu           Ordinal of GPU to use" << endl
         << "-time          Time interval to extract frames" << endl
         << "-frame         Frame interval to extract frames" << endl
+        << "-keyframe      Extract keyframes only, decoded on CPU by a pool of decoders" << endl
+        << "-pool          Number of decoders with -keyframe (default: number of CPUs)" << endl
         ;
     cout << endl;
     exit(1);
 }
 
-void ParseCommandLine(int argc, char *argv[], char *szInputFileName, char *szOutputFileName, int &iGpu, double &timeInterval, int &nFrameInterval)
+void ParseCommandLine(int argc, char *argv[], char *szInputFileName, char *szOutputFileName, int &iGpu, double &timeInterval, int &nFrameInterval,
+    bool &bKeyFrame, int &nDecoder)
 {
     ostringstream oss;
     int i;
@@ -66,19 +70,57 @@ void ParseCommandLine(int argc, char *argv[], char *szInputFileName, char *szOut
             nFrameInterval = atoi(argv[i]);
             continue;
         }
+        if (!_stricmp(argv[i], "-keyframe")) {
+            bKeyFrame = true;
+            continue;
+        }
+        if (!_stricmp(argv[i], "-pool")) {
+            if (++i == argc) {
+                ShowHelpAndExit("-pool");
+            }
+            nDecoder = atoi(argv[i]);
+            continue;
+        }
         ShowHelpAndExit(argv[i]);
     }
 }
 
+void ExtractKeyFrames(const char *szInFilePath, const char *szOutFilePath, double timeInterval, int nFrameInterval, int nDecoder) {
+    KeyFrameExtractor extractor(szInFilePath, nDecoder);
+    if (timeInterval > 0) {
+        cout << "Extract keyframes from '" << szInFilePath << "', interval = " << timeInterval << " sec" << endl;
+        extractor.SetInterval(timeInterval);
+    } else if (nFrameInterval > 0) {
+        cout << "Extract keyframes from '" << szInFilePath << "', interval = " << nFrameInterval << " frames" << endl;
+        extractor.SetInterval(nFrameInterval);
+    } else {
+        cout << "Extract all keyframes from '" << szInFilePath << "'" << endl;
+    }
+
+    ofstream fOut(szOutFilePath, ios::out | ios::binary);
+    uint8_t *pFrame;
+    KeyFrameExtractor::KeyFrame k;
+    while ((pFrame = extractor.Extract(&k))) {
+        LOG(INFO) << "Keyframe " << k.iFrame << " at " << k.time << " sec";
+        fOut.write(reinterpret_cast<char *>(pFrame), extractor.GetFrameSize());
+    }
+}
+
 int main(int argc, char *argv[]) {
     char szInFilePath[256] = "bunny.mp4",
         szOutFilePath[256] = "out.native";
     int iGpu = 0;
     double timeInterval = 0;
     int nFrameInterval = 0;
-    ParseCommandLine(argc, argv, szInFilePath, szOutFilePath, iGpu, timeInterval, nFrameInterval);
+    bool bKeyFrame = false;
+    int nDecoder = 0;
+    ParseCommandLine(argc, argv, szInFilePath, szOutFilePath, iGpu, timeInterval, nFrameInterval, bKeyFrame, nDecoder);
 
     av_log_set_level(AV_LOG_WARNING);
+    if (bKeyFrame) {
+        ExtractKeyFrames(szInFilePath, szOutFilePath, timeInterval, nFrameInterval, nDecoder);
+        return 0;
+    }
     ck(cuInit(0));
     int nGpu = 0;
     ck(cuDeviceGetCount(&nGpu));
@@ -0,0 +1,119 @@
+#include <iostream>
+#include <stdint.h>
+#include "KeyFrameExtractor.h"
+#include "NvCodec/NvCommon.h"
+
+using namespace std;
+
+simplelogger::Logger *logger = simplelogger::LoggerFactory::CreateConsoleLogger(simplelogger::WARNING);
+
+void ShowHelpAndExit(const char *szBadOption = NULL) {
+    if (szBadOption) {
+        cout << "Error parsing \"" << szBadOption << "\"" << endl;
+    }
+    cout << "Options:" << endl
+        << "-i             Input file path" << endl
+        << "-time          Time interval between thumbnails" << endl
+        << "-frame         Frame interval between thumbnails" << endl
+        << "-pool          Largest number of decoders to run (default: number of CPUs)" << endl
+        << "-width         Thumbnail width (default: video width)" << endl
+        ;
+    cout << endl;
+    exit(1);
+}
+
+void ParseCommandLine(int argc, char *argv[], char *szInputFileName, double &timeInterval, int &nFrameInterval, int &nMaxDecoder, int &nWidth)
+{
+    int i;
+    for (i = 1; i < argc; i++) {
+        if (!_stricmp(argv[i], "-h")) {
+            ShowHelpAndExit();
+        }
+        if (!_stricmp(argv[i], "-i")) {
+            if (++i == argc) {
+                ShowHelpAndExit("-i");
+            }
+            sprintf(szInputFileName, "%s", argv[i]);
+            continue;
+        }
+        if (!_stricmp(argv[i], "-time")) {
+            if (++i == argc) {
+                ShowHelpAndExit("-time");
+            }
+            timeInterval = atof(argv[i]);
+            continue;
+        }
+        if (!_stricmp(argv[i], "-frame")) {
+            if (++i == argc) {
+                ShowHelpAndExit("-frame");
+            }
+            nFrameInterval = atoi(argv[i]);
+            continue;
+        }
+        if (!_stricmp(argv[i], "-pool")) {
+            if (++i == argc) {
+                ShowHelpAndExit("-pool");
+            }
+            nMaxDecoder = atoi(argv[i]);
+            continue;
+        }
+        if (!_stricmp(argv[i], "-width")) {
+            if (++i == argc) {
+                ShowHelpAndExit("-width");
+            }
+            nWidth = atoi(argv[i]);
+            continue;
+        }
+        ShowHelpAndExit(argv[i]);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    char szInFilePath[256] = "bunny.mp4";
+    double timeInterval = 0;
+    int nFrameInterval = 0, nMaxDecoder = thread::hardware_concurrency(), nWidth = 0;
+    ParseCommandLine(argc, argv, szInFilePath, timeInterval, nFrameInterval, nMaxDecoder, nWidth);
+    nMaxDecoder = max(nMaxDecoder, 1);
+
+    av_log_set_level(AV_LOG_ERROR);
+    if (nFrameInterval > 0) {
+        cout << "Thumbnails of '" << szInFilePath << "', interval = " << nFrameInterval << " frames" << endl;
+    } else {
+        cout << "Thumbnails of '" << szInFilePath << "', interval = " << timeInterval << " sec" << endl;
+    }
+
+    BufferedFileReader reader(szInFilePath);
+    uint8_t *pBuf;
+    size_t nSize;
+    if (!reader.GetBuffer(&pBuf, &nSize)) {
+        return 1;
+    }
+    vector<int> vnDecoder;
+    for (int n = 1; n < nMaxDecoder; n *= 2) {
+        vnDecoder.push_back(n);
+    }
+    vnDecoder.push_back(nMaxDecoder);
+
+    const int nRound = 3;
+    for (int nDecoder : vnDecoder) {
+        int nThumbnail = 0;
+        StopWatch w;
+        w.Start();
+        for (int i = 0; i < nRound; i++) {
+            KeyFrameExtractor extractor(pBuf, nSize, nDecoder);
+            if (nFrameInterval > 0) {
+                extractor.SetInterval(nFrameInterval);
+            } else {
+                extractor.SetInterval(timeInterval);
+            }
+            extractor.SetThumbnailSize(nWidth, 0);
+            while (extractor.Extract()) {
+                nThumbnail++;
+            }
+        }
+        double t = w.Stop();
+        cout << "decoders=" << nDecoder << ", thumbnails=" << nThumbnail / nRound
+            << ", thumbnails/sec=" << nThumbnail / t << endl;
+    }
+    return 0;
+}
@@ -16,6 +16,9 @@
 #include <memory>
 #include <cuda_runtime.h>
 #include <boost/algorithm/string/replace.hpp>
+extern "C" {
+#include <libavutil/cpu.h>
+}
 #include "AvToolkit/Demuxer.h"
 #include "AvToolkit/Muxer.h"
 #include "AvToolkit/AudDec.h"
@@ -336,6 +339,10 @@ int main(int argc, char *argv[]) {
     CUcontext cuContext = NULL;
     ck(cuCtxCreate(&cuContext, 0, cuDevice));
 
+    if (options.nThreadPool >= 0) {
+        av_cpu_set_thread_pool(options.nThreadPool);
+    }
+
     vector<int> vnFps(options.nSession);
     vector<int> vbEnd(options.nSession);
     vector<thread *> vpth;
@@ -14,6 +14,7 @@ struct Options {
     string strInputFile;
     int nSession;
     int nFpsLimit;
+    int nThreadPool;
 
     string strAudioFilterDesc;
     string strAudioCodec;
@@ -43,6 +44,9 @@ struct Options {
         strInputFile = pt.get<string>("Options.InputFile", "");
         nSession = pt.get<int>("Options.Session", 1);
         nFpsLimit = pt.get<int>("Options.FpsLimit", 0);
+        // < 0: each codec context and filter graph has its own slice threads,
+        // >= 0: all sessions share a pool of that many threads, 0 for one per CPU
+        nThreadPool = pt.get<int>("Options.ThreadPool", -1);
 
         strAudioFilterDesc = pt.get<string>("Options.AudioFilterDesc", "");
         strAudioCodec = pt.get<string>("Options.AudioCodec", "");
@@ -49,15 +49,21 @@ public:
                 if (pFrameDst) delete[] pFrameDst;
                 nWidthDst = frm->width;
                 nHeightDst = frm->height;
-                pFrameDst = new uint8_t[nWidthDst * nHeightDst * 3 / 2];
+                // An NV12 chroma row of an odd width holds nWidthDst + 1 bytes
+                nPitchDst = (nWidthDst + 1) & ~1;
+                pFrameDst = new uint8_t[nPitchDst * (nHeightDst + (nHeightDst + 1) / 2)];
             }
-            av_image_copy_plane(pFrameDst, nWidthDst, frm->data[0], frm->linesize[0], nWidthDst, nHeightDst);
-            av_image_copy_plane(pFrameDst + nWidthDst * nHeightDst, nWidthDst, frm->data[1], frm->linesize[1], nWidthDst, nHeightDst / 2);
+            // Large frames are copied by several threads
+            uint8_t *apDst[4] = {pFrameDst, pFrameDst + nPitchDst * nHeightDst};
+            const uint8_t *apSrc[4] = {frm->data[0], frm->data[1]};
+            ptrdiff_t anDstLinesize[4] = {nPitchDst, nPitchDst};
+            ptrdiff_t anSrcLinesize[4] = {frm->linesize[0], frm->linesize[1]};
+            av_image_copy_threads(apDst, anDstLinesize, apSrc, anSrcLinesize, AV_PIX_FMT_NV12, nWidthDst, nHeightDst, 0);
 
             CUDA_MEMCPY2D m = { 0 };
             m.srcMemoryType = CU_MEMORYTYPE_HOST;
             m.srcHost = pFrameDst;
-            m.srcPitch = nWidthDst;
+            m.srcPitch = nPitchDst;
             m.dstMemoryType = CU_MEMORYTYPE_DEVICE;
             m.dstDevice = (CUdeviceptr)dpFrame;
             m.dstPitch = dpFrame2TransData[dpFrame].nPitch;
@@ -86,4 +92,5 @@ private:
     uint8_t *pFrameSrc = NULL, *pFrameDst = NULL;
     int nWidthSrc = 0, nWidthDst = 0; 
     int nHeightSrc = 0, nHeightDst = 0;
+    int nPitchDst = 0;
 };
@@ -0,0 +1,411 @@
+#pragma once
+
+#include "AvToolkit/Demuxer.h"
+#include "AvToolkit/VidDec.h"
+extern "C" {
+#include <libswscale/swscale.h>
+}
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <math.h>
+
+extern simplelogger::Logger *logger;
+
+/* Picks at most one keyframe per interval on a fixed grid of targets, like FrameExtractor does
+   for any frame: a keyframe is taken once it reaches the target, then the target moves on by
+   whole intervals past it. The time grid starts at the first keyframe, the frame grid at 0. */
+class KeyFrameSelector {
+public:
+    KeyFrameSelector(double timeInterval = 0, int nFrameInterval = 0)
+        : m_timeInterval(timeInterval), m_frameInterval(nFrameInterval) {}
+
+    bool Select(double time, int64_t iFrame) {
+        const double eps = 1.0e-6;
+        if (m_frameInterval > 0) {
+            if (iFrame < m_frameTarget) {
+                return false;
+            }
+            m_frameTarget += (iFrame - m_frameTarget) / m_frameInterval * m_frameInterval + m_frameInterval;
+            return true;
+        }
+        if (m_timeInterval <= 0) {
+            return true;
+        }
+        if (m_bFirst) {
+            m_timeTarget = time;
+            m_bFirst = false;
+        }
+        if (time < m_timeTarget - eps) {
+            return false;
+        }
+        m_timeTarget += (floor((time - m_timeTarget + eps) / m_timeInterval) + 1) * m_timeInterval;
+        return true;
+    }
+
+private:
+    double m_timeInterval;
+    int m_frameInterval;
+    double m_timeTarget = 0;
+    int64_t m_frameTarget = 0;
+    bool m_bFirst = true;
+};
+
+/* Thumbnails from keyframes only: the keyframes are enumerated from the container index when
+   it is complete (falling back to a scan of the packet flags), only the selected packets are
+   read, and they are decoded in parallel by a pool of independent software decoders, each
+   keyframe on its own. Thumbnails are NV12 in host memory and come out in stream order.
+   The intervals apply to the timestamps of the index, decoding times in MP4 and presentation
+   times in Matroska; the packet scan uses decoding times, like the index libavformat builds. */
+class KeyFrameExtractor {
+public:
+    struct KeyFrame {
+        int64_t iFrame;     // decoding order, -1 if unknown
+        int64_t dts;        // in stream time base; the index timestamp until the packet is read
+        int64_t pts;        // of the decoded frame
+        int64_t pos;
+        double time;        // pts in seconds
+    };
+
+    KeyFrameExtractor(const char *szFilePath, int nDecoder = 0) : m_dm(szFilePath) {
+        Init(nDecoder);
+    }
+    KeyFrameExtractor(uint8_t * const pBuffer, size_t nBufferSize, int nDecoder = 0) : m_dm(pBuffer, nBufferSize) {
+        Init(nDecoder);
+    }
+    ~KeyFrameExtractor() {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_bStop = true;
+        }
+        m_cvJob.notify_all();
+        for (auto &th : m_vWorker) {
+            th.join();
+        }
+        for (auto &job : m_qJob) {
+            av_packet_free(&job.pkt);
+        }
+        avcodec_parameters_free(&m_par);
+        LOG(INFO) << "nKeyFrameSelected=" << m_nSubmitted << ", nPacketDemuxed=" << m_nPacketDemuxed
+            << ", nFrameExtracted=" << m_nExtracted << ", nDecoder=" << m_vWorker.size()
+            << (m_bIndex ? ", from index" : ", from packet scan");
+    }
+
+    void SetInterval(int nFrameInterval) {
+        m_frameInterval = nFrameInterval;
+        m_timeInterval = 0;
+    }
+    void SetInterval(double timeInterval) {
+        m_timeInterval = timeInterval;
+        m_frameInterval = 0;
+    }
+    /* 0 keeps the video size; with one side 0 it follows the aspect ratio. Set before Extract(). */
+    void SetThumbnailSize(int nWidth, int nHeight) {
+        if (!m_dm.GetVideoStream()) {
+            return;
+        }
+        AVCodecParameters *par = m_dm.GetVideoStream()->codecpar;
+        if (!nWidth && !nHeight) {
+            nWidth = par->width;
+            nHeight = par->height;
+        } else if (!par->width || !par->height) {
+            LOG(WARNING) << "Video size unknown, thumbnail size " << nWidth << "x" << nHeight;
+        } else if (!nHeight) {
+            nHeight = (int)((int64_t)nWidth * par->height / par->width);
+        } else if (!nWidth) {
+            nWidth = (int)((int64_t)nHeight * par->width / par->height);
+        }
+        m_nWidth = (nWidth + 1) & ~1;
+        m_nHeight = (nHeight + 1) & ~1;
+    }
+    /* Scan the packets even if the index is usable; set before Extract() */
+    void SetIndexUsage(bool bUseIndex) {
+        m_bUseIndex = bUseIndex;
+    }
+
+    int GetWidth() {
+        return m_nWidth;
+    }
+    int GetHeight() {
+        return m_nHeight;
+    }
+    int GetFrameSize() {
+        return m_nWidth * m_nHeight * 3 / 2;
+    }
+    bool IsIndexUsed() {
+        return m_bIndex;
+    }
+
+    /* Returns the next thumbnail, valid until the next call, or nullptr at the end */
+    uint8_t *Extract(KeyFrame *pKeyFrame = nullptr) {
+        if (!m_bStarted) {
+            Start();
+        }
+        while (true) {
+            Feed();
+            std::unique_lock<std::mutex> lock(m_mtx);
+            if (m_iNext >= m_nSubmitted) {
+                return nullptr;
+            }
+            m_cvResult.wait(lock, [this] { return m_mResult.count(m_iNext) > 0; });
+            auto it = m_mResult.find(m_iNext++);
+            m_result = std::move(it->second);
+            m_mResult.erase(it);
+            lock.unlock();
+
+            if (m_result.vFrame.empty()) {
+                LOG(WARNING) << "No frame decoded from keyframe at pos " << m_result.keyFrame.pos;
+                continue;
+            }
+            if (pKeyFrame) *pKeyFrame = m_result.keyFrame;
+            m_nExtracted++;
+            return m_result.vFrame.data();
+        }
+    }
+
+private:
+    class IndexDemuxer : public Demuxer {
+    public:
+        IndexDemuxer(const char *szFilePath) : Demuxer(szFilePath) {}
+        IndexDemuxer(uint8_t * const pBuffer, size_t nBufferSize) : Demuxer(pBuffer, nBufferSize) {}
+
+        /* Keyframes of the index, numbered when the index has every frame. Empty if the index
+           is built while reading (and so is incomplete before the end) or missing. */
+        bool GetIndexKeyFrames(std::vector<KeyFrame> &vKeyFrame, bool &bNumbered) {
+            vKeyFrame.clear();
+            AVStream *st = GetVideoStream();
+            if (!st || (m_fmt->iformat->flags & AVFMT_GENERIC_INDEX) || !m_fmt->iformat->read_seek) {
+                return false;
+            }
+            // Some demuxers (Matroska with the cues at the end) load the index on the first seek
+            av_seek_frame(m_fmt, m_iVideo, st->start_time != AV_NOPTS_VALUE ? st->start_time : 0, AVSEEK_FLAG_BACKWARD);
+            int n = avformat_index_get_entries_count(st);
+            int64_t iFrame = 0;
+            bool bAllKey = true;
+            for (int i = 0; i < n; i++) {
+                const AVIndexEntry *e = avformat_index_get_entry(st, i);
+                if (e->flags & AVINDEX_DISCARD_FRAME) {
+                    continue;
+                }
+                if (e->flags & AVINDEX_KEYFRAME) {
+                    vKeyFrame.push_back({iFrame, e->timestamp, AV_NOPTS_VALUE, e->pos, 0});
+                } else {
+                    bAllKey = false;
+                }
+                iFrame++;
+            }
+            bNumbered = !bAllKey || (st->nb_frames > 0 && iFrame == st->nb_frames);
+            if (!bNumbered) {
+                for (auto &k : vKeyFrame) {
+                    k.iFrame = -1;
+                }
+            }
+            return vKeyFrame.size() > 0;
+        }
+
+        /* Reads the packet of an index entry. The entry may hold the position of the packet
+           (MP4) or of the cluster it starts (Matroska), and its decoding or presentation time,
+           so the packet is the first keyframe from that position with that timestamp. The
+           keyframe gets the position and the decoding time of the packet. */
+        bool ReadAt(KeyFrame &k, AVPacket **pPkt) {
+            if (av_seek_frame(m_fmt, m_iVideo, k.dts, AVSEEK_FLAG_BACKWARD) < 0) {
+                LOG(ERROR) << "av_seek_frame() failed at dts " << k.dts;
+                return false;
+            }
+            AVPacket *pkt = nullptr;
+            while (Demux(&pkt)) {
+                if (pkt->pos < k.pos) {
+                    continue;
+                }
+                if ((pkt->flags & AV_PKT_FLAG_KEY) && (pkt->dts == k.dts || pkt->pts == k.dts)) {
+                    k.pos = pkt->pos;
+                    k.dts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+                    *pPkt = pkt;
+                    return true;
+                }
+                if (pkt->dts != AV_NOPTS_VALUE && pkt->dts > k.dts && (pkt->pts == AV_NOPTS_VALUE || pkt->pts > k.dts)) {
+                    break;
+                }
+            }
+            LOG(ERROR) << "Keyframe of index entry at pos " << k.pos << " not found after seeking";
+            return false;
+        }
+    };
+
+    struct Job {
+        int i;
+        KeyFrame keyFrame;
+        AVPacket *pkt;
+    };
+    struct Result {
+        KeyFrame keyFrame;
+        std::vector<uint8_t> vFrame;
+    };
+
+    void Init(int nDecoder) {
+        if (!m_dm.GetVideoStream()) {
+            LOG(ERROR) << "No video stream";
+            return;
+        }
+        m_nDecoder = nDecoder > 0 ? nDecoder : std::max(1u, std::thread::hardware_concurrency());
+        SetThumbnailSize(0, 0);
+    }
+
+    void Start() {
+        m_bStarted = true;
+        AVStream *st = m_dm.GetVideoStream();
+        if (!st) {
+            return;
+        }
+        m_tb = st->time_base;
+        KeyFrameSelector selector(m_timeInterval, m_frameInterval);
+        std::vector<KeyFrame> vKeyFrame;
+        bool bNumbered = false;
+        if (m_bUseIndex && m_dm.GetIndexKeyFrames(vKeyFrame, bNumbered) && (bNumbered || !m_frameInterval)) {
+            m_bIndex = true;
+            for (auto &k : vKeyFrame) {
+                if (selector.Select(k.dts * av_q2d(m_tb), k.iFrame)) {
+                    m_vSelected.push_back(k);
+                }
+            }
+            LOG(INFO) << m_vSelected.size() << " of " << vKeyFrame.size() << " keyframes selected from the index";
+        } else {
+            m_selector = selector;
+        }
+        // The decoders are opened while Feed() demuxes, which may update the stream parameters
+        m_par = cknn(avcodec_parameters_alloc());
+        ckav(avcodec_parameters_copy(m_par, st->codecpar));
+        for (int i = 0; i < m_nDecoder; i++) {
+            m_vWorker.push_back(std::thread(&KeyFrameExtractor::Decode, this));
+        }
+    }
+
+    /* Keeps the decoders busy, with a bounded number of thumbnails in flight */
+    void Feed() {
+        while (!m_bEnd && m_nSubmitted - m_iNext < 2 * m_nDecoder) {
+            AVPacket *pkt = nullptr;
+            KeyFrame k;
+            if (m_bIndex) {
+                if (m_iSelected >= (int)m_vSelected.size()) {
+                    m_bEnd = true;
+                    break;
+                }
+                k = m_vSelected[m_iSelected++];
+                if (!m_dm.ReadAt(k, &pkt)) {
+                    continue;
+                }
+                m_nPacketDemuxed++;
+            } else {
+                while (true) {
+                    if (!m_dm.Demux(&pkt)) {
+                        pkt = nullptr;
+                        break;
+                    }
+                    if (pkt->flags & AV_PKT_FLAG_DISCARD) {
+                        continue;
+                    }
+                    m_nPacketDemuxed++;
+                    int64_t dts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+                    k = {m_nPacketDemuxed - 1, dts, AV_NOPTS_VALUE, pkt->pos, 0};
+                    if ((pkt->flags & AV_PKT_FLAG_KEY) && m_selector.Select(dts * av_q2d(m_tb), k.iFrame)) {
+                        break;
+                    }
+                }
+                if (!pkt) {
+                    m_bEnd = true;
+                    break;
+                }
+            }
+            k.pts = pkt->pts;
+            Job job = {m_nSubmitted, k, av_packet_clone(pkt)};
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_qJob.push_back(job);
+                m_nSubmitted++;
+            }
+            m_cvJob.notify_one();
+        }
+    }
+
+    /* A decoder of the pool: every keyframe is decoded alone, then the decoder is flushed */
+    void Decode() {
+        VidDec dec(m_par);
+        AVCodecContext *ctx = dec.GetCodecContext();
+        // Output keyframes that aren't IDR (open GOP) even though no recovery point precedes them
+        ctx->flags2 |= AV_CODEC_FLAG2_SHOW_ALL;
+        SwsContext *sws = nullptr;
+        std::vector<AVFrame *> vFrm;
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mtx);
+                m_cvJob.wait(lock, [this] { return m_bStop || !m_qJob.empty(); });
+                if (m_bStop) {
+                    break;
+                }
+                job = m_qJob.front();
+                m_qJob.pop_front();
+            }
+
+            Result result = {job.keyFrame};
+            AVFrame *frm = nullptr;
+            dec.Decode(job.pkt, vFrm);
+            if (vFrm.empty()) {
+                dec.Decode(nullptr, vFrm);
+            }
+            if (vFrm.size()) {
+                frm = vFrm[0];
+            }
+            if (frm) {
+                sws = sws_getCachedContext(sws, frm->width, frm->height, (AVPixelFormat)frm->format,
+                    m_nWidth, m_nHeight, AV_PIX_FMT_NV12, SWS_BILINEAR, nullptr, nullptr, nullptr);
+                if (sws) {
+                    result.vFrame.resize(GetFrameSize());
+                    uint8_t *apDst[] = {result.vFrame.data(), result.vFrame.data() + m_nWidth * m_nHeight};
+                    int anDstPitch[] = {m_nWidth, m_nWidth};
+                    sws_scale(sws, frm->data, frm->linesize, 0, frm->height, apDst, anDstPitch);
+                }
+                int64_t pts = frm->best_effort_timestamp;
+                if (pts != AV_NOPTS_VALUE) {
+                    result.keyFrame.pts = pts;
+                }
+            }
+            result.keyFrame.time = result.keyFrame.pts != AV_NOPTS_VALUE ? result.keyFrame.pts * av_q2d(m_tb) : NAN;
+            avcodec_flush_buffers(ctx);
+            av_packet_free(&job.pkt);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_mResult[job.i] = std::move(result);
+            }
+            m_cvResult.notify_all();
+        }
+        sws_freeContext(sws);
+    }
+
+    IndexDemuxer m_dm;
+    AVCodecParameters *m_par = nullptr;
+    AVRational m_tb = {1, 1};
+    int m_nDecoder = 1;
+    int m_nWidth = 0, m_nHeight = 0;
+    int m_frameInterval = 0;
+    double m_timeInterval = 0;
+    bool m_bUseIndex = true, m_bIndex = false, m_bStarted = false, m_bEnd = false;
+
+    KeyFrameSelector m_selector;
+    std::vector<KeyFrame> m_vSelected;
+    int m_iSelected = 0;
+
+    std::vector<std::thread> m_vWorker;
+    std::mutex m_mtx;
+    std::condition_variable m_cvJob, m_cvResult;
+    std::deque<Job> m_qJob;
+    std::map<int, Result> m_mResult;
+    Result m_result;
+    bool m_bStop = false;
+    int m_nSubmitted = 0, m_iNext = 0;
+    int64_t m_nPacketDemuxed = 0, m_nExtracted = 0;
+};
@@ -101,6 +101,16 @@ private:
         return !vdpFrame.empty();
     }
     void CopyImage(CUdeviceptr dpSrc, int nWidthInBytes, int nHeight, uint8_t *pDst, int nDstPitch, bool bDevice) {
+        if (!nDstPitch || nDstPitch == nWidthInBytes) {
+            // Contiguous rows on both sides: a single linear copy
+            size_t nSize = (size_t)nWidthInBytes * nHeight;
+            if (bDevice) {
+                ck(cuMemcpyDtoD((CUdeviceptr)pDst, dpSrc, nSize));
+            } else {
+                ck(cuMemcpyDtoH(pDst, dpSrc, nSize));
+            }
+            return;
+        }
         CUDA_MEMCPY2D m = { 0 };
         m.WidthInBytes = nWidthInBytes;
         m.Height = nHeight;
@@ -0,0 +1,242 @@
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include "../app/KeyFrameExtractor.h"
+
+using namespace std;
+
+simplelogger::Logger *logger = simplelogger::LoggerFactory::CreateConsoleLogger(simplelogger::WARNING);
+
+typedef KeyFrameExtractor::KeyFrame KeyFrame;
+
+/* The thumbnails expected on the time grid t0 + k * interval: for each grid point, the first
+   keyframe at or after it, each keyframe at most once */
+vector<int> SelectOnGrid(vector<double> const &vTime, double interval) {
+    vector<int> vSelected;
+    if (vTime.empty()) {
+        return vSelected;
+    }
+    for (int k = 0; ; k++) {
+        double target = vTime[0] + k * interval;
+        if (target > vTime.back() + 1.0e-6) {
+            break;
+        }
+        for (int i = vSelected.size() ? vSelected.back() : 0; i < (int)vTime.size(); i++) {
+            if (vTime[i] >= target - 1.0e-6) {
+                if (vSelected.empty() || vSelected.back() != i) {
+                    vSelected.push_back(i);
+                }
+                break;
+            }
+        }
+    }
+    return vSelected;
+}
+
+bool TestSelector() {
+    struct {
+        vector<double> vTime;
+        double interval;
+        vector<int> vExpected;
+    } aCase[] = {
+        {{0, 2, 4, 6, 8, 10, 12}, 5, {0, 3, 5}},
+        {{0, 2, 4, 6, 8, 10, 12}, 0.5, {0, 1, 2, 3, 4, 5, 6}},
+        {{1.5, 1.9, 7, 7.2, 8, 30}, 2, {0, 2, 4, 5}},
+        {{0.1, 0.2}, 10, {0}},
+    };
+    bool bOk = true;
+    for (auto &c : aCase) {
+        KeyFrameSelector selector(c.interval);
+        vector<int> vSelected;
+        for (int i = 0; i < (int)c.vTime.size(); i++) {
+            if (selector.Select(c.vTime[i], -1)) vSelected.push_back(i);
+        }
+        bOk &= vSelected == c.vExpected && SelectOnGrid(c.vTime, c.interval) == c.vExpected;
+    }
+
+    srand(1);
+    for (int r = 0; r < 1000; r++) {
+        vector<double> vTime;
+        double t = rand() % 100 / 10.0;
+        for (int i = rand() % 50; i >= 0; i--) {
+            vTime.push_back(t);
+            t += (1 + rand() % 80) / 25.0;
+        }
+        double interval = (1 + rand() % 100) / 20.0;
+        KeyFrameSelector selector(interval);
+        vector<int> vSelected;
+        for (int i = 0; i < (int)vTime.size(); i++) {
+            if (selector.Select(vTime[i], -1)) vSelected.push_back(i);
+        }
+        bOk &= vSelected == SelectOnGrid(vTime, interval);
+    }
+
+    for (int interval = 1; interval < 40; interval++) {
+        KeyFrameSelector selector(0, interval);
+        int64_t iLast = -interval;
+        for (int64_t iFrame = 0; iFrame < 500; iFrame += 1 + iFrame % 7) {
+            bool bExpected = iFrame / interval > iLast / interval;
+            if (selector.Select(0, iFrame) != bExpected) bOk = false;
+            if (bExpected) iLast = iFrame;
+        }
+    }
+    cout << "selector: " << (bOk ? "ok" : "FAILED") << endl;
+    return bOk;
+}
+
+/* The keyframes of the file from the packet flags, with a plain demuxing pass */
+vector<KeyFrame> ScanKeyFrames(const char *szFilePath, AVRational &tb) {
+    Demuxer demuxer(szFilePath);
+    tb = demuxer.GetVideoStream()->time_base;
+    vector<KeyFrame> vKeyFrame;
+    AVPacket *pkt = nullptr;
+    int64_t iFrame = 0;
+    while (demuxer.Demux(&pkt)) {
+        if (pkt->flags & AV_PKT_FLAG_DISCARD) {
+            continue;
+        }
+        if (pkt->flags & AV_PKT_FLAG_KEY) {
+            int64_t dts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+            vKeyFrame.push_back({iFrame, dts, pkt->pts, pkt->pos, pkt->pts * av_q2d(tb)});
+        }
+        iFrame++;
+    }
+    return vKeyFrame;
+}
+
+/* The keyframes of the index, as in KeyFrameExtractor, each with the index of the packet it
+   points to in vAll: the first keyframe from its position with its timestamp */
+vector<KeyFrame> IndexKeyFrames(const char *szFilePath, vector<KeyFrame> const &vAll, vector<int> &vPacket) {
+    class IndexDemuxer : public Demuxer {
+    public:
+        IndexDemuxer(const char *szFilePath) : Demuxer(szFilePath) {
+            // Loads the index if it is deferred
+            av_seek_frame(m_fmt, m_iVideo, 0, AVSEEK_FLAG_BACKWARD);
+        }
+    } demuxer(szFilePath);
+    AVStream *st = demuxer.GetVideoStream();
+    vector<KeyFrame> vKeyFrame;
+    vPacket.clear();
+    int64_t iFrame = 0;
+    for (int i = 0; i < avformat_index_get_entries_count(st); i++) {
+        const AVIndexEntry *e = avformat_index_get_entry(st, i);
+        if (e->flags & AVINDEX_DISCARD_FRAME) {
+            continue;
+        }
+        if (e->flags & AVINDEX_KEYFRAME) {
+            int j = 0;
+            while (j < (int)vAll.size() && (vAll[j].pos < e->pos || (vAll[j].dts != e->timestamp && vAll[j].pts != e->timestamp))) {
+                j++;
+            }
+            vKeyFrame.push_back({iFrame, e->timestamp, AV_NOPTS_VALUE, e->pos, 0});
+            vPacket.push_back(j);
+        }
+        iFrame++;
+    }
+    return vKeyFrame;
+}
+
+/* The keyframes selected from vKeyFrame, on the time grid or every nFrameInterval frames */
+vector<int> SelectExpected(vector<KeyFrame> const &vKeyFrame, AVRational tb, double timeInterval, int nFrameInterval) {
+    vector<int> vExpected;
+    if (nFrameInterval) {
+        int64_t iLast = -nFrameInterval;
+        for (int i = 0; i < (int)vKeyFrame.size(); i++) {
+            if (vKeyFrame[i].iFrame / nFrameInterval > iLast / nFrameInterval) {
+                vExpected.push_back(i);
+                iLast = vKeyFrame[i].iFrame;
+            }
+        }
+    } else if (timeInterval > 0) {
+        vector<double> vTime;
+        for (auto &k : vKeyFrame) {
+            vTime.push_back(k.dts * av_q2d(tb));
+        }
+        vExpected = SelectOnGrid(vTime, timeInterval);
+    } else {
+        for (int i = 0; i < (int)vKeyFrame.size(); i++) {
+            vExpected.push_back(i);
+        }
+    }
+    return vExpected;
+}
+
+vector<KeyFrame> Extract(const char *szFilePath, double timeInterval, int nFrameInterval, int nDecoder, bool bUseIndex,
+    vector<uint8_t> &vThumbnail, bool &bIndexUsed) {
+    KeyFrameExtractor extractor(szFilePath, nDecoder);
+    if (nFrameInterval) {
+        extractor.SetInterval(nFrameInterval);
+    } else {
+        extractor.SetInterval(timeInterval);
+    }
+    extractor.SetThumbnailSize(160, 0);
+    extractor.SetIndexUsage(bUseIndex);
+    vector<KeyFrame> vKeyFrame;
+    KeyFrame k;
+    uint8_t *pFrame;
+    vThumbnail.clear();
+    while ((pFrame = extractor.Extract(&k))) {
+        vKeyFrame.push_back(k);
+        vThumbnail.insert(vThumbnail.end(), pFrame, pFrame + extractor.GetFrameSize());
+    }
+    bIndexUsed = extractor.IsIndexUsed();
+    return vKeyFrame;
+}
+
+bool TestFile(const char *szFilePath, double timeInterval, int nFrameInterval) {
+    AVRational tb;
+    vector<KeyFrame> vAll = ScanKeyFrames(szFilePath, tb);
+    vector<int> vScanExpected = SelectExpected(vAll, tb, timeInterval, nFrameInterval), vIndexExpected, vPacket;
+    for (int i : SelectExpected(IndexKeyFrames(szFilePath, vAll, vPacket), tb, timeInterval, nFrameInterval)) {
+        vIndexExpected.push_back(vPacket[i]);
+    }
+
+    bool bOk = true, bIndexUsed = false;
+    vector<uint8_t> vRef, vThumbnail;
+    for (bool bUseIndex : {false, true}) {
+        for (int nDecoder : {1, 3, 8}) {
+            vector<KeyFrame> vKeyFrame = Extract(szFilePath, timeInterval, nFrameInterval, nDecoder, bUseIndex,
+                nDecoder > 1 ? vThumbnail : vRef, bIndexUsed);
+            vector<int> const &vExpected = bIndexUsed ? vIndexExpected : vScanExpected;
+            bool bMatch = vKeyFrame.size() == vExpected.size();
+            for (int i = 0; bMatch && i < (int)vKeyFrame.size(); i++) {
+                if (vExpected[i] >= (int)vAll.size()) {
+                    bMatch = false;
+                    break;
+                }
+                KeyFrame const &k = vKeyFrame[i], &e = vAll[vExpected[i]];
+                // The thumbnail of the keyframe packet, presented at the time of the packet
+                bMatch = k.pos == e.pos && k.pts == e.pts && fabs(k.time - e.time) < 1.0e-6;
+            }
+            // Thumbnails are the same whatever the number of decoders
+            if (nDecoder > 1) {
+                bMatch &= vThumbnail == vRef;
+            }
+            cout << "time interval " << timeInterval << ", frame interval " << nFrameInterval << ", "
+                << nDecoder << " decoders, " << (bIndexUsed ? "index" : "packet scan") << ": "
+                << vKeyFrame.size() << " thumbnails " << (bMatch ? "ok" : "FAILED") << endl;
+            bOk &= bMatch;
+        }
+    }
+    return bOk;
+}
+
+int main(int argc, char *argv[]) {
+    const char *szInFilePath = "bunny.mp4";
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            szInFilePath = argv[++i];
+        } else {
+            cout << "Usage: " << argv[0] << " [-i input_file]" << endl;
+            return 1;
+        }
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+    bool bOk = TestSelector();
+    bOk &= TestFile(szInFilePath, 0, 0);
+    bOk &= TestFile(szInFilePath, 1.0, 0);
+    bOk &= TestFile(szInFilePath, 3.5, 0);
+    bOk &= TestFile(szInFilePath, 0, 50);
+    return !bOk;
+}